@@ -0,0 +1,136 @@
+// Compares the token-splicing conf patcher with the parse/modify/print path it replaced, on an
+// ubnt_lcm_gui.conf with many customAnimations. Run with `make bench`.
+
+#include "bench.h"
+#include "cJSON.h"
+#include "unifi_profile_conf.h"
+#include "utils_json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_ENTRIES 2000
+
+// Pretty-printed like the device writes it, with WELCOME last so a scan has to cross every entry.
+static char *build_conf(size_t entries, size_t *len) {
+    size_t cap = 256 + entries * 160;
+    char *buf = malloc(cap);
+    size_t n = 0;
+
+    if (!buf) {
+        return NULL;
+    }
+
+    n += (size_t)snprintf(buf + n, cap - n, "{\n    \"brightness\": 80,\n    \"customAnimations\": [\n");
+
+    for (size_t i = 0; i < entries; i++) {
+        n += (size_t)snprintf(buf + n, cap - n,
+                              "        {\n            \"guiId\": \"CUSTOM_%zu\",\n            \"file\": \"anim_%zu.png\",\n"
+                              "            \"count\": %zu,\n            \"enable\": true\n        },\n", i, i, i % 60);
+    }
+
+    n += (size_t)snprintf(buf + n, cap - n,
+                          "        {\n            \"guiId\": \"WELCOME\",\n            \"file\": \"old.png\",\n"
+                          "            \"count\": 1,\n            \"durationMs\": 100,\n            \"enable\": false,\n"
+                          "            \"loop\": false\n        }\n    ]\n}\n");
+
+    *len = n;
+    return buf;
+}
+
+// The former implementation: parse the whole tree, update one element, print everything.
+static char *patch_with_cjson(const char *in, const unifi_profile_t *desired) {
+    cJSON *root = cJSON_Parse(in);
+    cJSON *item = NULL;
+
+    if (!root) {
+        return NULL;
+    }
+
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(root, "customAnimations")) {
+        cJSON *gui_id = cJSON_GetObjectItemCaseSensitive(item, "guiId");
+
+        if (cJSON_IsString(gui_id) && strcmp(gui_id->valuestring, "WELCOME") == 0) {
+            json_upsert_number_cs(item, "count", desired->welcome.count);
+            json_upsert_number_cs(item, "durationMs", desired->welcome.duration_ms);
+            json_upsert_bool_cs(item, "enable", desired->welcome.enabled);
+            json_upsert_string_cs(item, "file", desired->welcome.file);
+            json_upsert_bool_cs(item, "loop", desired->welcome.loop);
+            break;
+        }
+    }
+
+    char *out = cJSON_Print(root);
+    cJSON_Delete(root);
+
+    return out;
+}
+
+typedef struct {
+    char *conf;
+    size_t len;
+    unifi_profile_t desired;
+} patch_case_t;
+
+static bool bench_cjson(void *arg, size_t iterations) {
+    const patch_case_t *c = arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        char *out = patch_with_cjson(c->conf, &c->desired);
+
+        if (!out) {
+            return false;
+        }
+
+        cJSON_free(out);
+    }
+
+    return true;
+}
+
+static bool bench_splice(void *arg, size_t iterations) {
+    const patch_case_t *c = arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        char *out = NULL;
+        size_t out_len = 0;
+
+        if (!unifi_profile_patch_lcm_gui_buffer(c->conf, c->len, &c->desired, &out, &out_len)) {
+            return false;
+        }
+
+        free(out);
+    }
+
+    return true;
+}
+
+int main(void) {
+    patch_case_t c;
+    char name[64];
+
+    bench_begin("conf_patch");
+
+    memset(&c.desired, 0, sizeof(c.desired));
+    c.desired.welcome.enabled = true;
+    c.desired.welcome.count = 24;
+    c.desired.welcome.duration_ms = 3000;
+    snprintf(c.desired.welcome.file, sizeof(c.desired.welcome.file), "%s", "christmas.png");
+
+    c.conf = build_conf(BENCH_ENTRIES, &c.len);
+    if (!c.conf) {
+        bench_fail("lcm_gui", "cannot build the conf");
+        return bench_end();
+    }
+
+    snprintf(name, sizeof(name), "lcm_gui/%d_entries/cjson", BENCH_ENTRIES);
+    bench_run(name, c.len, bench_cjson, &c);
+
+    snprintf(name, sizeof(name), "lcm_gui/%d_entries/splice", BENCH_ENTRIES);
+    bench_run(name, c.len, bench_splice, &c);
+
+    free(c.conf);
+
+    return bench_end();
+}
@@ -0,0 +1,116 @@
+// Compares the schema-bound profile.json parser with the cJSON tree walk it replaced. Run with `make bench`.
+
+#include "bench.h"
+#include "cJSON.h"
+#include "json_bind.h"
+#include "unifi_profile_json.h"
+#include "utils_json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char PROFILE_JSON[] =
+    "{\n"
+    "\t\"schemaVersion\":\t1,\n"
+    "\t\"welcome\":\t{\n"
+    "\t\t\"enabled\":\ttrue,\n"
+    "\t\t\"file\":\t\"christmas_tree.png\",\n"
+    "\t\t\"count\":\t24,\n"
+    "\t\t\"durationMs\":\t3000,\n"
+    "\t\t\"loop\":\tfalse,\n"
+    "\t\t\"guiId\":\t\"WELCOME\"\n"
+    "\t},\n"
+    "\t\"ringButton\":\t{\n"
+    "\t\t\"enabled\":\ttrue,\n"
+    "\t\t\"file\":\t\"jingle_bells.wav\",\n"
+    "\t\t\"repeatTimes\":\t1,\n"
+    "\t\t\"volume\":\t90,\n"
+    "\t\t\"soundStateName\":\t\"RING_BUTTON_PRESSED\"\n"
+    "\t}\n"
+    "}\n";
+
+static void copy_string(char *dst, size_t size, const char *src) {
+    if (src) {
+        snprintf(dst, size, "%s", src);
+    }
+}
+
+// The former implementation: build the tree, then look every member up by name.
+static bool parse_with_cjson(const char *json, size_t len, unifi_profile_t *p) {
+    cJSON *root = cJSON_ParseWithLength(json, len);
+
+    if (!root) {
+        return false;
+    }
+
+    memset(p, 0, sizeof(*p));
+    json_get_int(root, "schemaVersion", &p->schema_version);
+
+    cJSON *welcome = cJSON_GetObjectItemCaseSensitive(root, "welcome");
+    json_get_bool(welcome, "enabled", &p->welcome.enabled);
+    copy_string(p->welcome.file, sizeof(p->welcome.file), json_get_string(welcome, "file"));
+    json_get_int(welcome, "count", &p->welcome.count);
+    json_get_int(welcome, "durationMs", &p->welcome.duration_ms);
+    json_get_bool(welcome, "loop", &p->welcome.loop);
+    copy_string(p->welcome.gui_id, sizeof(p->welcome.gui_id), json_get_string(welcome, "guiId"));
+
+    cJSON *ring = cJSON_GetObjectItemCaseSensitive(root, "ringButton");
+    json_get_bool(ring, "enabled", &p->ring_button.enabled);
+    copy_string(p->ring_button.file, sizeof(p->ring_button.file), json_get_string(ring, "file"));
+    json_get_int(ring, "repeatTimes", &p->ring_button.repeat_times);
+    json_get_int(ring, "volume", &p->ring_button.volume);
+    copy_string(p->ring_button.sound_state_name, sizeof(p->ring_button.sound_state_name), json_get_string(ring, "soundStateName"));
+
+    cJSON_Delete(root);
+
+    return true;
+}
+
+static bool bench_cjson(void *arg, size_t iterations) {
+    unifi_profile_t p;
+
+    (void)arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!parse_with_cjson(PROFILE_JSON, sizeof(PROFILE_JSON) - 1, &p)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool bench_bind(void *arg, size_t iterations) {
+    unifi_profile_t p;
+
+    (void)arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, PROFILE_JSON, sizeof(PROFILE_JSON) - 1, &p, NULL)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(void) {
+    size_t len = sizeof(PROFILE_JSON) - 1;
+    unifi_profile_t a;
+    unifi_profile_t b;
+
+    bench_begin("json_bind");
+
+    if (!parse_with_cjson(PROFILE_JSON, len, &a) ||
+        !json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, PROFILE_JSON, len, &b, NULL) ||
+        memcmp(&a.welcome, &b.welcome, sizeof(a.welcome)) != 0 || a.ring_button.volume != b.ring_button.volume) {
+        bench_fail("profile_json", "parsers disagree");
+        return bench_end();
+    }
+
+    bench_run("profile_json/cjson", len, bench_cjson, NULL);
+    bench_run("profile_json/json_bind", len, bench_bind, NULL);
+
+    return bench_end();
+}
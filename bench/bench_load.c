@@ -0,0 +1,473 @@
+// End-to-end load: the service runs in-process against a local MQTT broker stand-in (bench/support/mqtt_broker.c)
+// and simulated doorbells. Commands are published on cmd/preset_set like Home Assistant would, and each one is
+// timed from its publish until the device's status topic returns to "idle".
+//
+//   BENCH_LOAD_MESSAGES (2000)   commands for an unknown preset; they fail fast, so this measures MQTT and routing
+//   BENCH_LOAD_APPLIES (20)      commands that run a full apply on the simulator; each device alternates between two
+//                                presets, since re-selecting the preset a device already runs uploads nothing
+//   BENCH_LOAD_CONCURRENCY (8)   commands in flight; beyond the inbound queue capacity the router drops
+//   BENCH_LOAD_DUPLICATES (0)    extra copies of every command, published back to back
+//   BENCH_LOAD_DEVICES (2)       simulated doorbells; commands go round robin
+//   BENCH_SIM_LATENCY_MS (0), BENCH_SIM_BANDWIDTH_KBPS (0 = unlimited)
+//
+// deadline_init() is left out, so a newer command does not supersede the queued ones for its device and every
+// command is served and timed.
+
+#include "bench.h"
+#include "arena.h"
+#include "config.h"
+#include "ha_mqtt.h"
+#include "ha_status.h"
+#include "ha_topics.h"
+#include "metrics.h"
+#include "mqtt.h"
+#include "mqtt_broker.h"
+#include "mqtt_router.h"
+#include "unifi_profiles_repo.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOAD_MAX_DEVICES 8
+#define LOAD_PROFILES_SRC "tests/fixtures/profiles"
+#define LOAD_PRESET "Christmas"
+#define LOAD_PRESET_ALT "Christmas Eve"
+#define LOAD_PRESET_ALT_DIR "christmas_eve"
+#define LOAD_UNKNOWN_PRESET "No Such Preset"
+#define LOAD_CONNECT_TIMEOUT_MS 5000
+#define LOAD_QUIET_MS 5000      // no command finished for this long: the rest are not coming
+
+typedef struct {
+    double *sent_ns;    // publish times of commands that have not seen their idle yet, oldest first
+    size_t head;
+    size_t count;
+    size_t cap;
+} load_pending_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cv = PTHREAD_COND_INITIALIZER;
+static load_pending_t g_pending[LOAD_MAX_DEVICES];
+static const char *g_status_topics[LOAD_MAX_DEVICES];
+static size_t g_devices;
+static double *g_latencies;
+static size_t g_completed;
+static double g_last_progress_ns;
+
+static atomic_bool g_service_running;
+static bool g_mqtt_initialized;
+static char g_root[] = "/tmp/doorbell-bench-load-XXXXXX";
+
+static int env_int(const char *name, int fallback, int min, int max) {
+    const char *value = getenv(name);
+
+    if (!value || !*value) {
+        return fallback;
+    }
+
+    int n = atoi(value);
+
+    return n >= min && n <= max ? n : fallback;
+}
+
+static bool pending_push(load_pending_t *q, double sent_ns) {
+    if (q->count == q->cap) {
+        size_t cap = q->cap ? q->cap * 2 : 256;
+        double *grown = malloc(cap * sizeof(*grown));
+
+        if (!grown) {
+            return false;
+        }
+
+        for (size_t i = 0; i < q->count; i++) {
+            grown[i] = q->sent_ns[(q->head + i) % q->cap];
+        }
+
+        free(q->sent_ns);
+        q->sent_ns = grown;
+        q->head = 0;
+        q->cap = cap;
+    }
+
+    q->sent_ns[(q->head + q->count++) % q->cap] = sent_ns;
+
+    return true;
+}
+
+// Broker thread: every "idle" completes the oldest outstanding command of its device. That pairing is exact
+// while nothing is dropped, since the router runs commands in arrival order.
+static void on_publish(const char *topic, const char *payload, size_t len, void *user) {
+    (void)user;
+
+    if (len != 4 || memcmp(payload, "idle", 4) != 0) {
+        return;
+    }
+
+    double now = bench_now_ns();
+
+    pthread_mutex_lock(&g_lock);
+
+    for (size_t d = 0; d < g_devices; d++) {
+        load_pending_t *q = &g_pending[d];
+
+        if (strcmp(topic, g_status_topics[d]) != 0 || q->count == 0) {
+            continue;
+        }
+
+        g_latencies[g_completed++] = now - q->sent_ns[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        g_last_progress_ns = now;
+        pthread_cond_signal(&g_cv);
+        break;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void *service_loop(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&g_service_running)) {
+        mqtt_loop(100);
+        status_flush_performance();
+    }
+
+    return NULL;
+}
+
+static size_t dropped_since(uint64_t base) {
+    return (size_t)(metrics_counter_value(METRIC_INBOUND_DROPPED) - base);
+}
+
+// Waits with g_lock held until at most limit commands are outstanding. False if the service stopped answering.
+static bool wait_outstanding(size_t sent, size_t limit, uint64_t dropped_base) {
+    while (sent - g_completed - dropped_since(dropped_base) > limit) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 50 * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        // Drops do not signal, so poll for them.
+        pthread_cond_timedwait(&g_cv, &g_lock, &deadline);
+
+        if (bench_now_ns() - g_last_progress_ns > LOAD_QUIET_MS * 1e6) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Command i goes to device i % g_devices; successive commands to one device cycle through payloads.
+static void run_scenario(const char *name, const char *const *payloads, size_t payload_count, size_t messages, size_t concurrency, size_t duplicates) {
+    size_t copies = 1 + duplicates;
+    size_t total = messages * copies;
+    size_t window = concurrency > copies ? concurrency : copies;
+    size_t sent = 0;
+    bool answered = true;
+
+    g_latencies = malloc(total * sizeof(*g_latencies));
+    if (!g_latencies) {
+        bench_fail(name, "out of memory");
+        return;
+    }
+
+    pthread_mutex_lock(&g_lock);
+
+    for (size_t d = 0; d < g_devices; d++) {
+        g_pending[d].head = 0;
+        g_pending[d].count = 0;
+    }
+
+    g_completed = 0;
+    g_last_progress_ns = bench_now_ns();
+
+    uint64_t dropped_base = metrics_counter_value(METRIC_INBOUND_DROPPED);
+    double start = bench_now_ns();
+
+    for (size_t i = 0; i < messages && answered; i++) {
+        size_t device = i % g_devices;
+        const char *topic = ha_topic(device, HA_TOPIC_CMD_PRESET_SET);
+        const char *payload = payloads[(i / g_devices) % payload_count];
+
+        answered = wait_outstanding(sent, window - copies, dropped_base);
+
+        for (size_t c = 0; c < copies && answered; c++) {
+            if (!pending_push(&g_pending[device], bench_now_ns())) {
+                answered = false;
+                break;
+            }
+
+            // The broker thread takes g_lock to record an idle, so deliver without holding it.
+            pthread_mutex_unlock(&g_lock);
+            mqtt_broker_publish(topic, payload, strlen(payload));
+            pthread_mutex_lock(&g_lock);
+            sent++;
+        }
+    }
+
+    if (answered) {
+        answered = wait_outstanding(sent, 0, dropped_base);
+    }
+
+    double elapsed = bench_now_ns() - start;
+    size_t completed = g_completed;
+    size_t dropped = dropped_since(dropped_base);
+
+    pthread_mutex_unlock(&g_lock);
+
+    // Commands that were neither dropped nor answered with an idle of their own were merged with another one.
+    size_t coalesced = sent > completed + dropped ? sent - completed - dropped : 0;
+    bench_field_t fields[] = {
+        { "sent", (long long)sent },
+        { "duplicates", (long long)(sent - sent / copies) },
+        { "completed", (long long)completed },
+        { "dropped", (long long)dropped },
+        { "coalesced", (long long)coalesced },
+        { "commands_per_s", (long long)((double)completed / (elapsed / 1e9)) },
+    };
+
+    if (!answered && completed == 0) {
+        bench_fail(name, "the service did not answer");
+    } else {
+        bench_record_latency(name, g_latencies, completed, fields, sizeof(fields) / sizeof(fields[0]));
+    }
+
+    free(g_latencies);
+    g_latencies = NULL;
+}
+
+static bool copy_file(const char *from, const char *to) {
+    char *data = NULL;
+    size_t len = 0;
+
+    if (!utils_read_file(from, &data, &len)) {
+        return false;
+    }
+
+    FILE *fp = fopen(to, "wb");
+    bool ok = fp && fwrite(data, 1, len, fp) == len;
+
+    if (fp && fclose(fp) != 0) {
+        ok = false;
+    }
+
+    arena_free(data);
+
+    return ok;
+}
+
+// The service writes its last-applied state next to the profiles, so it gets a copy of the fixture library.
+static bool copy_profile(const char *name, const char *profiles_dir, const char *as) {
+    char src_dir[PATH_MAX];
+    char dst_dir[PATH_MAX];
+    bool ok = true;
+
+    if (!utils_build_path(src_dir, sizeof(src_dir), LOAD_PROFILES_SRC, name) ||
+        !utils_build_path(dst_dir, sizeof(dst_dir), profiles_dir, as)) {
+        return false;
+    }
+
+    DIR *dir = opendir(src_dir);
+    if (!dir || !utils_create_directory(dst_dir)) {
+        if (dir) {
+            closedir(dir);
+        }
+        return false;
+    }
+
+    struct dirent *entry;
+
+    while (ok && (entry = readdir(dir)) != NULL) {
+        char from[PATH_MAX];
+        char to[PATH_MAX];
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        ok = utils_build_path(from, sizeof(from), src_dir, entry->d_name) &&
+             utils_build_path(to, sizeof(to), dst_dir, entry->d_name) &&
+             copy_file(from, to);
+    }
+
+    closedir(dir);
+
+    return ok;
+}
+
+static bool write_config(const char *path, int devices) {
+    FILE *fp = fopen(path, "w");
+
+    if (!fp) {
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"mqtt\": { \"host\": \"127.0.0.1\", \"port\": %d, \"qos\": 1, \"clean_session\": 1 },\n  \"ssh\": [\n",
+            mqtt_broker_port());
+
+    for (int d = 0; d < devices; d++) {
+        fprintf(fp, "    { \"id\": \"door%d\", \"host\": \"127.0.0.1\", \"sim\": { \"root\": \"%s/door%d\", \"latency_ms\": %d, \"bandwidth_kbps\": %d } }%s\n",
+                d, g_root, d, env_int("BENCH_SIM_LATENCY_MS", 0, 0, 60000), env_int("BENCH_SIM_BANDWIDTH_KBPS", 0, 0, 10000000),
+                d + 1 < devices ? "," : "");
+    }
+
+    fprintf(fp, "  ],\n  \"presets\": [ { \"name\": \"%s\", \"directory\": \"christmas\" }, { \"name\": \"%s\", \"directory\": \"%s\" } ]\n}\n",
+            LOAD_PRESET, LOAD_PRESET_ALT, LOAD_PRESET_ALT_DIR);
+
+    return fclose(fp) == 0;
+}
+
+// The same assets as the fixture with the other welcome image, so switching between the two presets changes the device.
+static bool write_alt_profile(const char *profiles_dir) {
+    char path[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), "%s/%s/profile.json", profiles_dir, LOAD_PRESET_ALT_DIR) >= (int)sizeof(path)) {
+        return false;
+    }
+
+    FILE *fp = fopen(path, "w");
+
+    if (!fp) {
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"schemaVersion\": 1,\n"
+                "  \"welcome\": { \"enabled\": true, \"file\": \"christmas2.png\", \"count\": 1, \"durationMs\": 1000, \"loop\": false },\n"
+                "  \"ringButton\": { \"enabled\": true, \"file\": \"christmas.ogg\", \"repeatTimes\": 1, \"volume\": 100 }\n}\n");
+
+    return fclose(fp) == 0;
+}
+
+// Like main(): configuration, profiles, topics, MQTT and the inbound router. False if the service did not
+// come up or never subscribed to its commands on the broker.
+static bool service_start(config_t *cfg, mqtt_router_ctx_t *ctx, pthread_t *loop, const char **reason) {
+    char config_path[PATH_MAX];
+    char profiles_dir[PATH_MAX];
+
+    snprintf(config_path, sizeof(config_path), "%s/config.json", g_root);
+    snprintf(profiles_dir, sizeof(profiles_dir), "%s/profiles", g_root);
+
+    *reason = "cannot prepare the service configuration";
+    if (!write_config(config_path, (int)g_devices) || !utils_create_directory(profiles_dir) ||
+        !copy_profile("christmas", profiles_dir, "christmas") || !copy_profile("christmas", profiles_dir, LOAD_PRESET_ALT_DIR) ||
+        !write_alt_profile(profiles_dir) || !config_load(config_path, cfg)) {
+        return false;
+    }
+
+    *reason = "the service did not start";
+    if (!profiles_repo_init(profiles_dir, &cfg->preset_cfg) || !ha_topics_init(cfg) || !ha_mqtt_bind(cfg) ||
+        !mqtt_init(&cfg->mqtt_cfg)) {
+        return false;
+    }
+
+    g_mqtt_initialized = true;
+
+    ctx->device = NULL;
+    ctx->devices_cfg = &cfg->devices_cfg;
+    ctx->fleet_cfg = &cfg->fleet_cfg;
+    ctx->preset_cfg = &cfg->preset_cfg;
+
+    if (!mqtt_router_start(ctx)) {
+        return false;
+    }
+
+    ha_routes_register_commands(&cfg->devices_cfg);
+
+    atomic_store(&g_service_running, true);
+    if (pthread_create(loop, NULL, service_loop, NULL) != 0) {
+        atomic_store(&g_service_running, false);
+        return false;
+    }
+
+    // The on-connect handler subscribes the fleet command last.
+    double deadline = bench_now_ns() + LOAD_CONNECT_TIMEOUT_MS * 1e6;
+
+    *reason = "the service did not subscribe on the broker; is the MQTT client library a stub?";
+    while (!mqtt_broker_subscribed(ha_topic(0, HA_TOPIC_CMD_FLEET_APPLY))) {
+        if (bench_now_ns() > deadline) {
+            return false;
+        }
+
+        struct timespec ts = { 0, 10 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    return true;
+}
+
+int main(void) {
+    bench_begin("load");
+
+    config_t cfg = {0};
+    mqtt_router_ctx_t ctx;
+    pthread_t loop;
+    const char *reason = NULL;
+
+    size_t messages = (size_t)env_int("BENCH_LOAD_MESSAGES", 2000, 0, 1000000);
+    size_t applies = (size_t)env_int("BENCH_LOAD_APPLIES", 20, 0, 100000);
+    size_t concurrency = (size_t)env_int("BENCH_LOAD_CONCURRENCY", 8, 1, 100000);
+    size_t duplicates = (size_t)env_int("BENCH_LOAD_DUPLICATES", 0, 0, 100);
+
+    g_devices = (size_t)env_int("BENCH_LOAD_DEVICES", 2, 1, LOAD_MAX_DEVICES);
+
+    if (!mkdtemp(g_root) || !mqtt_broker_start(on_publish, NULL)) {
+        bench_fail("load", "cannot set up the broker stand-in");
+        return bench_end();
+    }
+
+    bool started = service_start(&cfg, &ctx, &loop, &reason);
+
+    if (started) {
+        for (size_t d = 0; d < g_devices; d++) {
+            g_status_topics[d] = ha_topic(d, HA_TOPIC_STATUS);
+        }
+
+        static const char *const unknown_presets[] = { LOAD_UNKNOWN_PRESET };
+        static const char *const apply_presets[] = { LOAD_PRESET, LOAD_PRESET_ALT };
+        char name[64];
+
+        snprintf(name, sizeof(name), "load/routing/c%zu_d%zu", concurrency, duplicates);
+        if (messages > 0) {
+            run_scenario(name, unknown_presets, 1, messages, concurrency, duplicates);
+        }
+
+        snprintf(name, sizeof(name), "load/apply/c%zu_d%zu", concurrency, duplicates);
+        if (applies > 0) {
+            run_scenario(name, apply_presets, 2, applies, concurrency, duplicates);
+        }
+    } else {
+        bench_skip("load", reason);
+    }
+
+    if (atomic_load(&g_service_running)) {
+        atomic_store(&g_service_running, false);
+        pthread_join(loop, NULL);
+    }
+
+    mqtt_router_stop();
+
+    if (g_mqtt_initialized) {
+        mqtt_disconnect();
+    }
+    mqtt_broker_stop();
+    ha_topics_shutdown();
+    profiles_repo_shutdown();
+    config_free(&cfg);
+
+    for (size_t d = 0; d < LOAD_MAX_DEVICES; d++) {
+        free(g_pending[d].sent_ns);
+    }
+
+    utils_delete_directory(g_root);
+
+    return bench_end();
+}
@@ -0,0 +1,225 @@
+// End-to-end apply and download. Runs against the simulated doorbell in a temporary root, or over SSH
+// against a real doorbell (or anything laid out like one) when BENCH_SSH_HOST is set.
+//
+//   BENCH_SIM_LATENCY_MS (0), BENCH_SIM_BANDWIDTH_KBPS (0 = unlimited)
+//   BENCH_SSH_HOST, BENCH_SSH_PORT (22), BENCH_SSH_USER (ubnt), BENCH_SSH_PASSWORD
+//   BENCH_PROFILE_DIR (a generated profile with a 256 KiB sprite and a 128 KiB sound), BENCH_MACRO_RUNS (5)
+
+#include "bench.h"
+#include "errors.h"
+#include "ssh.h"
+#include "transport.h"
+#include "unifi_profile_json.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MACRO_MAX_RUNS 31
+#define MACRO_SPRITE_BYTES (256 * 1024)
+#define MACRO_SOUND_BYTES (128 * 1024)
+
+static const char *env_or(const char *name, const char *fallback) {
+    const char *value = getenv(name);
+
+    return value && *value ? value : fallback;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void record_runs(const char *name, double *samples, int runs, size_t bytes_per_op) {
+    qsort(samples, (size_t)runs, sizeof(samples[0]), compare_double);
+    bench_record(name, (size_t)runs, samples[runs / 2], samples[0], bytes_per_op);
+}
+
+// Incompressible bytes, so neither the PNG optimizer nor gzip shrinks the payload below its nominal size.
+static bool write_noise_file(const char *dir, const char *name, size_t size, unsigned int seed) {
+    char path[PATH_MAX];
+
+    if (!utils_build_path(path, sizeof(path), dir, name)) {
+        return false;
+    }
+
+    FILE *fp = fopen(path, "wb");
+
+    if (!fp) {
+        return false;
+    }
+
+    unsigned int state = seed;
+
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1103515245u + 12345u;
+        fputc((int)(state >> 24), fp);
+    }
+
+    return fclose(fp) == 0;
+}
+
+// The test fixture's assets are empty, which would make the transfer rate meaningless.
+static bool write_bench_profile(const char *dir) {
+    static const char profile_json[] =
+        "{ \"schemaVersion\": 1,\n"
+        "  \"welcome\": { \"enabled\": true, \"file\": \"bench.png\", \"count\": 1, \"durationMs\": 1000, \"loop\": false },\n"
+        "  \"ringButton\": { \"enabled\": true, \"file\": \"bench.ogg\", \"repeatTimes\": 1, \"volume\": 100 } }\n";
+    char path[PATH_MAX];
+
+    return write_noise_file(dir, "bench.png", MACRO_SPRITE_BYTES, 1u) && write_noise_file(dir, "bench.ogg", MACRO_SOUND_BYTES, 2u) &&
+           utils_build_path(path, sizeof(path), dir, "profile.json") && utils_write_file(path, profile_json);
+}
+
+static bool run_apply(const config_ssh_t *ssh_cfg, const char *profile_dir, const unifi_profile_t *profile, bool force, unifi_apply_stats_t *stats) {
+    transport_t *session = transport_open(ssh_cfg);
+
+    if (!session) {
+        return false;
+    }
+
+    int rc = unifi_profile_upload_and_apply(session, profile_dir, profile, force, stats);
+    transport_close(session);
+
+    return rc == ERROR_NONE;
+}
+
+static bool run_download(const config_ssh_t *ssh_cfg) {
+    char tmp_dir[] = "/tmp/doorbell-bench-download-XXXXXX";
+    unifi_profile_t profile;
+
+    if (!mkdtemp(tmp_dir)) {
+        return false;
+    }
+
+    transport_t *session = transport_open(ssh_cfg);
+    bool ok = session && unifi_profile_download_and_load(session, tmp_dir, NULL, &profile);
+
+    if (session) {
+        transport_close(session);
+    }
+
+    utils_delete_directory(tmp_dir);
+
+    return ok;
+}
+
+int main(void) {
+    bench_begin("macro");
+
+    config_ssh_t ssh_cfg;
+    char sim_root[] = "/tmp/doorbell-bench-sim-XXXXXX";
+    const char *host = getenv("BENCH_SSH_HOST");
+    const char *backend = "sim";
+
+    memset(&ssh_cfg, 0, sizeof(ssh_cfg));
+
+    if (host && *host) {
+        backend = "ssh";
+        snprintf(ssh_cfg.host, sizeof(ssh_cfg.host), "%s", host);
+        snprintf(ssh_cfg.user, sizeof(ssh_cfg.user), "%s", env_or("BENCH_SSH_USER", "ubnt"));
+        snprintf(ssh_cfg.password_env, sizeof(ssh_cfg.password_env), "%s", "BENCH_SSH_PASSWORD");
+        ssh_cfg.port = atoi(env_or("BENCH_SSH_PORT", "22"));
+    } else if (mkdtemp(sim_root)) {
+        snprintf(ssh_cfg.sim.root, sizeof(ssh_cfg.sim.root), "%s", sim_root);
+        ssh_cfg.sim.latency_ms = atoi(env_or("BENCH_SIM_LATENCY_MS", "0"));
+        ssh_cfg.sim.bandwidth_kbps = atoi(env_or("BENCH_SIM_BANDWIDTH_KBPS", "0"));
+    } else {
+        bench_fail("apply/sim", "cannot create the simulator root");
+        return bench_end();
+    }
+
+    int runs = atoi(env_or("BENCH_MACRO_RUNS", "5"));
+    if (runs < 1 || runs > MACRO_MAX_RUNS) {
+        runs = 5;
+    }
+
+    if (!ssh_global_init()) {
+        bench_fail("apply", "libssh2 init failed");
+        return bench_end();
+    }
+
+    char generated_dir[] = "/tmp/doorbell-bench-profile-XXXXXX";
+    const char *profile_dir = getenv("BENCH_PROFILE_DIR");
+    bool generated = false;
+    unifi_profile_t profile;
+    double samples[MACRO_MAX_RUNS];
+    char name[64];
+
+    snprintf(name, sizeof(name), "apply/%s", backend);
+
+    if (!profile_dir || !*profile_dir) {
+        generated = mkdtemp(generated_dir) != NULL;
+        profile_dir = generated_dir;
+    }
+
+    if (profile_dir == generated_dir && (!generated || !write_bench_profile(generated_dir))) {
+        bench_fail(name, "cannot generate the profile");
+    } else if (!unifi_profile_load_from_file(profile_dir, &profile)) {
+        bench_fail(name, "cannot load the profile");
+    } else {
+        unifi_apply_stats_t stats = {0};
+        bool ok = true;
+
+        // Forced, so every run uploads and restarts even though the profile is applied after the first one.
+        for (int r = 0; r < runs && ok; r++) {
+            double start = bench_now_ns();
+            ok = run_apply(&ssh_cfg, profile_dir, &profile, true, &stats);
+            samples[r] = bench_now_ns() - start;
+        }
+
+        if (!ok) {
+            bench_fail(name, "apply failed");
+        } else {
+            record_runs(name, samples, runs, (size_t)stats.bytes_sent);
+
+            // Re-applying what the device already runs: only the confs and sidecars are read.
+            snprintf(name, sizeof(name), "apply_unchanged/%s", backend);
+
+            for (int r = 0; r < runs && ok; r++) {
+                double start = bench_now_ns();
+                ok = run_apply(&ssh_cfg, profile_dir, &profile, false, &stats) && stats.unchanged;
+                samples[r] = bench_now_ns() - start;
+            }
+
+            if (ok) {
+                record_runs(name, samples, runs, (size_t)stats.bytes_sent);
+            } else {
+                bench_fail(name, "re-apply was not detected as unchanged");
+            }
+        }
+    }
+
+    bool ok = true;
+
+    snprintf(name, sizeof(name), "download/%s", backend);
+
+    for (int r = 0; r < runs && ok; r++) {
+        double start = bench_now_ns();
+        ok = run_download(&ssh_cfg);
+        samples[r] = bench_now_ns() - start;
+    }
+
+    if (ok) {
+        record_runs(name, samples, runs, 0);
+    } else {
+        bench_fail(name, "download failed");
+    }
+
+    ssh_global_cleanup();
+
+    if (generated) {
+        utils_delete_directory(generated_dir);
+    }
+
+    if (ssh_cfg.sim.root[0] != '\0') {
+        utils_delete_directory(sim_root);
+    }
+
+    return bench_end();
+}
@@ -0,0 +1,231 @@
+// Microbenchmarks for the hot paths of an apply: hashing, conf patching, inbound routing, discovery payloads
+// and the apply script. Run with `make bench` from the repository root.
+
+#include "bench.h"
+#include "config.h"
+#include "ha_discovery.h"
+#include "ha_topics.h"
+#include "mqtt_router.h"
+#include "ssh_commands.h"
+#include "unifi_profiles_repo.h"
+#include "unifi_profile_conf.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MD5_FILE_SIZE (256 * 1024)
+#define ROUTER_TOPIC "bench/doorbell/cmd"
+#define ROUTER_IN_FLIGHT 48     // stays below the inbound queue capacity so nothing is dropped
+
+static char g_tmp_dir[] = "/tmp/doorbell-bench-XXXXXX";
+
+static size_t file_size(const char *path) {
+    struct stat st;
+
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static bool bench_md5(void *arg, size_t iterations) {
+    const char *path = arg;
+    char hex[33];
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!utils_md5_file_hex(path, hex)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+typedef struct {
+    char in_path[PATH_MAX];
+    char out_path[PATH_MAX];
+    unifi_profile_t desired;
+} patch_case_t;
+
+static bool bench_patch_lcm_gui(void *arg, size_t iterations) {
+    const patch_case_t *c = arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!unifi_profile_patch_lcm_gui_conf(c->in_path, c->out_path, &c->desired)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool bench_patch_sounds_leds(void *arg, size_t iterations) {
+    const patch_case_t *c = arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!unifi_profile_patch_sounds_leds_conf(c->in_path, c->out_path, &c->desired)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static atomic_size_t g_routed;
+
+static void route_count(const mqtt_router_ctx_t *ctx, const char *payload, size_t len) {
+    (void)ctx;
+    (void)payload;
+    (void)len;
+
+    atomic_fetch_add_explicit(&g_routed, 1, memory_order_release);
+}
+
+// Enqueue on this thread, dispatch on the router's worker; an operation ends when its handler has run.
+static bool bench_router(void *arg, size_t iterations) {
+    (void)arg;
+
+    static const char payload[] = "Christmas";
+    size_t base = atomic_load_explicit(&g_routed, memory_order_acquire);
+
+    for (size_t i = 0; i < iterations; i++) {
+        while (i - (atomic_load_explicit(&g_routed, memory_order_acquire) - base) >= ROUTER_IN_FLIGHT) {
+            sched_yield();
+        }
+
+        if (mqtt_router_enqueue(ROUTER_TOPIC, (int)strlen(ROUTER_TOPIC), payload, sizeof(payload) - 1) != 0) {
+            return false;
+        }
+    }
+
+    while (atomic_load_explicit(&g_routed, memory_order_acquire) - base < iterations) {
+        sched_yield();
+    }
+
+    return true;
+}
+
+static bool bench_discovery(void *arg, size_t iterations) {
+    const config_t *cfg = arg;
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!ha_publish_discovery(cfg)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool bench_apply_command(void *arg, size_t iterations) {
+    (void)arg;
+
+    char cmd[4096];
+
+    for (size_t i = 0; i < iterations; i++) {
+        if (!build_apply_profile_command(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi/upload-a1B2c3", "christmas_tree.png", "jingle_bells.wav")) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool write_random_file(const char *path, size_t size) {
+    FILE *fp = fopen(path, "wb");
+
+    if (!fp) {
+        return false;
+    }
+
+    unsigned int seed = 42;
+
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        fputc((int)(seed >> 16) & 0xff, fp);
+    }
+
+    return fclose(fp) == 0;
+}
+
+static void desired_profile(unifi_profile_t *p) {
+    memset(p, 0, sizeof(*p));
+
+    p->welcome.enabled = true;
+    p->welcome.count = 24;
+    p->welcome.duration_ms = 3000;
+    snprintf(p->welcome.file, sizeof(p->welcome.file), "%s", "christmas_tree.png");
+
+    p->ring_button.enabled = true;
+    p->ring_button.repeat_times = 1;
+    p->ring_button.volume = 90;
+    snprintf(p->ring_button.file, sizeof(p->ring_button.file), "%s", "jingle_bells.wav");
+}
+
+int main(void) {
+    bench_begin("micro");
+
+    if (!mkdtemp(g_tmp_dir)) {
+        bench_fail("setup", "cannot create a temporary directory");
+        return bench_end();
+    }
+
+    char md5_path[PATH_MAX];
+    snprintf(md5_path, sizeof(md5_path), "%s/asset.bin", g_tmp_dir);
+
+    if (write_random_file(md5_path, MD5_FILE_SIZE)) {
+        bench_run("md5_file_hex/256KiB", MD5_FILE_SIZE, bench_md5, md5_path);
+    } else {
+        bench_fail("md5_file_hex/256KiB", "cannot write the input file");
+    }
+
+    patch_case_t patch;
+    desired_profile(&patch.desired);
+
+    snprintf(patch.in_path, sizeof(patch.in_path), "%s", "bench/fixtures/ubnt_lcm_gui.conf");
+    snprintf(patch.out_path, sizeof(patch.out_path), "%s/ubnt_lcm_gui.conf.patched", g_tmp_dir);
+    bench_run("patch_lcm_gui_conf", file_size(patch.in_path), bench_patch_lcm_gui, &patch);
+
+    snprintf(patch.in_path, sizeof(patch.in_path), "%s", "bench/fixtures/ubnt_sounds_leds.conf");
+    snprintf(patch.out_path, sizeof(patch.out_path), "%s/ubnt_sounds_leds.conf.patched", g_tmp_dir);
+    bench_run("patch_sounds_leds_conf", file_size(patch.in_path), bench_patch_sounds_leds, &patch);
+
+    mqtt_router_ctx_t ctx = {0};
+
+    if (mqtt_routes_add(ROUTER_TOPIC, route_count, NULL, 0) == 0 && mqtt_router_start(&ctx)) {
+        bench_run("mqtt_router_enqueue_dispatch", 0, bench_router, NULL);
+        mqtt_router_stop();
+    } else {
+        bench_fail("mqtt_router_enqueue_dispatch", "router did not start");
+    }
+
+    config_t cfg = {0};
+
+    // The preset select needs the repo for its options.
+    if (config_load("tests/fixtures/config_fleet.json", &cfg) && ha_topics_init(&cfg) &&
+        profiles_repo_init("tests/fixtures/profiles", &cfg.preset_cfg)) {
+        char name[64];
+        snprintf(name, sizeof(name), "ha_publish_discovery/%zu_devices", cfg.devices_cfg.count);
+        bench_run(name, 0, bench_discovery, &cfg);
+        profiles_repo_shutdown();
+        ha_topics_shutdown();
+    } else {
+        bench_skip("ha_publish_discovery", "test fixtures not found; run from the repository root");
+    }
+
+    config_free(&cfg);
+
+    bench_run("build_apply_profile_command", 0, bench_apply_command, NULL);
+
+    remove(patch.out_path);
+    snprintf(patch.out_path, sizeof(patch.out_path), "%s/ubnt_lcm_gui.conf.patched", g_tmp_dir);
+    remove(patch.out_path);
+    remove(md5_path);
+    rmdir(g_tmp_dir);
+
+    return bench_end();
+}
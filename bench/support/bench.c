@@ -0,0 +1,226 @@
+#include "bench.h"
+#include "logger.h"
+#include "version.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_MIN_MS 100
+#define BENCH_DEFAULT_ROUNDS 5
+#define BENCH_MAX_ROUNDS 31
+
+static const char *g_bench = "bench";
+static FILE *g_output = NULL;
+static int g_failures = 0;
+
+static int bench_env_int(const char *name, int fallback, int max) {
+    const char *value = getenv(name);
+
+    if (!value || !*value) {
+        return fallback;
+    }
+
+    int n = atoi(value);
+
+    return n > 0 && n <= max ? n : fallback;
+}
+
+double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+void bench_begin(const char *bench) {
+    g_bench = bench;
+    g_failures = 0;
+
+    // Library code logs at INFO on hot paths; keep it out of the timings.
+    log_set_level(LOG_LEVEL_FATAL);
+
+    const char *path = getenv("BENCH_OUTPUT");
+
+    if (path && *path) {
+        g_output = fopen(path, "a");
+
+        if (!g_output) {
+            fprintf(stderr, "Cannot append results to '%s'\n", path);
+        }
+    }
+
+    printf("%-40s %12s %14s %14s %10s\n", bench, "iterations", "ns/op", "min ns/op", "MB/s");
+}
+
+static void bench_json_string(const char *s) {
+    fputc('"', g_output);
+
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', g_output);
+        }
+
+        fputc((unsigned char)*s < 0x20 ? ' ' : *s, g_output);
+    }
+
+    fputc('"', g_output);
+}
+
+static void bench_json_begin(const char *name) {
+    fputs("{\"bench\":", g_output);
+    bench_json_string(g_bench);
+    fputs(",\"name\":", g_output);
+    bench_json_string(name);
+    fputs(",\"version\":", g_output);
+    bench_json_string(APP_VERSION);
+}
+
+void bench_record(const char *name, size_t iterations, double ns_per_op, double ns_per_op_min, size_t bytes_per_op) {
+    double mb_per_s = bytes_per_op > 0 && ns_per_op > 0 ? (double)bytes_per_op / ns_per_op * 1e3 : 0;
+
+    if (bytes_per_op > 0) {
+        printf("%-40s %12zu %14.1f %14.1f %10.1f\n", name, iterations, ns_per_op, ns_per_op_min, mb_per_s);
+    } else {
+        printf("%-40s %12zu %14.1f %14.1f %10s\n", name, iterations, ns_per_op, ns_per_op_min, "-");
+    }
+
+    if (g_output) {
+        bench_json_begin(name);
+        fprintf(g_output, ",\"iterations\":%zu,\"ns_per_op\":%.1f,\"ns_per_op_min\":%.1f", iterations, ns_per_op, ns_per_op_min);
+
+        if (bytes_per_op > 0) {
+            fprintf(g_output, ",\"mb_per_s\":%.2f", mb_per_s);
+        }
+
+        fputs("}\n", g_output);
+    }
+}
+
+static void bench_status(const char *name, const char *status, const char *reason) {
+    printf("%-40s %s: %s\n", name, status, reason);
+
+    if (g_output) {
+        bench_json_begin(name);
+        fprintf(g_output, ",\"%s\":", status);
+        bench_json_string(reason);
+        fputs("}\n", g_output);
+    }
+}
+
+void bench_skip(const char *name, const char *reason) {
+    bench_status(name, "skipped", reason);
+}
+
+void bench_fail(const char *name, const char *reason) {
+    g_failures++;
+    bench_status(name, "failed", reason);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples.
+static double bench_percentile(const double *sorted, size_t count, double p) {
+    size_t rank = (size_t)(p * (double)count + 0.999999);
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void bench_record_latency(const char *name, double *samples_ns, size_t count, const bench_field_t *fields, size_t field_count) {
+    if (count == 0) {
+        bench_fail(name, "no samples");
+        return;
+    }
+
+    qsort(samples_ns, count, sizeof(samples_ns[0]), compare_double);
+
+    double p50 = bench_percentile(samples_ns, count, 0.50);
+    double p90 = bench_percentile(samples_ns, count, 0.90);
+    double p99 = bench_percentile(samples_ns, count, 0.99);
+    double max = samples_ns[count - 1];
+
+    printf("%-40s %12zu %14.1f %14.1f %10s\n", name, count, p50, samples_ns[0], "-");
+    printf("%-40s p90 %.1f  p99 %.1f  max %.1f", "", p90, p99, max);
+
+    for (size_t i = 0; i < field_count; i++) {
+        printf("  %s %lld", fields[i].key, fields[i].value);
+    }
+
+    putchar('\n');
+
+    if (g_output) {
+        bench_json_begin(name);
+        fprintf(g_output, ",\"iterations\":%zu,\"ns_per_op\":%.1f,\"ns_per_op_min\":%.1f,\"p90_ns\":%.1f,\"p99_ns\":%.1f,\"max_ns\":%.1f",
+                count, p50, samples_ns[0], p90, p99, max);
+
+        for (size_t i = 0; i < field_count; i++) {
+            fputc(',', g_output);
+            bench_json_string(fields[i].key);
+            fprintf(g_output, ":%lld", fields[i].value);
+        }
+
+        fputs("}\n", g_output);
+    }
+}
+
+bool bench_run(const char *name, size_t bytes_per_op, bench_fn fn, void *arg) {
+    double min_ns = bench_env_int("BENCH_MIN_MS", BENCH_DEFAULT_MIN_MS, 60000) * 1e6;
+    int rounds = bench_env_int("BENCH_ROUNDS", BENCH_DEFAULT_ROUNDS, BENCH_MAX_ROUNDS);
+    double samples[BENCH_MAX_ROUNDS];
+    size_t iterations = 1;
+
+    // Double the count until one round is long enough for the clock to be negligible.
+    for (;;) {
+        double start = bench_now_ns();
+
+        if (!fn(arg, iterations)) {
+            bench_fail(name, "operation failed");
+            return false;
+        }
+
+        double elapsed = bench_now_ns() - start;
+
+        if (elapsed >= min_ns || iterations >= ((size_t)1 << 40)) {
+            break;
+        }
+
+        // Jump close to the target once a round is measurable, then settle on it.
+        if (elapsed > min_ns / 100) {
+            size_t estimate = (size_t)((double)iterations * min_ns / elapsed * 1.1);
+            iterations = estimate > iterations ? estimate : iterations * 2;
+        } else {
+            iterations *= 2;
+        }
+    }
+
+    for (int r = 0; r < rounds; r++) {
+        double start = bench_now_ns();
+
+        if (!fn(arg, iterations)) {
+            bench_fail(name, "operation failed");
+            return false;
+        }
+
+        samples[r] = (bench_now_ns() - start) / (double)iterations;
+    }
+
+    qsort(samples, (size_t)rounds, sizeof(samples[0]), compare_double);
+    bench_record(name, iterations, samples[rounds / 2], samples[0], bytes_per_op);
+
+    return true;
+}
+
+int bench_end(void) {
+    if (g_output) {
+        fclose(g_output);
+        g_output = NULL;
+    }
+
+    return g_failures ? 1 : 0;
+}
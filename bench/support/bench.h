@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Runs iterations of the measured operation. Returning false stops the benchmark and marks it failed.
+ */
+typedef bool (*bench_fn)(void *arg, size_t iterations);
+
+/**
+ * @brief Start a benchmark binary. Every result is printed as a table row and, when BENCH_OUTPUT names
+ *        a file, appended to it as one JSON object per line:
+ *        {"bench":"micro","name":"md5_file_hex","version":"1.2.0","iterations":512,"ns_per_op":81234.5,
+ *         "ns_per_op_min":80110.2,"mb_per_s":403.3}
+ *
+ * @param bench name of the binary, e.g. "micro"
+ */
+void bench_begin(const char *bench);
+
+/**
+ * @brief Calibrate the iteration count until one round takes BENCH_MIN_MS (default 100 ms), then run
+ *        BENCH_ROUNDS rounds (default 5) and record the median.
+ *
+ * @param name
+ * @param bytes_per_op bytes processed per operation for a throughput column, 0 for none
+ * @param fn
+ * @param arg
+ * @return false if fn failed
+ */
+bool bench_run(const char *name, size_t bytes_per_op, bench_fn fn, void *arg);
+
+/**
+ * @brief Record a result measured by the caller, for benchmarks that cannot be repeated cheaply.
+ */
+void bench_record(const char *name, size_t iterations, double ns_per_op, double ns_per_op_min, size_t bytes_per_op);
+
+typedef struct {
+    const char *key;
+    long long value;
+} bench_field_t;
+
+/**
+ * @brief Record a latency distribution measured by the caller: the median as ns/op and the fastest sample
+ *        as min ns/op, plus p90_ns, p99_ns and max_ns and the extra counts in fields (e.g. drops), which
+ *        are also printed on a second row. samples_ns is sorted in place.
+ */
+void bench_record_latency(const char *name, double *samples_ns, size_t count, const bench_field_t *fields, size_t field_count);
+
+/**
+ * @brief Record that a benchmark did not run, e.g. because its device is not configured.
+ */
+void bench_skip(const char *name, const char *reason);
+
+void bench_fail(const char *name, const char *reason);
+
+double bench_now_ns(void);
+
+/**
+ * @brief Finish the binary.
+ *
+ * @return int exit status: 1 if any benchmark failed
+ */
+int bench_end(void);
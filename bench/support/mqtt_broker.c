@@ -0,0 +1,628 @@
+#include "mqtt_broker.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BROKER_MAX_CLIENTS 8
+#define BROKER_MAX_FILTERS 64
+#define BROKER_MAX_PACKET (1024 * 1024)
+#define BROKER_POLL_MS 50
+
+enum {
+    PKT_CONNECT = 1,
+    PKT_PUBLISH = 3,
+    PKT_PUBACK = 4,
+    PKT_PUBREC = 5,
+    PKT_PUBREL = 6,
+    PKT_PUBCOMP = 7,
+    PKT_SUBSCRIBE = 8,
+    PKT_SUBACK = 9,
+    PKT_UNSUBSCRIBE = 10,
+    PKT_UNSUBACK = 11,
+    PKT_PINGREQ = 12,
+    PKT_PINGRESP = 13,
+    PKT_DISCONNECT = 14,
+};
+
+typedef struct {
+    char *topic;
+    int qos;
+} broker_filter_t;
+
+typedef struct {
+    int fd;                 // -1 when the slot is free
+    unsigned char *buf;     // bytes received but not parsed yet; only the broker thread touches it
+    size_t len;
+    size_t cap;
+    broker_filter_t filters[BROKER_MAX_FILTERS];
+    size_t filter_count;
+    uint16_t next_id;
+} broker_client_t;
+
+static broker_client_t g_clients[BROKER_MAX_CLIENTS];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;     // filters, slots and socket writes
+static pthread_t g_thread;
+static atomic_bool g_running;
+static int g_listen_fd = -1;
+static int g_port;
+static mqtt_broker_observer_fn g_observer;
+static void *g_user;
+
+static bool send_all(int fd, const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (n <= 0) {
+            return false;
+        }
+
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return true;
+}
+
+static void send_ack(broker_client_t *c, int type, uint16_t id) {
+    unsigned char pkt[4] = { (unsigned char)(type << 4), 2, (unsigned char)(id >> 8), (unsigned char)id };
+
+    // PUBREL carries the reserved flag bits 0010.
+    if (type == PKT_PUBREL) {
+        pkt[0] |= 0x02;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    send_all(c->fd, pkt, sizeof(pkt));
+    pthread_mutex_unlock(&g_lock);
+}
+
+static size_t encode_length(unsigned char *out, size_t len) {
+    size_t n = 0;
+
+    do {
+        unsigned char byte = len % 128;
+        len /= 128;
+        out[n++] = len > 0 ? (byte | 0x80) : byte;
+    } while (len > 0);
+
+    return n;
+}
+
+// MQTT 3.1.1 section 4.7: + matches one level, # the rest including the parent level.
+static bool topic_matches(const char *filter, const char *topic) {
+    while (*filter) {
+        if (*filter == '#') {
+            return true;
+        }
+
+        if (*filter == '+') {
+            while (*topic && *topic != '/') {
+                topic++;
+            }
+
+            filter++;
+            continue;
+        }
+
+        if (*filter == '/' && filter[1] == '#' && *topic == '\0') {
+            return true;
+        }
+
+        if (*filter != *topic) {
+            return false;
+        }
+
+        filter++;
+        topic++;
+    }
+
+    return *topic == '\0';
+}
+
+static size_t deliver_locked(const char *topic, const char *payload, size_t len) {
+    size_t topic_len = strlen(topic);
+    size_t delivered = 0;
+    unsigned char *pkt = malloc(1 + 4 + 2 + topic_len + 2 + len);
+
+    if (!pkt) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        broker_client_t *c = &g_clients[i];
+        int qos = -1;
+
+        if (c->fd < 0) {
+            continue;
+        }
+
+        for (size_t f = 0; f < c->filter_count; f++) {
+            if (c->filters[f].qos > qos && topic_matches(c->filters[f].topic, topic)) {
+                qos = c->filters[f].qos;
+            }
+        }
+
+        if (qos < 0) {
+            continue;
+        }
+
+        size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + len;
+        size_t n = 0;
+
+        pkt[n++] = (unsigned char)((PKT_PUBLISH << 4) | (qos << 1));
+        n += encode_length(pkt + n, remaining);
+        pkt[n++] = (unsigned char)(topic_len >> 8);
+        pkt[n++] = (unsigned char)topic_len;
+        memcpy(pkt + n, topic, topic_len);
+        n += topic_len;
+
+        if (qos > 0) {
+            uint16_t id = ++c->next_id ? c->next_id : ++c->next_id;
+            pkt[n++] = (unsigned char)(id >> 8);
+            pkt[n++] = (unsigned char)id;
+        }
+
+        memcpy(pkt + n, payload, len);
+        n += len;
+
+        if (send_all(c->fd, pkt, n)) {
+            delivered++;
+        }
+    }
+
+    free(pkt);
+
+    return delivered;
+}
+
+static bool read_string(const unsigned char **p, const unsigned char *end, char **out) {
+    if (end - *p < 2) {
+        return false;
+    }
+
+    size_t len = ((size_t)(*p)[0] << 8) | (*p)[1];
+    *p += 2;
+
+    if ((size_t)(end - *p) < len) {
+        return false;
+    }
+
+    *out = malloc(len + 1);
+    if (!*out) {
+        return false;
+    }
+
+    memcpy(*out, *p, len);
+    (*out)[len] = '\0';
+    *p += len;
+
+    return true;
+}
+
+static void add_filter_locked(broker_client_t *c, char *topic, int qos) {
+    for (size_t i = 0; i < c->filter_count; i++) {
+        if (strcmp(c->filters[i].topic, topic) == 0) {
+            c->filters[i].qos = qos;
+            free(topic);
+            return;
+        }
+    }
+
+    if (c->filter_count == BROKER_MAX_FILTERS) {
+        free(topic);
+        return;
+    }
+
+    c->filters[c->filter_count++] = (broker_filter_t){ topic, qos };
+}
+
+static void remove_filter_locked(broker_client_t *c, const char *topic) {
+    for (size_t i = 0; i < c->filter_count; i++) {
+        if (strcmp(c->filters[i].topic, topic) == 0) {
+            free(c->filters[i].topic);
+            c->filters[i] = c->filters[--c->filter_count];
+            return;
+        }
+    }
+}
+
+static bool handle_publish(broker_client_t *c, int flags, const unsigned char *p, const unsigned char *end) {
+    int qos = (flags >> 1) & 0x03;
+    char *topic = NULL;
+    uint16_t id = 0;
+
+    if (!read_string(&p, end, &topic)) {
+        return false;
+    }
+
+    if (qos > 0) {
+        if (end - p < 2) {
+            free(topic);
+            return false;
+        }
+
+        id = (uint16_t)((p[0] << 8) | p[1]);
+        p += 2;
+    }
+
+    if (qos == 1) {
+        send_ack(c, PKT_PUBACK, id);
+    } else if (qos == 2) {
+        send_ack(c, PKT_PUBREC, id);
+    }
+
+    pthread_mutex_lock(&g_lock);
+    deliver_locked(topic, (const char *)p, (size_t)(end - p));
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_observer) {
+        g_observer(topic, (const char *)p, (size_t)(end - p), g_user);
+    }
+
+    free(topic);
+
+    return true;
+}
+
+static bool handle_subscribe(broker_client_t *c, const unsigned char *p, const unsigned char *end, bool subscribe) {
+    unsigned char ack[4 + 1 + BROKER_MAX_FILTERS];
+    size_t granted = 0;
+
+    if (end - p < 2) {
+        return false;
+    }
+
+    uint16_t id = (uint16_t)((p[0] << 8) | p[1]);
+    p += 2;
+
+    pthread_mutex_lock(&g_lock);
+
+    while (p < end) {
+        char *topic = NULL;
+
+        if (!read_string(&p, end, &topic)) {
+            pthread_mutex_unlock(&g_lock);
+            return false;
+        }
+
+        if (!subscribe) {
+            remove_filter_locked(c, topic);
+            free(topic);
+            continue;
+        }
+
+        if (p == end) {
+            free(topic);
+            pthread_mutex_unlock(&g_lock);
+            return false;
+        }
+
+        int qos = *p++ & 0x03;
+        qos = qos > 1 ? 1 : qos;
+        add_filter_locked(c, topic, qos);
+
+        if (granted < BROKER_MAX_FILTERS) {
+            ack[4 + granted++] = (unsigned char)qos;
+        }
+    }
+
+    if (subscribe) {
+        ack[0] = (unsigned char)((PKT_SUBACK << 4) | 0);
+        ack[1] = (unsigned char)(2 + granted);
+        ack[2] = (unsigned char)(id >> 8);
+        ack[3] = (unsigned char)id;
+        send_all(c->fd, ack, 4 + granted);
+    }
+
+    pthread_mutex_unlock(&g_lock);
+
+    if (!subscribe) {
+        send_ack(c, PKT_UNSUBACK, id);
+    }
+
+    return true;
+}
+
+// Returns false when the client disconnects or sends something that is not MQTT.
+static bool handle_packet(broker_client_t *c, int type, int flags, const unsigned char *body, size_t len) {
+    static const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    static const unsigned char pingresp[] = { PKT_PINGRESP << 4, 0x00 };
+    const unsigned char *end = body + len;
+
+    switch (type) {
+    case PKT_CONNECT:
+        pthread_mutex_lock(&g_lock);
+        send_all(c->fd, connack, sizeof(connack));
+        pthread_mutex_unlock(&g_lock);
+        return true;
+    case PKT_PUBLISH:
+        return handle_publish(c, flags, body, end);
+    case PKT_PUBREL:
+        if (len >= 2) {
+            send_ack(c, PKT_PUBCOMP, (uint16_t)((body[0] << 8) | body[1]));
+        }
+        return true;
+    case PKT_SUBSCRIBE:
+        return handle_subscribe(c, body, end, true);
+    case PKT_UNSUBSCRIBE:
+        return handle_subscribe(c, body, end, false);
+    case PKT_PINGREQ:
+        pthread_mutex_lock(&g_lock);
+        send_all(c->fd, pingresp, sizeof(pingresp));
+        pthread_mutex_unlock(&g_lock);
+        return true;
+    case PKT_PUBACK:
+    case PKT_PUBREC:
+    case PKT_PUBCOMP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void close_client(broker_client_t *c) {
+    pthread_mutex_lock(&g_lock);
+
+    close(c->fd);
+    c->fd = -1;
+
+    for (size_t i = 0; i < c->filter_count; i++) {
+        free(c->filters[i].topic);
+    }
+
+    c->filter_count = 0;
+    pthread_mutex_unlock(&g_lock);
+
+    free(c->buf);
+    c->buf = NULL;
+    c->len = 0;
+    c->cap = 0;
+}
+
+// Parses every complete packet in the client's buffer.
+static bool drain_packets(broker_client_t *c) {
+    size_t off = 0;
+
+    while (c->len - off >= 2) {
+        size_t remaining = 0;
+        size_t header = 1;
+        size_t shift = 0;
+        bool complete = false;
+
+        while (header < 5 && off + header < c->len) {
+            unsigned char byte = c->buf[off + header++];
+            remaining |= (size_t)(byte & 0x7f) << shift;
+            shift += 7;
+
+            if (!(byte & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+
+        if (!complete) {
+            if (header >= 5 || remaining > BROKER_MAX_PACKET) {
+                return false;
+            }
+
+            break;
+        }
+
+        if (remaining > BROKER_MAX_PACKET) {
+            return false;
+        }
+
+        if (c->len - off - header < remaining) {
+            break;
+        }
+
+        unsigned char first = c->buf[off];
+
+        if (!handle_packet(c, first >> 4, first & 0x0f, c->buf + off + header, remaining)) {
+            return false;
+        }
+
+        off += header + remaining;
+    }
+
+    memmove(c->buf, c->buf + off, c->len - off);
+    c->len -= off;
+
+    return true;
+}
+
+static bool read_client(broker_client_t *c) {
+    if (c->cap - c->len < 4096) {
+        size_t cap = c->cap ? c->cap * 2 : 16384;
+
+        if (cap > 4 * BROKER_MAX_PACKET) {
+            return false;
+        }
+
+        unsigned char *buf = realloc(c->buf, cap);
+
+        if (!buf) {
+            return false;
+        }
+
+        c->buf = buf;
+        c->cap = cap;
+    }
+
+    ssize_t n = recv(c->fd, c->buf + c->len, c->cap - c->len, 0);
+
+    if (n <= 0) {
+        return false;
+    }
+
+    c->len += (size_t)n;
+
+    return drain_packets(c);
+}
+
+static void accept_client(void) {
+    int fd = accept(g_listen_fd, NULL, NULL);
+    int one = 1;
+
+    if (fd < 0) {
+        return;
+    }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    pthread_mutex_lock(&g_lock);
+
+    for (size_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        if (g_clients[i].fd < 0) {
+            g_clients[i].fd = fd;
+            g_clients[i].next_id = 0;
+            fd = -1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+static void *broker_thread(void *arg) {
+    (void)arg;
+
+    struct pollfd fds[1 + BROKER_MAX_CLIENTS];
+    broker_client_t *owners[1 + BROKER_MAX_CLIENTS];
+
+    while (atomic_load(&g_running)) {
+        nfds_t n = 0;
+
+        fds[n++] = (struct pollfd){ .fd = g_listen_fd, .events = POLLIN };
+
+        // Only this thread opens and closes slots, so the table can be read without the lock.
+        for (size_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+            if (g_clients[i].fd >= 0) {
+                owners[n] = &g_clients[i];
+                fds[n++] = (struct pollfd){ .fd = g_clients[i].fd, .events = POLLIN };
+            }
+        }
+
+        if (poll(fds, n, BROKER_POLL_MS) <= 0) {
+            continue;
+        }
+
+        for (nfds_t i = 1; i < n; i++) {
+            if (fds[i].revents && !read_client(owners[i])) {
+                close_client(owners[i]);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            accept_client();
+        }
+    }
+
+    return NULL;
+}
+
+bool mqtt_broker_start(mqtt_broker_observer_fn observer, void *user) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (size_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        g_clients[i].fd = -1;
+    }
+
+    g_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (g_listen_fd < 0 ||
+        bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(g_listen_fd, BROKER_MAX_CLIENTS) != 0 ||
+        getsockname(g_listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        goto fail;
+    }
+
+    g_port = ntohs(addr.sin_port);
+    g_observer = observer;
+    g_user = user;
+    atomic_store(&g_running, true);
+
+    if (pthread_create(&g_thread, NULL, broker_thread, NULL) != 0) {
+        atomic_store(&g_running, false);
+        goto fail;
+    }
+
+    return true;
+
+fail:
+    if (g_listen_fd >= 0) {
+        close(g_listen_fd);
+        g_listen_fd = -1;
+    }
+
+    return false;
+}
+
+void mqtt_broker_stop(void) {
+    if (!atomic_load(&g_running)) {
+        return;
+    }
+
+    atomic_store(&g_running, false);
+    pthread_join(g_thread, NULL);
+
+    for (size_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        if (g_clients[i].fd >= 0) {
+            close_client(&g_clients[i]);
+        }
+    }
+
+    close(g_listen_fd);
+    g_listen_fd = -1;
+}
+
+int mqtt_broker_port(void) {
+    return g_port;
+}
+
+bool mqtt_broker_subscribed(const char *topic) {
+    bool found = false;
+
+    pthread_mutex_lock(&g_lock);
+
+    for (size_t i = 0; i < BROKER_MAX_CLIENTS && !found; i++) {
+        for (size_t f = 0; g_clients[i].fd >= 0 && f < g_clients[i].filter_count && !found; f++) {
+            found = topic_matches(g_clients[i].filters[f].topic, topic);
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+
+    return found;
+}
+
+size_t mqtt_broker_publish(const char *topic, const char *payload, size_t len) {
+    if (!topic || (!payload && len > 0)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    size_t delivered = deliver_locked(topic, payload ? payload : "", len);
+    pthread_mutex_unlock(&g_lock);
+
+    return delivered;
+}
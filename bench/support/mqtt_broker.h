@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Called on the broker thread for every PUBLISH a client sends, after it has been acknowledged and
+ *        forwarded to the matching subscribers.
+ */
+typedef void (*mqtt_broker_observer_fn)(const char *topic, const char *payload, size_t len, void *user);
+
+/**
+ * @brief Start a minimal MQTT 3.1.1 broker on 127.0.0.1 with an ephemeral port, for benchmarks that run
+ *        the service in-process. It accepts any CONNECT, grants subscriptions (with + and # wildcards) at
+ *        QoS 0 or 1, forwards publishes, answers QoS 1 and 2 handshakes and pings. There is no session
+ *        state, retained store or will delivery.
+ *
+ * @param observer may be NULL
+ * @param user passed to observer
+ * @return false if the socket or the thread could not be set up
+ */
+bool mqtt_broker_start(mqtt_broker_observer_fn observer, void *user);
+
+void mqtt_broker_stop(void);
+
+int mqtt_broker_port(void);
+
+/**
+ * @brief Whether any connected client has a subscription matching topic.
+ */
+bool mqtt_broker_subscribed(const char *topic);
+
+/**
+ * @brief Deliver a message to every matching subscriber as if a client had published it.
+ *
+ * @return size_t number of subscribers it was written to
+ */
+size_t mqtt_broker_publish(const char *topic, const char *payload, size_t len);
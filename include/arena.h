@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Per-command arena: a chunked bump allocator that a thread enters for the duration of a command
+ * and resets in one step afterwards, so the many short-lived blocks a command makes (cJSON nodes,
+ * file and SSH output buffers) never reach the heap.
+ *
+ * arena_malloc/arena_realloc/arena_free allocate from the calling thread's current arena, or from
+ * the heap when it has none. Every block records where it came from, so arena_free is safe from any
+ * thread: heap blocks are freed, arena blocks are released with their arena's next reset.
+ */
+
+typedef struct arena arena_t;
+
+/**
+ * @brief Create an arena that reserves memory in chunks of chunk_size bytes (0 for the default).
+ *
+ * @param chunk_size
+ * @return arena_t* or NULL on allocation failure
+ */
+arena_t *arena_create(size_t chunk_size);
+
+/**
+ * @brief Free an arena and every chunk it holds.
+ *
+ * @param arena
+ */
+void arena_destroy(arena_t *arena);
+
+/**
+ * @brief Release every block allocated from the arena. The first chunk is kept for the next command;
+ *        the others go back to the heap.
+ *
+ * @param arena
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * @brief Bytes handed out since the last reset, including block headers.
+ *
+ * @param arena
+ * @return size_t
+ */
+size_t arena_used(const arena_t *arena);
+
+/**
+ * @brief Make arena the calling thread's current arena.
+ *
+ * @param arena NULL sends the thread's allocations to the heap, e.g. for data that outlives the command
+ * @return arena_t* the previous current arena, to pass to arena_leave
+ */
+arena_t *arena_enter(arena_t *arena);
+
+/**
+ * @brief Restore the current arena saved by arena_enter.
+ *
+ * @param previous
+ */
+void arena_leave(arena_t *previous);
+
+/**
+ * @brief Allocate from the current arena, or the heap. Blocks are aligned for any scalar type.
+ *
+ * @param size
+ * @return void* or NULL on allocation failure
+ */
+void *arena_malloc(size_t size);
+
+/**
+ * @brief Resize a block from arena_malloc. The last block of the current arena grows in place.
+ *
+ * @param ptr may be NULL
+ * @param size
+ * @return void* or NULL on allocation failure; ptr is then left untouched
+ */
+void *arena_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Free a block from arena_malloc. Arena blocks are left for the arena's reset.
+ *
+ * @param ptr may be NULL
+ */
+void arena_free(void *ptr);
+
+/**
+ * @brief Route cJSON's allocations through arena_malloc/arena_free. Call once at startup before any
+ *        cJSON use; memory cJSON returns must then be released with cJSON_free, not free.
+ */
+void arena_install_cjson_hooks(void);
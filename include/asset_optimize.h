@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A compressed transfer is only used when it is at most this share of the original size.
+#define ASSET_GZIP_MAX_RATIO_PCT 90
+
+/**
+ * @brief Losslessly recompresses a PNG: keeps only the chunks needed to render it (IHDR, PLTE, tRNS, IDAT, IEND)
+ *        and re-deflates the image data at the highest level as a single IDAT. Pixel data and filters are unchanged.
+ *
+ * @param in
+ * @param in_len
+ * @param out receives a malloc'd buffer, which may be larger than the input
+ * @param out_len
+ * @return true
+ * @return false if the input is not a PNG this can rewrite (corrupt, animated, ...)
+ */
+bool asset_optimize_png(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+
+/**
+ * @brief Returns an optimized copy of a PNG, computing it only the first time a source digest is seen.
+ *        The copy is kept as <cache_dir>/<src_md5>.png; a source that does not shrink is remembered too.
+ *
+ * @param in source bytes
+ * @param in_len
+ * @param src_md5 digest of the source bytes
+ * @param cache_dir created if missing
+ * @param out_path receives the optimized file, or an empty string when the source should be used as-is
+ * @param out_len
+ * @return true
+ * @return false on I/O failure; the source can still be used
+ */
+bool asset_optimize_png_cached(const unsigned char *in, size_t in_len, const char *src_md5, const char *cache_dir, char *out_path, size_t out_len);
+
+/**
+ * @brief Tells whether a file name is a format that is already compressed (PNG, Ogg, MP3, gzip), so
+ *        compressing it again for transfer is not attempted.
+ *
+ * @param name
+ * @return true
+ * @return false
+ */
+bool asset_optimize_is_precompressed(const char *name);
+
+/**
+ * @brief Gzip-compresses a buffer for transfer and reports whether the result is worth sending, that is at
+ *        most ASSET_GZIP_MAX_RATIO_PCT percent of the input.
+ *
+ * @param in
+ * @param in_len
+ * @param out receives a malloc'd gzip stream, also when it is not worth sending
+ * @param out_len
+ * @return true if the compressed stream should be sent instead of the input
+ * @return false if compression failed or did not pay off
+ */
+bool asset_optimize_gzip(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Content-addressed store: each distinct file is kept once as <store_dir>/<md5> and hard-linked
+ * wherever it is used. The store and its users must be on the same filesystem.
+ */
+
+/**
+ * @brief Check that a string is a 32 character lowercase hex MD5 digest.
+ * 
+ * @param md5_hex 
+ * @return true 
+ * @return false 
+ */
+bool blob_store_is_md5(const char *md5_hex);
+
+/**
+ * @brief Hard-link the blob with the given digest to dst_path.
+ * 
+ * @param store_dir 
+ * @param md5_hex 
+ * @param dst_path must not exist yet
+ * @return true if the store held the blob and it was linked
+ * @return false if the blob is not held or linking failed
+ */
+bool blob_store_link(const char *store_dir, const char *md5_hex, const char *dst_path);
+
+/**
+ * @brief Move every regular file directly inside dir into the store. A file whose content is already
+ *        held is replaced by a link to the existing blob; any other file becomes a new blob.
+ * 
+ * @param store_dir created if missing
+ * @param dir 
+ * @return true if every file was adopted
+ * @return false 
+ */
+bool blob_store_adopt_dir(const char *store_dir, const char *dir);
+
+/**
+ * @brief Delete blobs that are no longer linked from anywhere else.
+ * 
+ * @param store_dir 
+ * @return long long bytes freed
+ */
+long long blob_store_prune(const char *store_dir);
+
+/**
+ * @brief Total size of the blobs in the store.
+ * 
+ * @param store_dir 
+ * @return long long bytes
+ */
+long long blob_store_size(const char *store_dir);
@@ -54,3 +54,34 @@ void command_test_config(const mqtt_router_ctx_t *ctx, const char *payload, size
  * @param payloadLen 
  */
 void command_download_assets(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen);
+
+/**
+ * @brief Reports a cancel of the device's running and queued commands. The cancel itself happens in the
+ *        router as the message arrives (MQTT_ROUTE_SUPERSEDES), so it does not wait behind the command.
+ * 
+ * @param ctx 
+ * @param payload 
+ * @param payloadLen 
+ */
+void command_cancel(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen);
+
+/**
+ * @brief Changes volume, repeat count, animation duration or loop of the profile the device runs, without
+ *        uploading its assets. The payload is a JSON object with any of "volume", "repeat_times",
+ *        "duration_ms" and "loop"; only the conf holding them is replaced and only its service restarted.
+ * 
+ * @param ctx 
+ * @param payload 
+ * @param payloadLen 
+ */
+void command_set_params(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen);
+
+/**
+ * @brief Applies a preset to every device, or to the devices carrying a tag, with bounded parallelism.
+ *        The payload is either a preset name or {"preset": "...", "tag": "..."}.
+ * 
+ * @param ctx 
+ * @param payload 
+ * @param payloadLen 
+ */
+void command_fleet_apply(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef struct {
@@ -23,13 +24,90 @@ typedef struct {
     char instance_human[64];
 } config_mqtt_t;
 
+typedef struct {
+    char root[256];         // local directory standing in for the device; empty = a real device over SSH
+    int latency_ms;         // added to every command and transfer
+    int bandwidth_kbps;     // transfer rate limit, 0 = unlimited
+} config_sim_t;
+
 typedef struct {
     char host[256];
     int port;
     char user[30];
     char password_env[50];
+    int connect_timeout_s;  // TCP connect, handshake and authentication; 0 = no limit
+    int command_timeout_s;  // whole command including transfers and the remote script; 0 = no limit
+    config_sim_t sim;
 } config_ssh_t;
 
+#define CONFIG_DEVICE_MAX_TAGS 8
+
+typedef struct {
+    size_t index;
+    char id[64];
+    char name_human[64];
+    char tags[CONFIG_DEVICE_MAX_TAGS][32];
+    size_t tag_count;
+    config_ssh_t ssh_cfg;
+} config_device_t;
+
+typedef struct {
+    config_device_t *items;
+    size_t count;
+} config_devices_t;
+
+typedef struct {
+    int concurrency;
+} config_fleet_t;
+
+typedef struct {
+    int max_entries;    // 0 disables the on-device cache
+    int max_kb;
+    char directory[128];
+} config_cache_t;
+
+typedef struct {
+    int max_mb;         // 0 = keep every download
+} config_downloads_t;
+
+typedef struct {
+    int png;            // 1 = losslessly recompress welcome sprite sheets before upload
+    int gzip;           // 1 = send compressible files gzip'd and inflate them on the device
+} config_optimize_t;
+
+typedef struct {
+    int port;           // 0 disables the metrics listener
+    char address[64];   // listen address
+} config_metrics_t;
+
+typedef struct {
+    int enabled;        // 1 = write Chrome trace-event spans to .state/trace.json
+    int max_kb;         // the file is rotated to trace.json.1 beyond this size
+} config_trace_t;
+
+typedef struct {
+    int year;   // 0 = every year
+    int month;
+    int day;
+    int hour;
+    int minute;
+} config_schedule_time_t;
+
+typedef struct {
+    char preset[128];
+    char tag[32];
+    config_schedule_time_t start;
+    config_schedule_time_t end;
+    bool has_end;
+} config_schedule_window_t;
+
+typedef struct {
+    config_schedule_window_t *items;
+    size_t count;
+    int lead_minutes;
+    char default_preset[128];
+} config_schedule_t;
+
 typedef struct {
     char *display_name;
     char *key_name;
@@ -43,6 +121,13 @@ typedef struct {
 
 typedef struct {
     config_mqtt_t mqtt_cfg;
-    config_ssh_t ssh_cfg;
+    config_devices_t devices_cfg;
+    config_fleet_t fleet_cfg;
+    config_cache_t cache_cfg;
+    config_downloads_t downloads_cfg;
+    config_optimize_t optimize_cfg;
+    config_metrics_t metrics_cfg;
+    config_trace_t trace_cfg;
+    config_schedule_t schedule_cfg;
     config_preset_t preset_cfg;
 } config_t;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Device index for operations not bound to one doorbell; they can time out but are never cancelled.
+#define DEADLINE_NO_DEVICE ((size_t)-1)
+
+/**
+ * @brief A running command on one thread: its deadline and the cancel generation of its device when the
+ *        command was received. Lives on the caller's stack between deadline_begin() and deadline_end().
+ *        Operations nest; the innermost one on a thread is the one transports check.
+ */
+typedef struct deadline_op {
+    size_t device;
+    unsigned generation;
+    uint64_t expires_us;        // monotonic, 0 = no deadline
+    int sock;                   // shut down when the operation is cancelled, -1 for none
+    int shield;                 // > 0 while cancels are held off; see deadline_shield_begin()
+    struct deadline_op *outer;  // enclosing operation on the same thread
+    struct deadline_op *next;   // running operations, for deadline_cancel()
+} deadline_op_t;
+
+/**
+ * @brief Allocates a cancel generation per device. Call once at startup, before commands run.
+ *
+ * @param device_count
+ * @return false on allocation failure
+ */
+bool deadline_init(size_t device_count);
+
+void deadline_shutdown(void);
+
+/**
+ * @brief Current cancel generation of a device. A command records it when it is received; it is cancelled
+ *        once the generation moves on.
+ *
+ * @param device device index
+ * @return unsigned 0 for DEADLINE_NO_DEVICE or an unknown device
+ */
+unsigned deadline_generation(size_t device);
+
+/**
+ * @brief Cancels every running and queued command of a device. Sockets registered with
+ *        deadline_watch_socket() are shut down so blocked reads and writes return at once,
+ *        except for shielded operations. Safe to call from any thread.
+ *
+ * @param device device index
+ * @return unsigned the new generation
+ */
+unsigned deadline_cancel(size_t device);
+
+/**
+ * @brief Starts an operation on the calling thread.
+ *
+ * @param op
+ * @param device device index or DEADLINE_NO_DEVICE
+ * @param generation from deadline_generation() when the command was received
+ * @param timeout_s 0 for no deadline
+ */
+void deadline_begin(deadline_op_t *op, size_t device, unsigned generation, int timeout_s);
+
+void deadline_end(deadline_op_t *op);
+
+/**
+ * @brief Restarts the deadline of the current operation at timeout_s from now. For work that first waits
+ *        for its device, so the wait does not use up the command's time.
+ *
+ * @param timeout_s 0 for no deadline
+ */
+void deadline_arm(int timeout_s);
+
+// True once the current operation was cancelled or ran past its deadline; false outside an operation.
+bool deadline_expired(void);
+
+bool deadline_cancelled(void);
+
+/**
+ * @brief Time left for the current operation.
+ *
+ * @return int milliseconds, 0 when expired or cancelled, -1 when there is no deadline
+ */
+int deadline_remaining_ms(void);
+
+/**
+ * @brief Picks the error to report for an operation that failed after deadline_expired() became true.
+ *
+ * @param timeout_error reported when the deadline passed
+ * @return int ERROR_OPERATION_CANCELLED when cancelled, otherwise timeout_error
+ */
+int deadline_error(int timeout_error);
+
+/**
+ * @brief Holds off cancels for the current operation until deadline_shield_end(): its socket is not shut
+ *        down and deadline_cancelled() stays false, so only the deadline bounds it. A cancel received
+ *        meanwhile takes effect once the shield ends. For steps that must not be abandoned halfway,
+ *        such as the apply script, which keeps running on the doorbell when its connection drops.
+ */
+void deadline_shield_begin(void);
+
+void deadline_shield_end(void);
+
+// Registers the socket of the current operation so a cancel can unblock it. Unwatch before closing it.
+void deadline_watch_socket(int sock);
+
+void deadline_unwatch_socket(int sock);
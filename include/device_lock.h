@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Allocates one lock per device. Everything that changes a device (router commands, fleet rollouts,
+ *        scheduled staging and cut-overs) holds its lock, so two applies never share the upload area
+ *        and the status of a device is not reset by another thread's work. Call once at startup.
+ *
+ * @param device_count
+ * @return false on allocation failure
+ */
+bool device_lock_init(size_t device_count);
+
+// Call only after every thread that takes a device lock has stopped.
+void device_lock_shutdown(void);
+
+/**
+ * @brief Waits for and takes the lock of a device. Not recursive. Does nothing for an unknown device or
+ *        before device_lock_init(), so single-threaded tools need not initialise the locks.
+ *
+ * @param device device index
+ */
+void device_lock(size_t device);
+
+void device_unlock(size_t device);
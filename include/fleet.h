@@ -0,0 +1,71 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Applies something to a single device. Runs on a rollout worker thread, in an operation that a cancel
+ *        of the device stops but that has no deadline until fn calls deadline_arm().
+ *
+ * @param device device being served
+ * @param user opaque pointer passed to fleet_rollout_run()
+ * @return int ERROR_NONE on success, otherwise an error code
+ */
+typedef int (*fleet_apply_fn)(const config_device_t *device, void *user);
+
+typedef struct {
+    const config_device_t *device;
+    int error;
+    long long elapsed_ms;
+} fleet_result_t;
+
+typedef struct {
+    fleet_result_t *results;
+    size_t count;
+    size_t succeeded;
+    int concurrency;
+    long long wall_ms;
+} fleet_rollout_t;
+
+/**
+ * @brief Selects the devices a rollout targets: every device, or only those carrying the given tag.
+ *
+ * @param rollout
+ * @param devices
+ * @param tag tag to match, or NULL/empty for all devices
+ * @return true
+ * @return false on allocation failure
+ */
+bool fleet_rollout_init(fleet_rollout_t *rollout, const config_devices_t *devices, const char *tag);
+
+/**
+ * @brief Runs fn for every selected device on at most `concurrency` worker threads and records
+ *        the per-device result and the total wall time.
+ *
+ * @param rollout
+ * @param concurrency maximum number of devices served at once
+ * @param fn
+ * @param user
+ * @return true if every device succeeded
+ * @return false
+ */
+bool fleet_rollout_run(fleet_rollout_t *rollout, int concurrency, fleet_apply_fn fn, void *user);
+
+/**
+ * @brief Serializes the rollout results as the fleet summary attributes payload.
+ *
+ * @param rollout
+ * @param profile profile that was applied
+ * @param tag tag filter, or NULL
+ * @return char* JSON string, free with cJSON_free(). NULL on failure.
+ */
+char *fleet_rollout_summary_json(const fleet_rollout_t *rollout, const char *profile, const char *tag);
+
+/**
+ * @brief Releases the rollout results.
+ *
+ * @param rollout
+ */
+void fleet_rollout_free(fleet_rollout_t *rollout);
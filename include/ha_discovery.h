@@ -10,4 +10,15 @@
  * @return true 
  * @return false 
  */
-bool ha_publish_discovery(const config_t *cfg);
\ No newline at end of file
+bool ha_publish_discovery(const config_t *cfg);
+
+/**
+ * @brief Re-publish the discovery configuration of a single entity for every device,
+ *        e.g. the preset select after its options changed.
+ * 
+ * @param cfg 
+ * @param object_id entity object_id, as in HA_ENTITIES
+ * @return true 
+ * @return false 
+ */
+bool ha_publish_discovery_entity(const config_t *cfg, const char *object_id);
\ No newline at end of file
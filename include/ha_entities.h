@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ha_topics.h"
+#include "mqtt_router.h"
 #include "mqtt_router_types.h"
 #include "cJSON.h"
 #include <stddef.h>
@@ -20,16 +22,26 @@ struct entity_t {
     const char *object_id;
     const char *name;
     const char *category;
-    const char *state_topic;
-    const char *availability_topic;
-    const char *command_topic;
+    ha_topic_id_t state_topic;
+    ha_topic_id_t availability_topic;
+    ha_topic_id_t command_topic;
     const char *icon;
     const char *device_class;
+    const char *unit_of_measurement;
     const char *value_template;
-    const char *json_attributes_topic;
+    const char *command_template;
+    double min;                 // number range, emitted when max > min
+    double max;
+    double step;
+    const char *payload_on;     // switch
+    const char *payload_off;
+    const char *state_on;
+    const char *state_off;
+    ha_topic_id_t json_attributes_topic;
     const char *json_attributes_template;
     add_options_fn add_options;
     mqtt_handler_fn handle_command;
+    unsigned route_flags;   // MQTT_ROUTE_* for the command topic
 };
 
 extern const entity_t HA_ENTITIES[];
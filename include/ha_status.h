@@ -1,8 +1,26 @@
 #pragma once
 
 #include "errors.h"
+#include "ha_topics.h"
 #include "logger.h"
+#include "unifi_profile.h"
 #include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Bind the calling thread to a device. Every status_set_* call made from this thread
+ *        afterwards publishes to that device's topics.
+ * 
+ * @param device device index (config_device_t.index)
+ */
+void status_bind_device(size_t device);
+
+/**
+ * @brief Return the device index the calling thread is bound to.
+ * 
+ * @return size_t 
+ */
+size_t status_bound_device(void);
 
 /**
  * @brief Set the current status state.
@@ -14,10 +32,10 @@ void status_set_state(const char *state);
 /**
  * @brief Set a status message on a given topic.
  * 
- * @param topic topic to publish to
+ * @param topic id of the topic to publish to
  * @param message status message
  */
-void status_set_status_message(const char *topic, const char *message);
+void status_set_status_message(ha_topic_id_t topic, const char *message);
 
 /**
  * @brief Set the last error information.
@@ -71,6 +89,80 @@ void status_set_last_download(const char *directory, const char *path, const cha
  */
 void status_set_availability(bool available);
 
+/**
+ * @brief Publish the outcome of a fleet rollout. These topics are shared by all devices.
+ * 
+ * @param state short outcome, e.g. "running", "ok", "partial" or "failed"
+ * @param attributes_json summary payload from fleet_rollout_summary_json(), or NULL to leave it unchanged
+ */
+void status_set_fleet_rollout(const char *state, const char *attributes_json);
+
+/**
+ * @brief Publish the result of a scheduled switch for the bound device.
+ * 
+ * @param latency_ms milliseconds between the scheduled time and the end of the cut-over, as text
+ * @param attributes_json details of the switch
+ */
+void status_set_schedule_switch(const char *latency_ms, const char *attributes_json);
+
+/**
+ * @brief Publish the on-device asset cache outcome of the last upload for the bound device.
+ *        The state is "hit", "miss", "partial" or "none" (no assets enabled).
+ * 
+ * @param hits assets restored from the cache
+ * @param misses assets transferred
+ * @param evictions cache entries removed to stay within budget
+ */
+void status_set_asset_cache(int hits, int misses, int evictions);
+
+/**
+ * @brief Publish how many bytes recompression kept off the wire in the last upload for the bound device.
+ * 
+ * @param sent asset bytes transferred
+ * @param saved bytes the transferred assets shed before upload
+ */
+void status_set_upload_savings(long long sent, long long saved);
+
+/**
+ * @brief Publish the adjustable parameters of the profile the bound device runs. A parameter whose
+ *        welcome animation or ring sound is not enabled is published as null.
+ * 
+ * @param profile
+ */
+void status_set_params(const unifi_profile_t *profile);
+
+/**
+ * @brief Outcome and timings of one apply, as fed to the performance sensors.
+ */
+typedef struct {
+    bool ok;
+    double apply_seconds;   // upload plus apply script, or the cut-over alone for a staged apply
+    double upload_seconds;  // 0 when nothing was transferred
+    long long bytes_sent;
+    double rtt_ms;          // ssh_session_rtt_ms(), negative when unknown
+    bool unchanged;         // the device already ran the profile, so nothing was applied
+} status_apply_sample_t;
+
+/**
+ * @brief Record an apply on the bound device and publish its performance sensors. Publishes are
+ *        rate limited per device; a sample that arrives too soon is sent by status_flush_performance().
+ *
+ * @param sample
+ */
+void status_record_apply(const status_apply_sample_t *sample);
+
+/**
+ * @brief Publish performance sensors whose rate limit has expired and that have changed, including
+ *        the inbound queue depth, for every configured device. Call regularly from the main loop.
+ */
+void status_flush_performance(void);
+
+/**
+ * @brief Queues the performance sensors of every configured device for the next status_flush_performance(),
+ *        regardless of the rate limit. Call when the broker connects, as publishes while it was away were lost.
+ */
+void status_mark_performance_dirty(void);
+
 
 #define HA_ERR(code, detail) \
     do { \
@@ -3,57 +3,107 @@
 #include "config_types.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    HA_TOPIC_SCOPE_DEVICE = 0,  // "<prefix>/doorbell-mqtt/<device id>/..."
+    HA_TOPIC_SCOPE_SERVICE      // "<prefix>/doorbell-mqtt/<instance>/...", shared by all devices
+} ha_topic_scope_t;
+
+typedef enum {
+    HA_TOPIC_NONE = 0,
+#define X(id, subtopic, scope) id,
+#include "ha_topics.def"
+#undef X
+    HA_TOPIC_COUNT
+} ha_topic_id_t;
 
 /**
  * @brief Initializes Home Assistant MQTT topics based on the provided configuration.
- * 
- * @param cfg 
+ *        Every fixed topic is formatted once here and interned into a single table.
+ *
+ * @param cfg
+ * @return true
+ * @return false
+ */
+bool ha_topics_init(const config_t *cfg);
+
+/**
+ * @brief Releases the interned topic table. Pointers returned by ha_topic() are invalid afterwards.
+ *
+ */
+void ha_topics_shutdown(void);
+
+/**
+ * @brief Returns the number of per-device topic tables.
+ *
+ * @return size_t
+ */
+size_t ha_topics_device_count(void);
+
+/**
+ * @brief Returns the full MQTT topic for the given id and device. The string is owned by the
+ *        topic table and stays valid until ha_topics_shutdown().
+ *
+ * @param device device index
+ * @param id topic id
+ * @return const char* full topic, or NULL for HA_TOPIC_NONE or an unknown device
+ */
+const char *ha_topic(size_t device, ha_topic_id_t id);
+
+/**
+ * @brief Returns the subtopic (relative to the base topic) for the given id.
+ *
+ * @param id
+ * @return const char*
  */
-void ha_topics_init(const config_t *cfg);
+const char *ha_topic_subtopic(ha_topic_id_t id);
 
 /**
- * @brief Returns the base MQTT topic for this instance, constructed from the configured prefix and instance name.
- * 
- * @return const char* 
+ * @brief Returns the base MQTT topic for this service instance, constructed from the configured prefix and instance name.
+ *        Device topics live under "<prefix>/doorbell-mqtt/<device id>"; availability is shared under this base.
+ *
+ * @return const char*
  */
 const char *ha_get_base_topic(void);
 
 /**
- * @brief Builds a full MQTT topic by appending the provided subtopic to the base topic. 
- *        The result is written to the provided output buffer.
- * 
- * @param out 
- * @param out_size 
- * @param subtopic 
+ * @brief Builds a full MQTT topic by appending the provided subtopic to the base topic.
+ *        The result is written to the provided output buffer. Prefer ha_topic() for fixed topics.
+ *
+ * @param out
+ * @param out_size
+ * @param subtopic
  */
 void ha_build_topic(char *out, size_t out_size, const char *subtopic);
 
 /**
  * @brief Returns the MQTT topic used for reporting availability status to Home Assistant.
- * 
- * @return const char* 
+ *
+ * @return const char*
  */
 const char *ha_availability_topic(void);
 
 /**
- * @brief 
- * 
- * @return const char* 
+ * @brief Returns the MQTT topic used for reporting the service state.
+ *
+ * @return const char*
  */
 const char *ha_status_topic(void);
 
 /**
- * @brief Subscribes to all command topics for entities defined in ha_topics.h. 
- *        This should be called after connecting to MQTT to ensure command handling 
+ * @brief Subscribes to all command topics for entities defined in ha_topics.h.
+ *        This should be called after connecting to MQTT to ensure command handling
  *        is active.
- * 
+ *
  */
 void ha_topic_subscribe_commands(void);
 
 /**
- * @brief Registers command handlers for all entities defined in ha_topics.h. 
+ * @brief Registers command handlers for all entities defined in ha_topics.h, once per device.
  *        This should be called during initialization to ensure that incoming
  *        commands are properly routed to their handlers.
- * 
+ *
+ * @param devices configured devices, in the order passed to ha_topics_init()
  */
-void  ha_routes_register_commands(void);
+void  ha_routes_register_commands(const config_devices_t *devices);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Schema-driven JSON binding: a struct is described once by an X-macro .def file and parsed straight
+ * from the text into the struct, or written from it, without building a cJSON tree.
+ *
+ * A .def file lists one X(member, "jsonKey", KIND, default) line per scalar member and one
+ * X_OBJECT(member, "jsonKey", fields) line per nested struct. The including file binds it to a type:
+ *
+ *     #define X(member, key, kind, def) JSON_BIND_FIELD(my_struct_t, member, key, kind, def)
+ *     #define X_OBJECT(member, key, fields) JSON_BIND_OBJECT(my_struct_t, member, key, fields)
+ *     static const json_bind_field_t MY_FIELDS[] = {
+ *     #include "my_struct.def"
+ *     };
+ *     #undef X
+ *     #undef X_OBJECT
+ */
+
+typedef enum {
+    JSON_BIND_INT,      // int
+    JSON_BIND_BOOL,     // bool
+    JSON_BIND_TIME,     // time_t, written as a number of seconds
+    JSON_BIND_STRING,   // char[], NUL-terminated; longer values are an error
+    JSON_BIND_OBJECT,   // nested struct described by its own field table
+} json_bind_kind_t;
+
+typedef struct json_bind_field {
+    const char *key;
+    json_bind_kind_t kind;
+    size_t offset;
+    size_t size;
+    long long default_value;                // INT, BOOL and TIME; strings default to ""
+    const struct json_bind_field *fields;   // OBJECT only
+    size_t field_count;
+} json_bind_field_t;
+
+typedef struct {
+    size_t offset;      // byte offset of the problem in the input
+    int line;           // 1-based
+    int column;         // 1-based, in bytes
+    char message[128];
+} json_bind_error_t;
+
+#define JSON_BIND_FIELD(type, member, json_key, kind, def) \
+    { (json_key), JSON_BIND_##kind, offsetof(type, member), sizeof(((type *)0)->member), (def), NULL, 0 },
+
+#define JSON_BIND_OBJECT(type, member, json_key, sub_fields) \
+    { (json_key), JSON_BIND_OBJECT, offsetof(type, member), sizeof(((type *)0)->member), 0, (sub_fields), sizeof(sub_fields) / sizeof((sub_fields)[0]) },
+
+/**
+ * @brief Sets every bound member of out to its schema default.
+ *
+ * @param fields
+ * @param count
+ * @param out
+ */
+void json_bind_defaults(const json_bind_field_t *fields, size_t count, void *out);
+
+/**
+ * @brief Parses a JSON object into out. Members missing from the input (or null) keep their schema default;
+ *        unknown members are skipped. A value of the wrong type is an error.
+ *
+ * @param fields
+ * @param count
+ * @param json
+ * @param len
+ * @param out
+ * @param err may be NULL; receives the position and reason of the first problem
+ * @return true
+ * @return false
+ */
+bool json_bind_parse(const json_bind_field_t *fields, size_t count, const char *json, size_t len, void *out, json_bind_error_t *err);
+
+/**
+ * @brief Writes in as an indented JSON object, members in schema order.
+ *
+ * @param fields
+ * @param count
+ * @param in
+ * @param out receives a malloc'd, NUL-terminated buffer
+ * @param out_len may be NULL
+ * @return true
+ * @return false on allocation failure
+ */
+bool json_bind_write(const json_bind_field_t *fields, size_t count, const void *in, char **out, size_t *out_len);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Skips JSON whitespace.
+ *
+ * @param p
+ * @param end
+ * @return const char* first non-whitespace byte, or end
+ */
+const char *json_scan_skip_ws(const char *p, const char *end);
+
+/**
+ * @brief Skips one JSON value (string, number, literal, object or array) without building it.
+ *        Only the structure is checked: brackets must balance and strings must be terminated.
+ *
+ * @param p first byte of the value
+ * @param end
+ * @return const char* the byte after the value, or NULL when the input is malformed
+ */
+const char *json_scan_skip_value(const char *p, const char *end);
+
+/**
+ * @brief Finds a member of an object by key. Keys are compared byte for byte, so escaped keys never match.
+ *
+ * @param obj the object's opening '{'
+ * @param end
+ * @param key
+ * @param value receives the first byte of the member's value
+ * @param value_end receives the byte after the member's value
+ * @return true if the member exists
+ * @return false if it does not, or the object is malformed
+ */
+bool json_scan_find_member(const char *obj, const char *end, const char *key, const char **value, const char **value_end);
+
+/**
+ * @brief Tells whether a value span is a JSON string equal to s (byte for byte, no unescaping).
+ *
+ * @param value
+ * @param value_end
+ * @param s
+ * @return true
+ * @return false
+ */
+bool json_scan_string_equals(const char *value, const char *value_end, const char *s);
+
+/**
+ * @brief Writes s as a quoted JSON string, escaping quotes, backslashes and control characters.
+ *
+ * @param out
+ * @param out_size
+ * @param s
+ * @return true
+ * @return false if out is too small
+ */
+bool json_scan_quote(char *out, size_t out_size, const char *s);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
 typedef enum {
     LOG_LEVEL_DEBUG = 0,
     LOG_LEVEL_INFO,
@@ -8,10 +11,58 @@ typedef enum {
     LOG_LEVEL_FATAL
 } log_level_t;
 
+typedef enum {
+    LOG_FORMAT_TEXT = 0,    // "2026-01-01 12:00:00 [INFO ] message"
+    LOG_FORMAT_JSON,        // one JSON object per line
+} log_format_t;
+
+typedef enum {
+    LOG_OVERFLOW_DROP = 0,  // a full queue drops the line and counts it
+    LOG_OVERFLOW_BLOCK,     // a full queue makes the caller wait for the writer
+} log_overflow_t;
+
+/**
+ * @brief Set the level, format and overflow policy from the arguments or the LOG_LEVEL, LOG_FORMAT and
+ *        LOG_OVERFLOW environment variables. Logging stays synchronous until log_start_async.
+ *
+ * @param log_level NULL reads LOG_LEVEL
+ */
 void log_init(const char *log_level);
 
 void log_set_level(log_level_t level);
 
+void log_set_format(log_format_t format);
+
+void log_set_overflow(log_overflow_t overflow);
+
+/**
+ * @brief Send log lines to stream instead of stderr. Call before log_start_async.
+ *
+ * @param stream NULL restores stderr
+ */
+void log_set_stream(FILE *stream);
+
+/**
+ * @brief Hand lines to a background writer through a lock-free queue. Callers only format the message;
+ *        timestamps, output formatting and flushing happen on the writer thread.
+ *
+ * @return true
+ * @return false if the writer thread could not be started; logging stays synchronous
+ */
+bool log_start_async(void);
+
+/**
+ * @brief Write every queued line, stop the writer and return to synchronous logging.
+ */
+void log_shutdown(void);
+
+/**
+ * @brief Lines dropped because the queue was full, since startup.
+ *
+ * @return unsigned long
+ */
+unsigned long log_dropped(void);
+
 void log_log_impl(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...) __attribute__((format(printf, 5, 6)));
 
 #define log_log(level, file, line, func, ...) log_log_impl(level, file, line, func, __VA_ARGS__)
@@ -25,4 +76,3 @@ void log_log_impl(log_level_t level, const char *file, int line, const char *fun
 #define LOG_ERROR(...) log_log(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__)
 
 #define LOG_FATAL(...) log_log(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__)
-
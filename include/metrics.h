@@ -0,0 +1,90 @@
+#pragma once
+
+#include "config_types.h"
+#include "errors.h"
+#include "ha_topics.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+#define X(kind, id, name, help) id,
+#include "metrics.def"
+#undef X
+    METRIC_COUNT
+} metric_id_t;
+
+/**
+ * @brief Add n to a counter. Lock-free: each thread updates its own shard and shards are only summed
+ *        when the metrics are rendered, so hot paths never contend on a shared cache line.
+ *
+ * @param id a COUNTER metric
+ * @param n
+ */
+void metrics_add(metric_id_t id, uint64_t n);
+
+void metrics_inc(metric_id_t id);
+
+// Sum of all shards of a counter; relaxed, so concurrent increments may not be included yet.
+uint64_t metrics_counter_value(metric_id_t id);
+
+/**
+ * @brief Set or adjust a gauge. Gauges are a single shared value, not sharded.
+ *
+ * @param id a GAUGE metric
+ */
+void metrics_gauge_set(metric_id_t id, int64_t value);
+
+void metrics_gauge_add(metric_id_t id, int64_t delta);
+
+int64_t metrics_gauge_value(metric_id_t id);
+
+/**
+ * @brief Record one observation in a histogram.
+ *
+ * @param id a HISTOGRAM metric
+ * @param seconds
+ */
+void metrics_observe_seconds(metric_id_t id, double seconds);
+
+/**
+ * @brief Monotonic timestamp for metrics_observe_since.
+ *
+ * @return uint64_t microseconds
+ */
+uint64_t metrics_now_us(void);
+
+/**
+ * @brief Record the time elapsed since start_us in a histogram.
+ */
+void metrics_observe_since(metric_id_t id, uint64_t start_us);
+
+/**
+ * @brief Count an error reported to Home Assistant, labelled by its code. ERROR_NONE is ignored.
+ */
+void metrics_count_error(error_code_t code);
+
+/**
+ * @brief Count a status publish, labelled by its Home Assistant topic.
+ */
+void metrics_count_publish(ha_topic_id_t topic);
+
+/**
+ * @brief Render every metric in the Prometheus text exposition format.
+ *
+ * @param len receives the length, may be NULL
+ * @return char* caller frees with free(), NULL on allocation failure
+ */
+char *metrics_render(size_t *len);
+
+/**
+ * @brief Serve GET /metrics on cfg->address:cfg->port from a background thread.
+ *
+ * @param cfg port 0 leaves the endpoint disabled
+ * @return true if the endpoint is listening or disabled
+ * @return false if the socket could not be bound or the thread could not be started
+ */
+bool metrics_http_start(const config_metrics_t *cfg);
+
+void metrics_http_stop(void);
@@ -11,4 +11,7 @@ void mqtt_router_stop(void);
 
 int mqtt_router_enqueue(const char *topic, int topicLen, const char *payload, size_t len);
 
-int mqtt_routes_add(const char *topic, mqtt_handler_fn fn);
\ No newline at end of file
+// A message on the route cancels the running and queued commands of its device before it is queued itself.
+#define MQTT_ROUTE_SUPERSEDES 0x1
+
+int mqtt_routes_add(const char *topic, mqtt_handler_fn fn, const config_device_t *device, unsigned flags);
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include <stddef.h>
 
 typedef struct mqtt_router_ctx {
-    const config_ssh_t *ssh_cfg;
+    const config_device_t *device;
+    const config_devices_t *devices_cfg;
+    const config_fleet_t *fleet_cfg;
     const config_preset_t *preset_cfg;
 } mqtt_router_ctx_t;
 
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PROFILE_CHECK_SCHEMA_VERSION 1
+#define PROFILE_CHECK_SPRITE_PX 240
+#define PROFILE_CHECK_MAX_THREADS 8
+
+typedef struct {
+    char directory[256];    // relative to the profiles directory
+    char digest[33];        // empty when the profile could not be read
+    int error;              // ERROR_NONE when the profile is valid
+    char message[256];
+    bool cached;            // result reused from an earlier run with the same digest
+} profile_check_result_t;
+
+typedef struct {
+    profile_check_result_t *items;
+    size_t count;
+    size_t failed;
+    size_t cached;
+    int threads;
+    long long wall_ms;
+} profile_check_report_t;
+
+/**
+ * @brief Reads the frame layout of a PNG sprite sheet from its header.
+ *
+ * @param head first bytes of the file (at least 24)
+ * @param len
+ * @param frames receives the number of PROFILE_CHECK_SPRITE_PX square frames
+ * @return true if the header is a PNG whose size is a whole number of frames
+ * @return false
+ */
+bool profile_check_png_frames(const unsigned char *head, size_t len, int *frames);
+
+/**
+ * @brief Checks that a sound starts with an Ogg or RIFF/WAVE header.
+ *
+ * @param head first bytes of the file (at least 12)
+ * @param len
+ * @return true
+ * @return false
+ */
+bool profile_check_sound_header(const unsigned char *head, size_t len);
+
+/**
+ * @brief Validates one profile directory without touching the network: schema version, that the enabled
+ *        assets exist, and that welcome.count matches the sprite sheet.
+ *
+ * @param profile_dir
+ * @param message receives the first problem found
+ * @param message_len
+ * @return int ERROR_NONE when valid, otherwise ERROR_PROFILE_NOT_FOUND or ERROR_PROFILE_INVALID
+ */
+int profile_check_dir(const char *profile_dir, char *message, size_t message_len);
+
+/**
+ * @brief Validates every profile under profiles_dir, and every configured preset directory, on a pool of
+ *        threads. Results are cached in .state/profile_check.json keyed by a digest of each profile, so
+ *        unchanged profiles are not read again.
+ *
+ * @param profiles_dir
+ * @param presets may be NULL
+ * @param threads 1..PROFILE_CHECK_MAX_THREADS
+ * @param out release with profile_check_report_free()
+ * @return true if every profile is valid
+ * @return false
+ */
+bool profile_check_library(const char *profiles_dir, const config_preset_t *presets, int threads, profile_check_report_t *out);
+
+/**
+ * @brief Releases a report filled by profile_check_library().
+ *
+ * @param report
+ */
+void profile_check_report_free(profile_check_report_t *report);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+#include <time.h>
+
+typedef struct {
+    time_t at;
+    const char *preset;
+    const char *tag;    // NULL or empty for every device
+} scheduler_event_t;
+
+/**
+ * @brief Finds the next scheduled switch strictly after `now`. A window contributes its start
+ *        (switch to its preset) and, when schedule.default_preset is set, its end (switch back).
+ *
+ * @param schedule
+ * @param now
+ * @param out
+ * @return true if an upcoming switch exists
+ * @return false
+ */
+bool scheduler_next_event(const config_schedule_t *schedule, time_t now, scheduler_event_t *out);
+
+/**
+ * @brief Finds the latest scheduled switch at or before `now`: the preset the schedule says should be
+ *        running. After a window's end that is schedule.default_preset; without one, nothing.
+ *
+ * @param schedule
+ * @param now
+ * @param out
+ * @return true if a preset should be running
+ * @return false when no switch has happened yet or the latest one was an end without a default preset
+ */
+bool scheduler_active_event(const config_schedule_t *schedule, time_t now, scheduler_event_t *out);
+
+/**
+ * @brief Applies the preset of scheduler_active_event() to the devices of its window and returns when done.
+ *        Devices that already run it are left alone. The scheduler thread calls this once as it starts.
+ *
+ * @param cfg
+ * @param now
+ */
+void scheduler_catch_up(const config_t *cfg, time_t now);
+
+/**
+ * @brief Starts the scheduler thread. Assets for each switch are staged on the devices
+ *        schedule.lead_minutes ahead; at the scheduled time only the cut-over runs. First it catches
+ *        up with the window that is already active (scheduler_catch_up()).
+ *        Does nothing when no schedule windows are configured.
+ *
+ * @param cfg must outlive the scheduler
+ * @return true
+ * @return false
+ */
+bool scheduler_start(const config_t *cfg);
+
+/**
+ * @brief Stops the scheduler thread, interrupting any wait.
+ *
+ */
+void scheduler_stop(void);
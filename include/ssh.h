@@ -15,8 +15,16 @@ ssh_session_t *ssh_session_create(const config_ssh_t *ssh_cfg);
 
 void ssh_session_destroy(ssh_session_t *session);
 
+// Kernel's smoothed TCP round-trip time to the device in milliseconds, or -1 if it is unavailable.
+double ssh_session_rtt_ms(const ssh_session_t *session);
+
+// stdout_data and stderr_data are released with arena_free.
 bool ssh_exec_command(ssh_session_t *session, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len);
 
 bool ssh_scp_upload_file(ssh_session_t *session, const char *local_path, const char *remote_dir, unsigned long remote_mode);
 
+bool ssh_scp_upload_buffer(ssh_session_t *session, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode);
+
+bool ssh_exec_write(ssh_session_t *session, const char *command, const void *data, size_t len);
+
 bool ssh_scp_download_file(ssh_session_t *session, const char *remote_path, const char *local_path);
\ No newline at end of file
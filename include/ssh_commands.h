@@ -5,19 +5,43 @@
 #define CMD_MKDIR "mkdir -p '%s'"
 #define CMD_MV "mv '%s' '%s'"
 #define CMD_RM_RF "rm -rf '%s'"
+#define CMD_CAT "cat '%s'"
+// Prints "<size> <mtime>", or nothing when the file is missing; always exits 0.
+#define CMD_STAT "stat -c '%%s %%Y' '%s' 2>/dev/null || true"
+#define CMD_WRITE_FILE "cat > '%s/%s'"
 #define CMD_RESTART_LCM "systemctl restart unifi-lcm-gui unifi-lcm-sound"
+#define CMD_CACHE_FETCH "cp -f '%s/%s' '%s/%s' && printf '%%s' '%s' > '%s/%s.md5' && touch '%s/%s'"
+
+// Evicts least recently used entries (oldest mtime first) until both the entry and size budgets hold.
+// Each evicted entry is reported on stdout as "EVICT <md5>".
+#define SCRIPT_CACHE_PRUNE \
+    "cd \"$CACHE\" || exit 0\n" \
+    "n=0; kb=0\n" \
+    "for f in $(ls -t); do\n" \
+    "  s=$(du -k \"$f\" | cut -f1)\n" \
+    "  n=$((n+1)); kb=$((kb+s))\n" \
+    "  if [ $n -gt %d -o $kb -gt %d ]; then rm -f \"$f\" && echo \"EVICT $f\"; fi\n" \
+    "done\n"
 
 #define SCRIPT_PREAMBLE \
     "set -eu\n" \
     "STEP=\"\"\n" \
     "fail() { rc=$1; echo \"ERROR step=$STEP rc=$rc\" 1>&2; exit $rc; }\n" \
-    "run() { STEP=$1; shift; \"$@\" || fail $?; }\n" \
+    "run() { STEP=$1; shift; t0=; [ -z \"${TRACE_STEPS:-}\" ] || read t0 _ < /proc/uptime || t0=; \"$@\" || fail $?;\n" \
+    "  [ -z \"$t0\" ] || { read t1 _ < /proc/uptime || t1=$t0; echo \"TRACE step=$STEP start=$t0 end=$t1\" 1>&2; }; }\n" \
     "\n" \
     "PERSIST_DIR='/etc/persistent'\n" \
     "ANIM_DIR='/etc/persistent/lcm/animation'\n" \
     "SND_DIR='/etc/persistent/sounds'\n" \
     "run ensure_dirs mkdir -p \"$ANIM_DIR\" \"$SND_DIR\"\n"
 
+// Inflates files sent compressed (<name>.gz) back to <name> before anything is moved into place.
+#define SCRIPT_DECOMPRESS \
+    "for f in '%s'/*.gz; do\n" \
+    "  [ -e \"$f\" ] || continue\n" \
+    "  run decompress gzip -df \"$f\"\n" \
+    "done\n"
+
 #define SCRIPT_RESTART \
     "run restart_services sh -c '\n" \
     "  has_proc() { pidof \"$1\" >/dev/null 2>&1; }\n" \
@@ -51,6 +75,29 @@
     "  echo \"OK\"\n" \
     "'\n"
 
+// Restarts the one doorbell service whose conf was replaced, with the same limits as SCRIPT_RESTART.
+#define SCRIPT_RESTART_SERVICE \
+    "run restart_service sh -c '\n" \
+    "  svc=%s\n" \
+    "  has_proc() { pidof \"$svc\" >/dev/null 2>&1; }\n" \
+    "  killall \"$svc\" >/dev/null 2>&1; rc=$?; [ $rc -eq 0 -o $rc -eq 1 ] || exit $rc\n" \
+    "\n" \
+    "  # 0.2s * 25 = 5s max\n" \
+    "  t=25; while has_proc; do [ $t -gt 0 ] || exit 210; sleep 0.2; t=$((t-1)); done\n" \
+    "  # 0.2s * 50 = 10s max\n" \
+    "  t=50; until has_proc; do [ $t -gt 0 ] || exit 211; sleep 0.2; t=$((t-1)); done\n" \
+    "  echo \"OK\"\n" \
+    "'\n"
+
+
+// Prepended to the apply script to make every step report its start and end uptime on stderr.
+#define SCRIPT_TRACE_STEPS "TRACE_STEPS=1\n"
+
+typedef struct {
+    char step[64];
+    double start_s;     // device uptime in seconds
+    double end_s;
+} ssh_step_trace_t;
 
 typedef struct {
     bool has_error;     
@@ -66,6 +113,46 @@ bool ssh_cmd_rm_rf(char *out, size_t out_sz, const char *path);
 
 bool ssh_cmd_restart_lcm(char *out, size_t out_sz);
 
+bool ssh_cmd_cat(char *out, size_t out_sz, const char *path);
+
+bool ssh_cmd_stat(char *out, size_t out_sz, const char *path);
+
+/**
+ * @brief Builds a command that writes its stdin to dir/name.
+ */
+bool ssh_cmd_write_file(char *out, size_t out_sz, const char *dir, const char *name);
+
 bool build_apply_profile_command(char *out, size_t out_sz, const char *tmp_dir, const char *anim_file, const char *sound_file);
 
-bool ssh_parse_step_error(const char *stderr_text, ssh_step_error_t *out);
\ No newline at end of file
+/**
+ * @brief Builds a script that moves only the patched confs uploaded to tmp_dir into place and restarts only
+ *        the services that read them. Assets are left alone.
+ */
+bool build_apply_conf_command(char *out, size_t out_sz, const char *tmp_dir, bool lcm_gui, bool sounds_leds);
+
+/**
+ * @brief Builds a command that copies a cached asset into dst_dir and writes its .md5 sidecar next to it.
+ *        The command fails when md5_hex is not in the cache.
+ */
+bool ssh_cmd_cache_fetch(char *out, size_t out_sz, const char *cache_dir, const char *md5_hex, const char *dst_dir, const char *file);
+
+/**
+ * @brief Builds a script that adds the given uploaded files to the cache under their md5 and then prunes it
+ *        down to max_entries files and max_kb kilobytes.
+ */
+bool build_cache_store_command(char *out, size_t out_sz, const char *cache_dir, const char *src_dir, const char *const *files, const char *const *md5_hexes, size_t count, int max_entries, int max_kb);
+
+/**
+ * @brief Counts the "EVICT <md5>" lines printed by the cache prune script.
+ */
+int ssh_parse_cache_evictions(const char *stdout_text);
+
+bool ssh_parse_step_error(const char *stderr_text, ssh_step_error_t *out);
+
+/**
+ * @brief Reads the next "TRACE step=<name> start=<uptime> end=<uptime>" line printed by a script run with
+ *        SCRIPT_TRACE_STEPS, starting at *cursor, and moves *cursor past it.
+ *
+ * @return false when there are no more
+ */
+bool ssh_parse_step_trace(const char **cursor, ssh_step_trace_t *out);
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_FILE "trace.json"
+
+/**
+ * @brief Start writing spans to <state_dir>/trace.json in the Chrome trace-event format (a JSON array of
+ *        complete "X" events), which chrome://tracing and Perfetto load directly. When the file grows past
+ *        cfg->max_kb it is renamed to trace.json.1 and a new one is started. Does nothing when tracing is
+ *        disabled.
+ *
+ * @param cfg
+ * @param state_dir created if it does not exist
+ * @return false if tracing is enabled but the file cannot be opened
+ */
+bool trace_start(const config_trace_t *cfg, const char *state_dir);
+
+void trace_stop(void);
+
+bool trace_enabled(void);
+
+/**
+ * @brief Timestamp for the start of a span. Costs one relaxed load when tracing is off.
+ *
+ * @return uint64_t microseconds, or 0 when tracing is off
+ */
+uint64_t trace_begin(void);
+
+/**
+ * @brief Record a span from start_us until now on the calling thread. Spans on one thread nest by time,
+ *        so a span ended inside another shows up as its child.
+ *
+ * @param start_us from trace_begin(); 0 records nothing
+ * @param cat category, e.g. "ssh"
+ * @param name
+ * @param detail shown as args.detail, may be NULL
+ * @param bytes shown as args.bytes when positive
+ */
+void trace_end(uint64_t start_us, const char *cat, const char *name, const char *detail, long long bytes);
+
+/**
+ * @brief Record a span with an explicit duration, for work timed elsewhere (e.g. remote script steps).
+ */
+void trace_span(uint64_t start_us, uint64_t duration_us, const char *cat, const char *name, const char *detail, long long bytes);
+
+/**
+ * @brief Write buffered spans to the file. Called once per command so a slow apply can be inspected
+ *        while the service runs.
+ */
+void trace_flush(void);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A connection to one doorbell. unifi_remote.c only talks to the device through this, so the same
+ *        apply and download code runs over SSH or against the local simulator (see transport_sim_open()).
+ */
+typedef struct transport transport_t;
+
+typedef struct {
+    long long size;
+    long long mtime;    // seconds since the epoch
+} transport_stat_t;
+
+/**
+ * @brief Backend operations. Every function receives the backend's own state as impl. Output buffers
+ *        of exec are released with arena_free; exec fails when the command exits non-zero.
+ */
+typedef struct {
+    const char *name;
+    bool (*exec)(void *impl, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len);
+    bool (*exec_write)(void *impl, const char *command, const void *data, size_t len);
+    bool (*upload_file)(void *impl, const char *local_path, const char *remote_dir, unsigned long remote_mode);
+    bool (*upload_buffer)(void *impl, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode);
+    bool (*download_file)(void *impl, const char *remote_path, const char *local_path);
+    bool (*stat)(void *impl, const char *remote_path, transport_stat_t *out);
+    double (*rtt_ms)(const void *impl);
+    void (*close)(void *impl);
+} transport_ops_t;
+
+/**
+ * @brief Connects to a device: the simulator when ssh_cfg->sim.root is set, otherwise SSH.
+ *
+ * @param ssh_cfg
+ * @return transport_t* NULL if the connection failed
+ */
+transport_t *transport_open(const config_ssh_t *ssh_cfg);
+
+/**
+ * @brief Wraps backend state in a transport. The transport owns impl and releases it through ops->close.
+ *
+ * @param ops
+ * @param impl
+ * @return transport_t* NULL on allocation failure, in which case impl is closed
+ */
+transport_t *transport_create(const transport_ops_t *ops, void *impl);
+
+void transport_close(transport_t *transport);
+
+const char *transport_name(const transport_t *transport);
+
+// stdout_data and stderr_data are released with arena_free.
+bool transport_exec(transport_t *transport, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len);
+
+// Runs command with data on its stdin.
+bool transport_exec_write(transport_t *transport, const char *command, const void *data, size_t len);
+
+bool transport_upload_file(transport_t *transport, const char *local_path, const char *remote_dir, unsigned long remote_mode);
+
+bool transport_upload_buffer(transport_t *transport, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode);
+
+bool transport_download_file(transport_t *transport, const char *remote_path, const char *local_path);
+
+// False when the remote file does not exist.
+bool transport_stat(transport_t *transport, const char *remote_path, transport_stat_t *out);
+
+// Round-trip time to the device in milliseconds, or -1 if it is unknown.
+double transport_rtt_ms(const transport_t *transport);
+
+/**
+ * @brief Opens a simulated doorbell. Device paths (/etc/persistent and the upload areas) map onto
+ *        sim_cfg->root, commands and the apply script run locally with /bin/sh, and the configured latency
+ *        and bandwidth are added to every operation. The root is created and seeded with default confs
+ *        when it does not hold them yet.
+ *
+ * @param sim_cfg
+ * @return transport_t* NULL if the root cannot be prepared
+ */
+transport_t *transport_sim_open(const config_sim_t *sim_cfg);
@@ -27,6 +27,7 @@ typedef struct {
 } unifi_profile_t;
 
 typedef struct {
+    int schema_version;
     char profile_name[256];
     bool is_preset;
     time_t appied_at;
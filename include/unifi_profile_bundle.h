@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Packed profile bundle (profile.dbp): a single file holding profile.json, a table of the assets with their
+ * MD5 digests, and the raw asset bytes. A profile directory containing a bundle is loaded from it instead of
+ * from loose files.
+ *
+ * Layout, all integers little-endian:
+ *   header  magic "DBPBNDL1", u32 version, u32 asset_count, u32 json_offset, u32 json_len, u64 data_offset
+ *   table   asset_count x { char name[256] (NUL padded), char md5[32] (hex), u64 offset, u64 size }
+ *   json    json_len bytes of profile.json
+ *   data    asset bytes at the offsets given in the table
+ */
+
+#define UNIFI_BUNDLE_FILE "profile.dbp"
+#define UNIFI_BUNDLE_VERSION 1
+#define UNIFI_BUNDLE_MAX_ASSETS 8
+
+typedef struct {
+    char name[256];
+    char md5_hex[33];
+    const unsigned char *data;  // points into the bundle mapping
+    size_t size;
+} unifi_bundle_asset_t;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    const char *json;           // not NUL-terminated
+    size_t json_len;
+    unifi_bundle_asset_t assets[UNIFI_BUNDLE_MAX_ASSETS];
+    size_t asset_count;
+} unifi_bundle_t;
+
+/**
+ * @brief Maps a bundle read-only and validates its header and table against the file size. Asset bytes
+ *        are not read or hashed; the embedded digests are trusted.
+ *
+ * @param path
+ * @param out release with unifi_bundle_close()
+ * @return true
+ * @return false if the file is missing, truncated or not a bundle
+ */
+bool unifi_bundle_open(const char *path, unifi_bundle_t *out);
+
+/**
+ * @brief Unmaps a bundle. Asset data pointers are invalid afterwards. Safe on a zeroed or closed bundle.
+ *
+ * @param bundle
+ */
+void unifi_bundle_close(unifi_bundle_t *bundle);
+
+/**
+ * @brief Finds an asset by file name.
+ *
+ * @param bundle
+ * @param name
+ * @return const unifi_bundle_asset_t* NULL when not present
+ */
+const unifi_bundle_asset_t *unifi_bundle_find(const unifi_bundle_t *bundle, const char *name);
+
+/**
+ * @brief Packs a profile directory (profile.json plus the files it references) into a bundle.
+ *        Writes to a temporary file next to out_path and renames it into place.
+ *
+ * @param profile_dir
+ * @param out_path
+ * @return true
+ * @return false
+ */
+bool unifi_bundle_pack_dir(const char *profile_dir, const char *out_path);
@@ -2,6 +2,7 @@
 
 #include "unifi_profile.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * @brief Read profile data from LCM GUI configuration.
@@ -23,6 +24,35 @@ bool unifi_profile_read_from_lcm_gui_conf(const char *path, unifi_profile_t *out
  */
 bool unifi_profile_read_from_sounds_leds_conf(const char *path, unifi_profile_t *out);
 
+/**
+ * @brief Patch an LCM GUI configuration held in memory. The WELCOME entry of customAnimations is located by
+ *        scanning tokens and only its changed values are spliced in; every other byte is copied unchanged.
+ *        A disabled welcome animation removes the entry.
+ * 
+ * @param in 
+ * @param in_len 
+ * @param desired 
+ * @param out receives a malloc'd, NUL-terminated buffer
+ * @param out_len 
+ * @return true 
+ * @return false if the conf is not a well-formed JSON object
+ */
+bool unifi_profile_patch_lcm_gui_buffer(const char *in, size_t in_len, const unifi_profile_t *desired, char **out, size_t *out_len);
+
+/**
+ * @brief Patch a Sounds & LEDs configuration held in memory, splicing the RING_BUTTON_PRESSED entry of
+ *        customSounds in place like unifi_profile_patch_lcm_gui_buffer().
+ * 
+ * @param in 
+ * @param in_len 
+ * @param desired 
+ * @param out receives a malloc'd, NUL-terminated buffer
+ * @param out_len 
+ * @return true 
+ * @return false 
+ */
+bool unifi_profile_patch_sounds_leds_buffer(const char *in, size_t in_len, const unifi_profile_t *desired, char **out, size_t *out_len);
+
 /**
  * @brief Patch LCM GUI configuration with desired profile data.
  * 
@@ -43,4 +73,26 @@ bool unifi_profile_patch_lcm_gui_conf(const char *in_path, const char *out_path,
  * @return true 
  * @return false 
  */
-bool unifi_profile_patch_sounds_leds_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired);
\ No newline at end of file
+bool unifi_profile_patch_sounds_leds_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired);
+/**
+ * @brief Compare two configurations as JSON values, ignoring whitespace and member order. Used to tell
+ *        whether patching a device conf would change anything.
+ * 
+ * @param a 
+ * @param a_len 
+ * @param b 
+ * @param b_len 
+ * @return true if both parse and hold the same value
+ * @return false 
+ */
+bool unifi_profile_conf_equivalent(const char *a, size_t a_len, const char *b, size_t b_len);
+
+/**
+ * @brief unifi_profile_conf_equivalent() for two conf files.
+ * 
+ * @param a_path 
+ * @param b_path 
+ * @return true 
+ * @return false if either file is missing, unreadable or not JSON, or they differ
+ */
+bool unifi_profile_conf_files_equivalent(const char *a_path, const char *b_path);
@@ -1,19 +1,41 @@
 #pragma once
 
+#include "json_bind.h"
 #include "unifi_profile.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+
+// Field tables generated from unifi_profile.def and unifi_last_applied.def.
+extern const json_bind_field_t UNIFI_PROFILE_FIELDS[];
+extern const size_t UNIFI_PROFILE_FIELD_COUNT;
+extern const json_bind_field_t UNIFI_LAST_APPLIED_FIELDS[];
+extern const size_t UNIFI_LAST_APPLIED_FIELD_COUNT;
 
 /**
- * @brief Load a unifi_profile_t from a JSON file.
+ * @brief Load a unifi_profile_t from a profile directory: from its profile.dbp bundle when present,
+ *        otherwise from profile.json.
  * 
- * @param path 
+ * @param path profile directory
  * @param p 
  * @return true 
  * @return false 
  */
 bool unifi_profile_load_from_file(const char *path, unifi_profile_t *p);
 
+/**
+ * @brief Load a unifi_profile_t from profile JSON held in memory. Missing members take their defaults
+ *        from unifi_profile.def; malformed JSON or a mistyped member is logged with its line and column.
+ * 
+ * @param json need not be NUL-terminated
+ * @param json_len 
+ * @param source name used in error messages
+ * @param p 
+ * @return true 
+ * @return false 
+ */
+bool unifi_profile_load_from_json(const char *json, size_t json_len, const char *source, unifi_profile_t *p);
+
 /**
  * @brief Write a unifi_profile_t to a JSON file.
  * 
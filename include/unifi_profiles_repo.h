@@ -1,13 +1,28 @@
 #pragma once
 
+#include "cJSON.h"
 #include "config_types.h"
 #include "unifi_profile.h"
+#include "unifi_remote.h"
 #include <linux/limits.h>
 #include <stdbool.h>
 
+/**
+ * @brief A configured preset as indexed at startup: profile.json is parsed and the assets are resolved
+ *        and hashed once, so applying it needs no disk access before the transfer. Read-only for callers.
+ */
+typedef struct {
+    const char *name;           // display name from the configuration
+    unifi_apply_plan_t plan;
+    long long image_size;       // bytes; 0 when the welcome animation is disabled
+    long long sound_size;       // bytes; 0 when the ring button sound is disabled
+    int refs;                   // managed by the repo
+    bool retired;               // replaced by a reload; freed on the last release
+} profiles_preset_t;
 
 /**
- * @brief Initialize the profiles module with the given base directory and configuration.
+ * @brief Initialize the profiles module with the given base directory and configuration, and build the preset catalog.
+ *        Presets whose profile cannot be loaded are logged and left out of the catalog; they do not fail init.
  * 
  * @param base_dir 
  * @param cfg 
@@ -27,6 +42,53 @@ bool profiles_repo_init(const char *base_dir, const config_preset_t *cfg);
  */
 bool profiles_repo_resolve_preset(const char *preset_name, char *out_dir, size_t out_len);
 
+/**
+ * @brief Look up a preset in the catalog (case/space-insensitive). The preset stays valid until it is
+ *        passed to profiles_repo_release_preset().
+ * 
+ * @param preset_name 
+ * @param out 
+ * @return int ERROR_NONE, ERROR_PROFILE_NOT_FOUND, or the error that kept the preset out of the catalog
+ */
+int profiles_repo_acquire_preset(const char *preset_name, const profiles_preset_t **out);
+
+/**
+ * @brief Release a preset returned by profiles_repo_acquire_preset(). NULL is ignored.
+ * 
+ * @param preset 
+ */
+void profiles_repo_release_preset(const profiles_preset_t *preset);
+
+/**
+ * @brief Replace the preset catalog with one built from a reloaded configuration. Presets whose name and
+ *        directory are unchanged keep their indexed profile; the rest are loaded again. Lookups keep working
+ *        on the old catalog until the swap. Must only be called from one thread.
+ * 
+ * @param cfg 
+ * @param names_changed optional, set when the list of preset names (or its order) changed
+ * @return true 
+ * @return false on allocation failure; the old catalog stays in place
+ */
+bool profiles_repo_reload_presets(const config_preset_t *cfg, bool *names_changed);
+
+/**
+ * @brief Reload the profile of every preset mapped to the given directory (relative to the base directory).
+ *        Same threading rule as profiles_repo_reload_presets().
+ * 
+ * @param directory 
+ * @return true if a preset uses the directory
+ * @return false 
+ */
+bool profiles_repo_reindex_directory(const char *directory);
+
+/**
+ * @brief Append the current preset display names, in configuration order, to a cJSON array.
+ * 
+ * @param array 
+ * @return size_t number of names added
+ */
+size_t profiles_repo_add_preset_names(cJSON *array);
+
 /**
  * @brief Resolve a custom profile directory.
  * 
@@ -48,10 +110,29 @@ bool profiles_repo_resolve_custom(const char *custom_directory, char *out_dir, s
  */
 bool profiles_repo_create_temp_profile_dir(char *out_dir, size_t out_len);
 
+/**
+ * @brief Set the size budget shared by the "downloads" and "partial" directories.
+ * 
+ * @param cfg max_mb of 0 keeps every download
+ */
+void profiles_repo_set_downloads_budget(const config_downloads_t *cfg);
+
+/**
+ * @brief Get the directory of the content-addressed store that download files are hard-linked from.
+ * 
+ * @param out_dir 
+ * @param out_len 
+ * @return true 
+ * @return false 
+ */
+bool profiles_repo_blob_dir(char *out_dir, size_t out_len);
+
 /**
  * @brief Rename the temporary profile directory to a final location. If partial is true, it will be moved to a "partial" 
  *        subdirectory to indicate an incomplete download. Otherwise, it will be moved to a "downloads" subdirectory. 
  *        The final path will be returned in out.
+ *        Its files are first moved into the blob store, so identical files across downloads are kept once. Afterwards
+ *        the oldest downloads are deleted until the store fits the downloads budget; the new one is always kept.
  * 
  * @param temp_dir
  * @param time 
@@ -69,21 +150,23 @@ bool profiles_repo_rename_temp_profile_dir(const char *temp_dir, time_t *time, b
  * @brief Write the last applied profile information to storage. This can be used to track which profile was last applied,
  *        when, and whether it was a preset or custom profile.
  * 
+ * @param device_id device the profile was applied to, or NULL for the legacy single-device file
  * @param profile 
  * @param is_preset 
  * @return true 
  * @return false 
  */
-bool profiles_write_last_applied(const char *name, bool is_preset);
+bool profiles_write_last_applied(const char *device_id, const char *name, bool is_preset);
 
 /**
  * @brief Load the last applied profile information from storage.
  * 
+ * @param device_id device to load state for, or NULL for the legacy single-device file
  * @param out 
  * @return true 
  * @return false 
  */
-bool profile_load_last_applied(unifi_last_applied_profile_t *out);
+bool profile_load_last_applied(const char *device_id, unifi_last_applied_profile_t *out);
 
 /**
  * @brief Shutdown the profiles module and release global resources.
@@ -1,9 +1,72 @@
 #pragma  once
 
-#include "ssh.h"
+#include "config_types.h"
+#include "transport.h"
 #include "unifi_profile.h"
+#include "unifi_profile_bundle.h"
+#include <linux/limits.h>
 #include <stdbool.h>
 
+// Remote upload area for immediate applies; wiped at the start of every apply.
+#define UNIFI_REMOTE_UPLOAD_DIR "/tmp/doorbell-mqtt-unifi"
+// Remote area for a profile staged ahead of a scheduled cut-over; separate so immediate applies leave it alone.
+#define UNIFI_REMOTE_STAGING_DIR "/tmp/doorbell-mqtt-unifi-staged"
+
+/**
+ * @brief Device-independent part of an apply: the profile plus its resolved and hashed assets.
+ *        Prepared once and reused read-only for every device the profile is applied to.
+ */
+typedef struct {
+    char profile_dir[PATH_MAX];
+    unifi_profile_t profile;
+    char image_path[PATH_MAX];      // empty when the welcome animation is disabled
+    char image_md5_path[PATH_MAX];
+    char image_md5[33];
+    char sound_path[PATH_MAX];      // empty when the ring button sound is disabled
+    char sound_md5_path[PATH_MAX];
+    char sound_md5[33];
+    char work_dir[PATH_MAX];        // local directory holding the .md5 sidecars
+    long long image_size;
+    long long sound_size;
+    const unsigned char *image_data;    // set when the asset is uploaded straight from the bundle
+    const unsigned char *sound_data;
+    unifi_bundle_t bundle;          // mapped when the profile directory holds a profile.dbp
+    unsigned char *image_optimized; // recompressed welcome image owned by the plan; image_data points here when set
+    long long image_saved;          // bytes the recompressed image saves on every upload
+} unifi_apply_plan_t;
+
+/**
+ * @brief Outcome of the on-device asset cache for one upload. All zero when the cache is disabled.
+ */
+typedef struct {
+    bool cache_enabled;
+    int cache_hits;         // assets restored on the device without a transfer
+    int cache_misses;       // assets transferred over SCP
+    int cache_evictions;
+    long long bytes_sent;   // asset and conf bytes put on the wire
+    long long bytes_saved;  // bytes kept off the wire by PNG recompression and gzip transfers
+    double upload_seconds;  // time spent putting bytes_sent on the wire
+    double apply_seconds;   // upload plus the apply script, as recorded in the apply duration histogram
+    bool unchanged;         // the device already ran the profile; nothing was uploaded or restarted
+} unifi_apply_stats_t;
+
+/**
+ * @brief Sets the on-device asset cache used by every later upload. Call once at startup,
+ *        before any apply runs. A max_entries of 0 disables the cache.
+ * 
+ * @param cache_cfg 
+ */
+void unifi_remote_set_cache(const config_cache_t *cache_cfg);
+
+/**
+ * @brief Sets the upload-size optimizations applied when a plan is prepared. Call once at startup,
+ *        before any plan is prepared.
+ * 
+ * @param optimize_cfg NULL disables every optimization
+ * @param cache_dir local directory for optimized copies, keyed by the source MD5
+ */
+void unifi_remote_set_optimize(const config_optimize_t *optimize_cfg, const char *cache_dir);
+
 /**
  * @brief Downloads the current configuration from the device, including the ubnt_lcm_gui.conf 
  *        and ubnt_sounds_leds.conf files, and loads them into a unifi_profile_t structure. 
@@ -14,25 +77,129 @@
  * @return true 
  * @return false 
  */
-bool unifi_conf_download_and_load(ssh_session_t *session, const char *tmp_dir, unifi_profile_t *out);
+bool unifi_conf_download_and_load(transport_t *session, const char *tmp_dir, unifi_profile_t *out);
 
 /**
- * @brief Downloads the current configuration from the device including the assets.
+ * @brief Downloads the current configuration from the device including the assets. An asset whose
+ *        device-side .md5 sidecar names a blob already held in blob_dir is linked from there instead of transferred.
  * 
  * @param session 
  * @param tmp_dir 
+ * @param blob_dir may be NULL to always transfer the assets
  * @param out 
  * @return true 
  * @return false 
  */
-bool unifi_profile_download_and_load(ssh_session_t *session, const char *tmp_dir, unifi_profile_t *out);
+bool unifi_profile_download_and_load(transport_t *session, const char *tmp_dir, const char *blob_dir, unifi_profile_t *out);
 
 /**
  * @brief Uploads the given profile to the device and applies it. This includes uploading any custom animation or sound files,
+ *        unless the device already runs the profile (see unifi_profile_apply_plan()).
  * 
  * @param session 
  * @param profile_dir 
  * @param profile 
+ * @param force upload and restart even when the device already runs the profile
+ * @param stats optional, receives the asset cache outcome
  * @return int 
  */
-int unifi_profile_upload_and_apply(ssh_session_t *session, const char *profile_dir, const unifi_profile_t *profile);
+int unifi_profile_upload_and_apply(transport_t *session, const char *profile_dir, const unifi_profile_t *profile, bool force, unifi_apply_stats_t *stats);
+
+/**
+ * @brief Resolves and hashes the enabled assets of a profile so it can be applied to any number of devices.
+ *        When the directory holds a profile.dbp bundle it stays mapped and its embedded digests are used
+ *        instead of hashing. Release the plan with unifi_apply_plan_release() when done.
+ * 
+ * @param profile_dir 
+ * @param profile 
+ * @param plan 
+ * @return int ERROR_NONE on success, otherwise an error code
+ */
+int unifi_apply_plan_prepare(const char *profile_dir, const unifi_profile_t *profile, unifi_apply_plan_t *plan);
+
+/**
+ * @brief Deletes the local files created by unifi_apply_plan_prepare() and unmaps its bundle.
+ * 
+ * @param plan 
+ */
+void unifi_apply_plan_release(unifi_apply_plan_t *plan);
+
+/**
+ * @brief Applies a prepared plan to one device. The device configuration is downloaded and patched per call;
+ *        the plan itself is not modified, so several threads may share it. When the patched confs equal the
+ *        device's and the device-side .md5 sidecars match the plan's assets, nothing is uploaded or restarted
+ *        and stats->unchanged is set.
+ * 
+ * @param session 
+ * @param plan 
+ * @param stats optional, receives the asset cache outcome
+ * @return int ERROR_NONE on success, otherwise an error code
+ */
+int unifi_profile_apply_plan(transport_t *session, const unifi_apply_plan_t *plan, unifi_apply_stats_t *stats);
+
+/**
+ * @brief Uploads the plan's assets and the patched device confs into UNIFI_REMOTE_STAGING_DIR without applying them.
+ *        The confs are patched against the device state at staging time.
+ * 
+ * @param session 
+ * @param plan 
+ * @param stats optional, receives the asset cache outcome
+ * @return int ERROR_NONE on success, otherwise an error code
+ */
+int unifi_profile_stage_plan(transport_t *session, const unifi_apply_plan_t *plan, unifi_apply_stats_t *stats);
+
+/**
+ * @brief Applies a profile previously staged with unifi_profile_stage_plan(): only the moves and the service restart run.
+ * 
+ * @param session 
+ * @param plan the plan that was staged
+ * @return int ERROR_NONE on success, ERROR_PROFILE_APPLY_MISSING_TMP_FILES if nothing is staged, otherwise an error code
+ */
+int unifi_profile_cutover(transport_t *session, const unifi_apply_plan_t *plan);
+
+// Accepted ranges for a parameter-only update; the volume range matches profile_check.
+#define UNIFI_PARAM_VOLUME_MIN 1
+#define UNIFI_PARAM_VOLUME_MAX 100
+#define UNIFI_PARAM_REPEAT_MIN 1
+#define UNIFI_PARAM_REPEAT_MAX 10
+#define UNIFI_PARAM_DURATION_MS_MIN 1
+#define UNIFI_PARAM_DURATION_MS_MAX 60000
+
+/**
+ * @brief A parameter-only update: the values to change on the running profile, each flagged when present.
+ *        The frame count is not one of them; it must match the sprite sheet, so it only changes with the image.
+ */
+typedef struct {
+    bool has_volume;
+    int volume;
+    bool has_repeat_times;
+    int repeat_times;
+    bool has_duration_ms;
+    int duration_ms;
+    bool has_loop;
+    bool loop;
+} unifi_profile_params_t;
+
+/**
+ * @brief Changes parameters of the profile the device runs without touching its assets. Only the conf holding
+ *        the changed values is uploaded and only the service reading it is restarted; when no value changes,
+ *        nothing is uploaded and stats->unchanged is set.
+ * 
+ * @param session 
+ * @param params 
+ * @param current receives the device profile, with the parameters applied on success
+ * @param stats optional, receives the transfer outcome
+ * @return int ERROR_NONE on success, ERROR_PARAMS_INVALID when the device has no custom asset to adjust,
+ *         otherwise an error code
+ */
+int unifi_profile_apply_params(transport_t *session, const unifi_profile_params_t *params, unifi_profile_t *current, unifi_apply_stats_t *stats);
+
+/**
+ * @brief Removes UNIFI_REMOTE_UPLOAD_DIR from the device, e.g. after an apply was cancelled or ran past its
+ *        deadline halfway through the upload.
+ *
+ * @param session
+ * @return true
+ * @return false
+ */
+bool unifi_remote_clear_upload_area(transport_t *session);
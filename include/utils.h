@@ -38,7 +38,7 @@ bool utils_build_path(char *out, size_t out_len, const char *base, const char *c
  * @brief Read the contest of a file into a buffer.
  * 
  * @param path source file path
- * @param out_content content buffer
+ * @param out_content content buffer, NUL-terminated; release with arena_free
  * @param out_size content buffer size
  * @return true 
  * @return false 
@@ -93,6 +93,18 @@ void utils_build_iso_timestamp(time_t *t, char *out, size_t out_size);
  */
 void to_human_readable(const char *input, char *output, size_t out_size);
 
+/**
+ * @brief Normalize a name for case/space-insensitive lookups: surrounding whitespace is trimmed
+ *        and the rest is lowercased.
+ * 
+ * @param input name to normalize
+ * @param output output buffer
+ * @param out_size size of the output buffer
+ * @return true on success
+ * @return false if the name is empty after trimming or does not fit
+ */
+bool utils_normalize_name(const char *input, char *output, size_t out_size);
+
 /**
  * @brief Calculate the MD5 hash of a file and return it as a hex string.
  * 
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "config_types.h"
+
+#include <stdbool.h>
+
+/**
+ * @brief Starts watching the configuration file and the profiles directory with inotify.
+ *        Edits to a preset's profile directory re-index just that preset; edits to the configuration
+ *        reload the preset list and re-publish the preset select discovery when the names changed.
+ *        Other configuration sections still need a restart.
+ *
+ * @param config_path configuration file to watch
+ * @param profiles_dir profiles base directory
+ * @param cfg running configuration, used to re-publish discovery; must outlive the watcher
+ * @return true
+ * @return false
+ */
+bool watcher_start(const char *config_path, const char *profiles_dir, const config_t *cfg);
+
+/**
+ * @brief Stops the watcher thread. Safe to call when it was never started.
+ *
+ */
+void watcher_stop(void);
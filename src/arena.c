@@ -0,0 +1,252 @@
+#include "arena.h"
+#include "cJSON.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;        // usable bytes after the chunk header
+    size_t used;
+} arena_chunk_t;
+
+// Precedes every block; 16 bytes so the block after it keeps malloc's alignment.
+typedef struct {
+    arena_t *arena;     // NULL for heap blocks
+    size_t size;        // usable bytes
+} arena_block_t;
+
+struct arena {
+    arena_chunk_t *chunks;      // newest first; allocation only happens in the head
+    size_t chunk_size;
+    size_t used;
+    void *last;                 // most recent block, which may grow in place
+};
+
+_Static_assert(sizeof(arena_block_t) % ARENA_ALIGN == 0, "arena block header breaks alignment");
+_Static_assert(sizeof(arena_chunk_t) <= ARENA_ALIGN * 2, "arena chunk header too large");
+
+// Chunk payload starts after a header padded to the alignment.
+#define ARENA_CHUNK_HEADER (((sizeof(arena_chunk_t) + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN)
+
+static _Thread_local arena_t *t_current;
+
+static size_t arena_round(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static unsigned char *chunk_data(arena_chunk_t *chunk) {
+    return (unsigned char *)chunk + ARENA_CHUNK_HEADER;
+}
+
+static arena_block_t *block_of(void *ptr) {
+    return (arena_block_t *)ptr - 1;
+}
+
+static arena_chunk_t *arena_add_chunk(arena_t *arena, size_t need) {
+    size_t size = need > arena->chunk_size ? need : arena->chunk_size;
+    arena_chunk_t *chunk = malloc(ARENA_CHUNK_HEADER + size);
+
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    return chunk;
+}
+
+arena_t *arena_create(size_t chunk_size) {
+    arena_t *arena = calloc(1, sizeof(*arena));
+
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->chunk_size = arena_round(chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK);
+
+    if (!arena_add_chunk(arena, 0)) {
+        free(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void arena_destroy(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    arena_chunk_t *chunk = arena->chunks;
+
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+void arena_reset(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    // Keep the oldest chunk, which is always a standard size; oversized ones only serve a single command.
+    arena_chunk_t *chunk = arena->chunks;
+
+    while (chunk && chunk->next) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = chunk;
+    arena->used = 0;
+    arena->last = NULL;
+
+    if (chunk) {
+        chunk->used = 0;
+    }
+}
+
+size_t arena_used(const arena_t *arena) {
+    return arena ? arena->used : 0;
+}
+
+arena_t *arena_enter(arena_t *arena) {
+    arena_t *previous = t_current;
+    t_current = arena;
+
+    return previous;
+}
+
+void arena_leave(arena_t *previous) {
+    t_current = previous;
+}
+
+static void *arena_alloc_block(arena_t *arena, size_t size) {
+    size_t need = sizeof(arena_block_t) + arena_round(size);
+    arena_chunk_t *chunk = arena->chunks;
+
+    if (!chunk || chunk->size - chunk->used < need) {
+        chunk = arena_add_chunk(arena, need);
+
+        if (!chunk) {
+            return NULL;
+        }
+    }
+
+    arena_block_t *block = (arena_block_t *)(chunk_data(chunk) + chunk->used);
+    block->arena = arena;
+    block->size = arena_round(size);
+
+    chunk->used += need;
+    arena->used += need;
+    arena->last = block + 1;
+
+    return block + 1;
+}
+
+void *arena_malloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(arena_block_t) - ARENA_ALIGN) {
+        return NULL;
+    }
+
+    if (t_current) {
+        return arena_alloc_block(t_current, size);
+    }
+
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+
+    if (!block) {
+        return NULL;
+    }
+
+    block->arena = NULL;
+    block->size = size;
+
+    return block + 1;
+}
+
+void *arena_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return arena_malloc(size);
+    }
+
+    arena_block_t *block = block_of(ptr);
+
+    if (size > SIZE_MAX - sizeof(arena_block_t) - ARENA_ALIGN) {
+        return NULL;
+    }
+
+    // Heap blocks stay on the heap; they may be owned by something that outlives the command.
+    if (!block->arena) {
+        arena_block_t *grown = realloc(block, sizeof(arena_block_t) + size);
+
+        if (!grown) {
+            return NULL;
+        }
+
+        grown->size = size;
+        return grown + 1;
+    }
+
+    // The newest block of the current arena grows into the rest of its chunk.
+    if (block->arena == t_current && t_current->last == ptr) {
+        arena_chunk_t *chunk = t_current->chunks;
+        size_t grow = arena_round(size) > block->size ? arena_round(size) - block->size : 0;
+
+        if (chunk->size - chunk->used >= grow) {
+            chunk->used += grow;
+            t_current->used += grow;
+            block->size += grow;
+            return ptr;
+        }
+    }
+
+    if (size <= block->size) {
+        return ptr;
+    }
+
+    void *moved = arena_malloc(size);
+
+    if (!moved) {
+        return NULL;
+    }
+
+    memcpy(moved, ptr, block->size);
+    arena_free(ptr);
+
+    return moved;
+}
+
+void arena_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    arena_block_t *block = block_of(ptr);
+
+    if (!block->arena) {
+        free(block);
+    }
+}
+
+void arena_install_cjson_hooks(void) {
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc,
+        .free_fn = arena_free,
+    };
+
+    cJSON_InitHooks(&hooks);
+}
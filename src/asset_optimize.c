@@ -0,0 +1,407 @@
+#include "asset_optimize.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <linux/limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define PNG_SIGNATURE_SIZE 8
+// Refuse to inflate image data beyond this; sprite sheets are a few MB decoded.
+#define PNG_MAX_RAW_BYTES (256u * 1024u * 1024u)
+
+static const unsigned char PNG_SIGNATURE[PNG_SIGNATURE_SIZE] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} asset_buf_t;
+
+static uint32_t be32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static bool buf_reserve(asset_buf_t *b, size_t extra) {
+    if (b->len + extra <= b->cap) {
+        return true;
+    }
+
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra) {
+        cap *= 2;
+    }
+
+    unsigned char *data = realloc(b->data, cap);
+    if (!data) {
+        return false;
+    }
+
+    b->data = data;
+    b->cap = cap;
+    return true;
+}
+
+static bool buf_append(asset_buf_t *b, const void *data, size_t len) {
+    if (!buf_reserve(b, len)) {
+        return false;
+    }
+
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return true;
+}
+
+static bool png_write_chunk(asset_buf_t *out, const char type[4], const unsigned char *data, size_t len) {
+    unsigned char head[8];
+    unsigned char crc_bytes[4];
+
+    if (len > 0x7fffffffu) {
+        return false;
+    }
+
+    put_be32(head, (uint32_t)len);
+    memcpy(head + 4, type, 4);
+
+    uLong crc = crc32(0L, (const Bytef *)type, 4);
+    if (len > 0) {
+        crc = crc32(crc, data, (uInt)len);
+    }
+    put_be32(crc_bytes, (uint32_t)crc);
+
+    return buf_append(out, head, sizeof(head)) && (len == 0 || buf_append(out, data, len)) && buf_append(out, crc_bytes, sizeof(crc_bytes));
+}
+
+static bool png_inflate(const asset_buf_t *zdata, asset_buf_t *raw) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    if (inflateInit(&zs) != Z_OK) {
+        return false;
+    }
+
+    zs.next_in = zdata->data;
+    zs.avail_in = (uInt)zdata->len;
+
+    int rc = Z_OK;
+
+    while (rc == Z_OK) {
+        if (!buf_reserve(raw, 65536) || raw->len > PNG_MAX_RAW_BYTES) {
+            rc = Z_MEM_ERROR;
+            break;
+        }
+
+        zs.next_out = raw->data + raw->len;
+        zs.avail_out = (uInt)(raw->cap - raw->len);
+
+        rc = inflate(&zs, Z_NO_FLUSH);
+        raw->len = raw->cap - zs.avail_out;
+
+        if (rc == Z_BUF_ERROR && zs.avail_in == 0) {
+            break;      // truncated stream
+        }
+    }
+
+    inflateEnd(&zs);
+
+    return rc == Z_STREAM_END;
+}
+
+static bool png_deflate(const asset_buf_t *raw, int strategy, asset_buf_t *out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15, 9, strategy) != Z_OK) {
+        return false;
+    }
+
+    out->len = 0;
+
+    if (!buf_reserve(out, deflateBound(&zs, (uLong)raw->len))) {
+        deflateEnd(&zs);
+        return false;
+    }
+
+    zs.next_in = raw->data;
+    zs.avail_in = (uInt)raw->len;
+    zs.next_out = out->data;
+    zs.avail_out = (uInt)out->cap;
+
+    int rc = deflate(&zs, Z_FINISH);
+    out->len = out->cap - zs.avail_out;
+
+    deflateEnd(&zs);
+
+    return rc == Z_STREAM_END;
+}
+
+bool asset_optimize_png(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in || !out || !out_len || in_len < PNG_SIGNATURE_SIZE || memcmp(in, PNG_SIGNATURE, PNG_SIGNATURE_SIZE) != 0) {
+        return false;
+    }
+
+    asset_buf_t idat = {0};
+    asset_buf_t raw = {0};
+    asset_buf_t best = {0};
+    asset_buf_t candidate = {0};
+    asset_buf_t result = {0};
+    bool ok = false;
+    bool seen_iend = false;
+
+    // Pass 1: validate the chunk layout and gather the image data.
+    for (size_t pos = PNG_SIGNATURE_SIZE; !seen_iend; ) {
+        if (in_len - pos < 12) {
+            goto cleanup;
+        }
+
+        uint32_t len = be32(in + pos);
+        const unsigned char *type = in + pos + 4;
+
+        if (len > in_len - pos - 12) {
+            goto cleanup;
+        }
+
+        if (crc32(crc32(0L, type, 4), type + 4, len) != be32(type + 4 + len)) {
+            LOG_DEBUG("PNG chunk %.4s has a bad CRC; leaving file unchanged", (const char *)type);
+            goto cleanup;
+        }
+
+        if (memcmp(type, "acTL", 4) == 0) {
+            goto cleanup;   // animated PNG: frame data lives outside IDAT
+        }
+
+        if (memcmp(type, "IDAT", 4) == 0 && !buf_append(&idat, type + 4, len)) {
+            goto cleanup;
+        }
+
+        seen_iend = memcmp(type, "IEND", 4) == 0;
+        pos += 12 + (size_t)len;
+    }
+
+    if (idat.len == 0 || !png_inflate(&idat, &raw)) {
+        goto cleanup;
+    }
+
+    static const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED };
+
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++) {
+        if (!png_deflate(&raw, strategies[i], &candidate)) {
+            goto cleanup;
+        }
+
+        if (best.data == NULL || candidate.len < best.len) {
+            asset_buf_t tmp = best;
+            best = candidate;
+            candidate = tmp;
+        }
+    }
+
+    // Pass 2: copy the critical chunks (and tRNS) in their original order, with one IDAT in place of the first.
+    if (!buf_append(&result, PNG_SIGNATURE, PNG_SIGNATURE_SIZE)) {
+        goto cleanup;
+    }
+
+    bool idat_written = false;
+
+    for (size_t pos = PNG_SIGNATURE_SIZE; pos < in_len; ) {
+        uint32_t len = be32(in + pos);
+        const char *type = (const char *)in + pos + 4;
+        const unsigned char *data = in + pos + 8;
+
+        pos += 12 + (size_t)len;
+
+        if (memcmp(type, "IDAT", 4) == 0) {
+            if (!idat_written && !png_write_chunk(&result, "IDAT", best.data, best.len)) {
+                goto cleanup;
+            }
+
+            idat_written = true;
+            continue;
+        }
+
+        bool keep = memcmp(type, "IHDR", 4) == 0 || memcmp(type, "PLTE", 4) == 0 ||
+                    memcmp(type, "tRNS", 4) == 0 || memcmp(type, "IEND", 4) == 0;
+
+        if (keep && !png_write_chunk(&result, type, data, len)) {
+            goto cleanup;
+        }
+
+        if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+    }
+
+    *out = result.data;
+    *out_len = result.len;
+    result.data = NULL;
+    ok = true;
+
+cleanup:
+    free(idat.data);
+    free(raw.data);
+    free(best.data);
+    free(candidate.data);
+    free(result.data);
+
+    return ok;
+}
+
+static bool write_binary_atomic(const char *path, const unsigned char *data, size_t len) {
+    char tmp_path[PATH_MAX];
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return false;
+    }
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        LOG_WARN("Failed to create '%s': %s", tmp_path, strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, len, fp) == len;
+
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        LOG_WARN("Failed to write '%s'", path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool asset_optimize_png_cached(const unsigned char *in, size_t in_len, const char *src_md5, const char *cache_dir, char *out_path, size_t out_len) {
+    char name[48];
+    char keep_path[PATH_MAX];
+
+    if (!in || !src_md5 || !cache_dir || !out_path || out_len == 0) {
+        return false;
+    }
+
+    out_path[0] = '\0';
+
+    snprintf(name, sizeof(name), "%s.png", src_md5);
+    if (!utils_build_path(out_path, out_len, cache_dir, name)) {
+        out_path[0] = '\0';
+        return false;
+    }
+
+    if (utils_file_exists(out_path)) {
+        return true;
+    }
+
+    // Marker for sources that did not shrink, so they are not recompressed on every start.
+    snprintf(name, sizeof(name), "%s.keep", src_md5);
+    if (!utils_build_path(keep_path, sizeof(keep_path), cache_dir, name)) {
+        out_path[0] = '\0';
+        return false;
+    }
+
+    if (utils_file_exists(keep_path)) {
+        out_path[0] = '\0';
+        return true;
+    }
+
+    if (!utils_create_directory(cache_dir)) {
+        out_path[0] = '\0';
+        return false;
+    }
+
+    unsigned char *optimized = NULL;
+    size_t optimized_len = 0;
+    bool ok;
+
+    if (asset_optimize_png(in, in_len, &optimized, &optimized_len) && optimized_len < in_len) {
+        ok = write_binary_atomic(out_path, optimized, optimized_len);
+        LOG_INFO("Optimized PNG %s: %zu -> %zu bytes", src_md5, in_len, optimized_len);
+    } else {
+        ok = utils_write_file(keep_path, "");
+        LOG_DEBUG("PNG %s does not shrink; uploading it unchanged", src_md5);
+    }
+
+    free(optimized);
+
+    if (!ok || !utils_file_exists(out_path)) {
+        out_path[0] = '\0';
+    }
+
+    return ok;
+}
+
+bool asset_optimize_is_precompressed(const char *name) {
+    static const char *const extensions[] = { ".png", ".ogg", ".mp3", ".gz" };
+
+    const char *ext = name ? strrchr(name, '.') : NULL;
+    if (!ext) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        if (strcasecmp(ext, extensions[i]) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool asset_optimize_gzip(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in || !out || !out_len) {
+        return false;
+    }
+
+    *out = NULL;
+    *out_len = 0;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    // windowBits 15 + 16 selects the gzip wrapper, which busybox gzip on the device understands.
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    asset_buf_t buf = {0};
+
+    if (!buf_reserve(&buf, deflateBound(&zs, (uLong)in_len) + 32)) {
+        deflateEnd(&zs);
+        return false;
+    }
+
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)in_len;
+    zs.next_out = buf.data;
+    zs.avail_out = (uInt)buf.cap;
+
+    int rc = deflate(&zs, Z_FINISH);
+    buf.len = buf.cap - zs.avail_out;
+
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END) {
+        free(buf.data);
+        return false;
+    }
+
+    *out = buf.data;
+    *out_len = buf.len;
+
+    return (unsigned long long)buf.len * 100 <= (unsigned long long)in_len * ASSET_GZIP_MAX_RATIO_PCT;
+}
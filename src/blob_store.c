@@ -0,0 +1,178 @@
+#include "blob_store.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool blob_store_is_md5(const char *md5_hex) {
+    if (!md5_hex) {
+        return false;
+    }
+
+    size_t i = 0;
+
+    for (; md5_hex[i]; i++) {
+        char c = md5_hex[i];
+
+        if (i == 32 || !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+
+    return i == 32;
+}
+
+bool blob_store_link(const char *store_dir, const char *md5_hex, const char *dst_path) {
+    char blob_path[PATH_MAX];
+
+    if (!store_dir || !dst_path || !blob_store_is_md5(md5_hex)) {
+        return false;
+    }
+
+    if (!utils_build_path(blob_path, sizeof(blob_path), store_dir, md5_hex)) {
+        return false;
+    }
+
+    if (link(blob_path, dst_path) != 0) {
+        if (errno != ENOENT) {
+            LOG_WARN("Failed to link blob '%s' to '%s': %s", blob_path, dst_path, strerror(errno));
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool blob_store_adopt_file(const char *store_dir, const char *path) {
+    char md5_hex[33];
+    char blob_path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+
+    if (!utils_md5_file_hex(path, md5_hex)) {
+        return false;
+    }
+
+    if (!utils_build_path(blob_path, sizeof(blob_path), store_dir, md5_hex)) {
+        return false;
+    }
+
+    if (link(path, blob_path) == 0) {
+        return true;
+    }
+
+    if (errno != EEXIST) {
+        LOG_WARN("Failed to store '%s' as '%s': %s", path, blob_path, strerror(errno));
+        return false;
+    }
+
+    // Already held: swap the file for a link to the existing blob. The rename keeps `path` valid throughout.
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.blob", path) >= (int)sizeof(tmp_path)) {
+        return false;
+    }
+
+    if (link(blob_path, tmp_path) != 0) {
+        LOG_WARN("Failed to link blob '%s': %s", blob_path, strerror(errno));
+        return false;
+    }
+
+    if (rename(tmp_path, path) != 0) {
+        LOG_WARN("Failed to replace '%s' with its blob: %s", path, strerror(errno));
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool blob_store_adopt_dir(const char *store_dir, const char *dir) {
+    if (!store_dir || !dir) {
+        return false;
+    }
+
+    if (!utils_create_directory(store_dir)) {
+        return false;
+    }
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        LOG_WARN("Failed to open '%s': %s", dir, strerror(errno));
+        return false;
+    }
+
+    bool ok = true;
+    size_t adopted = 0;
+    struct dirent *entry;
+    char path[PATH_MAX];
+
+    while ((entry = readdir(d)) != NULL) {
+        struct stat st;
+
+        if (!utils_build_path(path, sizeof(path), dir, entry->d_name) || lstat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        if (blob_store_adopt_file(store_dir, path)) {
+            adopted++;
+        } else {
+            ok = false;
+        }
+    }
+
+    closedir(d);
+
+    LOG_DEBUG("Adopted %zu file(s) from '%s' into '%s'", adopted, dir, store_dir);
+    return ok;
+}
+
+// Calls fn for every blob; returns the summed result.
+static long long blob_store_walk(const char *store_dir, long long (*fn)(const char *path, const struct stat *st)) {
+    DIR *d = opendir(store_dir);
+    if (!d) {
+        return 0;
+    }
+
+    long long total = 0;
+    struct dirent *entry;
+    char path[PATH_MAX];
+
+    while ((entry = readdir(d)) != NULL) {
+        struct stat st;
+
+        if (!blob_store_is_md5(entry->d_name) || !utils_build_path(path, sizeof(path), store_dir, entry->d_name) || lstat(path, &st) != 0) {
+            continue;
+        }
+
+        total += fn(path, &st);
+    }
+
+    closedir(d);
+    return total;
+}
+
+static long long blob_prune_one(const char *path, const struct stat *st) {
+    if (st->st_nlink > 1 || unlink(path) != 0) {
+        return 0;
+    }
+
+    return (long long)st->st_size;
+}
+
+static long long blob_size_one(const char *path, const struct stat *st) {
+    (void)path;
+    return (long long)st->st_size;
+}
+
+long long blob_store_prune(const char *store_dir) {
+    return store_dir ? blob_store_walk(store_dir, blob_prune_one) : 0;
+}
+
+long long blob_store_size(const char *store_dir) {
+    return store_dir ? blob_store_walk(store_dir, blob_size_one) : 0;
+}
@@ -1,65 +1,133 @@
 #include "command.h"
+#include "cJSON.h"
+#include "deadline.h"
+#include "device_lock.h"
 #include "errors.h"
+#include "fleet.h"
 #include "ha_status.h"
+#include "metrics.h"
 #include "mqtt_router_types.h"
-#include "ssh.h"
+#include "transport.h"
 #include "unifi_profile.h"
 #include "unifi_profile_json.h"
 #include "unifi_profiles_repo.h"
 #include "unifi_remote.h"
 #include "utils.h"
+#include "utils_json.h"
 #include <linux/limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+static bool command_begin(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
+    if (ctx == NULL || ctx->device == NULL || payload == NULL || payloadLen == 0) {
+        return false;
+    }
+
+    status_bind_device(ctx->device->index);
+    metrics_inc(METRIC_COMMANDS);
+
+    return true;
+}
+
+// Budget for removing what an aborted apply left on the device, over a connection of its own.
+#define COMMAND_CLEANUP_TIMEOUT_S 15
+
+// A connection refused because the command was cancelled or is overdue is not a network fault.
+static int command_connect_error(void) {
+    return deadline_expired() ? deadline_error(ERROR_SSH_TIMEOUT) : ERROR_SSH_CONNECTION_FAILED;
+}
+
+// An apply stopped by a cancel or its deadline can leave files in the upload area. The old connection may be
+// shut down or stuck, so a new one with its own short budget removes them.
+static void command_cleanup_aborted(const config_device_t *device) {
+    if (!deadline_expired()) {
+        return;
+    }
+
+    deadline_op_t op;
+    deadline_begin(&op, device->index, deadline_generation(device->index), COMMAND_CLEANUP_TIMEOUT_S);
+
+    transport_t *session = transport_open(&device->ssh_cfg);
+
+    if (!session || !unifi_remote_clear_upload_area(session)) {
+        LOG_WARN("Could not clean the upload area of device '%s' after an aborted apply", device->id);
+    }
+
+    transport_close(session);
+    deadline_end(&op);
+}
+
+static void command_publish_apply_stats(const transport_t *session, const unifi_apply_stats_t *stats, int rc) {
+    status_apply_sample_t sample = {
+        .ok = (rc == ERROR_NONE),
+        .apply_seconds = stats->apply_seconds,
+        .upload_seconds = stats->upload_seconds,
+        .bytes_sent = stats->bytes_sent,
+        .rtt_ms = transport_rtt_ms(session),
+        .unchanged = stats->unchanged,
+    };
+
+    status_record_apply(&sample);
+
+    if (stats->cache_enabled) {
+        status_set_asset_cache(stats->cache_hits, stats->cache_misses, stats->cache_evictions);
+    }
+
+    if (stats->bytes_sent > 0) {
+        status_set_upload_savings(stats->bytes_sent, stats->bytes_saved);
+    }
+}
+
 void command_set_preset(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
-    if (ctx == NULL || payload == NULL || payloadLen == 0) {
+    if (!command_begin(ctx, payload, payloadLen)) {
         return;
     }
 
     status_set_state("uploading");
 
     bool ok = false;
-    ssh_session_t *session = NULL;
-    char profile_path[PATH_MAX];
-    unifi_profile_t profile;
+    transport_t *session = NULL;
+    const profiles_preset_t *preset = NULL;
 
-    if (!profiles_repo_resolve_preset(payload, profile_path, sizeof(profile_path))) {
-        HA_ERRF(ERROR_PROFILE_NOT_FOUND, "Profile directory for preset '%s' not found", payload);
-        goto cleanup;
-    }
-
-    if (!unifi_profile_load_from_file(profile_path, &profile)) {
-        HA_ERRF(ERROR_PROFILE_INVALID, "Error loading profile.json for preset '%s'", payload);
+    int rc = profiles_repo_acquire_preset(payload, &preset);
+    if (rc != ERROR_NONE) {
+        HA_ERRF(rc, "Preset '%s' is not available", payload);
         goto cleanup;
     }
 
-    session = ssh_session_create(ctx->ssh_cfg);
+    session = transport_open(&ctx->device->ssh_cfg);
     if (!session) {
-        HA_ERR(ERROR_SSH_CONNECTION_FAILED, "Failed to create SSH session");
+        HA_ERR(command_connect_error(), "Failed to create SSH session");
         goto cleanup;
     }
 
-    int rc = unifi_profile_upload_and_apply(session, profile_path, &profile);
+    unifi_apply_stats_t stats = {0};
+    rc = unifi_profile_apply_plan(session, &preset->plan, &stats);
+    command_publish_apply_stats(session, &stats, rc);
+
     if (rc != ERROR_NONE) {
         HA_ERR(rc, "Failed to upload and apply profile");
         goto cleanup;
     }
 
-    if (!profiles_write_last_applied(payload, true)) {
-        LOG_WARN("Failed to persist last_applied.json (profile=%s). State will not survive restart of service.", payload);
+    if (!profiles_write_last_applied(ctx->device->id, payload, true)) {
+        LOG_WARN("Failed to persist last applied state (device=%s profile=%s). State will not survive restart of service.", ctx->device->id, payload);
     }
 
+    status_set_params(&preset->plan.profile);
     ok = true;
 
 cleanup: 
     if (session) {
-        ssh_session_destroy(session);
+        transport_close(session);
     }
 
+    profiles_repo_release_preset(preset);
+
     if (!ok) {
+        command_cleanup_aborted(ctx->device);
         status_set_state("idle");
         return;
     }
@@ -72,14 +140,14 @@ cleanup:
 
 void command_apply_custom(const mqtt_router_ctx_t *ctx, const char *payload,
                           size_t payloadLen) {
-    if (ctx == NULL || payload == NULL || payloadLen == 0) {
+    if (!command_begin(ctx, payload, payloadLen)) {
         return;
     }
 
     status_set_state("uploading");
 
     bool ok = false;
-    ssh_session_t *session = NULL;
+    transport_t *session = NULL;
     char profile_path[PATH_MAX];
     unifi_profile_t profile;
 
@@ -97,30 +165,35 @@ void command_apply_custom(const mqtt_router_ctx_t *ctx, const char *payload,
         goto cleanup;
     }
 
-    session = ssh_session_create(ctx->ssh_cfg);
+    session = transport_open(&ctx->device->ssh_cfg);
     if (!session) {
-        HA_ERR(ERROR_SSH_CONNECTION_FAILED, "Failed to create SSH session");
+        HA_ERR(command_connect_error(), "Failed to create SSH session");
         goto cleanup;
     }
 
-    int rc = unifi_profile_upload_and_apply(session, profile_path, &profile);
+    unifi_apply_stats_t stats = {0};
+    int rc = unifi_profile_upload_and_apply(session, profile_path, &profile, false, &stats);
+    command_publish_apply_stats(session, &stats, rc);
+
     if (rc != ERROR_NONE) {
         HA_ERR(rc, "Failed to upload and apply profile");
         goto cleanup;
     }
 
-    if (!profiles_write_last_applied(payload, false)) {
-        LOG_WARN("Failed to persist last_applied.json (profile=%s). State will not survive restart of service.", payload);
+    if (!profiles_write_last_applied(ctx->device->id, payload, false)) {
+        LOG_WARN("Failed to persist last applied state (device=%s profile=%s). State will not survive restart of service.", ctx->device->id, payload);
     }
 
+    status_set_params(&profile);
     ok = true;
 
 cleanup: 
     if (session) {
-        ssh_session_destroy(session);
+        transport_close(session);
     }
 
     if (!ok) {
+        command_cleanup_aborted(ctx->device);
         status_set_state("idle");
         return;
     }
@@ -132,7 +205,7 @@ cleanup:
 
 void command_download_assets(const mqtt_router_ctx_t *ctx, const char *payload,
                              size_t payloadLen) {
-  if (ctx == NULL || payload == NULL || payloadLen == 0) {
+  if (!command_begin(ctx, payload, payloadLen)) {
     return;
   }
 
@@ -146,6 +219,7 @@ void command_download_assets(const mqtt_router_ctx_t *ctx, const char *payload,
   char temp_path[PATH_MAX];
   char final_dir[PATH_MAX];
   char final_path[PATH_MAX];
+  char blob_dir[PATH_MAX];
   unifi_profile_t profile;
 
   status_set_state("downloading");
@@ -154,14 +228,19 @@ void command_download_assets(const mqtt_router_ctx_t *ctx, const char *payload,
     HA_ERR(ERROR_PROFILE_DOWNLOAD_FAILED, "Failed to create temp path");
   }
 
-  ssh_session_t *session = ssh_session_create(ctx->ssh_cfg);
+  transport_t *session = transport_open(&ctx->device->ssh_cfg);
   if (!session) {
-    HA_ERR(ERROR_SSH_CONNECTION_FAILED, "Failed to create SSH session.");
+    HA_ERR(command_connect_error(), "Failed to create SSH session.");
     return;
   }
 
-  if (!unifi_profile_download_and_load(session, temp_path, &profile)) {
-    HA_ERR(ERROR_PROFILE_DOWNLOAD_FAILED, "Failed to download profile assets");
+  // Without a blob store every asset is transferred, as before.
+  if (!profiles_repo_blob_dir(blob_dir, sizeof(blob_dir))) {
+    blob_dir[0] = '\0';
+  }
+
+  if (!unifi_profile_download_and_load(session, temp_path, blob_dir[0] ? blob_dir : NULL, &profile)) {
+    HA_ERR(deadline_expired() ? deadline_error(ERROR_SSH_TIMEOUT) : ERROR_PROFILE_DOWNLOAD_FAILED, "Failed to download profile assets");
     goto cleanup;
   }
 
@@ -184,7 +263,7 @@ void command_download_assets(const mqtt_router_ctx_t *ctx, const char *payload,
 
 cleanup:
   if (session) {
-    ssh_session_destroy(session);
+    transport_close(session);
   }
 
   if (partial_download) {
@@ -200,7 +279,7 @@ cleanup:
 }
 
 void command_test_config(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
-    if (ctx == NULL || payload == NULL || payloadLen == 0) {
+    if (!command_begin(ctx, payload, payloadLen)) {
         return;
     }
 
@@ -210,7 +289,7 @@ void command_test_config(const mqtt_router_ctx_t *ctx, const char *payload, size
     status_set_state("uploading");
 
     bool ok = false;
-    ssh_session_t *session = NULL;
+    transport_t *session = NULL;
     char profile_path[PATH_MAX] = "./test-profile";
     unifi_profile_t profile;
 
@@ -219,26 +298,32 @@ void command_test_config(const mqtt_router_ctx_t *ctx, const char *payload, size
         goto cleanup;
     }
 
-    session = ssh_session_create(ctx->ssh_cfg);
+    session = transport_open(&ctx->device->ssh_cfg);
     if (!session) {
-        HA_ERR(ERROR_SSH_CONNECTION_FAILED, "Failed to create SSH session");
+        HA_ERR(command_connect_error(), "Failed to create SSH session");
         return;
     }
 
-    int rc = unifi_profile_upload_and_apply(session, profile_path, &profile);
+    // The point of the test is the upload, so it runs even when the test profile is already applied.
+    unifi_apply_stats_t stats = {0};
+    int rc = unifi_profile_upload_and_apply(session, profile_path, &profile, true, &stats);
+    command_publish_apply_stats(session, &stats, rc);
+
     if (rc != ERROR_NONE) {
         HA_ERR(rc, "Failed to upload and apply profile");
         goto cleanup;
     }
 
+    status_set_params(&profile);
     ok = true;
 
 cleanup: 
     if (session) {
-        ssh_session_destroy(session);
+        transport_close(session);
     }
 
     if (!ok) {
+        command_cleanup_aborted(ctx->device);
         status_set_state("idle");
     }
 
@@ -247,3 +332,265 @@ cleanup:
     status_set_custom_directory("");
     status_set_state("idle");
 }
+
+void command_cancel(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
+    if (!command_begin(ctx, payload, payloadLen)) {
+        return;
+    }
+
+    // The router already cancelled the device's commands when this message arrived; they have unwound by now.
+    LOG_INFO("Commands of device '%s' cancelled", ctx->device->id);
+    status_set_state("idle");
+}
+
+// Reads one optional integer member, failing when it is present but mistyped or out of range.
+static bool params_parse_int(cJSON *root, const char *key, int min, int max, bool *has, int *out) {
+    *has = cJSON_GetObjectItemCaseSensitive(root, key) != NULL;
+
+    if (!*has) {
+        return true;
+    }
+
+    if (!json_get_int(root, key, out) || *out < min || *out > max) {
+        HA_ERRF(ERROR_PARAMS_INVALID, "'%s' must be a whole number from %d to %d", key, min, max);
+        return false;
+    }
+
+    return true;
+}
+
+static bool params_parse(const char *payload, size_t payloadLen, unifi_profile_params_t *params) {
+    bool ok = false;
+    cJSON *item = NULL;
+
+    memset(params, 0, sizeof(*params));
+
+    cJSON *root = cJSON_ParseWithLength(payload, payloadLen);
+    if (!cJSON_IsObject(root)) {
+        HA_ERR(ERROR_PARAMS_INVALID, "Parameters must be a JSON object");
+        goto cleanup;
+    }
+
+    cJSON_ArrayForEach(item, root) {
+        if (strcmp(item->string, "volume") != 0 && strcmp(item->string, "repeat_times") != 0 &&
+            strcmp(item->string, "duration_ms") != 0 && strcmp(item->string, "loop") != 0) {
+            HA_ERRF(ERROR_PARAMS_INVALID, "'%s' cannot be changed without applying a profile", item->string);
+            goto cleanup;
+        }
+    }
+
+    if (!params_parse_int(root, "volume", UNIFI_PARAM_VOLUME_MIN, UNIFI_PARAM_VOLUME_MAX, &params->has_volume, &params->volume) ||
+        !params_parse_int(root, "repeat_times", UNIFI_PARAM_REPEAT_MIN, UNIFI_PARAM_REPEAT_MAX, &params->has_repeat_times, &params->repeat_times) ||
+        !params_parse_int(root, "duration_ms", UNIFI_PARAM_DURATION_MS_MIN, UNIFI_PARAM_DURATION_MS_MAX, &params->has_duration_ms, &params->duration_ms)) {
+        goto cleanup;
+    }
+
+    params->has_loop = cJSON_GetObjectItemCaseSensitive(root, "loop") != NULL;
+
+    if (params->has_loop && !json_get_bool(root, "loop", &params->loop)) {
+        HA_ERR(ERROR_PARAMS_INVALID, "'loop' must be true or false");
+        goto cleanup;
+    }
+
+    if (!params->has_volume && !params->has_repeat_times && !params->has_duration_ms && !params->has_loop) {
+        HA_ERR(ERROR_PARAMS_INVALID, "No parameter to change");
+        goto cleanup;
+    }
+
+    ok = true;
+
+cleanup:
+    cJSON_Delete(root);
+
+    return ok;
+}
+
+void command_set_params(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
+    if (!command_begin(ctx, payload, payloadLen)) {
+        return;
+    }
+
+    unifi_profile_params_t params;
+
+    if (!params_parse(payload, payloadLen, &params)) {
+        return;
+    }
+
+    status_set_state("uploading");
+
+    bool ok = false;
+    unifi_profile_t current;
+
+    transport_t *session = transport_open(&ctx->device->ssh_cfg);
+    if (!session) {
+        HA_ERR(command_connect_error(), "Failed to create SSH session");
+        goto cleanup;
+    }
+
+    unifi_apply_stats_t stats = {0};
+    int rc = unifi_profile_apply_params(session, &params, &current, &stats);
+    command_publish_apply_stats(session, &stats, rc);
+
+    if (rc != ERROR_NONE) {
+        HA_ERR(rc, "Failed to update parameters");
+        goto cleanup;
+    }
+
+    ok = true;
+
+cleanup:
+    if (session) {
+        transport_close(session);
+    }
+
+    if (!ok) {
+        command_cleanup_aborted(ctx->device);
+        status_set_state("idle");
+        return;
+    }
+
+    status_set_params(&current);
+    status_set_state("idle");
+}
+
+typedef struct {
+    const unifi_apply_plan_t *plan;
+    const char *preset;
+} fleet_apply_job_t;
+
+static int fleet_apply_device_locked(const config_device_t *device, void *user) {
+    const fleet_apply_job_t *job = user;
+
+    status_bind_device(device->index);
+    status_set_state("uploading");
+
+    transport_t *session = transport_open(&device->ssh_cfg);
+    if (!session) {
+        int rc = command_connect_error();
+
+        HA_ERR(rc, "Failed to create SSH session");
+        status_set_state("idle");
+        return rc;
+    }
+
+    unifi_apply_stats_t stats = {0};
+    int rc = unifi_profile_apply_plan(session, job->plan, &stats);
+    command_publish_apply_stats(session, &stats, rc);
+
+    transport_close(session);
+
+    if (rc != ERROR_NONE) {
+        HA_ERR(rc, "Failed to upload and apply profile");
+        command_cleanup_aborted(device);
+        status_set_state("idle");
+        return rc;
+    }
+
+    if (!profiles_write_last_applied(device->id, job->preset, true)) {
+        LOG_WARN("Failed to persist last applied state (device=%s profile=%s). State will not survive restart of service.", device->id, job->preset);
+    }
+
+    status_set_last_applied_profile(job->preset);
+    status_set_preset_selected(job->preset);
+    status_set_custom_directory("");
+    status_set_params(&job->plan->profile);
+    status_set_state("idle");
+
+    return ERROR_NONE;
+}
+
+// The fleet command has no device of its own, so the router does not lock for it; each device is locked here.
+static int fleet_apply_device(const config_device_t *device, void *user) {
+    device_lock(device->index);
+    deadline_arm(device->ssh_cfg.command_timeout_s);
+    int rc = fleet_apply_device_locked(device, user);
+    device_unlock(device->index);
+
+    return rc;
+}
+
+static bool fleet_parse_payload(const char *payload, char *preset, size_t preset_size, char *tag, size_t tag_size) {
+    tag[0] = '\0';
+
+    // Plain text is a preset name for the whole fleet; JSON allows narrowing to a tag.
+    if (payload[0] != '{') {
+        return snprintf(preset, preset_size, "%s", payload) < (int)preset_size;
+    }
+
+    cJSON *root = cJSON_Parse(payload);
+    if (!root) {
+        return false;
+    }
+
+    bool ok = false;
+    const char *name = json_get_string(root, "preset");
+    const char *group = json_get_string(root, "tag");
+
+    if (name && *name && snprintf(preset, preset_size, "%s", name) < (int)preset_size) {
+        ok = !group || snprintf(tag, tag_size, "%s", group) < (int)tag_size;
+    }
+
+    cJSON_Delete(root);
+
+    return ok;
+}
+
+void command_fleet_apply(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
+    if (ctx == NULL || ctx->devices_cfg == NULL || payload == NULL || payloadLen == 0) {
+        return;
+    }
+
+    char preset[256];
+    char tag[32];
+    const profiles_preset_t *entry = NULL;
+    fleet_rollout_t rollout = {0};
+    char *summary = NULL;
+
+    if (!fleet_parse_payload(payload, preset, sizeof(preset), tag, sizeof(tag))) {
+        LOG_ERROR("Invalid fleet apply payload '%s'", payload);
+        status_set_fleet_rollout("failed", NULL);
+        return;
+    }
+
+    status_set_fleet_rollout("running", NULL);
+
+    if (!fleet_rollout_init(&rollout, ctx->devices_cfg, tag)) {
+        goto cleanup;
+    }
+
+    if (rollout.count == 0) {
+        LOG_WARN("Fleet apply of '%s': no devices match tag '%s'", preset, tag);
+        goto cleanup;
+    }
+
+    // The catalog holds the device-independent part of the apply, shared read-only by every worker.
+    int rc = profiles_repo_acquire_preset(preset, &entry);
+    if (rc != ERROR_NONE) {
+        LOG_ERROR("Fleet apply: preset '%s' is not available (code=%d)", preset, rc);
+        goto cleanup;
+    }
+
+    fleet_apply_job_t job = { .plan = &entry->plan, .preset = preset };
+    int concurrency = ctx->fleet_cfg ? ctx->fleet_cfg->concurrency : 1;
+
+    LOG_INFO("Fleet apply of '%s' to %zu device(s), concurrency=%d", preset, rollout.count, concurrency);
+
+    fleet_rollout_run(&rollout, concurrency, fleet_apply_device, &job);
+
+cleanup:
+    profiles_repo_release_preset(entry);
+
+    summary = fleet_rollout_summary_json(&rollout, preset, tag);
+
+    const char *state = "failed";
+    if (rollout.count > 0 && rollout.succeeded == rollout.count) {
+        state = "ok";
+    } else if (rollout.succeeded > 0) {
+        state = "partial";
+    }
+
+    status_set_fleet_rollout(state, summary);
+
+    cJSON_free(summary);
+    fleet_rollout_free(&rollout);
+}
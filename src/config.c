@@ -1,4 +1,5 @@
 #include "config.h"
+#include "arena.h"
 #include "config_types.h"
 #include "logger.h"
 #include "utils.h"
@@ -6,6 +7,7 @@
 #include "cJSON.h"
 #include "utils_json.h"
 
+#include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -107,7 +109,7 @@ static bool cfg_set_str_from_env_json_default(
 }
 
 static int cfg_get_int_from_env_json_default(const cJSON *root, const char *json_key, const char *env_name, int default_value) {
-    const char *env_val = getenv(env_name);
+    const char *env_val = env_name ? getenv(env_name) : NULL;
     if (env_val && env_val[0] != '\0') {
         char *end = NULL;
         long v = strtol(env_val, &end, 10);
@@ -193,18 +195,411 @@ static bool config_load_mqtt(config_mqtt_t *mqtt_cfg, const cJSON *root) {
     return true;
 }
 
-static bool config_load_ssh(config_ssh_t *ssh_cfg, const cJSON *root) {
-    if (!cfg_set_str_from_env_json_default(ssh_cfg->host, sizeof(ssh_cfg->host), root, "host", "SSH_HOST", "localhost", "ssh.host", false) ||
-        !cfg_set_str_from_env_json_default(ssh_cfg->user, sizeof(ssh_cfg->user), root, "username", "SSH_USERNAME", "ubnt", "ssh.username", false) ||
+static bool config_load_sim(config_sim_t *sim_cfg, const cJSON *root, bool use_env) {
+    if (!cfg_set_str_from_env_json_default(sim_cfg->root, sizeof(sim_cfg->root), root, "root", use_env ? "SSH_SIM_ROOT" : NULL, "", "ssh.sim.root", false)) {
+        return false;
+    }
+
+    sim_cfg->latency_ms = cfg_get_int_from_env_json_default(root, "latency_ms", use_env ? "SSH_SIM_LATENCY_MS" : NULL, 0);
+    sim_cfg->bandwidth_kbps = cfg_get_int_from_env_json_default(root, "bandwidth_kbps", use_env ? "SSH_SIM_BANDWIDTH_KBPS" : NULL, 0);
+
+    if (sim_cfg->root[0] == '\0') {
+        return true;
+    }
+
+    // Device paths are rewritten into the root inside single-quoted shell arguments.
+    if (strchr(sim_cfg->root, '\'') || sim_cfg->root[0] != '/') {
+        LOG_ERROR("ssh.sim.root must be an absolute path without quotes.");
+        return false;
+    }
+
+    if (sim_cfg->latency_ms < 0 || sim_cfg->bandwidth_kbps < 0) {
+        LOG_WARN("Invalid simulator limits (latency_ms=%d bandwidth_kbps=%d); using none.", sim_cfg->latency_ms, sim_cfg->bandwidth_kbps);
+        sim_cfg->latency_ms = 0;
+        sim_cfg->bandwidth_kbps = 0;
+    }
+
+    LOG_DEBUG("ssh.sim.root='%s' latency_ms=%d bandwidth_kbps=%d", sim_cfg->root, sim_cfg->latency_ms, sim_cfg->bandwidth_kbps);
+
+    return true;
+}
+
+#define SSH_DEFAULT_CONNECT_TIMEOUT_S 10
+#define SSH_DEFAULT_COMMAND_TIMEOUT_S 300
+
+static bool config_load_ssh(config_ssh_t *ssh_cfg, const cJSON *root, bool use_env) {
+    if (!cfg_set_str_from_env_json_default(ssh_cfg->host, sizeof(ssh_cfg->host), root, "host", use_env ? "SSH_HOST" : NULL, "localhost", "ssh.host", false) ||
+        !cfg_set_str_from_env_json_default(ssh_cfg->user, sizeof(ssh_cfg->user), root, "username", use_env ? "SSH_USERNAME" : NULL, "ubnt", "ssh.username", false) ||
         !cfg_set_str_from_env_json_default(ssh_cfg->password_env, sizeof(ssh_cfg->password_env), root, "password_env", NULL, "UNIFI_PROTECT_RECOVERY_CODE", "ssh.password_env", false)) {
         return false;
     }
 
-    ssh_cfg->port = cfg_get_int_from_env_json_default(root, "port", "SSH_PORT", 22);
+    ssh_cfg->port = cfg_get_int_from_env_json_default(root, "port", use_env ? "SSH_PORT" : NULL, 22);
+    ssh_cfg->connect_timeout_s = cfg_get_int_from_env_json_default(root, "connect_timeout_seconds", use_env ? "SSH_CONNECT_TIMEOUT" : NULL, SSH_DEFAULT_CONNECT_TIMEOUT_S);
+    ssh_cfg->command_timeout_s = cfg_get_int_from_env_json_default(root, "command_timeout_seconds", use_env ? "SSH_COMMAND_TIMEOUT" : NULL, SSH_DEFAULT_COMMAND_TIMEOUT_S);
+
+    if (ssh_cfg->connect_timeout_s < 0 || ssh_cfg->command_timeout_s < 0) {
+        LOG_WARN("Invalid SSH timeouts (connect_timeout_seconds=%d command_timeout_seconds=%d); using defaults.", ssh_cfg->connect_timeout_s, ssh_cfg->command_timeout_s);
+        ssh_cfg->connect_timeout_s = SSH_DEFAULT_CONNECT_TIMEOUT_S;
+        ssh_cfg->command_timeout_s = SSH_DEFAULT_COMMAND_TIMEOUT_S;
+    }
+
+    return config_load_sim(&ssh_cfg->sim, cJSON_GetObjectItemCaseSensitive(root, "sim"), use_env);
+}
+
+static bool device_id_is_valid(const char *id) {
+    if (!id || *id == '\0') {
+        return false;
+    }
+
+    for (const unsigned char *p = (const unsigned char *)id; *p; p++) {
+        if (!isalnum(*p) && *p != '_' && *p != '-') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool device_id_exists(const config_device_t *items, size_t count, const char *id) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(items[i].id, id) == 0) return true;
+    }
+    return false;
+}
+
+static bool config_load_device_tags(config_device_t *device, const cJSON *tags) {
+    device->tag_count = 0;
+
+    if (!tags) {
+        return true;
+    }
+
+    if (!cJSON_IsArray(tags)) {
+        LOG_ERROR("Device '%s': 'tags' must be an array of strings.", device->id);
+        return false;
+    }
+
+    const cJSON *tag = NULL;
+    cJSON_ArrayForEach(tag, tags) {
+        if (!cJSON_IsString(tag) || !device_id_is_valid(tag->valuestring)) {
+            LOG_ERROR("Device '%s': invalid tag (letters, digits, '_' and '-' only).", device->id);
+            return false;
+        }
+
+        if (device->tag_count >= CONFIG_DEVICE_MAX_TAGS) {
+            LOG_ERROR("Device '%s': too many tags (max %d).", device->id, CONFIG_DEVICE_MAX_TAGS);
+            return false;
+        }
+
+        char *dst = device->tags[device->tag_count];
+        if (snprintf(dst, sizeof(device->tags[0]), "%s", tag->valuestring) >= (int)sizeof(device->tags[0])) {
+            LOG_ERROR("Device '%s': tag '%s' exceeds maximum length (%zu).", device->id, tag->valuestring, sizeof(device->tags[0]) - 1);
+            return false;
+        }
+
+        device->tag_count++;
+    }
 
     return true;
 }
 
+static bool config_load_devices(config_devices_t *devices_cfg, const config_mqtt_t *mqtt_cfg, const cJSON *ssh) {
+    devices_cfg->items = NULL;
+    devices_cfg->count = 0;
+
+    // Legacy single device: the device shares the instance namespace and honours the SSH_* env overrides.
+    if (cJSON_IsObject(ssh)) {
+        config_device_t *device = calloc(1, sizeof(*device));
+        if (!device) {
+            LOG_ERROR("Out of memory allocating device configuration");
+            return false;
+        }
+
+        snprintf(device->id, sizeof(device->id), "%s", mqtt_cfg->instance);
+        snprintf(device->name_human, sizeof(device->name_human), "%s", mqtt_cfg->instance_human);
+
+        if (!config_load_ssh(&device->ssh_cfg, ssh, true)) {
+            free(device);
+            return false;
+        }
+
+        devices_cfg->items = device;
+        devices_cfg->count = 1;
+        return true;
+    }
+
+    size_t count = (size_t)cJSON_GetArraySize(ssh);
+
+    if (count == 0) {
+        LOG_ERROR("The 'ssh' device list is empty");
+        return false;
+    }
+
+    config_device_t *items = calloc(count, sizeof(*items));
+    if (!items) {
+        LOG_ERROR("Out of memory allocating device configuration (count=%zu)", count);
+        return false;
+    }
+
+    size_t i = 0;
+    for (cJSON *item = ssh->child; item && i < count; item = item->next, i++) {
+        if (!cJSON_IsObject(item)) {
+            LOG_ERROR("Invalid device entry at index %zu (expected an object).", i);
+            goto fail;
+        }
+
+        const char *id = json_get_string(item, "id");
+
+        if (!device_id_is_valid(id)) {
+            LOG_ERROR("Invalid device id at index %zu (letters, digits, '_' and '-' only).", i);
+            goto fail;
+        }
+
+        if (device_id_exists(items, i, id)) {
+            LOG_ERROR("Duplicate device id '%s' at index %zu", id, i);
+            goto fail;
+        }
+
+        config_device_t *device = &items[i];
+        device->index = i;
+
+        if (snprintf(device->id, sizeof(device->id), "%s", id) >= (int)sizeof(device->id)) {
+            LOG_ERROR("Device id at index %zu exceeds maximum length (%zu).", i, sizeof(device->id) - 1);
+            goto fail;
+        }
+
+        const char *name = json_get_string(item, "name");
+
+        if (name && *name) {
+            snprintf(device->name_human, sizeof(device->name_human), "%s", name);
+        } else {
+            to_human_readable(device->id, device->name_human, sizeof(device->name_human));
+        }
+
+        if (!config_load_device_tags(device, cJSON_GetObjectItemCaseSensitive(item, "tags"))) {
+            goto fail;
+        }
+
+        if (!config_load_ssh(&device->ssh_cfg, item, false)) {
+            goto fail;
+        }
+
+        if (device->ssh_cfg.sim.root[0] != '\0') {
+            LOG_DEBUG("Device '%s' (%s) -> simulator in '%s'", device->id, device->name_human, device->ssh_cfg.sim.root);
+        } else {
+            LOG_DEBUG("Device '%s' (%s) -> %s:%d", device->id, device->name_human, device->ssh_cfg.host, device->ssh_cfg.port);
+        }
+    }
+
+    devices_cfg->items = items;
+    devices_cfg->count = count;
+
+    LOG_INFO("Loaded %zu devices from configuration.", count);
+    return true;
+
+fail:
+    free(items);
+    return false;
+}
+
+static void config_load_fleet(config_fleet_t *fleet_cfg, const cJSON *root) {
+    fleet_cfg->concurrency = cfg_get_int_from_env_json_default(root, "concurrency", "FLEET_CONCURRENCY", 4);
+
+    if (fleet_cfg->concurrency < 1) {
+        LOG_WARN("fleet.concurrency=%d is invalid; using 1.", fleet_cfg->concurrency);
+        fleet_cfg->concurrency = 1;
+    }
+
+    LOG_DEBUG("fleet.concurrency=%d", fleet_cfg->concurrency);
+}
+
+static bool config_load_cache(config_cache_t *cache_cfg, const cJSON *root) {
+    cache_cfg->max_entries = cfg_get_int_from_env_json_default(root, "max_entries", "CACHE_MAX_ENTRIES", 0);
+    cache_cfg->max_kb = cfg_get_int_from_env_json_default(root, "max_kb", "CACHE_MAX_KB", 20480);
+
+    if (!cfg_set_str_from_env_json_default(cache_cfg->directory, sizeof(cache_cfg->directory), root, "directory", NULL, "/etc/persistent/doorbell-mqtt-cache", "cache.directory", false)) {
+        return false;
+    }
+
+    if (cache_cfg->max_entries < 0 || cache_cfg->max_kb <= 0) {
+        LOG_WARN("Invalid cache budget (max_entries=%d max_kb=%d); on-device cache disabled.", cache_cfg->max_entries, cache_cfg->max_kb);
+        cache_cfg->max_entries = 0;
+    }
+
+    if (strchr(cache_cfg->directory, '\'') || cache_cfg->directory[0] != '/') {
+        LOG_ERROR("cache.directory must be an absolute path without quotes.");
+        return false;
+    }
+
+    LOG_DEBUG("cache.max_entries=%d cache.max_kb=%d cache.directory='%s'", cache_cfg->max_entries, cache_cfg->max_kb, cache_cfg->directory);
+
+    return true;
+}
+
+static void config_load_downloads(config_downloads_t *downloads_cfg, const cJSON *root) {
+    downloads_cfg->max_mb = cfg_get_int_from_env_json_default(root, "max_mb", "DOWNLOADS_MAX_MB", 512);
+
+    if (downloads_cfg->max_mb < 0) {
+        LOG_WARN("downloads.max_mb=%d is invalid; keeping every download.", downloads_cfg->max_mb);
+        downloads_cfg->max_mb = 0;
+    }
+
+    LOG_DEBUG("downloads.max_mb=%d", downloads_cfg->max_mb);
+}
+
+static void config_load_optimize(config_optimize_t *optimize_cfg, const cJSON *root) {
+    optimize_cfg->png = cfg_get_int_from_env_json_default(root, "png", "OPTIMIZE_PNG", 0) != 0;
+    optimize_cfg->gzip = cfg_get_int_from_env_json_default(root, "gzip", "OPTIMIZE_GZIP", 0) != 0;
+
+    LOG_DEBUG("optimize.png=%d optimize.gzip=%d", optimize_cfg->png, optimize_cfg->gzip);
+}
+
+static bool config_load_metrics(config_metrics_t *metrics_cfg, const cJSON *root) {
+    metrics_cfg->port = cfg_get_int_from_env_json_default(root, "port", "METRICS_PORT", 0);
+
+    if (!cfg_set_str_from_env_json_default(metrics_cfg->address, sizeof(metrics_cfg->address), root, "address", "METRICS_ADDRESS", "127.0.0.1", "metrics.address", false)) {
+        return false;
+    }
+
+    if (metrics_cfg->port < 0 || metrics_cfg->port > 65535) {
+        LOG_WARN("metrics.port=%d is invalid; metrics endpoint disabled.", metrics_cfg->port);
+        metrics_cfg->port = 0;
+    }
+
+    LOG_DEBUG("metrics.port=%d metrics.address='%s'", metrics_cfg->port, metrics_cfg->address);
+
+    return true;
+}
+
+#define TRACE_DEFAULT_MAX_KB 8192
+
+static void config_load_trace(config_trace_t *trace_cfg, const cJSON *root) {
+    trace_cfg->enabled = cfg_get_int_from_env_json_default(root, "enabled", "TRACE_ENABLED", 0) != 0;
+    trace_cfg->max_kb = cfg_get_int_from_env_json_default(root, "max_kb", "TRACE_MAX_KB", TRACE_DEFAULT_MAX_KB);
+
+    if (trace_cfg->max_kb < 1) {
+        LOG_WARN("trace.max_kb=%d is invalid; using %d.", trace_cfg->max_kb, TRACE_DEFAULT_MAX_KB);
+        trace_cfg->max_kb = TRACE_DEFAULT_MAX_KB;
+    }
+
+    LOG_DEBUG("trace.enabled=%d trace.max_kb=%d", trace_cfg->enabled, trace_cfg->max_kb);
+}
+
+static bool config_parse_schedule_time(const char *text, config_schedule_time_t *out) {
+    int consumed = 0;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!text) {
+        return false;
+    }
+
+    // "YYYY-MM-DD HH:MM" happens once; "MM-DD HH:MM" repeats every year.
+    if (sscanf(text, "%4d-%2d-%2d %2d:%2d%n", &out->year, &out->month, &out->day, &out->hour, &out->minute, &consumed) != 5 || text[consumed] != '\0') {
+        out->year = 0;
+        consumed = 0;
+
+        if (sscanf(text, "%2d-%2d %2d:%2d%n", &out->month, &out->day, &out->hour, &out->minute, &consumed) != 4 || text[consumed] != '\0') {
+            return false;
+        }
+    }
+
+    return out->month >= 1 && out->month <= 12 &&
+           out->day >= 1 && out->day <= 31 &&
+           out->hour >= 0 && out->hour <= 23 &&
+           out->minute >= 0 && out->minute <= 59;
+}
+
+static bool config_load_schedule(config_schedule_t *schedule_cfg, const cJSON *root) {
+    schedule_cfg->items = NULL;
+    schedule_cfg->count = 0;
+    schedule_cfg->lead_minutes = cfg_get_int_from_env_json_default(root, "lead_minutes", "SCHEDULE_LEAD_MINUTES", 60);
+    schedule_cfg->default_preset[0] = '\0';
+
+    if (schedule_cfg->lead_minutes < 0) {
+        LOG_WARN("schedule.lead_minutes=%d is invalid; using 0.", schedule_cfg->lead_minutes);
+        schedule_cfg->lead_minutes = 0;
+    }
+
+    if (!root) {
+        return true;
+    }
+
+    if (!cfg_set_str_from_env_json_default(schedule_cfg->default_preset, sizeof(schedule_cfg->default_preset), root, "default_preset", NULL, "", "schedule.default_preset", false)) {
+        return false;
+    }
+
+    const cJSON *windows = cJSON_GetObjectItemCaseSensitive(root, "windows");
+    if (!windows) {
+        return true;
+    }
+
+    if (!cJSON_IsArray(windows)) {
+        LOG_ERROR("'schedule.windows' must be an array.");
+        return false;
+    }
+
+    size_t count = (size_t)cJSON_GetArraySize(windows);
+    if (count == 0) {
+        return true;
+    }
+
+    config_schedule_window_t *items = calloc(count, sizeof(*items));
+    if (!items) {
+        LOG_ERROR("Out of memory allocating schedule windows (count=%zu)", count);
+        return false;
+    }
+
+    size_t i = 0;
+    for (cJSON *item = windows->child; item && i < count; item = item->next, i++) {
+        config_schedule_window_t *w = &items[i];
+
+        const char *preset = cJSON_IsObject(item) ? json_get_string(item, "preset") : NULL;
+        const char *tag = cJSON_IsObject(item) ? json_get_string(item, "tag") : NULL;
+        const char *start = cJSON_IsObject(item) ? json_get_string(item, "start") : NULL;
+        const char *end = cJSON_IsObject(item) ? json_get_string(item, "end") : NULL;
+
+        if (!preset || !*preset || snprintf(w->preset, sizeof(w->preset), "%s", preset) >= (int)sizeof(w->preset)) {
+            LOG_ERROR("Invalid schedule window at index %zu (missing or too long 'preset').", i);
+            goto fail;
+        }
+
+        if (tag && snprintf(w->tag, sizeof(w->tag), "%s", tag) >= (int)sizeof(w->tag)) {
+            LOG_ERROR("Invalid schedule window at index %zu ('tag' too long).", i);
+            goto fail;
+        }
+
+        if (!config_parse_schedule_time(start, &w->start)) {
+            LOG_ERROR("Invalid schedule window at index %zu: 'start' must be 'MM-DD HH:MM' or 'YYYY-MM-DD HH:MM'.", i);
+            goto fail;
+        }
+
+        if (end) {
+            if (!config_parse_schedule_time(end, &w->end) || (w->end.year == 0) != (w->start.year == 0)) {
+                LOG_ERROR("Invalid schedule window at index %zu: 'end' must use the same format as 'start'.", i);
+                goto fail;
+            }
+
+            w->has_end = true;
+
+            if (schedule_cfg->default_preset[0] == '\0') {
+                LOG_WARN("Schedule window '%s' has an end but no schedule.default_preset is set; the end is ignored.", w->preset);
+            }
+        }
+    }
+
+    schedule_cfg->items = items;
+    schedule_cfg->count = count;
+
+    LOG_INFO("Loaded %zu schedule windows from configuration.", count);
+    return true;
+
+fail:
+    free(items);
+    return false;
+}
+
 static void config_load_presets(config_preset_t *preset_cfg, const cJSON *presets) {
     if(!preset_cfg || !presets) {
         return;
@@ -297,11 +692,11 @@ bool config_load(const char *filename, config_t *cfg) {
     
     if (!root) { 
         LOG_ERROR("JSON parsing error in %s before: %s", filename, error_ptr ? error_ptr : "(unknown position)");
-        free(json_buffer);
+        arena_free(json_buffer);
         return false;
     }
 
-    free(json_buffer);
+    arena_free(json_buffer);
     json_buffer = NULL;
 
     cJSON *mqtt = cJSON_GetObjectItem(root, "mqtt");
@@ -317,13 +712,86 @@ bool config_load(const char *filename, config_t *cfg) {
 
 
     cJSON *ssh = cJSON_GetObjectItem(root, "ssh");
-    if (!ssh || !cJSON_IsObject(ssh)) {
+    if (!ssh || (!cJSON_IsObject(ssh) && !cJSON_IsArray(ssh))) {
         LOG_ERROR("Missing or invalid 'ssh' section in '%s'", filename);
         cJSON_Delete(root);
         return false;
     }
     
-    if (!config_load_ssh(&cfg->ssh_cfg, ssh)) {
+    if (!config_load_devices(&cfg->devices_cfg, &cfg->mqtt_cfg, ssh)) {
+        cJSON_Delete(root);
+        return false;
+    }
+
+    cJSON *fleet = cJSON_GetObjectItem(root, "fleet");
+    if (fleet && !cJSON_IsObject(fleet)) {
+        LOG_ERROR("Invalid 'fleet' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    config_load_fleet(&cfg->fleet_cfg, fleet);
+
+    cJSON *cache = cJSON_GetObjectItem(root, "cache");
+    if (cache && !cJSON_IsObject(cache)) {
+        LOG_ERROR("Invalid 'cache' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    if (!config_load_cache(&cfg->cache_cfg, cache)) {
+        cJSON_Delete(root);
+        return false;
+    }
+
+    cJSON *downloads = cJSON_GetObjectItem(root, "downloads");
+    if (downloads && !cJSON_IsObject(downloads)) {
+        LOG_ERROR("Invalid 'downloads' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    config_load_downloads(&cfg->downloads_cfg, downloads);
+
+    cJSON *optimize = cJSON_GetObjectItem(root, "optimize");
+    if (optimize && !cJSON_IsObject(optimize)) {
+        LOG_ERROR("Invalid 'optimize' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    config_load_optimize(&cfg->optimize_cfg, optimize);
+
+    cJSON *metrics = cJSON_GetObjectItem(root, "metrics");
+    if (metrics && !cJSON_IsObject(metrics)) {
+        LOG_ERROR("Invalid 'metrics' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    if (!config_load_metrics(&cfg->metrics_cfg, metrics)) {
+        cJSON_Delete(root);
+        return false;
+    }
+
+    cJSON *trace = cJSON_GetObjectItem(root, "trace");
+    if (trace && !cJSON_IsObject(trace)) {
+        LOG_ERROR("Invalid 'trace' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    config_load_trace(&cfg->trace_cfg, trace);
+
+    cJSON *schedule = cJSON_GetObjectItem(root, "schedule");
+    if (schedule && !cJSON_IsObject(schedule)) {
+        LOG_ERROR("Invalid 'schedule' section in '%s'", filename);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    if (!config_load_schedule(&cfg->schedule_cfg, schedule)) {
+        cJSON_Delete(root);
         return false;
     }
 
@@ -357,4 +825,14 @@ void config_free(config_t *cfg) {
 
     cfg->preset_cfg.items = NULL;
     cfg->preset_cfg.count = 0;
+
+    free(cfg->devices_cfg.items);
+
+    cfg->devices_cfg.items = NULL;
+    cfg->devices_cfg.count = 0;
+
+    free(cfg->schedule_cfg.items);
+
+    cfg->schedule_cfg.items = NULL;
+    cfg->schedule_cfg.count = 0;
 }
\ No newline at end of file
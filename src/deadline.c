@@ -0,0 +1,205 @@
+#include "deadline.h"
+#include "errors.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint *g_generations = NULL;
+static size_t g_device_count = 0;
+static deadline_op_t *g_running = NULL;
+
+static _Thread_local deadline_op_t *t_current = NULL;
+
+static uint64_t deadline_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+bool deadline_init(size_t device_count) {
+    deadline_shutdown();
+
+    if (device_count == 0) {
+        return true;
+    }
+
+    atomic_uint *generations = calloc(device_count, sizeof(*generations));
+
+    if (!generations) {
+        LOG_ERROR("Out of memory allocating cancel generations (count=%zu)", device_count);
+        return false;
+    }
+
+    for (size_t i = 0; i < device_count; i++) {
+        atomic_init(&generations[i], 0);
+    }
+
+    pthread_mutex_lock(&g_lock);
+    g_generations = generations;
+    g_device_count = device_count;
+    pthread_mutex_unlock(&g_lock);
+
+    return true;
+}
+
+void deadline_shutdown(void) {
+    pthread_mutex_lock(&g_lock);
+
+    free(g_generations);
+    g_generations = NULL;
+    g_device_count = 0;
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+unsigned deadline_generation(size_t device) {
+    if (device >= g_device_count) {
+        return 0;
+    }
+
+    return atomic_load(&g_generations[device]);
+}
+
+unsigned deadline_cancel(size_t device) {
+    if (device >= g_device_count) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_lock);
+
+    unsigned generation = atomic_fetch_add(&g_generations[device], 1) + 1;
+
+    // Sockets are only closed after deadline_unwatch_socket(), which takes the lock, so none is reused here.
+    for (deadline_op_t *op = g_running; op; op = op->next) {
+        if (op->device == device && op->generation != generation && op->sock >= 0 && op->shield == 0) {
+            shutdown(op->sock, SHUT_RDWR);
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+
+    return generation;
+}
+
+void deadline_begin(deadline_op_t *op, size_t device, unsigned generation, int timeout_s) {
+    op->device = device;
+    op->generation = generation;
+    op->expires_us = timeout_s > 0 ? deadline_now_us() + (uint64_t)timeout_s * 1000000u : 0;
+    op->sock = -1;
+    op->shield = 0;
+    op->outer = t_current;
+
+    pthread_mutex_lock(&g_lock);
+    op->next = g_running;
+    g_running = op;
+    pthread_mutex_unlock(&g_lock);
+
+    t_current = op;
+}
+
+void deadline_end(deadline_op_t *op) {
+    pthread_mutex_lock(&g_lock);
+
+    for (deadline_op_t **link = &g_running; *link; link = &(*link)->next) {
+        if (*link == op) {
+            *link = op->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+
+    t_current = op->outer;
+}
+
+void deadline_arm(int timeout_s) {
+    if (t_current) {
+        t_current->expires_us = timeout_s > 0 ? deadline_now_us() + (uint64_t)timeout_s * 1000000u : 0;
+    }
+}
+
+bool deadline_cancelled(void) {
+    const deadline_op_t *op = t_current;
+
+    return op && op->shield == 0 && op->device < g_device_count && deadline_generation(op->device) != op->generation;
+}
+
+bool deadline_expired(void) {
+    const deadline_op_t *op = t_current;
+
+    if (!op) {
+        return false;
+    }
+
+    return deadline_cancelled() || (op->expires_us != 0 && deadline_now_us() >= op->expires_us);
+}
+
+int deadline_remaining_ms(void) {
+    const deadline_op_t *op = t_current;
+
+    if (deadline_cancelled()) {
+        return 0;
+    }
+
+    if (!op || op->expires_us == 0) {
+        return -1;
+    }
+
+    uint64_t now = deadline_now_us();
+
+    // Round up so a deadline less than a millisecond away is not mistaken for an expired one.
+    return now >= op->expires_us ? 0 : (int)((op->expires_us - now + 999) / 1000);
+}
+
+int deadline_error(int timeout_error) {
+    return deadline_cancelled() ? ERROR_OPERATION_CANCELLED : timeout_error;
+}
+
+// The shield count is read by deadline_cancel() under the lock, so it is changed under it too.
+void deadline_shield_begin(void) {
+    pthread_mutex_lock(&g_lock);
+
+    if (t_current) {
+        t_current->shield++;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void deadline_shield_end(void) {
+    pthread_mutex_lock(&g_lock);
+
+    if (t_current && t_current->shield > 0) {
+        t_current->shield--;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void deadline_watch_socket(int sock) {
+    pthread_mutex_lock(&g_lock);
+
+    if (t_current) {
+        t_current->sock = sock;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void deadline_unwatch_socket(int sock) {
+    pthread_mutex_lock(&g_lock);
+
+    for (deadline_op_t *op = g_running; op; op = op->next) {
+        if (op->sock == sock) {
+            op->sock = -1;
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
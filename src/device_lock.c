@@ -0,0 +1,54 @@
+#include "device_lock.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static pthread_mutex_t *g_locks = NULL;
+static size_t g_device_count = 0;
+
+bool device_lock_init(size_t device_count) {
+    device_lock_shutdown();
+
+    if (device_count == 0) {
+        return true;
+    }
+
+    pthread_mutex_t *locks = calloc(device_count, sizeof(*locks));
+
+    if (!locks) {
+        LOG_ERROR("Out of memory allocating device locks (count=%zu)", device_count);
+        return false;
+    }
+
+    for (size_t i = 0; i < device_count; i++) {
+        pthread_mutex_init(&locks[i], NULL);
+    }
+
+    g_locks = locks;
+    g_device_count = device_count;
+
+    return true;
+}
+
+void device_lock_shutdown(void) {
+    for (size_t i = 0; i < g_device_count; i++) {
+        pthread_mutex_destroy(&g_locks[i]);
+    }
+
+    free(g_locks);
+    g_locks = NULL;
+    g_device_count = 0;
+}
+
+void device_lock(size_t device) {
+    if (device < g_device_count) {
+        pthread_mutex_lock(&g_locks[device]);
+    }
+}
+
+void device_unlock(size_t device) {
+    if (device < g_device_count) {
+        pthread_mutex_unlock(&g_locks[device]);
+    }
+}
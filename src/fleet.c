@@ -0,0 +1,228 @@
+#include "fleet.h"
+#include "cJSON.h"
+#include "deadline.h"
+#include "errors.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    fleet_rollout_t *rollout;
+    fleet_apply_fn fn;
+    void *user;
+    pthread_mutex_t lock;
+    size_t next;
+} fleet_pool_t;
+
+static long long fleet_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static bool device_has_tag(const config_device_t *device, const char *tag) {
+    for (size_t i = 0; i < device->tag_count; i++) {
+        if (strcmp(device->tags[i], tag) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void *fleet_worker(void *arg) {
+    fleet_pool_t *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->rollout->count) {
+            break;
+        }
+
+        // Each slot is owned by exactly one worker, so results need no locking.
+        fleet_result_t *result = &pool->rollout->results[i];
+        const config_device_t *device = result->device;
+        long long start = fleet_now_ms();
+        deadline_op_t op;
+
+        // A cancel of a device stops only its part of the rollout. fn arms the deadline once it holds the device.
+        deadline_begin(&op, device->index, deadline_generation(device->index), 0);
+        result->error = pool->fn(device, pool->user);
+        deadline_end(&op);
+
+        result->elapsed_ms = fleet_now_ms() - start;
+
+        LOG_INFO("Fleet device '%s' finished in %lld ms (code=%d)", result->device->id, result->elapsed_ms, result->error);
+    }
+
+    return NULL;
+}
+
+bool fleet_rollout_init(fleet_rollout_t *rollout, const config_devices_t *devices, const char *tag) {
+    if (!rollout || !devices) {
+        LOG_ERROR("Invalid parameters rollout=%p, devices=%p", (void*)rollout, (void*)devices);
+        return false;
+    }
+
+    memset(rollout, 0, sizeof(*rollout));
+
+    if (devices->count == 0) {
+        return true;
+    }
+
+    rollout->results = calloc(devices->count, sizeof(*rollout->results));
+    if (!rollout->results) {
+        LOG_ERROR("Out of memory allocating rollout results (count=%zu)", devices->count);
+        return false;
+    }
+
+    bool filter = tag && *tag;
+
+    for (size_t i = 0; i < devices->count; i++) {
+        if (filter && !device_has_tag(&devices->items[i], tag)) {
+            continue;
+        }
+
+        rollout->results[rollout->count].device = &devices->items[i];
+        rollout->results[rollout->count].error = ERROR_NONE;
+        rollout->count++;
+    }
+
+    return true;
+}
+
+bool fleet_rollout_run(fleet_rollout_t *rollout, int concurrency, fleet_apply_fn fn, void *user) {
+    if (!rollout || !fn) {
+        LOG_ERROR("Invalid parameters rollout=%p, fn=%s", (void*)rollout, fn ? "set" : "NULL");
+        return false;
+    }
+
+    size_t workers = concurrency < 1 ? 1 : (size_t)concurrency;
+    if (workers > rollout->count) {
+        workers = rollout->count;
+    }
+
+    rollout->concurrency = (int)workers;
+    rollout->succeeded = 0;
+
+    fleet_pool_t pool = {
+        .rollout = rollout,
+        .fn = fn,
+        .user = user,
+        .next = 0
+    };
+
+    pthread_mutex_init(&pool.lock, NULL);
+
+    pthread_t *threads = workers ? calloc(workers, sizeof(*threads)) : NULL;
+    size_t started = 0;
+
+    long long start = fleet_now_ms();
+
+    if (threads) {
+        for (; started < workers; started++) {
+            if (pthread_create(&threads[started], NULL, fleet_worker, &pool) != 0) {
+                LOG_WARN("Failed to start fleet worker %zu of %zu", started + 1, workers);
+                break;
+            }
+        }
+    }
+
+    // No worker could be started: serve the devices from the calling thread.
+    if (started == 0) {
+        fleet_worker(&pool);
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    rollout->wall_ms = fleet_now_ms() - start;
+
+    free(threads);
+    pthread_mutex_destroy(&pool.lock);
+
+    for (size_t i = 0; i < rollout->count; i++) {
+        if (rollout->results[i].error == ERROR_NONE) {
+            rollout->succeeded++;
+        }
+    }
+
+    LOG_INFO("Fleet rollout finished: %zu/%zu devices succeeded in %lld ms (concurrency=%zu)", rollout->succeeded, rollout->count, rollout->wall_ms, started ? started : 1);
+
+    return rollout->succeeded == rollout->count;
+}
+
+char *fleet_rollout_summary_json(const fleet_rollout_t *rollout, const char *profile, const char *tag) {
+    if (!rollout) {
+        return NULL;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for fleet summary.");
+        return NULL;
+    }
+
+    char *json = NULL;
+
+    cJSON_AddStringToObject(root, "profile", profile ? profile : "");
+
+    if (tag && *tag) {
+        cJSON_AddStringToObject(root, "tag", tag);
+    } else {
+        cJSON_AddNullToObject(root, "tag");
+    }
+
+    cJSON_AddNumberToObject(root, "devices", (double)rollout->count);
+    cJSON_AddNumberToObject(root, "succeeded", (double)rollout->succeeded);
+    cJSON_AddNumberToObject(root, "failed", (double)(rollout->count - rollout->succeeded));
+    cJSON_AddNumberToObject(root, "concurrency", rollout->concurrency);
+    cJSON_AddNumberToObject(root, "wall_ms", (double)rollout->wall_ms);
+
+    cJSON *results = cJSON_AddArrayToObject(root, "results");
+    if (!results) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < rollout->count; i++) {
+        const fleet_result_t *r = &rollout->results[i];
+
+        cJSON *item = cJSON_CreateObject();
+        if (!item) {
+            goto cleanup;
+        }
+
+        cJSON_AddStringToObject(item, "id", r->device->id);
+        cJSON_AddBoolToObject(item, "ok", r->error == ERROR_NONE);
+        cJSON_AddNumberToObject(item, "code", r->error);
+        cJSON_AddStringToObject(item, "name", error_code_name((error_code_t)r->error));
+        cJSON_AddNumberToObject(item, "elapsed_ms", (double)r->elapsed_ms);
+        cJSON_AddItemToArray(results, item);
+    }
+
+    json = cJSON_PrintUnformatted(root);
+
+cleanup:
+    cJSON_Delete(root);
+
+    return json;
+}
+
+void fleet_rollout_free(fleet_rollout_t *rollout) {
+    if (!rollout) {
+        return;
+    }
+
+    free(rollout->results);
+
+    rollout->results = NULL;
+    rollout->count = 0;
+    rollout->succeeded = 0;
+}
@@ -67,7 +67,7 @@ static bool create_device(cJSON *out, const char *prefix, const char *instance,
     return true;
 }
 
-static bool build_entity_payload(char *payload, size_t payload_size, const entity_t *d, const config_t *cfg) {
+static bool build_entity_payload(char *payload, size_t payload_size, const entity_t *d, const config_t *cfg, const config_device_t *dev) {
     cJSON *root = cJSON_CreateObject();
 
     if (!root) {
@@ -76,7 +76,7 @@ static bool build_entity_payload(char *payload, size_t payload_size, const entit
     }
 
     char buffer[256];
-    build_entity_name(buffer, sizeof(buffer), d->name, cfg->mqtt_cfg.instance_human);
+    build_entity_name(buffer, sizeof(buffer), d->name, dev->name_human);
     cJSON_AddStringToObject(root, "name", buffer);
 
     if (d->category) {
@@ -85,22 +85,21 @@ static bool build_entity_payload(char *payload, size_t payload_size, const entit
 
     cJSON_AddStringToObject(root, "object_id", d->object_id);
 
-    build_unique_id(buffer, sizeof(buffer), d->object_id, cfg->mqtt_cfg.instance);
+    build_unique_id(buffer, sizeof(buffer), d->object_id, dev->id);
     
     cJSON_AddStringToObject(root, "unique_id", buffer);
 
-    build_default_entity_id(buffer, sizeof(buffer), d->component, d->object_id, cfg->mqtt_cfg.instance);
+    build_default_entity_id(buffer, sizeof(buffer), d->component, d->object_id, dev->id);
     cJSON_AddStringToObject(root,"default_entity_id", buffer);
 
-    ha_build_topic(buffer, sizeof(buffer), d->state_topic);
-    cJSON_AddStringToObject(root, "state_topic", buffer);
+    if (d->state_topic != HA_TOPIC_NONE) {
+        cJSON_AddStringToObject(root, "state_topic", ha_topic(dev->index, d->state_topic));
+    }
 
-    ha_build_topic(buffer, sizeof(buffer), d->availability_topic);
-    cJSON_AddStringToObject(root, "availability_topic", buffer);
+    cJSON_AddStringToObject(root, "availability_topic", ha_topic(dev->index, d->availability_topic));
 
-    if (d->command_topic) {
-        ha_build_topic(buffer, sizeof(buffer), d->command_topic);
-        cJSON_AddStringToObject(root, "command_topic", buffer);
+    if (d->command_topic != HA_TOPIC_NONE) {
+        cJSON_AddStringToObject(root, "command_topic", ha_topic(dev->index, d->command_topic));
     }
 
     if (d->add_options) {
@@ -118,16 +117,39 @@ static bool build_entity_payload(char *payload, size_t payload_size, const entit
         cJSON_AddStringToObject(root, "device_class", d->device_class);
     }
 
+    if (d->unit_of_measurement) {
+        cJSON_AddStringToObject(root, "unit_of_measurement", d->unit_of_measurement);
+    }
+
     if (d->value_template) {
         cJSON_AddStringToObject(root, "value_template", d->value_template);
     }
 
-    if (d->json_attributes_topic) {
-        ha_build_topic(buffer, sizeof(buffer), d->json_attributes_topic);
-        cJSON_AddStringToObject(root, "json_attributes_topic", buffer);
+    if (d->command_template) {
+        cJSON_AddStringToObject(root, "command_template", d->command_template);
+    }
+
+    if (d->max > d->min) {
+        cJSON_AddNumberToObject(root, "min", d->min);
+        cJSON_AddNumberToObject(root, "max", d->max);
+        cJSON_AddNumberToObject(root, "step", d->step);
     }
 
-    if (!create_device(root, cfg->mqtt_cfg.prefix, cfg->mqtt_cfg.instance, cfg->mqtt_cfg.instance_human)) {
+    if (d->payload_on) {
+        cJSON_AddStringToObject(root, "payload_on", d->payload_on);
+        cJSON_AddStringToObject(root, "payload_off", d->payload_off);
+    }
+
+    if (d->state_on) {
+        cJSON_AddStringToObject(root, "state_on", d->state_on);
+        cJSON_AddStringToObject(root, "state_off", d->state_off);
+    }
+
+    if (d->json_attributes_topic != HA_TOPIC_NONE) {
+        cJSON_AddStringToObject(root, "json_attributes_topic", ha_topic(dev->index, d->json_attributes_topic));
+    }
+
+    if (!create_device(root, cfg->mqtt_cfg.prefix, dev->id, dev->name_human)) {
         cJSON_Delete(root);
         return false;
     }
@@ -157,7 +179,23 @@ static bool build_entity_payload(char *payload, size_t payload_size, const entit
     payload[payload_size - 1] = '\0';
 
     cJSON_Delete(root);
-    free(tmp);
+    cJSON_free(tmp);
+
+    return true;
+}
+
+static bool publish_entity(const config_t *cfg, const config_device_t *dev, const entity_t *d) {
+    char topic[256];
+    char payload[2048];
+
+    snprintf(topic, sizeof(topic), "homeassistant/%s/%s_doorbell_mqtt_%s_%s/config",
+             d->component, cfg->mqtt_cfg.prefix, dev->id, d->object_id);
+
+    if (!build_entity_payload(payload, sizeof(payload), d, cfg, dev)) {
+        return false;
+    }
+
+    mqtt_publish(topic, payload, 1, 1);
 
     return true;
 }
@@ -167,21 +205,40 @@ bool ha_publish_discovery(const config_t *cfg) {
         return false;
     }
 
+    for (size_t dev_idx = 0; dev_idx < cfg->devices_cfg.count; dev_idx++) {
+        const config_device_t *dev = &cfg->devices_cfg.items[dev_idx];
+
+        for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
+            if (!publish_entity(cfg, dev, &HA_ENTITIES[i])) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+bool ha_publish_discovery_entity(const config_t *cfg, const char *object_id) {
+    if (!cfg || !object_id) {
+        return false;
+    }
+
     for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
         const entity_t *d = &HA_ENTITIES[i];
 
-        char topic[256];
-        char payload[1024];
+        if (strcmp(d->object_id, object_id) != 0) {
+            continue;
+        }
 
-        snprintf(topic, sizeof(topic), "homeassistant/%s/%s_doorbell_mqtt_%s_%s/config",
-                 d->component, cfg->mqtt_cfg.prefix, cfg->mqtt_cfg.instance, d->object_id);
-    
-        if (!build_entity_payload(payload, sizeof(payload), d, cfg)) {
-            return false;
+        for (size_t dev_idx = 0; dev_idx < cfg->devices_cfg.count; dev_idx++) {
+            if (!publish_entity(cfg, &cfg->devices_cfg.items[dev_idx], d)) {
+                return false;
+            }
         }
 
-        mqtt_publish(topic, payload, 1, 1);
-    }  
-    
-    return true;
-}
\ No newline at end of file
+        return true;
+    }
+
+    LOG_WARN("No discovery entity with object_id '%s'", object_id);
+    return false;
+}
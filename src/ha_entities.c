@@ -1,28 +1,31 @@
 #include "ha_entities.h"
 #include "command.h"
 #include "config.h"
+#include "unifi_remote.h"
+#include "unifi_profiles_repo.h"
 
 #include "cJSON.h"
 
 
 
 static options_result_t add_preset_options(cJSON *root, const config_t *cfg, const entity_t *def) {
+    (void)cfg;
     (void)def;
 
-    if (cfg->preset_cfg.count == 0) {
-        return OPTIONS_ERR_EMPTY_LIST;
-    }
-
-    cJSON *presets = cJSON_AddArrayToObject(root, "options");
+    // The names come from the profiles repo rather than cfg, so a reloaded preset list is picked up.
+    cJSON *presets = cJSON_CreateArray();
 
     if (!presets) {
         return OPTIONS_ERR_UNKNOWN;
     }
 
-    for(size_t i = 0; i < cfg->preset_cfg.count; i++) {
-        cJSON_AddItemToArray(presets, cJSON_CreateString(cfg->preset_cfg.items[i].display_name));
+    if (profiles_repo_add_preset_names(presets) == 0) {
+        cJSON_Delete(presets);
+        return OPTIONS_ERR_EMPTY_LIST;
     }
 
+    cJSON_AddItemToObject(root, "options", presets);
+
     return OPTIONS_OK;
 } 
 
@@ -32,9 +35,9 @@ const entity_t HA_ENTITIES[]  = {
         .object_id = "status",
         .name = "Status",
         .category = "diagnostic",
-        .state_topic = "status",
-        .availability_topic = "availability",
-        .command_topic = NULL,
+        .state_topic = HA_TOPIC_STATUS,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
         .icon = "mdi:information-outline",
         .device_class = NULL,
         .add_options = NULL,
@@ -44,13 +47,13 @@ const entity_t HA_ENTITIES[]  = {
         .object_id = "last_error",
         .name = "Last Error",
         .category = "diagnostic",
-        .state_topic = "last_error",
-        .availability_topic = "availability",
-        .command_topic = NULL,
+        .state_topic = HA_TOPIC_LAST_ERROR,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
         .icon = "mdi:alert-circle-outline",
         .device_class = NULL,
         .value_template = "{{ value_json.message }}",
-        .json_attributes_topic = "last_error",
+        .json_attributes_topic = HA_TOPIC_LAST_ERROR,
         .json_attributes_template = NULL,
         .add_options = NULL,
         .handle_command = NULL
@@ -59,9 +62,9 @@ const entity_t HA_ENTITIES[]  = {
         .object_id = "last_applied_profile",
         .name = "Last Applied Profile",
         .category = NULL,
-        .state_topic = "last_applied_profile",
-        .availability_topic ="availability",
-        .command_topic = NULL,
+        .state_topic = HA_TOPIC_LAST_APPLIED_PROFILE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
         .icon = "mdi:badge-account",
         .device_class = NULL,
         .add_options = NULL,
@@ -71,65 +74,279 @@ const entity_t HA_ENTITIES[]  = {
         .object_id = "preset",
         .name = "Presets",
         .category = "config",
-        .state_topic = "preset/selected",
-        .availability_topic ="availability",
-        .command_topic = "cmd/preset_set",
+        .state_topic = HA_TOPIC_PRESET_SELECTED,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_PRESET_SET,
         .icon = "mdi:tune-variant",
         .device_class = NULL,
         .add_options = add_preset_options,
-        .handle_command = command_set_preset
+        .handle_command = command_set_preset,
+        .route_flags = MQTT_ROUTE_SUPERSEDES
     }, {
         .component = "text",
         .object_id = "custom_directory",
         .name = "Custom directory",
         .category = "config",
-        .state_topic = "custom/directory",
-        .availability_topic ="availability",
-        .command_topic = "cmd/apply_custom",
+        .state_topic = HA_TOPIC_CUSTOM_DIRECTORY,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_APPLY_CUSTOM,
         .icon = "mdi:folder",
         .device_class = NULL,
         .add_options = NULL,
-        .handle_command = command_apply_custom
+        .handle_command = command_apply_custom,
+        .route_flags = MQTT_ROUTE_SUPERSEDES
     }, {
         .component = "button",
         .object_id = "test_config",
         .name = "Test Config",
         .category = "config",
-        .state_topic = NULL,
-        .availability_topic = "availability",
-        .command_topic = "cmd/test_config",
+        .state_topic = HA_TOPIC_NONE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_TEST_CONFIG,
         .icon = "mdi:test-tube",
         .device_class = NULL,
         .add_options = NULL,
-        .handle_command = command_test_config
+        .handle_command = command_test_config,
+        .route_flags = MQTT_ROUTE_SUPERSEDES
     }, {
         .component = "button",
         .object_id = "download_assets",
         .name = "Asset Download",
         .category = NULL,
-        .state_topic = NULL,
-        .availability_topic = "availability",
-        .command_topic = "cmd/download_assets",
+        .state_topic = HA_TOPIC_NONE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_DOWNLOAD_ASSETS,
         .icon = "mdi:download",
         .device_class = NULL,
         .add_options = NULL,
         .handle_command = command_download_assets
+    }, {
+        .component = "button",
+        .object_id = "cancel",
+        .name = "Cancel",
+        .category = NULL,
+        .state_topic = HA_TOPIC_NONE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_CANCEL,
+        .icon = "mdi:cancel",
+        .device_class = NULL,
+        .add_options = NULL,
+        .handle_command = command_cancel,
+        .route_flags = MQTT_ROUTE_SUPERSEDES
+    }, {
+        // Parameter entities share cmd/params_set. They do not supersede: each one changes a different value.
+        .component = "number",
+        .object_id = "ring_volume",
+        .name = "Ring Volume",
+        .category = "config",
+        .state_topic = HA_TOPIC_PARAMS,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_PARAMS_SET,
+        .icon = "mdi:volume-high",
+        .device_class = NULL,
+        .unit_of_measurement = "%",
+        .value_template = "{{ value_json.volume }}",
+        .command_template = "{\"volume\": {{ value | int }}}",
+        .min = UNIFI_PARAM_VOLUME_MIN,
+        .max = UNIFI_PARAM_VOLUME_MAX,
+        .step = 1,
+        .add_options = NULL,
+        .handle_command = command_set_params
+    }, {
+        .component = "number",
+        .object_id = "ring_repeat",
+        .name = "Ring Repeat",
+        .category = "config",
+        .state_topic = HA_TOPIC_PARAMS,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_PARAMS_SET,
+        .icon = "mdi:repeat",
+        .device_class = NULL,
+        .value_template = "{{ value_json.repeat_times }}",
+        .command_template = "{\"repeat_times\": {{ value | int }}}",
+        .min = UNIFI_PARAM_REPEAT_MIN,
+        .max = UNIFI_PARAM_REPEAT_MAX,
+        .step = 1,
+        .add_options = NULL,
+        .handle_command = command_set_params
+    }, {
+        .component = "number",
+        .object_id = "welcome_duration",
+        .name = "Welcome Duration",
+        .category = "config",
+        .state_topic = HA_TOPIC_PARAMS,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_PARAMS_SET,
+        .icon = "mdi:timer-outline",
+        .device_class = NULL,
+        .unit_of_measurement = "ms",
+        .value_template = "{{ value_json.duration_ms }}",
+        .command_template = "{\"duration_ms\": {{ value | int }}}",
+        .min = UNIFI_PARAM_DURATION_MS_MIN,
+        .max = UNIFI_PARAM_DURATION_MS_MAX,
+        .step = 100,
+        .add_options = NULL,
+        .handle_command = command_set_params
+    }, {
+        .component = "switch",
+        .object_id = "welcome_loop",
+        .name = "Welcome Loop",
+        .category = "config",
+        .state_topic = HA_TOPIC_PARAMS,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_CMD_PARAMS_SET,
+        .icon = "mdi:sync",
+        .device_class = NULL,
+        .value_template = "{{ 'None' if value_json.loop is none else ('ON' if value_json.loop else 'OFF') }}",
+        .payload_on = "{\"loop\": true}",
+        .payload_off = "{\"loop\": false}",
+        .state_on = "ON",
+        .state_off = "OFF",
+        .add_options = NULL,
+        .handle_command = command_set_params
     }, {
         .component = "sensor",
         .object_id = "last_download",
         .name = "Last Asset Download",
         .category = "diagnostic",
-        .state_topic = "last_download/time/state",
-        .availability_topic = "availability",
-        .command_topic = NULL,
+        .state_topic = HA_TOPIC_LAST_DOWNLOAD_STATE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
         .icon = "mdi:folder-arrow-down",
         .device_class = "timestamp",
         .value_template = NULL,
-        .json_attributes_topic = "last_download/time/attributes",
+        .json_attributes_topic = HA_TOPIC_LAST_DOWNLOAD_ATTRIBUTES,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "last_switch_latency",
+        .name = "Scheduled Switch Latency",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_SCHEDULE_SWITCH_STATE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:timer-outline",
+        .device_class = "duration",
+        .unit_of_measurement = "ms",
+        .value_template = NULL,
+        .json_attributes_topic = HA_TOPIC_SCHEDULE_SWITCH_ATTRIBUTES,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "asset_cache",
+        .name = "Asset Cache",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_ASSET_CACHE_STATE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:cached",
+        .device_class = NULL,
+        .value_template = NULL,
+        .json_attributes_topic = HA_TOPIC_ASSET_CACHE_ATTRIBUTES,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "upload_savings",
+        .name = "Upload Savings",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_UPLOAD_SAVINGS_STATE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:package-down",
+        .device_class = "data_size",
+        .unit_of_measurement = "B",
+        .value_template = NULL,
+        .json_attributes_topic = HA_TOPIC_UPLOAD_SAVINGS_ATTRIBUTES,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "apply_duration",
+        .name = "Last Apply Duration",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_PERFORMANCE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:timer-sand",
+        .device_class = "duration",
+        .unit_of_measurement = "s",
+        .value_template = "{{ value_json.apply_seconds }}",
+        .json_attributes_topic = HA_TOPIC_NONE,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "transfer_throughput",
+        .name = "Transfer Throughput",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_PERFORMANCE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:speedometer",
+        .device_class = "data_rate",
+        .unit_of_measurement = "kB/s",
+        .value_template = "{{ value_json.throughput_kbps }}",
+        .json_attributes_topic = HA_TOPIC_NONE,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "ssh_round_trip",
+        .name = "SSH Round Trip",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_PERFORMANCE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:lan-pending",
+        .device_class = "duration",
+        .unit_of_measurement = "ms",
+        .value_template = "{{ value_json.ssh_rtt_ms }}",
+        .json_attributes_topic = HA_TOPIC_NONE,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "queue_depth",
+        .name = "Command Queue Depth",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_PERFORMANCE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:tray-full",
+        .device_class = NULL,
+        .unit_of_measurement = NULL,
+        .value_template = "{{ value_json.queue_depth }}",
+        .json_attributes_topic = HA_TOPIC_NONE,
+        .json_attributes_template = NULL,
+        .add_options = NULL,
+        .handle_command = NULL
+    }, {
+        .component = "sensor",
+        .object_id = "apply_success_rate",
+        .name = "Apply Success Rate",
+        .category = "diagnostic",
+        .state_topic = HA_TOPIC_PERFORMANCE,
+        .availability_topic = HA_TOPIC_AVAILABILITY,
+        .command_topic = HA_TOPIC_NONE,
+        .icon = "mdi:check-circle-outline",
+        .device_class = NULL,
+        .unit_of_measurement = "%",
+        .value_template = "{{ value_json.apply_success_rate }}",
+        .json_attributes_topic = HA_TOPIC_NONE,
         .json_attributes_template = NULL,
         .add_options = NULL,
         .handle_command = NULL
     }
 };
 
-const size_t HA_ENTITIES_COUNT = 8;
\ No newline at end of file
+const size_t HA_ENTITIES_COUNT = sizeof(HA_ENTITIES) / sizeof(HA_ENTITIES[0]);
\ No newline at end of file
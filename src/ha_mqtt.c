@@ -8,6 +8,28 @@
 
 static const config_t *g_cfg = NULL;
 
+static void ha_restore_device_state(const config_device_t *dev)
+{
+    unifi_last_applied_profile_t last_applied;
+
+    // The first device inherits state written before per-device state files existed.
+    if (!profile_load_last_applied(dev->id, &last_applied) &&
+        !(dev->index == 0 && profile_load_last_applied(NULL, &last_applied))) {
+        LOG_WARN("Failed to load last applied state for device '%s', state will not be restored", dev->id);
+        return;
+    }
+
+    status_set_last_applied_profile(last_applied.profile_name);
+
+    if (last_applied.is_preset) {
+        status_set_preset_selected(last_applied.profile_name);
+        status_set_custom_directory("");
+    } else {
+        status_set_custom_directory(last_applied.profile_name);
+        status_set_preset_selected("none");
+    }
+}
+
 static void ha_on_connect(bool reconnect, void *user)
 {
     (void)reconnect;
@@ -16,21 +38,17 @@ static void ha_on_connect(bool reconnect, void *user)
     ha_publish_discovery(g_cfg);
     ha_topic_subscribe_commands();
 
-    unifi_last_applied_profile_t last_applied;
-    if (!profile_load_last_applied(&last_applied)) {
-        LOG_WARN("Failed to load last_applied.json, state will not be restored");
-    } else {
-        status_set_last_applied_profile(last_applied.profile_name);
-
-        if (last_applied.is_preset) {
-            status_set_preset_selected(last_applied.profile_name);
-            status_set_custom_directory("");
-        } else {
-            status_set_custom_directory(last_applied.profile_name);
-            status_set_preset_selected("none");
-        }
+    size_t bound = status_bound_device();
+
+    for (size_t i = 0; i < g_cfg->devices_cfg.count; i++) {
+        status_bind_device(i);
+        ha_restore_device_state(&g_cfg->devices_cfg.items[i]);
     }
 
+    status_bind_device(bound);
+    status_mark_performance_dirty();
+
+    // Availability is shared by all devices, so one publish covers the fleet.
     status_set_availability(true);
 }
 
@@ -2,14 +2,64 @@
 #include "cJSON.h"
 #include "errors.h"
 #include "logger.h"
+#include "metrics.h"
 #include "mqtt.h"
 #include "ha_topics.h"
 #include <linux/limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
+
+// Performance sensors are published at most this often per device.
+#define STATUS_PERFORMANCE_INTERVAL_S 30
 
 static int g_last_error_code = 0;
 static char g_last_error_message[256] = { '\0'};
+// Each worker publishes for the device it is serving; see status_bind_device().
+static _Thread_local size_t g_status_device = 0;
+
+typedef struct {
+    bool dirty;                 // changed since the last publish
+    time_t last_publish;        // CLOCK_MONOTONIC seconds, 0 before the first publish
+    double apply_seconds;       // negative before the first apply
+    double throughput_kbps;     // of the last apply that transferred anything; negative before one did
+    double rtt_ms;
+    unsigned long applies;
+    unsigned long failures;
+    unsigned long unchanged;
+    long long queue_depth;      // as last published; negative before the first publish
+} status_performance_t;
+
+static pthread_mutex_t g_perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static status_performance_t *g_perf = NULL;
+static size_t g_perf_count = 0;
+
+static void status_publish_to(size_t device, ha_topic_id_t id, const char *payload) {
+    const char *topic = ha_topic(device, id);
+
+    if (!topic || !payload) {
+        LOG_ERROR("Cannot publish topic id %d for device %zu (topic=%p payload=%p)", (int)id, device, (void*)topic, (void*)payload);
+        return;
+    }
+
+    mqtt_publish(topic, payload, 1, 1);
+    metrics_count_publish(id);
+}
+
+static void status_publish(ha_topic_id_t id, const char *payload) {
+    status_publish_to(g_status_device, id, payload);
+}
+
+void status_bind_device(size_t device) {
+    g_status_device = device;
+}
+
+size_t status_bound_device(void) {
+    return g_status_device;
+}
 
 void status_set_state(const char *state) {
 
@@ -17,21 +67,15 @@ void status_set_state(const char *state) {
         return;
     }
 
-    char buffer[256];
-    ha_build_topic(buffer, sizeof(buffer), "status");
-
-    mqtt_publish(buffer, state, 1, 1);
+    status_publish(HA_TOPIC_STATUS, state);
 }
 
-void status_set_status_message(const char *topic, const char *message) {
-    if (!topic || !message) {
+void status_set_status_message(ha_topic_id_t topic, const char *message) {
+    if (topic == HA_TOPIC_NONE || !message) {
         return;
     }
 
-    char buffer[256];
-    ha_build_topic(buffer, sizeof(buffer), topic);
-
-    mqtt_publish(buffer, message, 1, 1);
+    status_publish(topic, message);
 }
 
 void status_set_error(error_code_t code, const char *message_override) {
@@ -42,6 +86,8 @@ void status_set_error(error_code_t code, const char *message_override) {
         msg = "Unknown error";
     }
 
+    metrics_count_error(code);
+
     cJSON *root = cJSON_CreateObject();
     if (!root) {
         LOG_ERROR("Failed to allocate cJSON object for last_error.");
@@ -55,9 +101,7 @@ void status_set_error(error_code_t code, const char *message_override) {
     char *json = cJSON_PrintUnformatted(root);
     
     if (json) {
-        char topic[256];
-        ha_build_topic(topic, sizeof(topic), "last_error");
-        mqtt_publish(topic, json, 1, 1);
+        status_publish(HA_TOPIC_LAST_ERROR, json);
     } else {
         LOG_ERROR("Failed to serialize last_error JSON.");
     }
@@ -84,27 +128,15 @@ bool status_error_changed(error_code_t code, const char *message)
 }
 
 void status_set_last_applied_profile(const char *profile) {
-    char buffer[255];
-
-    ha_build_topic(buffer, sizeof(buffer), "last_applied_profile");
-
-    mqtt_publish(buffer, profile, 1, 1);
+    status_publish(HA_TOPIC_LAST_APPLIED_PROFILE, profile);
 }
 
 void status_set_preset_selected(const char *preset) {
-    char buffer[255];
-
-    ha_build_topic(buffer, sizeof(buffer), "preset/selected");
-
-    mqtt_publish(buffer, preset, 1, 1);
+    status_publish(HA_TOPIC_PRESET_SELECTED, preset);
 }
 
 void status_set_custom_directory(const char *directory) {
-    char buffer[255];
-
-    ha_build_topic(buffer, sizeof(buffer), "custom/directory");
-
-    mqtt_publish(buffer, directory, 1, 1);
+    status_publish(HA_TOPIC_CUSTOM_DIRECTORY, directory);
 }
 
 void status_set_last_download(const char *directory, const char *path, const char *timestamp) {
@@ -113,9 +145,7 @@ void status_set_last_download(const char *directory, const char *path, const cha
         return;
     }
 
-    char state_topic[256];
-    ha_build_topic(state_topic, sizeof(state_topic), "last_download/time/state");
-    mqtt_publish(state_topic, timestamp, 1, 1);
+    status_publish(HA_TOPIC_LAST_DOWNLOAD_STATE, timestamp);
 
     cJSON *root = cJSON_CreateObject();
     if (!root) {
@@ -129,9 +159,7 @@ void status_set_last_download(const char *directory, const char *path, const cha
     char *json = cJSON_PrintUnformatted(root);
     
     if (json) {
-        char json_topic[256];
-        ha_build_topic(json_topic, sizeof(json_topic), "last_download/time/attributes");
-        mqtt_publish(json_topic, json, 1, 1);
+        status_publish(HA_TOPIC_LAST_DOWNLOAD_ATTRIBUTES, json);
 
         cJSON_free(json);
     } else {
@@ -141,12 +169,322 @@ void status_set_last_download(const char *directory, const char *path, const cha
     cJSON_Delete(root);
 }
 
-void status_set_availability(bool available) {
+void status_set_fleet_rollout(const char *state, const char *attributes_json) {
+    if (!state) {
+        return;
+    }
+
+    if (attributes_json) {
+        status_publish(HA_TOPIC_FLEET_ROLLOUT_ATTRIBUTES, attributes_json);
+    }
+
+    status_publish(HA_TOPIC_FLEET_ROLLOUT_STATE, state);
+}
+
+void status_set_schedule_switch(const char *latency_ms, const char *attributes_json) {
+    if (!latency_ms || !attributes_json) {
+        return;
+    }
+
+    status_publish(HA_TOPIC_SCHEDULE_SWITCH_ATTRIBUTES, attributes_json);
+    status_publish(HA_TOPIC_SCHEDULE_SWITCH_STATE, latency_ms);
+}
+
+void status_set_asset_cache(int hits, int misses, int evictions) {
+    const char *state = "none";
+
+    if (hits > 0 && misses > 0) {
+        state = "partial";
+    } else if (hits > 0) {
+        state = "hit";
+    } else if (misses > 0) {
+        state = "miss";
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for 'asset_cache/attributes'");
+        return;
+    }
+
+    cJSON_AddNumberToObject(root, "hits", hits);
+    cJSON_AddNumberToObject(root, "misses", misses);
+    cJSON_AddNumberToObject(root, "evictions", evictions);
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json) {
+        status_publish(HA_TOPIC_ASSET_CACHE_ATTRIBUTES, json);
+        cJSON_free(json);
+    } else {
+        LOG_ERROR("Failed to serialize 'asset_cache/attributes' JSON.");
+    }
+
+    cJSON_Delete(root);
+
+    status_publish(HA_TOPIC_ASSET_CACHE_STATE, state);
+}
+
+void status_set_upload_savings(long long sent, long long saved) {
+    char state[32];
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for 'upload_savings/attributes'");
+        return;
+    }
+
+    cJSON_AddNumberToObject(root, "bytes_sent", (double)sent);
+    cJSON_AddNumberToObject(root, "bytes_saved", (double)saved);
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json) {
+        status_publish(HA_TOPIC_UPLOAD_SAVINGS_ATTRIBUTES, json);
+        cJSON_free(json);
+    } else {
+        LOG_ERROR("Failed to serialize 'upload_savings/attributes' JSON.");
+    }
+
+    cJSON_Delete(root);
 
-    char buffer[255];
-    ha_build_topic(buffer, sizeof(buffer), "availability");
+    snprintf(state, sizeof(state), "%lld", saved);
+    status_publish(HA_TOPIC_UPLOAD_SAVINGS_STATE, state);
+}
+
+void status_set_params(const unifi_profile_t *profile) {
+    if (!profile) {
+        return;
+    }
+
+    bool welcome = profile->welcome.enabled && profile->welcome.file[0] != '\0';
+    bool ring = profile->ring_button.enabled && profile->ring_button.file[0] != '\0';
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for 'params'");
+        return;
+    }
 
-    mqtt_publish(buffer, available ? "online" : "fffline", 1, 1);
+    if (ring) {
+        cJSON_AddNumberToObject(root, "volume", profile->ring_button.volume);
+        cJSON_AddNumberToObject(root, "repeat_times", profile->ring_button.repeat_times);
+    } else {
+        cJSON_AddNullToObject(root, "volume");
+        cJSON_AddNullToObject(root, "repeat_times");
+    }
+
+    if (welcome) {
+        cJSON_AddNumberToObject(root, "duration_ms", profile->welcome.duration_ms);
+        cJSON_AddBoolToObject(root, "loop", profile->welcome.loop);
+    } else {
+        cJSON_AddNullToObject(root, "duration_ms");
+        cJSON_AddNullToObject(root, "loop");
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json) {
+        status_publish(HA_TOPIC_PARAMS, json);
+        cJSON_free(json);
+    } else {
+        LOG_ERROR("Failed to serialize 'params' JSON.");
+    }
+
+    cJSON_Delete(root);
+}
+
+void status_set_availability(bool available) {
+    status_publish(HA_TOPIC_AVAILABILITY, available ? "online" : "offline");
 
     return;
-}
\ No newline at end of file
+}
+
+static time_t status_monotonic_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec;
+}
+
+static double status_round2(double value) {
+    return (double)(long long)(value * 100.0 + (value < 0 ? -0.5 : 0.5)) / 100.0;
+}
+
+static void status_add_measure(cJSON *root, const char *name, double value) {
+    if (value < 0) {
+        cJSON_AddNullToObject(root, name);
+    } else {
+        cJSON_AddNumberToObject(root, name, status_round2(value));
+    }
+}
+
+// Called with g_perf_lock held. Serializes the device's sensors and counts them as published; the caller publishes
+// the returned payload (freed with cJSON_free()) after releasing the lock, so no apply waits on the broker.
+static char *status_performance_json(size_t device, long long queue_depth, time_t now) {
+    status_performance_t *p = &g_perf[device];
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for 'performance'");
+        return NULL;
+    }
+
+    status_add_measure(root, "apply_seconds", p->apply_seconds);
+    status_add_measure(root, "throughput_kbps", p->throughput_kbps);
+    status_add_measure(root, "ssh_rtt_ms", p->rtt_ms);
+    cJSON_AddNumberToObject(root, "queue_depth", (double)queue_depth);
+    status_add_measure(root, "apply_success_rate", p->applies ? 100.0 * (double)(p->applies - p->failures) / (double)p->applies : -1);
+    cJSON_AddNumberToObject(root, "applies", (double)p->applies);
+    cJSON_AddNumberToObject(root, "failures", (double)p->failures);
+    cJSON_AddNumberToObject(root, "unchanged", (double)p->unchanged);
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json) {
+        p->dirty = false;
+        p->last_publish = now;
+        p->queue_depth = queue_depth;
+    } else {
+        LOG_ERROR("Failed to serialize 'performance' JSON.");
+    }
+
+    cJSON_Delete(root);
+
+    return json;
+}
+
+static void status_publish_performance(size_t device, char *json) {
+    if (json) {
+        status_publish_to(device, HA_TOPIC_PERFORMANCE, json);
+        cJSON_free(json);
+    }
+}
+
+// Called with g_perf_lock held. New devices report no measures until their first apply.
+static bool status_performance_reserve(size_t count) {
+    if (count <= g_perf_count) {
+        return true;
+    }
+
+    status_performance_t *tmp = realloc(g_perf, count * sizeof(*g_perf));
+
+    if (!tmp) {
+        return false;
+    }
+
+    for (size_t i = g_perf_count; i < count; i++) {
+        memset(&tmp[i], 0, sizeof(tmp[i]));
+        tmp[i].apply_seconds = -1;
+        tmp[i].throughput_kbps = -1;
+        tmp[i].rtt_ms = -1;
+        tmp[i].queue_depth = -1;
+    }
+
+    g_perf = tmp;
+    g_perf_count = count;
+
+    return true;
+}
+
+static bool status_performance_due(const status_performance_t *p, time_t now) {
+    return p->dirty && (p->last_publish == 0 || now - p->last_publish >= STATUS_PERFORMANCE_INTERVAL_S);
+}
+
+void status_record_apply(const status_apply_sample_t *sample) {
+    if (!sample) {
+        return;
+    }
+
+    size_t device = g_status_device;
+
+    pthread_mutex_lock(&g_perf_lock);
+
+    if (!status_performance_reserve(device + 1)) {
+        pthread_mutex_unlock(&g_perf_lock);
+        LOG_ERROR("Out of memory recording apply performance for device %zu", device);
+        return;
+    }
+
+    status_performance_t *p = &g_perf[device];
+
+    p->dirty = true;
+    p->applies++;
+    p->failures += sample->ok ? 0 : 1;
+    p->unchanged += sample->unchanged ? 1 : 0;
+    p->apply_seconds = sample->apply_seconds;
+    p->rtt_ms = sample->rtt_ms;
+
+    // An unchanged or cut-over-only apply sends nothing; the last real transfer still describes the link.
+    if (sample->bytes_sent > 0 && sample->upload_seconds > 0) {
+        p->throughput_kbps = (double)sample->bytes_sent / 1000.0 / sample->upload_seconds;
+    }
+
+    time_t now = status_monotonic_s();
+    char *json = NULL;
+
+    if (status_performance_due(p, now)) {
+        json = status_performance_json(device, (long long)metrics_gauge_value(METRIC_INBOUND_QUEUE_DEPTH), now);
+    }
+
+    pthread_mutex_unlock(&g_perf_lock);
+
+    status_publish_performance(device, json);
+}
+
+void status_flush_performance(void) {
+    pthread_mutex_lock(&g_perf_lock);
+
+    // The queue depth is shared, so every configured doorbell reports it, applied to or not.
+    if (!status_performance_reserve(ha_topics_device_count())) {
+        LOG_ERROR("Out of memory publishing performance for %zu devices", ha_topics_device_count());
+    }
+
+    size_t count = g_perf_count;
+    char **payloads = count ? calloc(count, sizeof(*payloads)) : NULL;
+
+    if (!payloads) {
+        pthread_mutex_unlock(&g_perf_lock);
+        return;
+    }
+
+    long long depth = (long long)metrics_gauge_value(METRIC_INBOUND_QUEUE_DEPTH);
+    time_t now = status_monotonic_s();
+
+    for (size_t i = 0; i < count; i++) {
+        status_performance_t *p = &g_perf[i];
+
+        if (depth != p->queue_depth) {
+            p->dirty = true;
+        }
+
+        if (status_performance_due(p, now)) {
+            payloads[i] = status_performance_json(i, depth, now);
+        }
+    }
+
+    pthread_mutex_unlock(&g_perf_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        status_publish_performance(i, payloads[i]);
+    }
+
+    free(payloads);
+}
+
+void status_mark_performance_dirty(void) {
+    pthread_mutex_lock(&g_perf_lock);
+
+    if (!status_performance_reserve(ha_topics_device_count())) {
+        LOG_ERROR("Out of memory publishing performance for %zu devices", ha_topics_device_count());
+    }
+
+    // Due at once: the broker may never have received the last payloads.
+    for (size_t i = 0; i < g_perf_count; i++) {
+        g_perf[i].dirty = true;
+        g_perf[i].last_publish = 0;
+    }
+
+    pthread_mutex_unlock(&g_perf_lock);
+}
@@ -1,19 +1,161 @@
 #include "ha_topics.h"
+#include "command.h"
+#include "logger.h"
 #include "mqtt.h"
 #include "ha_entities.h"
 #include "mqtt_router.h"
 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+typedef struct {
+    uint32_t offset[HA_TOPIC_COUNT];
+} ha_topic_table_t;
+
+static const char *const g_subtopics[HA_TOPIC_COUNT] = {
+    [HA_TOPIC_NONE] = NULL,
+#define X(id, subtopic, scope) [id] = (subtopic),
+#include "ha_topics.def"
+#undef X
+};
+
+static const ha_topic_scope_t g_scopes[HA_TOPIC_COUNT] = {
+    [HA_TOPIC_NONE] = HA_TOPIC_SCOPE_DEVICE,
+#define X(id, subtopic, scope) [id] = (scope),
+#include "ha_topics.def"
+#undef X
+};
+
 static char g_base_topic[128];
-static char g_availability_topic[256];
-static char g_status_topic[256];
 
-void ha_topics_init(const config_t *cfg) {
+// All topic strings live back to back in one pool; tables only hold offsets into it.
+static char *g_topic_pool = NULL;
+static size_t g_topic_pool_len = 0;
+static size_t g_topic_pool_cap = 0;
+
+static ha_topic_table_t *g_topic_tables = NULL;
+static size_t g_topic_table_count = 0;
+
+static bool topic_pool_intern(const char *topic, uint32_t *out_offset) {
+    size_t len = strlen(topic);
+
+    for (size_t off = 0; off < g_topic_pool_len; off += strlen(g_topic_pool + off) + 1) {
+        if (strcmp(g_topic_pool + off, topic) == 0) {
+            *out_offset = (uint32_t)off;
+            return true;
+        }
+    }
+
+    if (g_topic_pool_len + len + 1 > g_topic_pool_cap) {
+        size_t cap = g_topic_pool_cap ? g_topic_pool_cap * 2 : 1024;
+        while (cap < g_topic_pool_len + len + 1) {
+            cap *= 2;
+        }
+
+        char *tmp = realloc(g_topic_pool, cap);
+        if (!tmp) {
+            LOG_ERROR("Out of memory growing topic pool to %zu bytes", cap);
+            return false;
+        }
+
+        g_topic_pool = tmp;
+        g_topic_pool_cap = cap;
+    }
+
+    memcpy(g_topic_pool + g_topic_pool_len, topic, len + 1);
+    *out_offset = (uint32_t)g_topic_pool_len;
+    g_topic_pool_len += len + 1;
+
+    return true;
+}
+
+static bool topic_table_build(ha_topic_table_t *table, const char *device_base_topic) {
+    char buffer[256];
+
+    for (int id = HA_TOPIC_NONE + 1; id < HA_TOPIC_COUNT; id++) {
+        // Service topics (availability follows the single LWT) are shared, so every table interns the same string.
+        const char *base_topic = (g_scopes[id] == HA_TOPIC_SCOPE_SERVICE) ? g_base_topic : device_base_topic;
+
+        int n = snprintf(buffer, sizeof(buffer), "%s/%s", base_topic, g_subtopics[id]);
+
+        if (n < 0 || (size_t)n >= sizeof(buffer)) {
+            LOG_ERROR("Topic '%s/%s' exceeds maximum length (%zu)", base_topic, g_subtopics[id], sizeof(buffer) - 1);
+            return false;
+        }
+
+        if (!topic_pool_intern(buffer, &table->offset[id])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ha_topics_init(const config_t *cfg) {
+    ha_topics_shutdown();
+
     snprintf(g_base_topic, sizeof(g_base_topic), "%s/doorbell-mqtt/%s", cfg->mqtt_cfg.prefix, cfg->mqtt_cfg.instance);
-    snprintf(g_availability_topic, sizeof(g_availability_topic), "%s/availability", g_base_topic);
-    snprintf(g_status_topic, sizeof(g_status_topic), "%s/status", g_base_topic);
+
+    if (cfg->devices_cfg.count == 0) {
+        LOG_ERROR("No devices configured");
+        return false;
+    }
+
+    g_topic_tables = calloc(cfg->devices_cfg.count, sizeof(*g_topic_tables));
+    if (!g_topic_tables) {
+        LOG_ERROR("Out of memory allocating topic tables (count=%zu)", cfg->devices_cfg.count);
+        return false;
+    }
+
+    g_topic_table_count = cfg->devices_cfg.count;
+
+    for (size_t i = 0; i < cfg->devices_cfg.count; i++) {
+        char device_base_topic[128];
+        int n = snprintf(device_base_topic, sizeof(device_base_topic), "%s/doorbell-mqtt/%s", cfg->mqtt_cfg.prefix, cfg->devices_cfg.items[i].id);
+
+        if (n < 0 || (size_t)n >= sizeof(device_base_topic) || !topic_table_build(&g_topic_tables[i], device_base_topic)) {
+            LOG_ERROR("Failed to build topics for device '%s'", cfg->devices_cfg.items[i].id);
+            ha_topics_shutdown();
+            return false;
+        }
+    }
+
+    LOG_DEBUG("Interned %d topics for %zu device(s) in %zu bytes", HA_TOPIC_COUNT - 1, g_topic_table_count, g_topic_pool_len);
+
+    return true;
+}
+
+void ha_topics_shutdown(void) {
+    free(g_topic_tables);
+    free(g_topic_pool);
+
+    g_topic_tables = NULL;
+    g_topic_table_count = 0;
+    g_topic_pool = NULL;
+    g_topic_pool_len = 0;
+    g_topic_pool_cap = 0;
+}
+
+size_t ha_topics_device_count(void) {
+    return g_topic_table_count;
+}
+
+const char *ha_topic(size_t device, ha_topic_id_t id) {
+    if (id <= HA_TOPIC_NONE || id >= HA_TOPIC_COUNT || device >= g_topic_table_count) {
+        return NULL;
+    }
+
+    return g_topic_pool + g_topic_tables[device].offset[id];
+}
+
+const char *ha_topic_subtopic(ha_topic_id_t id) {
+    if (id <= HA_TOPIC_NONE || id >= HA_TOPIC_COUNT) {
+        return NULL;
+    }
+
+    return g_subtopics[id];
 }
 
 const char *ha_get_base_topic(void) {
@@ -29,38 +171,57 @@ void ha_build_topic(char *out, size_t out_size, const char *subtopic) {
 }
 
 const char *ha_availability_topic(void) {
-    return g_availability_topic;
+    return ha_topic(0, HA_TOPIC_AVAILABILITY);
 }
 
 const char *ha_status_topic(void) {
-    return g_status_topic;
+    return ha_topic(0, HA_TOPIC_STATUS);
+}
+
+// Entities may share a command topic (e.g. the parameter numbers); it is subscribed and routed once.
+static bool entity_command_topic_seen(size_t i) {
+    for (size_t j = 0; j < i; j++) {
+        if (HA_ENTITIES[j].command_topic == HA_ENTITIES[i].command_topic) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void ha_topic_subscribe_commands(void) {
-    for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
-        const entity_t *ent = &HA_ENTITIES[i];
+    for (size_t device = 0; device < g_topic_table_count; device++) {
+        for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
+            const entity_t *ent = &HA_ENTITIES[i];
 
-        if(!ent->command_topic || ent->command_topic[0] == '\0') {
-            continue;
+            if (ent->command_topic == HA_TOPIC_NONE || entity_command_topic_seen(i)) {
+                continue;
+            }
+
+            mqtt_subscribe(ha_topic(device, ent->command_topic));
         }
+    }
 
-        char buffer[256];
-        ha_build_topic(buffer, sizeof(buffer), ent->command_topic);
-        mqtt_subscribe(buffer);
+    if (g_topic_table_count > 0) {
+        mqtt_subscribe(ha_topic(0, HA_TOPIC_CMD_FLEET_APPLY));
     }
 }
 
-void  ha_routes_register_commands(void) {
-    for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
-        const entity_t *ent = &HA_ENTITIES[i];
+void  ha_routes_register_commands(const config_devices_t *devices) {
+    for (size_t device = 0; device < g_topic_table_count && device < devices->count; device++) {
+        for (size_t i = 0; i < HA_ENTITIES_COUNT; i++) {
+            const entity_t *ent = &HA_ENTITIES[i];
 
-        if(!ent->command_topic || ent->command_topic[0] == '\0') {
-            continue;
+            if (ent->command_topic == HA_TOPIC_NONE || entity_command_topic_seen(i)) {
+                continue;
+            }
+
+            mqtt_routes_add(ha_topic(device, ent->command_topic), ent->handle_command, &devices->items[device], ent->route_flags);
         }
+    }
 
-        char buffer[256];
-        ha_build_topic(buffer, sizeof(buffer), ent->command_topic);
-        mqtt_routes_add(buffer, ent->handle_command);
+    // The fleet command is not bound to a device; the handler fans out itself.
+    if (g_topic_table_count > 0) {
+        mqtt_routes_add(ha_topic(0, HA_TOPIC_CMD_FLEET_APPLY), command_fleet_apply, NULL, 0);
     }
 }
-
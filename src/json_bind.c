@@ -0,0 +1,516 @@
+#include "json_bind.h"
+#include "json_scan.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Nested objects deeper than this are rejected; the bound files are two levels deep.
+#define JSON_BIND_MAX_DEPTH 8
+
+typedef struct {
+    const char *start;
+    const char *p;
+    const char *end;
+    json_bind_error_t *err;
+} bind_ctx_t;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} bind_buf_t;
+
+__attribute__((format(printf, 2, 3)))
+static bool bind_fail(bind_ctx_t *ctx, const char *fmt, ...) {
+    if (!ctx->err) {
+        return false;
+    }
+
+    json_bind_error_t *err = ctx->err;
+    va_list ap;
+
+    err->offset = (size_t)(ctx->p - ctx->start);
+    err->line = 1;
+    err->column = 1;
+
+    for (const char *c = ctx->start; c < ctx->p; c++) {
+        if (*c == '\n') {
+            err->line++;
+            err->column = 1;
+        } else {
+            err->column++;
+        }
+    }
+
+    va_start(ap, fmt);
+    vsnprintf(err->message, sizeof(err->message), fmt, ap);
+    va_end(ap);
+
+    return false;
+}
+
+static void bind_skip_ws(bind_ctx_t *ctx) {
+    ctx->p = json_scan_skip_ws(ctx->p, ctx->end);
+}
+
+static bool bind_expect(bind_ctx_t *ctx, char c) {
+    bind_skip_ws(ctx);
+
+    if (ctx->p >= ctx->end || *ctx->p != c) {
+        return bind_fail(ctx, "expected '%c'", c);
+    }
+
+    ctx->p++;
+    return true;
+}
+
+static bool bind_literal(bind_ctx_t *ctx, const char *word) {
+    size_t len = strlen(word);
+
+    if ((size_t)(ctx->end - ctx->p) < len || memcmp(ctx->p, word, len) != 0) {
+        return false;
+    }
+
+    ctx->p += len;
+    return true;
+}
+
+static int bind_hex4(const char *p) {
+    int v = 0;
+
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+
+    return v;
+}
+
+// Decodes a string token into out (NUL-terminated). out may be NULL to only validate and skip it.
+static bool bind_string(bind_ctx_t *ctx, char *out, size_t out_size) {
+    size_t n = 0;
+
+    if (ctx->p >= ctx->end || *ctx->p != '"') {
+        return bind_fail(ctx, "expected a string");
+    }
+
+    ctx->p++;
+
+    while (ctx->p < ctx->end && *ctx->p != '"') {
+        unsigned char c = (unsigned char)*ctx->p;
+        char utf8[4];
+        size_t utf8_len = 1;
+
+        if (c < 0x20) {
+            return bind_fail(ctx, "control character in string");
+        }
+
+        if (c != '\\') {
+            utf8[0] = (char)c;
+            ctx->p++;
+        } else {
+            if (ctx->end - ctx->p < 2) {
+                return bind_fail(ctx, "unterminated escape");
+            }
+
+            char e = ctx->p[1];
+            ctx->p += 2;
+
+            switch (e) {
+                case '"': case '\\': case '/': utf8[0] = e; break;
+                case 'b': utf8[0] = '\b'; break;
+                case 'f': utf8[0] = '\f'; break;
+                case 'n': utf8[0] = '\n'; break;
+                case 'r': utf8[0] = '\r'; break;
+                case 't': utf8[0] = '\t'; break;
+                case 'u': {
+                    int cp = ctx->end - ctx->p >= 4 ? bind_hex4(ctx->p) : -1;
+
+                    if (cp < 0) {
+                        return bind_fail(ctx, "invalid \\u escape");
+                    }
+
+                    ctx->p += 4;
+
+                    if (cp >= 0xd800 && cp <= 0xdbff) {
+                        int lo = ctx->end - ctx->p >= 6 && ctx->p[0] == '\\' && ctx->p[1] == 'u' ? bind_hex4(ctx->p + 2) : -1;
+
+                        if (lo < 0xdc00 || lo > 0xdfff) {
+                            return bind_fail(ctx, "unpaired surrogate");
+                        }
+
+                        ctx->p += 6;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    }
+
+                    if (cp < 0x80) {
+                        utf8[0] = (char)cp;
+                    } else if (cp < 0x800) {
+                        utf8[0] = (char)(0xc0 | (cp >> 6));
+                        utf8[1] = (char)(0x80 | (cp & 0x3f));
+                        utf8_len = 2;
+                    } else if (cp < 0x10000) {
+                        utf8[0] = (char)(0xe0 | (cp >> 12));
+                        utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                        utf8[2] = (char)(0x80 | (cp & 0x3f));
+                        utf8_len = 3;
+                    } else {
+                        utf8[0] = (char)(0xf0 | (cp >> 18));
+                        utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+                        utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                        utf8[3] = (char)(0x80 | (cp & 0x3f));
+                        utf8_len = 4;
+                    }
+                    break;
+                }
+                default:
+                    ctx->p -= 2;
+                    return bind_fail(ctx, "invalid escape '\\%c'", e);
+            }
+        }
+
+        if (out) {
+            if (n + utf8_len >= out_size) {
+                return bind_fail(ctx, "string longer than %zu bytes", out_size - 1);
+            }
+
+            memcpy(out + n, utf8, utf8_len);
+            n += utf8_len;
+        }
+    }
+
+    if (ctx->p >= ctx->end) {
+        return bind_fail(ctx, "unterminated string");
+    }
+
+    ctx->p++;
+
+    if (out) {
+        out[n] = '\0';
+    }
+
+    return true;
+}
+
+static bool bind_number(bind_ctx_t *ctx, double *out) {
+    char token[64];
+    size_t n = 0;
+
+    while (ctx->p + n < ctx->end && n < sizeof(token) - 1 && strchr("+-0123456789.eE", ctx->p[n]) && ctx->p[n] != '\0') {
+        token[n] = ctx->p[n];
+        n++;
+    }
+
+    token[n] = '\0';
+
+    char *token_end = NULL;
+    double v = n > 0 ? strtod(token, &token_end) : 0;
+
+    if (n == 0 || token_end != token + n) {
+        return bind_fail(ctx, "expected a number");
+    }
+
+    ctx->p += n;
+    *out = v;
+
+    return true;
+}
+
+static bool bind_object(bind_ctx_t *ctx, const json_bind_field_t *fields, size_t count, char *base, int depth);
+
+static bool bind_value(bind_ctx_t *ctx, const json_bind_field_t *field, char *base, int depth) {
+    void *dst = base + field->offset;
+    double number = 0;
+
+    bind_skip_ws(ctx);
+
+    // null keeps the default.
+    if (bind_literal(ctx, "null")) {
+        return true;
+    }
+
+    switch (field->kind) {
+        case JSON_BIND_BOOL:
+            if (bind_literal(ctx, "true")) {
+                *(bool *)dst = true;
+            } else if (bind_literal(ctx, "false")) {
+                *(bool *)dst = false;
+            } else {
+                return bind_fail(ctx, "'%s' must be true or false", field->key);
+            }
+            return true;
+
+        case JSON_BIND_INT:
+            if (ctx->p >= ctx->end || !bind_number(ctx, &number)) {
+                return bind_fail(ctx, "'%s' must be a number", field->key);
+            }
+
+            if (number < (double)INT32_MIN || number > (double)INT32_MAX) {
+                return bind_fail(ctx, "'%s' is out of range", field->key);
+            }
+
+            *(int *)dst = (int)number;
+            return true;
+
+        case JSON_BIND_TIME:
+            if (ctx->p >= ctx->end || !bind_number(ctx, &number)) {
+                return bind_fail(ctx, "'%s' must be a number", field->key);
+            }
+
+            *(time_t *)dst = (time_t)number;
+            return true;
+
+        case JSON_BIND_STRING:
+            if (ctx->p >= ctx->end || *ctx->p != '"') {
+                return bind_fail(ctx, "'%s' must be a string", field->key);
+            }
+
+            return bind_string(ctx, dst, field->size);
+
+        case JSON_BIND_OBJECT:
+            return bind_object(ctx, field->fields, field->field_count, dst, depth + 1);
+    }
+
+    return false;
+}
+
+static bool bind_object(bind_ctx_t *ctx, const json_bind_field_t *fields, size_t count, char *base, int depth) {
+    if (depth > JSON_BIND_MAX_DEPTH) {
+        return bind_fail(ctx, "objects nested too deeply");
+    }
+
+    if (!bind_expect(ctx, '{')) {
+        return false;
+    }
+
+    bind_skip_ws(ctx);
+
+    if (ctx->p < ctx->end && *ctx->p == '}') {
+        ctx->p++;
+        return true;
+    }
+
+    for (;;) {
+        char key[64];
+        const char *key_start = NULL;
+
+        bind_skip_ws(ctx);
+        key_start = ctx->p;
+
+        // Keys longer than any bound key cannot match; they are skipped like unknown members.
+        if (!bind_string(ctx, NULL, 0)) {
+            return false;
+        }
+
+        size_t key_len = (size_t)(ctx->p - key_start) - 2;
+        const json_bind_field_t *field = NULL;
+
+        if (key_len < sizeof(key)) {
+            memcpy(key, key_start + 1, key_len);
+            key[key_len] = '\0';
+
+            for (size_t i = 0; i < count; i++) {
+                if (strcmp(fields[i].key, key) == 0) {
+                    field = &fields[i];
+                    break;
+                }
+            }
+        }
+
+        if (!bind_expect(ctx, ':')) {
+            return false;
+        }
+
+        if (field) {
+            if (!bind_value(ctx, field, base, depth)) {
+                return false;
+            }
+        } else {
+            bind_skip_ws(ctx);
+
+            const char *value_end = json_scan_skip_value(ctx->p, ctx->end);
+            if (!value_end) {
+                return bind_fail(ctx, "malformed value");
+            }
+
+            ctx->p = value_end;
+        }
+
+        bind_skip_ws(ctx);
+
+        if (ctx->p < ctx->end && *ctx->p == ',') {
+            ctx->p++;
+            continue;
+        }
+
+        return bind_expect(ctx, '}');
+    }
+}
+
+void json_bind_defaults(const json_bind_field_t *fields, size_t count, void *out) {
+    char *base = out;
+
+    for (size_t i = 0; i < count; i++) {
+        void *dst = base + fields[i].offset;
+
+        switch (fields[i].kind) {
+            case JSON_BIND_INT:    *(int *)dst = (int)fields[i].default_value; break;
+            case JSON_BIND_BOOL:   *(bool *)dst = fields[i].default_value != 0; break;
+            case JSON_BIND_TIME:   *(time_t *)dst = (time_t)fields[i].default_value; break;
+            case JSON_BIND_STRING: memset(dst, 0, fields[i].size); break;
+            case JSON_BIND_OBJECT: json_bind_defaults(fields[i].fields, fields[i].field_count, dst); break;
+        }
+    }
+}
+
+bool json_bind_parse(const json_bind_field_t *fields, size_t count, const char *json, size_t len, void *out, json_bind_error_t *err) {
+    if (!fields || !json || !out) {
+        return false;
+    }
+
+    bind_ctx_t ctx = { .start = json, .p = json, .end = json + len, .err = err };
+
+    if (err) {
+        memset(err, 0, sizeof(*err));
+    }
+
+    json_bind_defaults(fields, count, out);
+
+    if (!bind_object(&ctx, fields, count, out, 0)) {
+        return false;
+    }
+
+    bind_skip_ws(&ctx);
+
+    if (ctx.p != ctx.end) {
+        return bind_fail(&ctx, "unexpected data after the object");
+    }
+
+    return true;
+}
+
+static void buf_append(bind_buf_t *b, const char *data, size_t len) {
+    if (b->failed) {
+        return;
+    }
+
+    if (b->len + len + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 256;
+
+        while (cap < b->len + len + 1) {
+            cap *= 2;
+        }
+
+        char *grown = realloc(b->data, cap);
+        if (!grown) {
+            b->failed = true;
+            return;
+        }
+
+        b->data = grown;
+        b->cap = cap;
+    }
+
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+}
+
+__attribute__((format(printf, 2, 3)))
+static void buf_printf(bind_buf_t *b, const char *fmt, ...) {
+    char tmp[64];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        b->failed = true;
+        return;
+    }
+
+    buf_append(b, tmp, (size_t)n);
+}
+
+static void buf_indent(bind_buf_t *b, int depth) {
+    for (int i = 0; i < depth; i++) {
+        buf_append(b, "\t", 1);
+    }
+}
+
+static void buf_string(bind_buf_t *b, const char *s) {
+    buf_append(b, "\"", 1);
+
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            char esc[2] = { '\\', (char)*p };
+            buf_append(b, esc, 2);
+        } else if (*p < 0x20) {
+            buf_printf(b, "\\u%04x", *p);
+        } else {
+            buf_append(b, (const char *)p, 1);
+        }
+    }
+
+    buf_append(b, "\"", 1);
+}
+
+static void write_object(bind_buf_t *b, const json_bind_field_t *fields, size_t count, const char *base, int depth) {
+    buf_append(b, "{\n", 2);
+
+    for (size_t i = 0; i < count; i++) {
+        const void *src = base + fields[i].offset;
+
+        buf_indent(b, depth + 1);
+        buf_string(b, fields[i].key);
+        buf_append(b, ":\t", 2);
+
+        switch (fields[i].kind) {
+            case JSON_BIND_INT:    buf_printf(b, "%d", *(const int *)src); break;
+            case JSON_BIND_BOOL:   buf_printf(b, "%s", *(const bool *)src ? "true" : "false"); break;
+            case JSON_BIND_TIME:   buf_printf(b, "%lld", (long long)*(const time_t *)src); break;
+            case JSON_BIND_STRING: buf_string(b, src); break;
+            case JSON_BIND_OBJECT: write_object(b, fields[i].fields, fields[i].field_count, src, depth + 1); break;
+        }
+
+        buf_append(b, i + 1 < count ? ",\n" : "\n", i + 1 < count ? 2 : 1);
+    }
+
+    buf_indent(b, depth);
+    buf_append(b, "}", 1);
+}
+
+bool json_bind_write(const json_bind_field_t *fields, size_t count, const void *in, char **out, size_t *out_len) {
+    if (!fields || !in || !out) {
+        return false;
+    }
+
+    bind_buf_t b = {0};
+
+    write_object(&b, fields, count, in, 0);
+    buf_append(&b, "\n", 1);
+
+    if (b.failed) {
+        free(b.data);
+        return false;
+    }
+
+    *out = b.data;
+
+    if (out_len) {
+        *out_len = b.len;
+    }
+
+    return true;
+}
@@ -0,0 +1,189 @@
+#include "json_scan.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Containers nested deeper than this are rejected; device confs are three or four levels deep.
+#define JSON_SCAN_MAX_DEPTH 64
+
+static bool json_scan_is_ws(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+const char *json_scan_skip_ws(const char *p, const char *end) {
+    while (p < end && json_scan_is_ws(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+static const char *json_scan_skip_string(const char *p, const char *end) {
+    const char *start = p + 1;
+
+    for (p = start; p < end; p++) {
+        p = memchr(p, '"', (size_t)(end - p));
+        if (!p) {
+            return NULL;
+        }
+
+        // The quote is escaped when an odd number of backslashes precede it.
+        size_t slashes = 0;
+        while (p - slashes > start && p[-1 - (ptrdiff_t)slashes] == '\\') {
+            slashes++;
+        }
+
+        if (slashes % 2 == 0) {
+            return p + 1;
+        }
+    }
+
+    return NULL;
+}
+
+const char *json_scan_skip_value(const char *p, const char *end) {
+    if (!p || p >= end) {
+        return NULL;
+    }
+
+    if (*p == '"') {
+        return json_scan_skip_string(p, end);
+    }
+
+    if (*p != '{' && *p != '[') {
+        const char *start = p;
+
+        while (p < end && !json_scan_is_ws(*p) && *p != ',' && *p != '}' && *p != ']' && *p != ':') {
+            p++;
+        }
+
+        return p > start ? p : NULL;
+    }
+
+    char stack[JSON_SCAN_MAX_DEPTH];
+    int depth = 0;
+
+    while (p < end) {
+        char c = *p;
+
+        if (c == '"') {
+            p = json_scan_skip_string(p, end);
+            if (!p) {
+                return NULL;
+            }
+            continue;
+        }
+
+        if (c == '{' || c == '[') {
+            if (depth == JSON_SCAN_MAX_DEPTH) {
+                return NULL;
+            }
+            stack[depth++] = c == '{' ? '}' : ']';
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || stack[depth - 1] != c) {
+                return NULL;
+            }
+
+            if (--depth == 0) {
+                return p + 1;
+            }
+        }
+
+        p++;
+    }
+
+    return NULL;
+}
+
+bool json_scan_find_member(const char *obj, const char *end, const char *key, const char **value, const char **value_end) {
+    if (!obj || obj >= end || *obj != '{' || !key) {
+        return false;
+    }
+
+    size_t key_len = strlen(key);
+    const char *p = json_scan_skip_ws(obj + 1, end);
+
+    if (p < end && *p == '}') {
+        return false;
+    }
+
+    while (p < end && *p == '"') {
+        const char *name = p + 1;
+        const char *name_end = json_scan_skip_string(p, end);
+
+        if (!name_end) {
+            return false;
+        }
+
+        p = json_scan_skip_ws(name_end, end);
+        if (p >= end || *p != ':') {
+            return false;
+        }
+
+        const char *v = json_scan_skip_ws(p + 1, end);
+        const char *v_end = json_scan_skip_value(v, end);
+
+        if (!v_end) {
+            return false;
+        }
+
+        if ((size_t)(name_end - 1 - name) == key_len && memcmp(name, key, key_len) == 0) {
+            *value = v;
+            *value_end = v_end;
+            return true;
+        }
+
+        p = json_scan_skip_ws(v_end, end);
+        if (p >= end || *p != ',') {
+            return false;
+        }
+
+        p = json_scan_skip_ws(p + 1, end);
+    }
+
+    return false;
+}
+
+bool json_scan_string_equals(const char *value, const char *value_end, const char *s) {
+    size_t len = strlen(s);
+
+    return value && value_end - value == (ptrdiff_t)len + 2 && *value == '"' && memcmp(value + 1, s, len) == 0;
+}
+
+bool json_scan_quote(char *out, size_t out_size, const char *s) {
+    size_t n = 0;
+
+    if (!out || out_size < 3 || !s) {
+        return false;
+    }
+
+    out[n++] = '"';
+
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        char esc[7];
+        size_t esc_len;
+
+        if (*p == '"' || *p == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)*p;
+            esc_len = 2;
+        } else if (*p < 0x20) {
+            esc_len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", *p);
+        } else {
+            esc[0] = (char)*p;
+            esc_len = 1;
+        }
+
+        if (n + esc_len + 2 > out_size) {
+            return false;
+        }
+
+        memcpy(out + n, esc, esc_len);
+        n += esc_len;
+    }
+
+    out[n++] = '"';
+    out[n] = '\0';
+
+    return true;
+}
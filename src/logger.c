@@ -1,12 +1,56 @@
 #include "logger.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <time.h>
 
+#define LOG_RING_SLOTS 128      // power of two
+#define LOG_MSG_MAX 2048        // longer messages are truncated
+#define LOG_LINE_MAX (LOG_MSG_MAX * 6 + 512)   // room for a message escaped entirely as \u00XX
+
+// One queued line. seq implements a bounded MPSC ring (Vyukov): a slot is free for the producer
+// claiming position pos when seq == pos, and ready for the writer when seq == pos + 1.
+typedef struct {
+    atomic_size_t seq;
+    log_level_t level;
+    int line;
+    const char *file;
+    const char *func;
+    time_t ts;
+    char msg[LOG_MSG_MAX];
+} log_slot_t;
+
+// strftime output for one second, reused by every line stamped in that second.
+typedef struct {
+    time_t sec;
+    char text[20];
+    char iso[32];
+} log_time_cache_t;
+
 static log_level_t g_min_level = LOG_LEVEL_INFO;
+static log_format_t g_format = LOG_FORMAT_TEXT;
+static log_overflow_t g_overflow = LOG_OVERFLOW_DROP;
+static FILE *g_stream = NULL;
+
+static log_slot_t g_ring[LOG_RING_SLOTS];
+static atomic_size_t g_enqueue_pos;
+static size_t g_dequeue_pos;            // writer thread only
+static atomic_bool g_async;
+static atomic_bool g_stop;
+static atomic_bool g_writer_idle;
+static atomic_ulong g_dropped;
+static sem_t g_wakeup;
+static pthread_t g_writer;
+
+static _Thread_local log_time_cache_t t_time_cache = { .sec = -1 };
 
 static const char *level_to_string(log_level_t level) {
     switch (level) {
@@ -19,7 +63,234 @@ static const char *level_to_string(log_level_t level) {
     }
 }
 
+static const char *level_to_json(log_level_t level) {
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return "debug";
+        case LOG_LEVEL_INFO: return "info";
+        case LOG_LEVEL_WARN: return "warn";
+        case LOG_LEVEL_ERROR: return "error";
+        case LOG_LEVEL_FATAL: return "fatal";
+        default: return "unknown";
+    }
+}
+
+static FILE *log_stream(void) {
+    return g_stream ? g_stream : stderr;
+}
+
+static const log_time_cache_t *log_time(time_t ts) {
+    log_time_cache_t *cache = &t_time_cache;
+
+    if (cache->sec != ts) {
+        struct tm tm_info;
+        localtime_r(&ts, &tm_info);
+
+        strftime(cache->text, sizeof(cache->text), "%Y-%m-%d %H:%M:%S", &tm_info);
+        strftime(cache->iso, sizeof(cache->iso), "%Y-%m-%dT%H:%M:%S%z", &tm_info);
+        cache->sec = ts;
+    }
+
+    return cache;
+}
+
+static size_t append_json_string(char *out, size_t n, size_t size, const char *s) {
+    if (n < size) out[n] = '"';
+    n++;
+
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        char esc[8];
+        size_t len = 1;
+
+        esc[0] = (char)*p;
+
+        if (*p == '"' || *p == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)*p;
+            len = 2;
+        } else if (*p == '\n') {
+            memcpy(esc, "\\n", 2);
+            len = 2;
+        } else if (*p < 0x20) {
+            len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", *p);
+        }
+
+        if (n + len < size) {
+            memcpy(out + n, esc, len);
+        }
+        n += len;
+    }
+
+    if (n < size) out[n] = '"';
+    return n + 1;
+}
+
+// Formats one complete line, newline included. Returns its length, clamped to the buffer.
+static size_t log_format_line(char *out, size_t size, log_level_t level, time_t ts, const char *file, int line, const char *func, const char *msg) {
+    const log_time_cache_t *t = log_time(ts);
+    size_t n = 0;
+    int w = 0;
+
+    if (g_format == LOG_FORMAT_JSON) {
+        w = snprintf(out, size, "{\"ts\":\"%s\",\"level\":\"%s\",\"file\":\"%s\",\"line\":%d,\"func\":\"%s\",\"msg\":",
+                     t->iso, level_to_json(level), file, line, func);
+        n = w > 0 ? (size_t)w : 0;
+        n = append_json_string(out, n, size, msg);
+
+        if (n + 2 < size) {
+            out[n++] = '}';
+        }
+    } else {
+        switch (level) {
+        case LOG_LEVEL_DEBUG:
+        case LOG_LEVEL_FATAL:
+            w = snprintf(out, size, "%s [%s] %s:%d %s: %s", t->text, level_to_string(level), file, line, func, msg);
+            break;
+        case LOG_LEVEL_WARN:
+        case LOG_LEVEL_ERROR:
+            w = snprintf(out, size, "%s [%s] %s: %s", t->text, level_to_string(level), func, msg);
+            break;
+        case LOG_LEVEL_INFO:
+        default:
+            w = snprintf(out, size, "%s [%s] %s", t->text, level_to_string(level), msg);
+            break;
+        }
+
+        n = w > 0 ? (size_t)w : 0;
+    }
+
+    if (n > size - 2) {
+        n = size - 2;
+    }
+
+    out[n++] = '\n';
+    out[n] = '\0';
+
+    return n;
+}
+
+static void log_write_now(log_level_t level, time_t ts, const char *file, int line, const char *func, const char *msg, bool flush) {
+    char buffer[LOG_LINE_MAX];
+    size_t len = log_format_line(buffer, sizeof(buffer), level, ts, file, line, func, msg);
+    FILE *stream = log_stream();
+
+    fwrite(buffer, 1, len, stream);
+
+    if (flush) {
+        fflush(stream);
+    }
+}
+
+static log_slot_t *ring_claim(void) {
+    size_t pos = atomic_load_explicit(&g_enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        log_slot_t *slot = &g_ring[pos & (LOG_RING_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&g_enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static void ring_publish(log_slot_t *slot) {
+    size_t pos = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    if (atomic_exchange_explicit(&g_writer_idle, false, memory_order_acq_rel)) {
+        sem_post(&g_wakeup);
+    }
+}
+
+// Single consumer: the writer thread, or log_shutdown once the writer has exited.
+static bool ring_drain_one(void) {
+    log_slot_t *slot = &g_ring[g_dequeue_pos & (LOG_RING_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+    if (seq != g_dequeue_pos + 1) {
+        return false;
+    }
+
+    log_write_now(slot->level, slot->ts, slot->file, slot->line, slot->func, slot->msg, false);
+
+    atomic_store_explicit(&slot->seq, g_dequeue_pos + LOG_RING_SLOTS, memory_order_release);
+    g_dequeue_pos++;
+
+    return true;
+}
+
+static void log_report_dropped(unsigned long *reported) {
+    unsigned long dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+
+    if (dropped != *reported) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Log queue full; %lu line(s) dropped", dropped - *reported);
+        log_write_now(LOG_LEVEL_WARN, time(NULL), __FILE__, __LINE__, __func__, msg, false);
+        *reported = dropped;
+    }
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    unsigned long reported = atomic_load(&g_dropped);
+
+    for (;;) {
+        bool wrote = false;
+
+        while (ring_drain_one()) {
+            wrote = true;
+        }
+
+        log_report_dropped(&reported);
+
+        // Flush once per batch rather than once per line.
+        if (wrote) {
+            fflush(log_stream());
+            continue;
+        }
+
+        if (atomic_load(&g_stop)) {
+            break;
+        }
+
+        atomic_store(&g_writer_idle, true);
+
+        // Re-check after announcing idleness so a line published in between is not left waiting.
+        if (ring_drain_one()) {
+            atomic_store(&g_writer_idle, false);
+            fflush(log_stream());
+            continue;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 200 * 1000 * 1000;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        sem_timedwait(&g_wakeup, &deadline);
+        atomic_store(&g_writer_idle, false);
+    }
+
+    return NULL;
+}
+
 void log_init(const char *log_level) {
+    const char *format = getenv("LOG_FORMAT");
+    const char *overflow = getenv("LOG_OVERFLOW");
+
+    g_format = format && strcasecmp(format, "json") == 0 ? LOG_FORMAT_JSON : LOG_FORMAT_TEXT;
+    g_overflow = overflow && strcasecmp(overflow, "block") == 0 ? LOG_OVERFLOW_BLOCK : LOG_OVERFLOW_DROP;
+
     if (!log_level) {
         log_level = getenv("LOG_LEVEL");
     }
@@ -48,41 +319,111 @@ void log_set_level(log_level_t level) {
     g_min_level = level;
 }
 
+void log_set_format(log_format_t format) {
+    g_format = format;
+}
+
+void log_set_overflow(log_overflow_t overflow) {
+    g_overflow = overflow;
+}
+
+void log_set_stream(FILE *stream) {
+    g_stream = stream;
+}
+
+bool log_start_async(void) {
+    if (atomic_load(&g_async)) {
+        return true;
+    }
+
+    for (size_t i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_store_explicit(&g_ring[i].seq, i, memory_order_relaxed);
+    }
+
+    atomic_store(&g_enqueue_pos, 0);
+    g_dequeue_pos = 0;
+    atomic_store(&g_stop, false);
+    atomic_store(&g_writer_idle, false);
+
+    if (sem_init(&g_wakeup, 0, 0) != 0) {
+        return false;
+    }
+
+    if (pthread_create(&g_writer, NULL, log_writer, NULL) != 0) {
+        sem_destroy(&g_wakeup);
+        return false;
+    }
+
+    atomic_store(&g_async, true);
+
+    return true;
+}
+
+void log_shutdown(void) {
+    if (!atomic_exchange(&g_async, false)) {
+        return;
+    }
+
+    atomic_store(&g_stop, true);
+    sem_post(&g_wakeup);
+    pthread_join(g_writer, NULL);
+
+    // Lines published while the writer was exiting.
+    while (ring_drain_one()) {
+    }
+
+    fflush(log_stream());
+    sem_destroy(&g_wakeup);
+}
+
+unsigned long log_dropped(void) {
+    return atomic_load(&g_dropped);
+}
+
 void log_log_impl(log_level_t level, const char *file, int line, const char *func, const char *fmt, ...) {
     if (level < g_min_level) {
         return;
     }
 
-    time_t now = time(NULL);
-    struct tm tm_info;
-    localtime_r(&now, &tm_info);
+    va_list args;
 
-    char time_buffer[20];
-    strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &tm_info);
+    if (atomic_load_explicit(&g_async, memory_order_acquire)) {
+        log_slot_t *slot = ring_claim();
 
-    switch (level) {
-    case LOG_LEVEL_DEBUG:
-    case LOG_LEVEL_FATAL:
-        fprintf(stderr, "%s [%s] %s:%d %s: ", time_buffer, level_to_string(level), file, line, func);
-        break;
-    case LOG_LEVEL_INFO:
-        fprintf(stderr, "%s [%s] ", time_buffer, level_to_string(level));
-        break;
-    case LOG_LEVEL_WARN:
-    case LOG_LEVEL_ERROR:
-        fprintf(stderr, "%s [%s] %s: ", time_buffer, level_to_string(level), func);
-        break;
-    default:
-        fprintf(stderr, "%s [%s] ", time_buffer, level_to_string(level));
-        break;
+        while (!slot && g_overflow == LOG_OVERFLOW_BLOCK && atomic_load(&g_async)) {
+            if (atomic_exchange(&g_writer_idle, false)) {
+                sem_post(&g_wakeup);
+            }
+            sched_yield();
+            slot = ring_claim();
+        }
+
+        if (slot) {
+            slot->level = level;
+            slot->file = file;
+            slot->line = line;
+            slot->func = func;
+            slot->ts = time(NULL);
+
+            va_start(args, fmt);
+            vsnprintf(slot->msg, sizeof(slot->msg), fmt, args);
+            va_end(args);
+
+            ring_publish(slot);
+            return;
+        }
+
+        if (g_overflow == LOG_OVERFLOW_DROP) {
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return;
+        }
     }
 
-    va_list args;
+    char msg[LOG_MSG_MAX];
+
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    vsnprintf(msg, sizeof(msg), fmt, args);
     va_end(args);
 
-    fputc('\n', stderr);
-    fflush(stderr);
-
-}
\ No newline at end of file
+    log_write_now(level, time(NULL), file, line, func, msg, true);
+}
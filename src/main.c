@@ -1,19 +1,35 @@
 
+#include "arena.h"
 #include "banner.h"
 #include "config.h"
 #include "config_types.h"
+#include "deadline.h"
+#include "device_lock.h"
+#include "errors.h"
 #include "ha_mqtt.h"
+#include "ha_status.h"
 #include "logger.h"
+#include "metrics.h"
 #include "mqtt.h"
 #include "mqtt_router.h"
 #include "ha_topics.h"
 #include "mqtt_router_types.h"
+#include "profile_check.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "unifi_profile_bundle.h"
 #include "unifi_profiles_repo.h"
+#include "unifi_remote.h"
 #include "utils.h"
+#include "watcher.h"
 
+#include <linux/limits.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #define DEFAULT_CONFIG_PATH   "/config/config.json"
 #define DEFAULT_PROFILES_DIR  "/profiles"
@@ -24,24 +40,94 @@ static void handle_signal(int sig) {
     running = 0;
 }
 
-int main(void) {
+// --pack <profile_dir> [<out>]: writes the directory as a single bundle, by default <profile_dir>/profile.dbp.
+static int run_pack(int argc, char **argv) {
+    char out_path[PATH_MAX];
+
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: %s --pack <profile_dir> [<out.dbp>]\n", argv[0]);
+        return 2;
+    }
+
+    if (argc == 4) {
+        snprintf(out_path, sizeof(out_path), "%s", argv[3]);
+    } else if (!utils_build_path(out_path, sizeof(out_path), argv[2], UNIFI_BUNDLE_FILE)) {
+        LOG_FATAL("Bundle path for '%s' is too long", argv[2]);
+        return 1;
+    }
+
+    return unifi_bundle_pack_dir(argv[2], out_path) ? 0 : 1;
+}
+
+static const char *env_or_default(const char *name, const char *fallback) {
+    const char *value = getenv(name);
+    return value ? value : fallback;
+}
+
+static int check_thread_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (cpus > PROFILE_CHECK_MAX_THREADS ? PROFILE_CHECK_MAX_THREADS : (int)cpus);
+}
+
+// --check: validates the whole profile library offline and prints one line per profile.
+static int run_check(void) {
+    const char *config_path = env_or_default("CONFIG_PATH", DEFAULT_CONFIG_PATH);
+    const char *profiles_dir = env_or_default("PROFILES_DIR", DEFAULT_PROFILES_DIR);
+    config_t cfg = {0};
+    profile_check_report_t report;
+
+    if (!config_load(config_path, &cfg)) {
+        LOG_FATAL("Configuration load failed.");
+        config_free(&cfg);
+        return 1;
+    }
+
+    bool ok = profile_check_library(profiles_dir, &cfg.preset_cfg, check_thread_count(), &report);
+
+    for (size_t i = 0; i < report.count; i++) {
+        const profile_check_result_t *r = &report.items[i];
+
+        if (r->error == ERROR_NONE) {
+            printf("OK    %s\n", r->directory);
+        } else {
+            printf("FAIL  %s: %s (%s)\n", r->directory, r->message, error_code_name((error_code_t)r->error));
+        }
+    }
+
+    printf("%zu profile(s), %zu invalid\n", report.count, report.failed);
+
+    profile_check_report_free(&report);
+    config_free(&cfg);
+
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
     signal(SIGINT,  handle_signal);
     signal(SIGTERM, handle_signal);
+    // A cancel shuts down the device socket under a running transfer; report that as an error, not a signal.
+    signal(SIGPIPE, SIG_IGN);
 
     log_init(NULL);
+    arena_install_cjson_hooks();
 
-    print_banner();
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+        return run_pack(argc, argv);
+    }
 
-    const char *config_path = getenv("CONFIG_PATH");
-    if (!config_path) {
-        config_path = DEFAULT_CONFIG_PATH;
+    if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+        return run_check();
     }
 
-    const char *profiles_dir = getenv("PROFILES_DIR");
-    if (!profiles_dir) {
-        profiles_dir = DEFAULT_PROFILES_DIR;
+    print_banner();
+
+    if (!log_start_async()) {
+        LOG_WARN("Failed to start the log writer; logging synchronously.");
     }
 
+    const char *config_path = env_or_default("CONFIG_PATH", DEFAULT_CONFIG_PATH);
+    const char *profiles_dir = env_or_default("PROFILES_DIR", DEFAULT_PROFILES_DIR);
+
     if (!utils_delete_directory("/tmp/doorbell-mqtt-unifi")) {
         LOG_WARN("Did not clean '/tmp/doorbell-mqtt-unifi'");
     }
@@ -57,13 +143,43 @@ int main(void) {
         goto cleanup;
     }
 
+    // Before profiles_repo_init: preset plans are prepared there and pick up the optimized assets.
+    char optimize_dir[PATH_MAX];
+
+    if (utils_build_path(optimize_dir, sizeof(optimize_dir), profiles_dir, ".state/optimized")) {
+        unifi_remote_set_optimize(&cfg.optimize_cfg, optimize_dir);
+    }
+
+    char state_dir[PATH_MAX];
+
+    if (!utils_build_path(state_dir, sizeof(state_dir), profiles_dir, ".state") || !trace_start(&cfg.trace_cfg, state_dir)) {
+        LOG_WARN("Tracing failed to start; spans are not recorded.");
+    }
+
     if(!profiles_repo_init(profiles_dir, &cfg.preset_cfg)) {
         LOG_FATAL("Profiles initialization failed. Exiting.");
         rc = 1;
         goto cleanup;
     }
 
-    ha_topics_init(&cfg);
+    // Not fatal: invalid profiles are reported now instead of on their first apply.
+    profile_check_report_t check_report;
+
+    if (!profile_check_library(profiles_dir, &cfg.preset_cfg, check_thread_count(), &check_report)) {
+        for (size_t i = 0; i < check_report.count; i++) {
+            if (check_report.items[i].error != ERROR_NONE) {
+                LOG_WARN("Profile '%s' is invalid: %s", check_report.items[i].directory, check_report.items[i].message);
+            }
+        }
+    }
+
+    profile_check_report_free(&check_report);
+
+    if (!ha_topics_init(&cfg)) {
+        LOG_FATAL("Home Assistant topic initialization failed. Exiting.");
+        rc = 1;
+        goto cleanup;
+    }
 
     if (!ha_mqtt_bind(&cfg)) {
         LOG_FATAL("Home Assistant MQTT bind failed. Exiting.");
@@ -79,8 +195,25 @@ int main(void) {
 
     mqtt_initialized = true;
 
+    if (!deadline_init(cfg.devices_cfg.count)) {
+        LOG_FATAL("Command deadline initialization failed. Exiting.");
+        rc = 1;
+        goto cleanup;
+    }
+
+    if (!device_lock_init(cfg.devices_cfg.count)) {
+        LOG_FATAL("Device lock initialization failed. Exiting.");
+        rc = 1;
+        goto cleanup;
+    }
+
+    unifi_remote_set_cache(&cfg.cache_cfg);
+    profiles_repo_set_downloads_budget(&cfg.downloads_cfg);
+
     mqtt_router_ctx_t inbound_ctx;
-    inbound_ctx.ssh_cfg = &cfg.ssh_cfg;
+    inbound_ctx.device = NULL;
+    inbound_ctx.devices_cfg = &cfg.devices_cfg;
+    inbound_ctx.fleet_cfg = &cfg.fleet_cfg;
     inbound_ctx.preset_cfg = &cfg.preset_cfg;
 
     if (!mqtt_router_start(&inbound_ctx)) {
@@ -91,15 +224,33 @@ int main(void) {
 
     mqtt_router_started = true;
 
-    ha_routes_register_commands();
+    ha_routes_register_commands(&cfg.devices_cfg);
+
+    if (!scheduler_start(&cfg)) {
+        LOG_ERROR("Scheduler failed to start; scheduled switches are disabled.");
+    }
+
+    if (!watcher_start(config_path, profiles_dir, &cfg)) {
+        LOG_WARN("Watcher failed to start; configuration and profile changes need a restart.");
+    }
+
+    if (!metrics_http_start(&cfg.metrics_cfg)) {
+        LOG_WARN("Metrics endpoint failed to start; metrics are not exported.");
+    }
 
     while (running) {
         mqtt_loop(100);
+        status_flush_performance();
     }
 
     LOG_INFO("Shutdown requested, stopping service...");
 
 cleanup:
+    metrics_http_stop();
+    trace_stop();
+    watcher_stop();
+    scheduler_stop();
+
     if (mqtt_router_started) {
         mqtt_router_stop();
     }
@@ -108,10 +259,15 @@ cleanup:
         mqtt_disconnect();
     }
 
+    ha_topics_shutdown();
+    deadline_shutdown();
+    device_lock_shutdown();
+
     profiles_repo_shutdown();
     config_free(&cfg);
     
     LOG_INFO("Service stopped cleanly.");
-    
+    log_shutdown();
+
     return rc;
 }
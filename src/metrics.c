@@ -0,0 +1,537 @@
+#include "metrics.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define METRICS_SHARDS 16
+#define METRICS_CACHE_LINE 64
+#define METRICS_POLL_MS 500
+#define METRICS_REQUEST_MAX 2048
+
+typedef enum {
+    METRIC_KIND_COUNTER,
+    METRIC_KIND_GAUGE,
+    METRIC_KIND_HISTOGRAM,
+} metric_kind_t;
+
+typedef struct {
+    metric_kind_t kind;
+    const char *name;
+    const char *help;
+} metric_info_t;
+
+static const metric_info_t g_metrics[METRIC_COUNT] = {
+#define X(kind, id, name, help) [id] = { METRIC_KIND_##kind, (name), (help) },
+#include "metrics.def"
+#undef X
+};
+
+// Upper bounds in seconds; SSH connects take milliseconds, full applies take tens of seconds.
+static const double g_buckets[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120 };
+#define METRICS_BUCKETS (sizeof(g_buckets) / sizeof(g_buckets[0]))
+
+typedef struct {
+    int code;
+    const char *name;
+} metrics_error_label_t;
+
+static const metrics_error_label_t g_error_labels[] = {
+#define X(code, name, default_msg) { (code), #name },
+#include "errors.def"
+#undef X
+};
+#define METRICS_ERRORS (sizeof(g_error_labels) / sizeof(g_error_labels[0]))
+
+static const char *const g_topic_labels[HA_TOPIC_COUNT] = {
+    [HA_TOPIC_NONE] = "other",
+#define X(id, subtopic, scope) [id] = (subtopic),
+#include "ha_topics.def"
+#undef X
+};
+
+typedef struct {
+    atomic_uint_least64_t buckets[METRICS_BUCKETS];     // per bucket, cumulated when rendered
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t sum_us;
+} metrics_histogram_t;
+
+// One shard per group of threads; a thread only ever writes its own, so increments stay on a local cache line.
+typedef struct {
+    alignas(METRICS_CACHE_LINE) atomic_uint_least64_t counters[METRIC_COUNT];
+    metrics_histogram_t histograms[METRIC_COUNT];
+    atomic_uint_least64_t errors[METRICS_ERRORS];
+    atomic_uint_least64_t publishes[HA_TOPIC_COUNT];
+} metrics_shard_t;
+
+static metrics_shard_t g_shards[METRICS_SHARDS];
+static atomic_int_least64_t g_gauges[METRIC_COUNT];
+
+static atomic_uint g_next_shard;
+static _Thread_local metrics_shard_t *t_shard;
+
+static metrics_shard_t *metrics_shard(void) {
+    if (!t_shard) {
+        t_shard = &g_shards[atomic_fetch_add_explicit(&g_next_shard, 1, memory_order_relaxed) % METRICS_SHARDS];
+    }
+
+    return t_shard;
+}
+
+static void metrics_bump(atomic_uint_least64_t *slot, uint64_t n) {
+    atomic_fetch_add_explicit(slot, n, memory_order_relaxed);
+}
+
+void metrics_add(metric_id_t id, uint64_t n) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_COUNTER) {
+        return;
+    }
+
+    metrics_bump(&metrics_shard()->counters[id], n);
+}
+
+void metrics_inc(metric_id_t id) {
+    metrics_add(id, 1);
+}
+
+void metrics_gauge_set(metric_id_t id, int64_t value) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_GAUGE) {
+        return;
+    }
+
+    atomic_store_explicit(&g_gauges[id], value, memory_order_relaxed);
+}
+
+void metrics_gauge_add(metric_id_t id, int64_t delta) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_GAUGE) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&g_gauges[id], delta, memory_order_relaxed);
+}
+
+int64_t metrics_gauge_value(metric_id_t id) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_GAUGE) {
+        return 0;
+    }
+
+    return atomic_load_explicit(&g_gauges[id], memory_order_relaxed);
+}
+
+void metrics_observe_seconds(metric_id_t id, double seconds) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_HISTOGRAM) {
+        return;
+    }
+
+    if (seconds < 0) {
+        seconds = 0;
+    }
+
+    metrics_histogram_t *h = &metrics_shard()->histograms[id];
+    size_t i = 0;
+
+    while (i < METRICS_BUCKETS && seconds > g_buckets[i]) {
+        i++;
+    }
+
+    // Observations above the last bound only show up in +Inf, which is the count.
+    if (i < METRICS_BUCKETS) {
+        metrics_bump(&h->buckets[i], 1);
+    }
+
+    metrics_bump(&h->count, 1);
+    metrics_bump(&h->sum_us, (uint64_t)(seconds * 1e6 + 0.5));
+}
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void metrics_observe_since(metric_id_t id, uint64_t start_us) {
+    uint64_t now = metrics_now_us();
+
+    metrics_observe_seconds(id, now > start_us ? (double)(now - start_us) / 1e6 : 0.0);
+}
+
+void metrics_count_error(error_code_t code) {
+    if (code == ERROR_NONE) {
+        return;
+    }
+
+    for (size_t i = 0; i < METRICS_ERRORS; i++) {
+        if (g_error_labels[i].code == (int)code) {
+            metrics_bump(&metrics_shard()->errors[i], 1);
+            return;
+        }
+    }
+}
+
+void metrics_count_publish(ha_topic_id_t topic) {
+    if ((unsigned)topic >= HA_TOPIC_COUNT) {
+        topic = HA_TOPIC_NONE;
+    }
+
+    metrics_bump(&metrics_shard()->publishes[topic], 1);
+}
+
+static uint64_t metrics_sum(const atomic_uint_least64_t *first, size_t stride) {
+    uint64_t total = 0;
+    const unsigned char *p = (const unsigned char *)first;
+
+    for (size_t s = 0; s < METRICS_SHARDS; s++, p += stride) {
+        total += atomic_load_explicit((const atomic_uint_least64_t *)p, memory_order_relaxed);
+    }
+
+    return total;
+}
+
+#define METRICS_SUM(field) metrics_sum(&g_shards[0].field, sizeof(metrics_shard_t))
+
+uint64_t metrics_counter_value(metric_id_t id) {
+    if ((unsigned)id >= METRIC_COUNT || g_metrics[id].kind != METRIC_KIND_COUNTER) {
+        return 0;
+    }
+
+    return METRICS_SUM(counters[id]);
+}
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} metrics_buf_t;
+
+static void buf_printf(metrics_buf_t *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void buf_printf(metrics_buf_t *b, const char *fmt, ...) {
+    if (b->failed) {
+        return;
+    }
+
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+
+        if (n < 0) {
+            b->failed = true;
+            return;
+        }
+
+        if ((size_t)n < b->cap - b->len) {
+            b->len += (size_t)n;
+            return;
+        }
+
+        size_t cap = b->cap * 2;
+        while (cap - b->len <= (size_t)n) {
+            cap *= 2;
+        }
+
+        char *tmp = realloc(b->data, cap);
+        if (!tmp) {
+            b->failed = true;
+            return;
+        }
+
+        b->data = tmp;
+        b->cap = cap;
+    }
+}
+
+static void render_header(metrics_buf_t *b, const char *name, const char *help, const char *type) {
+    buf_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void render_histogram(metrics_buf_t *b, metric_id_t id) {
+    const char *name = g_metrics[id].name;
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += METRICS_SUM(histograms[id].buckets[i]);
+        buf_printf(b, "%s_bucket{le=\"%g\"} %llu\n", name, g_buckets[i], (unsigned long long)cumulative);
+    }
+
+    uint64_t count = METRICS_SUM(histograms[id].count);
+
+    buf_printf(b, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+    buf_printf(b, "%s_sum %.6f\n", name, (double)METRICS_SUM(histograms[id].sum_us) / 1e6);
+    buf_printf(b, "%s_count %llu\n", name, (unsigned long long)count);
+}
+
+char *metrics_render(size_t *len) {
+    metrics_buf_t b = { .cap = 8192 };
+
+    b.data = malloc(b.cap);
+    if (!b.data) {
+        return NULL;
+    }
+
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        const metric_info_t *m = &g_metrics[id];
+
+        switch (m->kind) {
+        case METRIC_KIND_COUNTER:
+            render_header(&b, m->name, m->help, "counter");
+            buf_printf(&b, "%s %llu\n", m->name, (unsigned long long)METRICS_SUM(counters[id]));
+            break;
+        case METRIC_KIND_GAUGE:
+            render_header(&b, m->name, m->help, "gauge");
+            buf_printf(&b, "%s %lld\n", m->name, (long long)atomic_load_explicit(&g_gauges[id], memory_order_relaxed));
+            break;
+        case METRIC_KIND_HISTOGRAM:
+            render_header(&b, m->name, m->help, "histogram");
+            render_histogram(&b, (metric_id_t)id);
+            break;
+        }
+    }
+
+    render_header(&b, "doorbell_errors_total", "Errors reported to Home Assistant by error code", "counter");
+    for (size_t i = 0; i < METRICS_ERRORS; i++) {
+        if (g_error_labels[i].code == ERROR_NONE) {
+            continue;
+        }
+
+        buf_printf(&b, "doorbell_errors_total{code=\"%d\",name=\"%s\"} %llu\n",
+                   g_error_labels[i].code, g_error_labels[i].name, (unsigned long long)METRICS_SUM(errors[i]));
+    }
+
+    render_header(&b, "doorbell_status_publishes_total", "Status messages published by topic", "counter");
+    for (int t = 0; t < HA_TOPIC_COUNT; t++) {
+        buf_printf(&b, "doorbell_status_publishes_total{topic=\"%s\"} %llu\n",
+                   g_topic_labels[t], (unsigned long long)METRICS_SUM(publishes[t]));
+    }
+
+    if (b.failed) {
+        free(b.data);
+        return NULL;
+    }
+
+    if (len) {
+        *len = b.len;
+    }
+
+    return b.data;
+}
+
+static struct {
+    int fd;
+    pthread_t thread;
+    atomic_bool running;
+} g_http = { .fd = -1 };
+
+static int metrics_http_listen(const config_metrics_t *cfg) {
+    struct addrinfo hints = {0};
+    struct addrinfo *res = NULL;
+    char port[16];
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    snprintf(port, sizeof(port), "%d", cfg->port);
+
+    int rc = getaddrinfo(cfg->address[0] ? cfg->address : NULL, port, &hints, &res);
+    if (rc != 0) {
+        LOG_ERROR("Cannot resolve metrics address '%s': %s", cfg->address, gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+
+    for (struct addrinfo *p = res; p; p = p->ai_next) {
+        fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, p->ai_addr, p->ai_addrlen) == 0 && listen(fd, 8) == 0) {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        LOG_ERROR("Cannot listen for metrics on %s:%d: %s", cfg->address, cfg->port, strerror(errno));
+    }
+
+    return fd;
+}
+
+static void http_send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return;
+        }
+
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void http_respond(int fd, const char *status, const char *content_type, const char *body, size_t body_len) {
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                     status, content_type, body_len);
+
+    if (n > 0 && (size_t)n < sizeof(header)) {
+        http_send_all(fd, header, (size_t)n);
+        http_send_all(fd, body, body_len);
+    }
+}
+
+static void metrics_http_serve(int fd) {
+    char request[METRICS_REQUEST_MAX];
+    size_t len = 0;
+
+    // A scraper that stalls mid-request must not hold up the next one for long.
+    struct timeval timeout = { .tv_sec = 2 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return;
+        }
+
+        len += (size_t)n;
+        request[len] = '\0';
+
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+
+    request[len] = '\0';
+
+    bool is_get = strncmp(request, "GET ", 4) == 0;
+    const char *path = request + 4;
+    size_t path_len = is_get ? strcspn(path, " ?\r\n") : 0;
+
+    if (!is_get) {
+        static const char body[] = "Method Not Allowed\n";
+        http_respond(fd, "405 Method Not Allowed", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+
+    if (path_len != strlen("/metrics") || strncmp(path, "/metrics", path_len) != 0) {
+        static const char body[] = "Not Found\n";
+        http_respond(fd, "404 Not Found", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+
+    size_t body_len = 0;
+    char *body = metrics_render(&body_len);
+
+    if (!body) {
+        static const char error[] = "Out of memory\n";
+        http_respond(fd, "500 Internal Server Error", "text/plain", error, sizeof(error) - 1);
+        return;
+    }
+
+    http_respond(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body, body_len);
+    free(body);
+}
+
+static void *metrics_http_thread(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&g_http.running)) {
+        struct pollfd pfd = { .fd = g_http.fd, .events = POLLIN };
+        int rc = poll(&pfd, 1, METRICS_POLL_MS);
+
+        if (rc <= 0) {
+            continue;
+        }
+
+        int client = accept(g_http.fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        metrics_http_serve(client);
+        close(client);
+    }
+
+    return NULL;
+}
+
+bool metrics_http_start(const config_metrics_t *cfg) {
+    if (!cfg || cfg->port <= 0) {
+        LOG_DEBUG("Metrics endpoint disabled");
+        return true;
+    }
+
+    if (atomic_load(&g_http.running)) {
+        return true;
+    }
+
+    g_http.fd = metrics_http_listen(cfg);
+    if (g_http.fd < 0) {
+        return false;
+    }
+
+    atomic_store(&g_http.running, true);
+
+    if (pthread_create(&g_http.thread, NULL, metrics_http_thread, NULL) != 0) {
+        LOG_ERROR("Failed to start metrics thread");
+        atomic_store(&g_http.running, false);
+        close(g_http.fd);
+        g_http.fd = -1;
+        return false;
+    }
+
+    LOG_INFO("Serving metrics on http://%s:%d/metrics", cfg->address, cfg->port);
+
+    return true;
+}
+
+void metrics_http_stop(void) {
+    if (!atomic_load(&g_http.running)) {
+        return;
+    }
+
+    atomic_store(&g_http.running, false);
+    pthread_join(g_http.thread, NULL);
+
+    close(g_http.fd);
+    g_http.fd = -1;
+}
@@ -1,7 +1,9 @@
 #include "mqtt.h"
 #include "config_types.h"
 #include "logger.h"
+#include "metrics.h"
 #include "mqtt_router.h"
+#include "trace.h"
 
 #include <MQTTClient.h>
 
@@ -32,6 +34,7 @@ static void conn_lost(void *context, char *cause) {
     (void)context;
     
     connected = false;
+    metrics_inc(METRIC_MQTT_CONNECTION_LOST);
 
     LOG_WARN("Connection lost: %s", cause ? cause : "(unknown)");
 }
@@ -44,7 +47,10 @@ static int msg_arrived(void *context, char *topicName, int topicLen, MQTTClient_
            got_len, topicName,
            message->payloadlen, (char*)message->payload);
 
+    uint64_t span = trace_begin();
+
     mqtt_router_enqueue(topicName, got_len, message->payload, (size_t)message->payloadlen);
+    trace_end(span, "mqtt", "receive", topicName, message->payloadlen);
 
     MQTTClient_freeMessage(&message);
     MQTTClient_free(topicName);
@@ -104,6 +110,10 @@ static int mqtt_connect_internal(bool reconnect) {
 
     connected = true;
 
+    if (reconnect) {
+        metrics_inc(METRIC_MQTT_RECONNECTS);
+    }
+
     if (g_on_connect) {
         g_on_connect(reconnect, g_cb_user);
     }
@@ -177,11 +187,18 @@ void mqtt_publish(const char *topic, const char *payload, int qos, int retained)
 
     LOG_DEBUG("Publishing %s", payload);
 
+    uint64_t span = trace_begin();
     int rc = MQTTClient_publishMessage(client, topic, &pubmsg, &token);
+
+    trace_end(span, "mqtt", "publish", topic, pubmsg.payloadlen);
+
     if (rc != MQTTCLIENT_SUCCESS) {
+        metrics_inc(METRIC_MQTT_PUBLISH_FAILURES);
         LOG_ERROR("Publish rc=%d topic=%s", rc, topic);
         return;
     }
+
+    metrics_inc(METRIC_MQTT_PUBLISHES);
     
     char buffer[60];
 
@@ -1,7 +1,11 @@
 #include "mqtt_router.h"
 #include "mqtt_router_types.h"
+#include "arena.h"
+#include "deadline.h"
+#include "device_lock.h"
 #include "logger.h"
-
+#include "metrics.h"
+#include "trace.h"
 
 #include <pthread.h>
 #include <stdbool.h>
@@ -10,13 +14,26 @@
 #include <string.h>
 
 #define IN_Q_CAP 64
-#define MAX_ROUTES 16
+
+struct Route {
+    char topic[256];
+    mqtt_handler_fn fn;
+    const config_device_t *device;
+    unsigned flags;
+};
+
+static struct Route *routes = NULL;
+static size_t route_count = 0;
+static size_t route_cap = 0;
 
 struct InMsg {
     char *topic;
     int topic_len;
     char *payload;
     size_t payload_len;
+    uint64_t trace_us;  // enqueue time for the queue-wait span, 0 when tracing is off
+    const struct Route *route;  // NULL for an unknown topic
+    unsigned generation;        // cancel generation of the route's device when the message arrived
 };
 
 static struct {
@@ -33,6 +50,32 @@ static struct {
     .running = 0
 };
 
+static const struct Route *mqtt_routes_find(const char *topic, int topicLen) {
+    size_t len = topicLen > 0 ? (size_t)topicLen : strlen(topic);
+
+    for (size_t i = 0; i < route_count; i++) {
+        if (strncmp(topic, routes[i].topic, len) == 0 && routes[i].topic[len] == '\0') {
+            return &routes[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Runs on the MQTT thread as the message arrives, so it reaches a command the worker is still busy with.
+static unsigned inq_route_generation(const struct Route *route) {
+    if (!route || !route->device) {
+        return 0;
+    }
+
+    if (route->flags & MQTT_ROUTE_SUPERSEDES) {
+        LOG_DEBUG("'%s' cancels the running and queued commands of device '%s'", route->topic, route->device->id);
+        return deadline_cancel(route->device->index);
+    }
+
+    return deadline_generation(route->device->index);
+}
+
 static bool inq_push_locked(const char *topic, int topicLen, const void *payload, size_t payloadLen) {
     size_t next = (inq.tail + 1) % IN_Q_CAP;
     if (next == inq.head) return false; // queue is full
@@ -48,8 +91,11 @@ static bool inq_push_locked(const char *topic, int topicLen, const void *payload
     memcpy(pcopy, payload, payloadLen);
     pcopy[payloadLen] = '\0';
 
-    inq.buf[inq.tail] = (struct InMsg){ tcopy, tlen, pcopy, payloadLen };
+    const struct Route *route = mqtt_routes_find(tcopy, tlen);
+
+    inq.buf[inq.tail] = (struct InMsg){ tcopy, tlen, pcopy, payloadLen, trace_begin(), route, inq_route_generation(route) };
     inq.tail = next;
+    metrics_gauge_add(METRIC_INBOUND_QUEUE_DEPTH, 1);
     pthread_cond_signal(&inq.cv);
 
     return true;
@@ -64,7 +110,12 @@ int mqtt_router_enqueue(const char *topic, int topicLen, const char *payload, si
 
     pthread_mutex_unlock(&inq.mtx);
 
+    if (ok == 0) {
+        metrics_inc(METRIC_INBOUND_MESSAGES);
+    }
+
     if (ok != 0) {
+        metrics_inc(METRIC_INBOUND_DROPPED);
         LOG_WARN("Inbound queue is full, dropping message on '%.*s'", (topicLen > 0) ? topicLen : (int)strlen(topic), topic);
     }
 
@@ -85,6 +136,7 @@ static bool inq_pop(struct InMsg *out) {
 
     *out = inq.buf[inq.head];
     inq.head = (inq.head + 1) % IN_Q_CAP;
+    metrics_gauge_add(METRIC_INBOUND_QUEUE_DEPTH, -1);
     pthread_mutex_unlock(&inq.mtx);
     return true;
 }
@@ -94,34 +146,54 @@ static void inq_free(struct InMsg *m) {
     free(m->payload);
 }
 
-struct Route {
-    char topic[256];
-    mqtt_handler_fn fn;
-};
+int mqtt_routes_add(const char *topic, mqtt_handler_fn fn, const config_device_t *device, unsigned flags) {
+    if (!topic || !fn) return -1;
 
-static struct Route routes[MAX_ROUTES];
-static size_t route_count = 0;
+    if (route_count == route_cap) {
+        size_t cap = route_cap ? route_cap * 2 : 16;
+        struct Route *tmp = realloc(routes, cap * sizeof(*routes));
+        if (!tmp) return -1;
 
-int mqtt_routes_add(const char *topic, mqtt_handler_fn fn) {
-    if (route_count >= MAX_ROUTES) return -1;
+        routes = tmp;
+        route_cap = cap;
+    }
 
     struct Route *r = &routes[route_count++];
 
     strncpy(r->topic, topic, sizeof(r->topic) - 1);
     r->topic[sizeof(r->topic) - 1] = '\0';
     r->fn = fn;
+    r->device = device;
+    r->flags = flags;
     return 0;
 }
 
-static void mqtt_routes_dispatch(const mqtt_router_ctx_t *ctx, const char *topic, const char *payload, size_t len) {
-    for (size_t i = 0; i < route_count; i++) {
-        if (strcmp(topic, routes[i].topic) == 0) {
-            routes[i].fn(ctx, payload, len);
-            return;
-        }
+static void mqtt_routes_dispatch(const mqtt_router_ctx_t *ctx, const struct InMsg *m) {
+    const struct Route *route = m->route;
+
+    if (!route) {
+        LOG_WARN("Unknown topic: '%s'", m->topic);
+        return;
+    }
+
+    size_t device = route->device ? route->device->index : DEADLINE_NO_DEVICE;
+
+    if (deadline_generation(device) != m->generation) {
+        LOG_INFO("Skipping '%s': superseded or cancelled while queued", m->topic);
+        return;
     }
 
-    LOG_WARN("Unknown topic: '%.s'", topic);
+    mqtt_router_ctx_t route_ctx = *ctx;
+    route_ctx.device = route->device;
+
+    deadline_op_t op;
+
+    // Scheduled work may hold the device; the deadline starts once the command has it to itself.
+    device_lock(device);
+    deadline_begin(&op, device, m->generation, route->device ? route->device->ssh_cfg.command_timeout_s : 0);
+    route->fn(&route_ctx, m->payload, m->payload_len);
+    deadline_end(&op);
+    device_unlock(device);
 }
 
 static void *in_worker(void *arg) {
@@ -132,15 +204,36 @@ static void *in_worker(void *arg) {
         return NULL;
     } 
 
+    // Each command allocates from this arena and it is reset once the handler returns.
+    arena_t *arena = arena_create(0);
+
+    if (!arena) {
+        LOG_WARN("in_worker: no command arena; handlers allocate from the heap");
+    }
+
+    arena_t *previous = arena_enter(arena);
     struct InMsg m;
 
     while (inq_pop(&m)) {
         LOG_DEBUG("%s: %.*s", m.topic, (int)m.payload_len, m.payload);
 
-        mqtt_routes_dispatch(ctx, m.topic, m.payload, m.payload_len);
+        trace_end(m.trace_us, "router", "queue_wait", m.topic, 0);
+
+        uint64_t span = trace_begin();
+
+        mqtt_routes_dispatch(ctx, &m);
+
+        trace_end(span, "router", "dispatch", m.topic, (long long)m.payload_len);
+        trace_flush();
+
+        LOG_DEBUG("Command on '%s' used %zu arena bytes", m.topic, arena_used(arena));
+        arena_reset(arena);
         inq_free(&m);
     }
 
+    arena_leave(previous);
+    arena_destroy(arena);
+
     return NULL;
 }
 
@@ -173,6 +266,12 @@ void mqtt_router_stop(void) {
     while (inq.head != inq.tail) {
         struct InMsg m = inq.buf[inq.head];
         inq.head = (inq.head + 1) % IN_Q_CAP;
+        metrics_gauge_add(METRIC_INBOUND_QUEUE_DEPTH, -1);
         inq_free(&m);
     }
+
+    free(routes);
+    routes = NULL;
+    route_count = 0;
+    route_cap = 0;
 }
@@ -0,0 +1,553 @@
+#include "profile_check.h"
+#include "arena.h"
+#include "cJSON.h"
+#include "errors.h"
+#include "logger.h"
+#include "md5.h"
+#include "unifi_profile.h"
+#include "unifi_profile_bundle.h"
+#include "unifi_profile_json.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define CHECK_HEAD_SIZE 32
+#define CHECK_CACHE_FILE ".state/profile_check.json"
+
+// A profile opened for checking: JSON bytes plus, for bundles, the mapping its assets live in.
+typedef struct {
+    char dir[PATH_MAX];
+    unifi_bundle_t bundle;
+    char *json;             // owned when loaded from profile.json
+    size_t json_len;
+    const char *json_view;
+    unifi_profile_t profile;
+} check_profile_t;
+
+typedef struct {
+    bool present;
+    unsigned char head[CHECK_HEAD_SIZE];
+    size_t head_len;
+} check_asset_t;
+
+typedef struct {
+    const char *profiles_dir;
+    const cJSON *cache;     // read-only while workers run
+    profile_check_report_t *report;
+    pthread_mutex_t lock;
+    size_t next;
+} check_pool_t;
+
+static long long check_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static uint32_t be32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+bool profile_check_png_frames(const unsigned char *head, size_t len, int *frames) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    if (!head || !frames || len < 24 || memcmp(head, signature, 8) != 0 || memcmp(head + 12, "IHDR", 4) != 0) {
+        return false;
+    }
+
+    uint32_t width = be32(head + 16);
+    uint32_t height = be32(head + 20);
+
+    if (width == 0 || height == 0 || width % PROFILE_CHECK_SPRITE_PX != 0 || height % PROFILE_CHECK_SPRITE_PX != 0) {
+        return false;
+    }
+
+    *frames = (int)((width / PROFILE_CHECK_SPRITE_PX) * (height / PROFILE_CHECK_SPRITE_PX));
+    return true;
+}
+
+bool profile_check_sound_header(const unsigned char *head, size_t len) {
+    if (!head) {
+        return false;
+    }
+
+    if (len >= 4 && memcmp(head, "OggS", 4) == 0) {
+        return true;
+    }
+
+    return len >= 12 && memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "WAVE", 4) == 0;
+}
+
+static int check_fail(char *message, size_t message_len, int error, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, message_len, fmt, args);
+    va_end(args);
+
+    return error;
+}
+
+static void check_profile_close(check_profile_t *p) {
+    unifi_bundle_close(&p->bundle);
+    arena_free(p->json);
+    p->json = NULL;
+}
+
+static int check_profile_open(const char *profile_dir, check_profile_t *p, char *message, size_t message_len) {
+    char path[PATH_MAX];
+
+    memset(p, 0, sizeof(*p));
+    snprintf(p->dir, sizeof(p->dir), "%s", profile_dir);
+
+    if (!utils_directory_exists(profile_dir)) {
+        return check_fail(message, message_len, ERROR_PROFILE_NOT_FOUND, "directory not found");
+    }
+
+    if (utils_build_path(path, sizeof(path), profile_dir, UNIFI_BUNDLE_FILE) && utils_file_exists(path)) {
+        if (!unifi_bundle_open(path, &p->bundle)) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "%s is not a valid bundle", UNIFI_BUNDLE_FILE);
+        }
+
+        p->json_view = p->bundle.json;
+        p->json_len = p->bundle.json_len;
+    } else {
+        if (!utils_build_path(path, sizeof(path), profile_dir, "profile.json") || !utils_file_exists(path)) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "profile.json is missing");
+        }
+
+        if (!utils_read_file(path, &p->json, &p->json_len)) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "profile.json could not be read");
+        }
+
+        p->json_view = p->json;
+    }
+
+    if (!unifi_profile_load_from_json(p->json_view, p->json_len, path, &p->profile)) {
+        return check_fail(message, message_len, ERROR_PROFILE_INVALID, "profile JSON could not be parsed");
+    }
+
+    return ERROR_NONE;
+}
+
+// Hashes what the result depends on: the profile JSON and, per referenced asset, its embedded digest
+// (bundles) or size and modification time (loose files). Asset contents are not read.
+static void check_profile_digest(const check_profile_t *p, char out_hex[33]) {
+    const char *files[2] = { p->profile.welcome.file, p->profile.ring_button.file };
+    MD5_CTX ctx;
+    uint8_t digest[16];
+
+    md5_init(&ctx);
+    md5_update(&ctx, (const BYTE *)p->json_view, p->json_len);
+
+    for (size_t i = 0; i < 2; i++) {
+        char line[PATH_MAX + 64];
+        int n;
+
+        if (p->bundle.map) {
+            const unifi_bundle_asset_t *asset = unifi_bundle_find(&p->bundle, files[i]);
+            n = snprintf(line, sizeof(line), "\n%s:%s", files[i], asset ? asset->md5_hex : "-");
+        } else {
+            char path[PATH_MAX];
+            struct stat st;
+
+            if (files[i][0] != '\0' && utils_build_path(path, sizeof(path), p->dir, files[i]) && stat(path, &st) == 0) {
+                n = snprintf(line, sizeof(line), "\n%s:%lld:%lld.%09ld", files[i], (long long)st.st_size, (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+            } else {
+                n = snprintf(line, sizeof(line), "\n%s:-", files[i]);
+            }
+        }
+
+        if (n > 0) {
+            md5_update(&ctx, (const BYTE *)line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+        }
+    }
+
+    md5_final(&ctx, digest);
+
+    for (size_t i = 0; i < sizeof(digest); i++) {
+        snprintf(out_hex + i * 2, 3, "%02x", digest[i]);
+    }
+}
+
+static void check_read_asset(const check_profile_t *p, const char *file, check_asset_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    if (file[0] == '\0') {
+        return;
+    }
+
+    if (p->bundle.map) {
+        const unifi_bundle_asset_t *asset = unifi_bundle_find(&p->bundle, file);
+
+        if (asset) {
+            out->present = true;
+            out->head_len = asset->size < CHECK_HEAD_SIZE ? asset->size : CHECK_HEAD_SIZE;
+            memcpy(out->head, asset->data, out->head_len);
+        }
+
+        return;
+    }
+
+    char path[PATH_MAX];
+
+    if (!utils_build_path(path, sizeof(path), p->dir, file)) {
+        return;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return;
+    }
+
+    out->present = true;
+    out->head_len = fread(out->head, 1, sizeof(out->head), fp);
+    fclose(fp);
+}
+
+static int check_profile_assets(const check_profile_t *p, char *message, size_t message_len) {
+    const unifi_profile_t *profile = &p->profile;
+    check_asset_t asset;
+
+    if (profile->schema_version != PROFILE_CHECK_SCHEMA_VERSION) {
+        return check_fail(message, message_len, ERROR_PROFILE_INVALID, "unsupported schemaVersion %d", profile->schema_version);
+    }
+
+    if (profile->welcome.enabled) {
+        int frames = 0;
+
+        check_read_asset(p, profile->welcome.file, &asset);
+
+        if (!asset.present) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "welcome.file '%s' is missing", profile->welcome.file);
+        }
+
+        if (!profile_check_png_frames(asset.head, asset.head_len, &frames)) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "welcome.file '%s' is not a PNG of %dx%d frames", profile->welcome.file, PROFILE_CHECK_SPRITE_PX, PROFILE_CHECK_SPRITE_PX);
+        }
+
+        if (profile->welcome.count != frames) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "welcome.count is %d but '%s' holds %d frames", profile->welcome.count, profile->welcome.file, frames);
+        }
+
+        if (profile->welcome.duration_ms <= 0) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "welcome.durationMs must be positive");
+        }
+    }
+
+    if (profile->ring_button.enabled) {
+        check_read_asset(p, profile->ring_button.file, &asset);
+
+        if (!asset.present) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "ringButton.file '%s' is missing", profile->ring_button.file);
+        }
+
+        if (!profile_check_sound_header(asset.head, asset.head_len)) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "ringButton.file '%s' is not an Ogg or WAV file", profile->ring_button.file);
+        }
+
+        if (profile->ring_button.volume < 1 || profile->ring_button.volume > 100) {
+            return check_fail(message, message_len, ERROR_PROFILE_INVALID, "ringButton.volume %d is outside 1-100", profile->ring_button.volume);
+        }
+    }
+
+    return ERROR_NONE;
+}
+
+int profile_check_dir(const char *profile_dir, char *message, size_t message_len) {
+    check_profile_t p;
+
+    if (!profile_dir || !message || message_len == 0) {
+        return ERROR_PROFILE_INVALID;
+    }
+
+    message[0] = '\0';
+
+    int rc = check_profile_open(profile_dir, &p, message, message_len);
+
+    if (rc == ERROR_NONE) {
+        rc = check_profile_assets(&p, message, message_len);
+    }
+
+    check_profile_close(&p);
+
+    return rc;
+}
+
+static void check_one(const char *profiles_dir, const cJSON *cache, profile_check_result_t *result) {
+    char profile_dir[PATH_MAX];
+    check_profile_t p;
+
+    if (!utils_build_path(profile_dir, sizeof(profile_dir), profiles_dir, result->directory)) {
+        result->error = check_fail(result->message, sizeof(result->message), ERROR_PROFILE_NOT_FOUND, "path too long");
+        return;
+    }
+
+    result->error = check_profile_open(profile_dir, &p, result->message, sizeof(result->message));
+
+    if (result->error == ERROR_NONE) {
+        check_profile_digest(&p, result->digest);
+
+        const cJSON *hit = cJSON_GetObjectItemCaseSensitive(cache, result->digest);
+        const cJSON *code = cJSON_GetObjectItemCaseSensitive(hit, "error");
+        const cJSON *message = cJSON_GetObjectItemCaseSensitive(hit, "message");
+
+        if (cJSON_IsNumber(code) && cJSON_IsString(message)) {
+            result->error = code->valueint;
+            snprintf(result->message, sizeof(result->message), "%s", message->valuestring);
+            result->cached = true;
+        } else {
+            result->error = check_profile_assets(&p, result->message, sizeof(result->message));
+        }
+    }
+
+    check_profile_close(&p);
+}
+
+static void *check_worker(void *arg) {
+    check_pool_t *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->report->count) {
+            break;
+        }
+
+        // Each slot is owned by exactly one worker, so results need no locking.
+        check_one(pool->profiles_dir, pool->cache, &pool->report->items[i]);
+    }
+
+    return NULL;
+}
+
+static bool check_add_directory(profile_check_report_t *report, size_t *capacity, const char *directory) {
+    for (size_t i = 0; i < report->count; i++) {
+        if (strcmp(report->items[i].directory, directory) == 0) {
+            return true;
+        }
+    }
+
+    if (report->count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 16;
+        profile_check_result_t *items = realloc(report->items, grown * sizeof(*items));
+
+        if (!items) {
+            LOG_ERROR("Out of memory growing profile check list (count=%zu)", report->count);
+            return false;
+        }
+
+        report->items = items;
+        *capacity = grown;
+    }
+
+    profile_check_result_t *item = &report->items[report->count++];
+    memset(item, 0, sizeof(*item));
+    snprintf(item->directory, sizeof(item->directory), "%s", directory);
+
+    return true;
+}
+
+// Every subdirectory holding a profile, skipping the service's own work areas, plus every configured preset.
+static bool check_collect(const char *profiles_dir, const config_preset_t *presets, profile_check_report_t *report) {
+    size_t capacity = 0;
+    bool ok = true;
+
+    DIR *d = opendir(profiles_dir);
+    if (!d) {
+        LOG_ERROR("Failed to open profiles directory '%s': %s", profiles_dir, strerror(errno));
+        return false;
+    }
+
+    struct dirent *entry;
+    char path[PATH_MAX];
+    char marker[PATH_MAX];
+
+    while (ok && (entry = readdir(d)) != NULL) {
+        const char *name = entry->d_name;
+
+        if (name[0] == '.' || strcmp(name, "tmp") == 0 || strcmp(name, "downloads") == 0 || strcmp(name, "partial") == 0) {
+            continue;
+        }
+
+        if (!utils_build_path(path, sizeof(path), profiles_dir, name) || !utils_directory_exists(path)) {
+            continue;
+        }
+
+        bool has_profile = (utils_build_path(marker, sizeof(marker), path, "profile.json") && utils_file_exists(marker)) ||
+                           (utils_build_path(marker, sizeof(marker), path, UNIFI_BUNDLE_FILE) && utils_file_exists(marker));
+
+        if (has_profile) {
+            ok = check_add_directory(report, &capacity, name);
+        }
+    }
+
+    closedir(d);
+
+    for (size_t i = 0; ok && presets && i < presets->count; i++) {
+        ok = check_add_directory(report, &capacity, presets->items[i].directory);
+    }
+
+    return ok;
+}
+
+static cJSON *check_cache_load(const char *path) {
+    char *text = NULL;
+
+    if (!utils_file_exists(path) || !utils_read_file(path, &text, NULL)) {
+        return NULL;
+    }
+
+    cJSON *root = cJSON_Parse(text);
+    arena_free(text);
+
+    if (root && !cJSON_IsObject(root)) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+
+    return root;
+}
+
+// Rewritten from scratch each run, so entries for removed or changed profiles drop out.
+static void check_cache_save(const char *profiles_dir, const char *path, const profile_check_report_t *report) {
+    char state_dir[PATH_MAX];
+    cJSON *root = cJSON_CreateObject();
+
+    if (!root) {
+        return;
+    }
+
+    for (size_t i = 0; i < report->count; i++) {
+        const profile_check_result_t *r = &report->items[i];
+
+        if (r->digest[0] == '\0') {
+            continue;
+        }
+
+        cJSON *entry = cJSON_AddObjectToObject(root, r->digest);
+
+        if (entry) {
+            cJSON_AddNumberToObject(entry, "error", r->error);
+            cJSON_AddStringToObject(entry, "message", r->message);
+        }
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json && utils_build_path(state_dir, sizeof(state_dir), profiles_dir, ".state") && utils_create_directory(state_dir)) {
+        if (!utils_write_file(path, json)) {
+            LOG_WARN("Failed to write profile check cache '%s'", path);
+        }
+    }
+
+    cJSON_free(json);
+    cJSON_Delete(root);
+}
+
+bool profile_check_library(const char *profiles_dir, const config_preset_t *presets, int threads, profile_check_report_t *out) {
+    if (!profiles_dir || !out) {
+        LOG_ERROR("Invalid parameters profiles_dir=%p, out=%p", (void*)profiles_dir, (void*)out);
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+
+    long long start = check_now_ms();
+
+    if (!check_collect(profiles_dir, presets, out)) {
+        return false;
+    }
+
+    char cache_path[PATH_MAX];
+    cJSON *cache = NULL;
+
+    if (utils_build_path(cache_path, sizeof(cache_path), profiles_dir, CHECK_CACHE_FILE)) {
+        cache = check_cache_load(cache_path);
+    } else {
+        cache_path[0] = '\0';
+    }
+
+    size_t workers = threads < 1 ? 1 : (size_t)threads;
+    if (workers > PROFILE_CHECK_MAX_THREADS) {
+        workers = PROFILE_CHECK_MAX_THREADS;
+    }
+    if (workers > out->count) {
+        workers = out->count;
+    }
+
+    check_pool_t pool = {
+        .profiles_dir = profiles_dir,
+        .cache = cache,
+        .report = out,
+        .next = 0
+    };
+
+    pthread_mutex_init(&pool.lock, NULL);
+
+    pthread_t *th = workers ? calloc(workers, sizeof(*th)) : NULL;
+    size_t started = 0;
+
+    if (th) {
+        for (; started < workers; started++) {
+            if (pthread_create(&th[started], NULL, check_worker, &pool) != 0) {
+                LOG_WARN("Failed to start profile check worker %zu of %zu", started + 1, workers);
+                break;
+            }
+        }
+    }
+
+    // No worker could be started: check from the calling thread.
+    if (started == 0) {
+        check_worker(&pool);
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(th[i], NULL);
+    }
+
+    free(th);
+    pthread_mutex_destroy(&pool.lock);
+    cJSON_Delete(cache);
+
+    for (size_t i = 0; i < out->count; i++) {
+        if (out->items[i].error != ERROR_NONE) {
+            out->failed++;
+        }
+
+        if (out->items[i].cached) {
+            out->cached++;
+        }
+    }
+
+    if (cache_path[0] != '\0') {
+        check_cache_save(profiles_dir, cache_path, out);
+    }
+
+    out->threads = started ? (int)started : 1;
+    out->wall_ms = check_now_ms() - start;
+
+    LOG_INFO("Checked %zu profile(s) in %lld ms: %zu invalid, %zu unchanged (threads=%d)", out->count, out->wall_ms, out->failed, out->cached, out->threads);
+
+    return out->failed == 0;
+}
+
+void profile_check_report_free(profile_check_report_t *report) {
+    if (!report) {
+        return;
+    }
+
+    free(report->items);
+    memset(report, 0, sizeof(*report));
+}
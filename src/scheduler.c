@@ -0,0 +1,508 @@
+#include "scheduler.h"
+#include "cJSON.h"
+#include "deadline.h"
+#include "device_lock.h"
+#include "errors.h"
+#include "fleet.h"
+#include "ha_status.h"
+#include "logger.h"
+#include "transport.h"
+#include "unifi_profiles_repo.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sessions are opened this long before the cut-over so the handshake is not on the critical path.
+#define SCHEDULER_CONNECT_AHEAD_S 15
+// With nothing scheduled, re-evaluate once a day (yearly windows roll over).
+#define SCHEDULER_IDLE_WAIT_S (24 * 60 * 60)
+
+typedef struct {
+    const unifi_apply_plan_t *plan;
+    const char *preset;
+    time_t at;
+    bool *staged;   // indexed by device index
+    bool catch_up;  // applying the active window now rather than switching at `at`
+} scheduler_job_t;
+
+static struct {
+    pthread_t th;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+    bool running;
+    const config_t *cfg;
+} g_sched = {
+    .mtx = PTHREAD_MUTEX_INITIALIZER,
+    .cv = PTHREAD_COND_INITIALIZER,
+    .running = false,
+    .cfg = NULL
+};
+
+static time_t schedule_time_next(const config_schedule_time_t *t, time_t now) {
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+
+    int first_year = t->year ? t->year : tm_now.tm_year + 1900;
+    int attempts = t->year ? 1 : 2;
+
+    for (int i = 0; i < attempts; i++) {
+        struct tm tm = {0};
+        tm.tm_year = first_year + i - 1900;
+        tm.tm_mon = t->month - 1;
+        tm.tm_mday = t->day;
+        tm.tm_hour = t->hour;
+        tm.tm_min = t->minute;
+        tm.tm_isdst = -1;
+
+        time_t at = mktime(&tm);
+        if (at != (time_t)-1 && at > now) {
+            return at;
+        }
+    }
+
+    return (time_t)-1;
+}
+
+// Latest occurrence at or before `now`, searching back one year for yearly times.
+static time_t schedule_time_prev(const config_schedule_time_t *t, time_t now) {
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+
+    int first_year = t->year ? t->year : tm_now.tm_year + 1900;
+    int attempts = t->year ? 1 : 2;
+
+    for (int i = 0; i < attempts; i++) {
+        struct tm tm = {0};
+        tm.tm_year = first_year - i - 1900;
+        tm.tm_mon = t->month - 1;
+        tm.tm_mday = t->day;
+        tm.tm_hour = t->hour;
+        tm.tm_min = t->minute;
+        tm.tm_isdst = -1;
+
+        time_t at = mktime(&tm);
+        if (at != (time_t)-1 && at <= now) {
+            return at;
+        }
+    }
+
+    return (time_t)-1;
+}
+
+static void consider_event(scheduler_event_t *best, bool *found, time_t at, const char *preset, const char *tag) {
+    if (at == (time_t)-1) {
+        return;
+    }
+
+    if (!*found || at < best->at) {
+        best->at = at;
+        best->preset = preset;
+        best->tag = tag;
+        *found = true;
+    }
+}
+
+// Keeps the latest boundary; an end without a default preset has a NULL preset and switches nothing.
+static void consider_past_event(scheduler_event_t *latest, bool *found, time_t at, const char *preset, const char *tag) {
+    if (at == (time_t)-1) {
+        return;
+    }
+
+    if (!*found || at > latest->at) {
+        latest->at = at;
+        latest->preset = preset;
+        latest->tag = tag;
+        *found = true;
+    }
+}
+
+bool scheduler_active_event(const config_schedule_t *schedule, time_t now, scheduler_event_t *out) {
+    if (!schedule || !out) {
+        return false;
+    }
+
+    bool found = false;
+    const char *default_preset = schedule->default_preset[0] != '\0' ? schedule->default_preset : NULL;
+
+    for (size_t i = 0; i < schedule->count; i++) {
+        const config_schedule_window_t *w = &schedule->items[i];
+
+        consider_past_event(out, &found, schedule_time_prev(&w->start, now), w->preset, w->tag);
+
+        if (w->has_end) {
+            consider_past_event(out, &found, schedule_time_prev(&w->end, now), default_preset, w->tag);
+        }
+    }
+
+    return found && out->preset != NULL;
+}
+
+bool scheduler_next_event(const config_schedule_t *schedule, time_t now, scheduler_event_t *out) {
+    if (!schedule || !out) {
+        return false;
+    }
+
+    bool found = false;
+
+    for (size_t i = 0; i < schedule->count; i++) {
+        const config_schedule_window_t *w = &schedule->items[i];
+
+        consider_event(out, &found, schedule_time_next(&w->start, now), w->preset, w->tag);
+
+        if (w->has_end && schedule->default_preset[0] != '\0') {
+            consider_event(out, &found, schedule_time_next(&w->end, now), schedule->default_preset, w->tag);
+        }
+    }
+
+    return found;
+}
+
+// Returns false when the scheduler is stopping.
+static bool scheduler_wait_until(time_t at) {
+    struct timespec ts = { .tv_sec = at, .tv_nsec = 0 };
+
+    pthread_mutex_lock(&g_sched.mtx);
+
+    while (g_sched.running && time(NULL) < at) {
+        if (pthread_cond_timedwait(&g_sched.cv, &g_sched.mtx, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    bool running = g_sched.running;
+    pthread_mutex_unlock(&g_sched.mtx);
+
+    return running;
+}
+
+static long long realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static int scheduler_stage_device(const config_device_t *device, void *user) {
+    const scheduler_job_t *job = user;
+
+    // A command running on the device keeps its status until it is done; staging waits behind it.
+    device_lock(device->index);
+    deadline_arm(device->ssh_cfg.command_timeout_s);
+    status_bind_device(device->index);
+    status_set_state("staging");
+
+    int rc = ERROR_SSH_CONNECTION_FAILED;
+    unifi_apply_stats_t stats = {0};
+    transport_t *session = transport_open(&device->ssh_cfg);
+
+    if (session) {
+        rc = unifi_profile_stage_plan(session, job->plan, &stats);
+        transport_close(session);
+    }
+
+    if (stats.cache_enabled) {
+        status_set_asset_cache(stats.cache_hits, stats.cache_misses, stats.cache_evictions);
+    }
+
+    if (stats.bytes_sent > 0) {
+        status_set_upload_savings(stats.bytes_sent, stats.bytes_saved);
+    }
+
+    job->staged[device->index] = (rc == ERROR_NONE);
+
+    if (rc != ERROR_NONE) {
+        // Not fatal: the cut-over falls back to a full apply for this device.
+        LOG_WARN("Staging '%s' on device '%s' failed (code=%d)", job->preset, device->id, rc);
+    }
+
+    status_set_state("idle");
+    device_unlock(device->index);
+
+    return rc;
+}
+
+static void scheduler_publish_switch(const scheduler_job_t *job, bool staged, int rc, long long latency_ms, long long cutover_ms) {
+    char iso_timestamp[25];
+    char latency[32];
+    time_t at = job->at;
+
+    utils_build_iso_timestamp(&at, iso_timestamp, sizeof(iso_timestamp));
+    snprintf(latency, sizeof(latency), "%lld", latency_ms);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        LOG_ERROR("Failed to allocate cJSON object for 'schedule/last_switch/attributes'");
+        return;
+    }
+
+    cJSON_AddStringToObject(root, "preset", job->preset);
+    cJSON_AddStringToObject(root, "scheduled_at", iso_timestamp);
+    cJSON_AddBoolToObject(root, "staged", staged);
+    cJSON_AddBoolToObject(root, "ok", rc == ERROR_NONE);
+    cJSON_AddNumberToObject(root, "code", rc);
+    cJSON_AddNumberToObject(root, "latency_ms", (double)latency_ms);
+    cJSON_AddNumberToObject(root, "cutover_ms", (double)cutover_ms);
+
+    char *json = cJSON_PrintUnformatted(root);
+
+    if (json) {
+        status_set_schedule_switch(latency, json);
+        cJSON_free(json);
+    } else {
+        LOG_ERROR("Failed to serialize 'schedule/last_switch/attributes' JSON.");
+    }
+
+    cJSON_Delete(root);
+}
+
+static int scheduler_cutover_device(const config_device_t *device, void *user) {
+    const scheduler_job_t *job = user;
+    bool staged = job->staged[device->index];
+
+    status_bind_device(device->index);
+
+    transport_t *session = transport_open(&device->ssh_cfg);
+    if (!session) {
+        HA_ERR(ERROR_SSH_CONNECTION_FAILED, "Failed to create SSH session for scheduled switch");
+        return ERROR_SSH_CONNECTION_FAILED;
+    }
+
+    if (!job->catch_up && !scheduler_wait_until(job->at)) {
+        transport_close(session);
+        return ERROR_PROFILE_APPLY_FAILED;
+    }
+
+    // Taken after the wait so commands keep the device until the switch time; the deadline starts once it is held.
+    device_lock(device->index);
+    deadline_arm(device->ssh_cfg.command_timeout_s);
+    status_set_state("uploading");
+
+    long long start_ms = realtime_ms();
+    int rc = ERROR_PROFILE_APPLY_MISSING_TMP_FILES;
+    unifi_apply_stats_t stats = {0};
+
+    if (staged) {
+        rc = unifi_profile_cutover(session, job->plan);
+    }
+
+    if (rc == ERROR_PROFILE_APPLY_MISSING_TMP_FILES) {
+        if (!job->catch_up) {
+            LOG_WARN("Nothing staged for '%s' on device '%s'; doing a full apply", job->preset, device->id);
+        }
+
+        staged = false;
+        rc = unifi_profile_apply_plan(session, job->plan, &stats);
+
+        if (stats.cache_enabled) {
+            status_set_asset_cache(stats.cache_hits, stats.cache_misses, stats.cache_evictions);
+        }
+
+        if (stats.bytes_sent > 0) {
+            status_set_upload_savings(stats.bytes_sent, stats.bytes_saved);
+        }
+    }
+
+    long long end_ms = realtime_ms();
+
+    status_apply_sample_t sample = {
+        .ok = (rc == ERROR_NONE),
+        .apply_seconds = staged ? (double)(end_ms - start_ms) / 1000.0 : stats.apply_seconds,
+        .upload_seconds = stats.upload_seconds,
+        .bytes_sent = stats.bytes_sent,
+        .rtt_ms = transport_rtt_ms(session),
+        .unchanged = stats.unchanged,
+    };
+
+    status_record_apply(&sample);
+    transport_close(session);
+
+    if (job->catch_up) {
+        // Not a switch on time, so it stays out of the switch latency sensor.
+        LOG_INFO("Catch-up to '%s' on device '%s' finished in %lld ms (code=%d)", job->preset, device->id, end_ms - start_ms, rc);
+    } else {
+        long long latency_ms = end_ms - (long long)job->at * 1000LL;
+
+        LOG_INFO("Scheduled switch to '%s' on device '%s' finished %lld ms after the scheduled time (staged=%d, code=%d)", job->preset, device->id, latency_ms, staged, rc);
+
+        scheduler_publish_switch(job, staged, rc, latency_ms, end_ms - start_ms);
+    }
+
+    if (rc != ERROR_NONE) {
+        HA_ERR(rc, "Scheduled switch failed");
+        status_set_state("idle");
+        device_unlock(device->index);
+        return rc;
+    }
+
+    if (!profiles_write_last_applied(device->id, job->preset, true)) {
+        LOG_WARN("Failed to persist last applied state (device=%s profile=%s). State will not survive restart of service.", device->id, job->preset);
+    }
+
+    status_set_last_applied_profile(job->preset);
+    status_set_preset_selected(job->preset);
+    status_set_custom_directory("");
+    status_set_params(&job->plan->profile);
+    status_set_state("idle");
+    device_unlock(device->index);
+
+    return ERROR_NONE;
+}
+
+static void scheduler_run_event(const config_t *cfg, const scheduler_event_t *ev) {
+    const profiles_preset_t *preset = NULL;
+    fleet_rollout_t rollout = {0};
+    bool *staged = NULL;
+
+    int rc = profiles_repo_acquire_preset(ev->preset, &preset);
+    if (rc != ERROR_NONE) {
+        LOG_ERROR("Scheduled switch: preset '%s' is not available (code=%d)", ev->preset, rc);
+        goto cleanup;
+    }
+
+    if (!fleet_rollout_init(&rollout, &cfg->devices_cfg, ev->tag) || rollout.count == 0) {
+        LOG_WARN("Scheduled switch to '%s': no devices selected", ev->preset);
+        goto cleanup;
+    }
+
+    staged = calloc(cfg->devices_cfg.count, sizeof(*staged));
+    if (!staged) {
+        LOG_ERROR("Out of memory allocating staging state (count=%zu)", cfg->devices_cfg.count);
+        goto cleanup;
+    }
+
+    scheduler_job_t job = { .plan = &preset->plan, .preset = ev->preset, .at = ev->at, .staged = staged };
+
+    LOG_INFO("Staging '%s' on %zu device(s)", ev->preset, rollout.count);
+    fleet_rollout_run(&rollout, cfg->fleet_cfg.concurrency, scheduler_stage_device, &job);
+
+    if (!scheduler_wait_until(ev->at - SCHEDULER_CONNECT_AHEAD_S)) {
+        goto cleanup;
+    }
+
+    // Every device cuts over at the same moment, so the fleet concurrency limit does not apply here.
+    fleet_rollout_run(&rollout, (int)rollout.count, scheduler_cutover_device, &job);
+
+cleanup:
+    profiles_repo_release_preset(preset);
+
+    free(staged);
+    fleet_rollout_free(&rollout);
+}
+
+void scheduler_catch_up(const config_t *cfg, time_t now) {
+    const profiles_preset_t *preset = NULL;
+    fleet_rollout_t rollout = {0};
+    bool *staged = NULL;
+    scheduler_event_t ev;
+
+    if (!cfg || !scheduler_active_event(&cfg->schedule_cfg, now, &ev)) {
+        return;
+    }
+
+    char iso_timestamp[25];
+    utils_build_iso_timestamp(&ev.at, iso_timestamp, sizeof(iso_timestamp));
+    LOG_INFO("Catching up: '%s' is scheduled since %s", ev.preset, iso_timestamp);
+
+    int rc = profiles_repo_acquire_preset(ev.preset, &preset);
+    if (rc != ERROR_NONE) {
+        LOG_ERROR("Scheduled catch-up: preset '%s' is not available (code=%d)", ev.preset, rc);
+        goto cleanup;
+    }
+
+    if (!fleet_rollout_init(&rollout, &cfg->devices_cfg, ev.tag) || rollout.count == 0) {
+        LOG_WARN("Scheduled catch-up to '%s': no devices selected", ev.preset);
+        goto cleanup;
+    }
+
+    // Nothing is staged: every device gets a full apply, which is skipped where the preset already runs.
+    staged = calloc(cfg->devices_cfg.count, sizeof(*staged));
+    if (!staged) {
+        LOG_ERROR("Out of memory allocating staging state (count=%zu)", cfg->devices_cfg.count);
+        goto cleanup;
+    }
+
+    scheduler_job_t job = { .plan = &preset->plan, .preset = ev.preset, .at = now, .staged = staged, .catch_up = true };
+
+    fleet_rollout_run(&rollout, cfg->fleet_cfg.concurrency, scheduler_cutover_device, &job);
+
+cleanup:
+    profiles_repo_release_preset(preset);
+
+    free(staged);
+    fleet_rollout_free(&rollout);
+}
+
+static void *scheduler_worker(void *arg) {
+    const config_t *cfg = arg;
+
+    // A restart inside a window, or a switch missed while the service was down, would otherwise wait for the next boundary.
+    scheduler_catch_up(cfg, time(NULL));
+
+    for (;;) {
+        time_t now = time(NULL);
+        scheduler_event_t ev;
+
+        if (!scheduler_next_event(&cfg->schedule_cfg, now, &ev)) {
+            LOG_INFO("No upcoming scheduled switches");
+
+            if (!scheduler_wait_until(now + SCHEDULER_IDLE_WAIT_S)) {
+                break;
+            }
+
+            continue;
+        }
+
+        char iso_timestamp[25];
+        utils_build_iso_timestamp(&ev.at, iso_timestamp, sizeof(iso_timestamp));
+        LOG_INFO("Next scheduled switch: '%s' at %s (staging %d min ahead)", ev.preset, iso_timestamp, cfg->schedule_cfg.lead_minutes);
+
+        if (!scheduler_wait_until(ev.at - (time_t)cfg->schedule_cfg.lead_minutes * 60)) {
+            break;
+        }
+
+        scheduler_run_event(cfg, &ev);
+    }
+
+    return NULL;
+}
+
+bool scheduler_start(const config_t *cfg) {
+    if (!cfg) {
+        return false;
+    }
+
+    if (cfg->schedule_cfg.count == 0 || g_sched.running) {
+        return true;
+    }
+
+    g_sched.cfg = cfg;
+    g_sched.running = true;
+
+    if (pthread_create(&g_sched.th, NULL, scheduler_worker, (void*)cfg) != 0) {
+        LOG_ERROR("Failed to start scheduler thread");
+        g_sched.running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void scheduler_stop(void) {
+    pthread_mutex_lock(&g_sched.mtx);
+
+    if (!g_sched.running) {
+        pthread_mutex_unlock(&g_sched.mtx);
+        return;
+    }
+
+    g_sched.running = false;
+    pthread_cond_broadcast(&g_sched.cv);
+    pthread_mutex_unlock(&g_sched.mtx);
+
+    pthread_join(g_sched.th, NULL);
+    g_sched.cfg = NULL;
+}
@@ -1,21 +1,30 @@
 #include "ssh.h"
+#include "arena.h"
 #include "config_types.h"
+#include "deadline.h"
 #include "logger.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <libssh2.h>
 #include <libssh2_sftp.h>
 #include <linux/limits.h>
+#include <linux/tcp.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 
+#define SSH_CLOSE_TIMEOUT_MS 2000
+
 struct ssh_session {
     int sock;
     LIBSSH2_SESSION *session;
@@ -36,7 +45,75 @@ void ssh_global_cleanup(void) {
     libssh2_exit();
 } 
 
-static int ssh_connect_tcp(const char *host, int port) {
+// Milliseconds allowed for a step that must end by until_us (metrics_now_us() clock, 0 = no limit), within what is
+// left of the current operation; -1 = unlimited.
+static int ssh_budget_ms(uint64_t until_us) {
+    int remaining = deadline_remaining_ms();
+    int limit = -1;
+
+    if (until_us != 0) {
+        uint64_t now = metrics_now_us();
+
+        // Round up so a step less than a millisecond from its limit is not mistaken for one past it.
+        limit = now >= until_us ? 0 : (int)((until_us - now + 999) / 1000);
+    }
+
+    if (remaining < 0) {
+        return limit;
+    }
+
+    return (limit < 0 || remaining < limit) ? remaining : limit;
+}
+
+// Non-blocking connect so an unreachable doorbell costs at most timeout_ms instead of the kernel's SYN retries.
+static bool ssh_connect_with_timeout(int sock, const struct sockaddr *addr, socklen_t addr_len, int timeout_ms) {
+    int flags = fcntl(sock, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+
+    int rc = connect(sock, addr, addr_len);
+
+    if (rc != 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+
+        do {
+            rc = poll(&pfd, 1, timeout_ms);
+        } while (rc < 0 && errno == EINTR);
+
+        if (rc == 0) {
+            errno = ETIMEDOUT;
+            rc = -1;
+        } else if (rc > 0 && getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0) {
+            rc = 0;
+        } else {
+            errno = err ? err : errno;
+            rc = -1;
+        }
+    }
+
+    fcntl(sock, F_SETFL, flags);
+
+    return rc == 0;
+}
+
+// Bounds every blocking libssh2 call that follows by budget_ms; false when no time is left.
+static bool ssh_arm(LIBSSH2_SESSION *session, int budget_ms) {
+    if (budget_ms == 0) {
+        LOG_ERROR("SSH operation aborted: %s", deadline_cancelled() ? "cancelled" : "deadline passed");
+        return false;
+    }
+
+    libssh2_session_set_timeout(session, budget_ms > 0 ? budget_ms : 0);
+
+    return true;
+}
+
+// Tries each address of host in turn until one connects or the budget up to until_us is spent.
+static int ssh_connect_tcp(const char *host, int port, uint64_t until_us) {
     char port_str[16];
     snprintf(port_str, sizeof(port_str), "%d", port);
 
@@ -58,12 +135,19 @@ static int ssh_connect_tcp(const char *host, int port) {
     int sock = -1;
     struct addrinfo *p;
     for (p = res; p != NULL; p = p->ai_next) {
+        int timeout_ms = ssh_budget_ms(until_us);
+
+        if (timeout_ms == 0) {
+            errno = ETIMEDOUT;
+            break;
+        }
+
         sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
         if (sock < 0) {
             continue;
         }
 
-        if (connect(sock, p->ai_addr, p->ai_addrlen) == 0 ) {
+        if (ssh_connect_with_timeout(sock, p->ai_addr, p->ai_addrlen, timeout_ms)) {
             break;
         }
 
@@ -74,7 +158,7 @@ static int ssh_connect_tcp(const char *host, int port) {
     freeaddrinfo(res);
 
     if (sock < 0) {
-        LOG_ERROR("Failed to connect to %s:%d", host, port);
+        LOG_ERROR("Failed to connect to %s:%d: %s", host, port, strerror(errno));
     }
 
     return sock;
@@ -107,31 +191,56 @@ ssh_session_t *ssh_session_create(const config_ssh_t *cfg) {
         return NULL;
     }
 
-    int sock = ssh_connect_tcp(cfg->host, cfg->port);
+    uint64_t start = metrics_now_us();
+    uint64_t span = trace_begin();
+
+    // Connecting, the handshake and authentication share one budget; libssh2 applies its timeout per call,
+    // so each step is armed with what is left of it.
+    uint64_t connect_until = cfg->connect_timeout_s > 0 ? start + (uint64_t)cfg->connect_timeout_s * 1000000u : 0;
+
+    int sock = ssh_connect_tcp(cfg->host, cfg->port, connect_until);
     if (sock < 0) {
+        metrics_inc(METRIC_SSH_CONNECT_FAILURES);
         return NULL;
     }
 
+    deadline_watch_socket(sock);
+
     LIBSSH2_SESSION *session = libssh2_session_init();
     if (!session) {
         LOG_ERROR("libssh2_session_init failed");
+        deadline_unwatch_socket(sock);
         close(sock);
         return NULL;
     }
 
     libssh2_session_set_blocking(session, 1);
 
-    int rc = libssh2_session_handshake(session, sock);
+    int rc = ssh_arm(session, ssh_budget_ms(connect_until)) ? libssh2_session_handshake(session, sock) : LIBSSH2_ERROR_TIMEOUT;
     if (rc != 0) {
         LOG_ERROR("libssh2_session_handshake failed: %d", rc);
+        metrics_inc(METRIC_SSH_CONNECT_FAILURES);
         libssh2_session_free(session);
+        deadline_unwatch_socket(sock);
         close(sock);
         return NULL;
     }
 
-    if (!ssh_authenticate(session, cfg)) {
+    metrics_observe_since(METRIC_SSH_CONNECT_SECONDS, start);
+    trace_end(span, "ssh", "connect", cfg->host, 0);
+    start = metrics_now_us();
+    span = trace_begin();
+
+    bool authenticated = ssh_arm(session, ssh_budget_ms(connect_until)) && ssh_authenticate(session, cfg);
+
+    metrics_observe_since(METRIC_SSH_AUTH_SECONDS, start);
+    trace_end(span, "ssh", "auth", cfg->user, 0);
+
+    if (!authenticated) {
+        metrics_inc(METRIC_SSH_CONNECT_FAILURES);
         libssh2_session_disconnect(session, "Authentication failed");
         libssh2_session_free(session);
+        deadline_unwatch_socket(sock);
         close(sock);
         return NULL;
     }
@@ -141,6 +250,7 @@ ssh_session_t *ssh_session_create(const config_ssh_t *cfg) {
         LOG_ERROR("Out of memory creating ssh_session_t");
         libssh2_session_disconnect(session, "Memory error");
         libssh2_session_free(session);
+        deadline_unwatch_socket(sock);
         close(sock);
         return NULL;
     }
@@ -159,17 +269,31 @@ void ssh_session_destroy(ssh_session_t *s) {
     }
 
     if (s->session) {
+        // A hung or cancelled device must not hold up the goodbye.
+        libssh2_session_set_timeout(s->session, SSH_CLOSE_TIMEOUT_MS);
         libssh2_session_disconnect(s->session, "Normal shutdown");
         libssh2_session_free(s->session);
     }
 
     if (s->sock >= 0) {
+        deadline_unwatch_socket(s->sock);
         close(s->sock);
     }
 
     free(s);
 }
 
+double ssh_session_rtt_ms(const ssh_session_t *s) {
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    if (!s || getsockopt(s->sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0 || info.tcpi_rtt == 0) {
+        return -1;
+    }
+
+    return info.tcpi_rtt / 1000.0;
+}
+
 bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len) {
     if (!s || !s->session || !command) {
         LOG_ERROR("ssh_exec_command: invalid arguments.");
@@ -181,7 +305,13 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
     if (stderr_data) *stderr_data = NULL;
     if (stderr_len) *stderr_len = 0;
 
+    if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
     LIBSSH2_CHANNEL *channel = libssh2_channel_open_session(s->session);
+    trace_end(span, "ssh", "channel_open", "session", 0);
     if (!channel) {
         LOG_ERROR("libssh2_channel_open_session failed.");
         return false;
@@ -200,20 +330,29 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
     char *err_buf = NULL; 
     size_t err_size = 0;
 
+    bool failed = false;
+
     for (;;) {
         bool did_work = false;
 
+        // A remote script that stops producing output must not hold the worker past the deadline.
+        if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+            failed = true;
+            break;
+        }
+
         // stdout
         for (;;) {
             ssize_t n = libssh2_channel_read(channel, buffer, sizeof(buffer));
             if (n == LIBSSH2_ERROR_EAGAIN) break;
+            if (n < 0) failed = true;
             if (n <= 0) break;
 
-            char *tmp = realloc(out_buf, out_size + (size_t)n + 1);
+            char *tmp = arena_realloc(out_buf, out_size + (size_t)n + 1);
             if (!tmp) {
                 LOG_ERROR("Out of memory reading stdout.");
-                free(out_buf);
-                free(err_buf);
+                arena_free(out_buf);
+                arena_free(err_buf);
                 libssh2_channel_close(channel);
                 libssh2_channel_free(channel);
                 return false;
@@ -229,13 +368,14 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
         for (;;) {
             ssize_t n = libssh2_channel_read_stderr(channel, buffer, sizeof(buffer));
             if (n == LIBSSH2_ERROR_EAGAIN) break;
+            if (n < 0) failed = true;
             if (n <= 0) break;
 
-            char *tmp = realloc(err_buf, err_size + (size_t)n + 1);
+            char *tmp = arena_realloc(err_buf, err_size + (size_t)n + 1);
             if (!tmp) {
                 LOG_ERROR("Out of memory reading stderr.");
-                free(out_buf);
-                free(err_buf);
+                arena_free(out_buf);
+                arena_free(err_buf);
                 libssh2_channel_close(channel);
                 libssh2_channel_free(channel);
                 return false;
@@ -248,7 +388,7 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
         }
 
         // Exit condition: remote closed / EOF and no more data to read.
-        if (libssh2_channel_eof(channel)) {
+        if (failed || libssh2_channel_eof(channel)) {
             break;
         }
 
@@ -260,6 +400,14 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
         }
     }
 
+    if (failed) {
+        LOG_ERROR("SSH command did not complete: %s", command);
+        arena_free(out_buf);
+        arena_free(err_buf);
+        libssh2_channel_free(channel);
+        return false;
+    }
+
     libssh2_channel_close(channel);
     libssh2_channel_wait_closed(channel);
 
@@ -270,14 +418,14 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
         *stdout_data = out_buf;
         if (stdout_len) *stdout_len = out_size;
     } else {
-        free(out_buf);
+        arena_free(out_buf);
     }
 
     if (stderr_data) {
         *stderr_data = err_buf;
         if (stderr_len) *stderr_len = err_size;
     } else {
-        free(err_buf);
+        arena_free(err_buf);
     }
 
     if (exit_status != 0) {
@@ -288,6 +436,25 @@ bool ssh_exec_command(ssh_session_t *s, const char *command, char **stdout_data,
     return true;
 }
 
+static bool scp_channel_write_all(LIBSSH2_SESSION *session, LIBSSH2_CHANNEL *channel, const char *data, size_t len, const char *remote_path) {
+    while (len > 0) {
+        if (!ssh_arm(session, ssh_budget_ms(0))) {
+            return false;
+        }
+
+        ssize_t nwritten = libssh2_channel_write(channel, data, len);
+        if (nwritten < 0) {
+            LOG_ERROR("Error writing to SCP channel for '%s'", remote_path);
+            return false;
+        }
+        metrics_add(METRIC_UPLOAD_BYTES, (uint64_t)nwritten);
+        data += nwritten;
+        len  -= (size_t)nwritten;
+    }
+
+    return true;
+}
+
 bool ssh_scp_upload_file(ssh_session_t *s, const char *local_path, const char *remote_dir, unsigned long remote_mode) {
     if (!s || !s->session || !local_path || !remote_dir) {
         LOG_ERROR("ssh_scp_upload_file: invalid arguments.");
@@ -305,6 +472,10 @@ bool ssh_scp_upload_file(ssh_session_t *s, const char *local_path, const char *r
         return false;
     }
 
+    if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+        return false;
+    }
+
     FILE *fp = fopen(local_path, "rb");
     if (!fp) {
         LOG_ERROR("Failed to open local file '%s': %s", local_path, strerror(errno));
@@ -320,7 +491,9 @@ bool ssh_scp_upload_file(ssh_session_t *s, const char *local_path, const char *r
         return false;
     }
 
+    uint64_t span = trace_begin();
     LIBSSH2_CHANNEL *channel = libssh2_scp_send64(s->session, remote_path, (int)remote_mode, (libssh2_uint64_t)file_size, 0, 0);
+    trace_end(span, "ssh", "channel_open", "scp_send", 0);
     if (!channel) {
         LOG_ERROR("libssh2_scp_send64 failed for remote path '%s'", remote_path);
         fclose(fp);
@@ -330,17 +503,10 @@ bool ssh_scp_upload_file(ssh_session_t *s, const char *local_path, const char *r
     char buffer[4096];
     size_t nread;
     while ((nread = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        char *ptr = buffer;
-        while (nread > 0) {
-            ssize_t nwritten = libssh2_channel_write(channel, ptr, nread);
-            if (nwritten < 0) {
-                LOG_ERROR("Error writing to SCP channel for '%s'", remote_path);
-                libssh2_channel_free(channel);
-                fclose(fp);
-                return false;
-            }
-            ptr   += nwritten;
-            nread -= nwritten;
+        if (!scp_channel_write_all(s->session, channel, buffer, nread, remote_path)) {
+            libssh2_channel_free(channel);
+            fclose(fp);
+            return false;
         }
     }
 
@@ -354,6 +520,94 @@ bool ssh_scp_upload_file(ssh_session_t *s, const char *local_path, const char *r
     return true;
 }
 
+bool ssh_scp_upload_buffer(ssh_session_t *s, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode) {
+    if (!s || !s->session || (!data && len > 0) || !remote_dir || !remote_name) {
+        LOG_ERROR("ssh_scp_upload_buffer: invalid arguments.");
+        return false;
+    }
+
+    char remote_path[PATH_MAX];
+    int n = snprintf(remote_path, sizeof(remote_path), "%s/%s", remote_dir, remote_name);
+
+    if (n <= 0 || (size_t)n >= sizeof(remote_path)) {
+        LOG_ERROR("Remote path truncated.");
+        return false;
+    }
+
+    if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    LIBSSH2_CHANNEL *channel = libssh2_scp_send64(s->session, remote_path, (int)remote_mode, (libssh2_uint64_t)len, 0, 0);
+    trace_end(span, "ssh", "channel_open", "scp_send", 0);
+    if (!channel) {
+        LOG_ERROR("libssh2_scp_send64 failed for remote path '%s'", remote_path);
+        return false;
+    }
+
+    // Written straight from the caller's memory (typically a mapped bundle), without a staging copy.
+    if (!scp_channel_write_all(s->session, channel, data, len, remote_path)) {
+        libssh2_channel_free(channel);
+        return false;
+    }
+
+    libssh2_channel_send_eof(channel);
+    libssh2_channel_wait_eof(channel);
+    libssh2_channel_wait_closed(channel);
+    libssh2_channel_free(channel);
+
+    LOG_INFO("SCP upload complete: %zu bytes -> %s", len, remote_path);
+    return true;
+}
+
+bool ssh_exec_write(ssh_session_t *s, const char *command, const void *data, size_t len) {
+    if (!s || !s->session || !command || (!data && len > 0)) {
+        LOG_ERROR("ssh_exec_write: invalid arguments.");
+        return false;
+    }
+
+    if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    LIBSSH2_CHANNEL *channel = libssh2_channel_open_session(s->session);
+    trace_end(span, "ssh", "channel_open", "session", 0);
+    if (!channel) {
+        LOG_ERROR("libssh2_channel_open_session failed.");
+        return false;
+    }
+
+    int rc = libssh2_channel_exec(channel, command);
+    if (rc != 0) {
+        LOG_ERROR("libssh2_channel_exec failed for command '%s' (rc=%d)", command, rc);
+        libssh2_channel_free(channel);
+        return false;
+    }
+
+    if (!scp_channel_write_all(s->session, channel, data, len, command)) {
+        libssh2_channel_free(channel);
+        return false;
+    }
+
+    libssh2_channel_send_eof(channel);
+    libssh2_channel_wait_eof(channel);
+    libssh2_channel_close(channel);
+    libssh2_channel_wait_closed(channel);
+
+    int exit_status = libssh2_channel_get_exit_status(channel);
+    libssh2_channel_free(channel);
+
+    if (exit_status != 0) {
+        LOG_ERROR("SSH command exited non-zero (exit=%d): %s", exit_status, command);
+        return false;
+    }
+
+    LOG_INFO("Streamed %zu bytes to '%s'", len, command);
+    return true;
+}
+
 bool ssh_scp_download_file(ssh_session_t *s, const char *remote_path, const char *local_path)
 {
     if (!s || !s->session || !remote_path || !local_path) {
@@ -361,10 +615,16 @@ bool ssh_scp_download_file(ssh_session_t *s, const char *remote_path, const char
         return false;
     }
 
+    if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+        return false;
+    }
+
     struct stat sb;
     memset(&sb, 0, sizeof(sb));
 
+    uint64_t span = trace_begin();
     LIBSSH2_CHANNEL *channel = libssh2_scp_recv2(s->session, remote_path, &sb);
+    trace_end(span, "ssh", "channel_open", "scp_recv", 0);
     if (!channel) {
         LOG_ERROR("libssh2_scp_recv2 failed for '%s'", remote_path);
         return false;
@@ -382,6 +642,12 @@ bool ssh_scp_download_file(ssh_session_t *s, const char *remote_path, const char
     off_t total = 0;
 
     while (remaining > 0) {
+        if (!ssh_arm(s->session, ssh_budget_ms(0))) {
+            fclose(fp);
+            libssh2_channel_free(channel);
+            return false;
+        }
+
         size_t want = (size_t)((remaining < (off_t)sizeof(buffer)) ? remaining : (off_t)sizeof(buffer));
 
         ssize_t n = libssh2_channel_read(channel, buffer, want);
@@ -424,6 +690,7 @@ bool ssh_scp_download_file(ssh_session_t *s, const char *remote_path, const char
             total += (off_t)to_write;
         }   
 
+        metrics_add(METRIC_DOWNLOAD_BYTES, (uint64_t)n);
         remaining -= (off_t)n;
     }
 
@@ -57,6 +57,30 @@ bool ssh_cmd_rm_rf(char *out, size_t out_sz, const char *path) {
     return (size_t)snprintf(out, out_sz, CMD_RM_RF, path) < out_sz;
 }
 
+bool ssh_cmd_cat(char *out, size_t out_sz, const char *path) {
+    if (!out || !ssh_arg_is_safe_single_quoted(path)) {
+        return false;
+    }
+
+    return (size_t)snprintf(out, out_sz, CMD_CAT, path) < out_sz;
+}
+
+bool ssh_cmd_stat(char *out, size_t out_sz, const char *path) {
+    if (!out || !ssh_arg_is_safe_single_quoted(path)) {
+        return false;
+    }
+
+    return (size_t)snprintf(out, out_sz, CMD_STAT, path) < out_sz;
+}
+
+bool ssh_cmd_write_file(char *out, size_t out_sz, const char *dir, const char *name) {
+    if (!out || !ssh_arg_is_safe_single_quoted(dir) || !ssh_arg_is_safe_single_quoted(name) || strchr(name, '/')) {
+        return false;
+    }
+
+    return (size_t)snprintf(out, out_sz, CMD_WRITE_FILE, dir, name) < out_sz;
+}
+
 bool ssh_cmd_restart_lcm(char *out, size_t out_sz) {
     return (size_t)snprintf(out, out_sz, CMD_RESTART_LCM) < out_sz;
 }
@@ -68,7 +92,7 @@ bool build_apply_profile_command(
     const char *anim_file,
     const char *sound_file
 ) {
-    if (!*out || !tmp_dir)
+    if (!out || out_sz == 0 || !tmp_dir)
         return false;
 
     if (!ssh_arg_is_safe_single_quoted(tmp_dir)) {
@@ -78,17 +102,19 @@ bool build_apply_profile_command(
     out[0] = '\0';
     size_t len = 0;
 
-    cmd_append(out, out_sz, &len, "%s", SCRIPT_PREAMBLE);
+    // A truncated script would still run up to where it was cut, so any overflow fails the whole build.
+    bool ok = cmd_append(out, out_sz, &len, "%s", SCRIPT_PREAMBLE) &&
+              cmd_append(out, out_sz, &len, SCRIPT_DECOMPRESS, tmp_dir);
 
-    if (!anim_file) {
-        cmd_append(out, out_sz, &len,
+    if (ok && !anim_file) {
+        ok = cmd_append(out, out_sz, &len,
             "run cleanup_anim rm -f \"$ANIM_DIR\"/*\n"
             "run move_anim_conf mv -f '%s/ubnt_lcm_gui.conf.patched' \"$PERSIST_DIR/ubnt_lcm_gui.conf\"\n",
             tmp_dir);
     }
 
-    if (anim_file) {
-        cmd_append(out, out_sz, &len,
+    if (ok && anim_file) {
+        ok = cmd_append(out, out_sz, &len,
             "run cleanup_anim rm -f \"$ANIM_DIR\"/*\n"
             "run move_anim mv -f '%s/%s' \"$ANIM_DIR/%s.anim\"\n"
             "run move_anim_md5 mv -f '%s/%s.md5' \"$ANIM_DIR/%s.md5\"\n"
@@ -98,8 +124,8 @@ bool build_apply_profile_command(
         );
     }
 
-    if (sound_file) {
-        cmd_append(out, out_sz, &len,
+    if (ok && sound_file) {
+        ok = cmd_append(out, out_sz, &len,
             "run cleanup_snd rm -f \"$SND_DIR\"/*\n"
             "run move_snd mv -f '%s/%s' \"$SND_DIR/%s\"\n"
             "run move_snd_md5 mv -f '%s/%s.md5' \"$SND_DIR/%s.md5\"\n"
@@ -109,9 +135,83 @@ bool build_apply_profile_command(
         );
     }
 
-    cmd_append(out, out_sz, &len, "%s", SCRIPT_RESTART);
+    return ok && cmd_append(out, out_sz, &len, "%s", SCRIPT_RESTART);
+}
+
+bool build_apply_conf_command(char *out, size_t out_sz, const char *tmp_dir, bool lcm_gui, bool sounds_leds) {
+    if (!out || out_sz == 0 || !ssh_arg_is_safe_single_quoted(tmp_dir) || (!lcm_gui && !sounds_leds)) {
+        return false;
+    }
+
+    out[0] = '\0';
+    size_t len = 0;
 
-    return true;
+    bool ok = cmd_append(out, out_sz, &len, "%s", SCRIPT_PREAMBLE) &&
+              cmd_append(out, out_sz, &len, SCRIPT_DECOMPRESS, tmp_dir);
+
+    if (ok && lcm_gui) {
+        ok = cmd_append(out, out_sz, &len, "run move_anim_conf mv -f '%s/ubnt_lcm_gui.conf.patched' \"$PERSIST_DIR/ubnt_lcm_gui.conf\"\n", tmp_dir) &&
+             cmd_append(out, out_sz, &len, SCRIPT_RESTART_SERVICE, "ubnt_lcm_gui");
+    }
+
+    if (ok && sounds_leds) {
+        ok = cmd_append(out, out_sz, &len, "run move_snd_conf mv -f '%s/ubnt_sounds_leds.conf.patched' \"$PERSIST_DIR/ubnt_sounds_leds.conf\"\n", tmp_dir) &&
+             cmd_append(out, out_sz, &len, SCRIPT_RESTART_SERVICE, "ubnt_sounds_leds");
+    }
+
+    return ok;
+}
+
+bool ssh_cmd_cache_fetch(char *out, size_t out_sz, const char *cache_dir, const char *md5_hex, const char *dst_dir, const char *file) {
+    if (!out || !ssh_arg_is_safe_single_quoted(cache_dir) || !ssh_arg_is_safe_single_quoted(md5_hex) ||
+        !ssh_arg_is_safe_single_quoted(dst_dir) || !ssh_arg_is_safe_single_quoted(file)) {
+        return false;
+    }
+
+    // Fails (and so reports a miss) when the entry is not cached. The touch marks it most recently used.
+    return (size_t)snprintf(out, out_sz, CMD_CACHE_FETCH,
+                            cache_dir, md5_hex, dst_dir, file,
+                            md5_hex, dst_dir, file,
+                            cache_dir, md5_hex) < out_sz;
+}
+
+bool build_cache_store_command(char *out, size_t out_sz, const char *cache_dir, const char *src_dir, const char *const *files, const char *const *md5_hexes, size_t count, int max_entries, int max_kb) {
+    if (!out || out_sz == 0 || !ssh_arg_is_safe_single_quoted(cache_dir) || !ssh_arg_is_safe_single_quoted(src_dir)) {
+        return false;
+    }
+
+    out[0] = '\0';
+    size_t len = 0;
+
+    if (!cmd_append(out, out_sz, &len, "CACHE='%s'\nmkdir -p \"$CACHE\" || exit 0\n", cache_dir)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!ssh_arg_is_safe_single_quoted(files[i]) || !ssh_arg_is_safe_single_quoted(md5_hexes[i])) {
+            return false;
+        }
+
+        // Runs before the apply script, so an asset sent compressed is still <file>.gz.
+        if (!cmd_append(out, out_sz, &len, "{ cp -f '%s/%s' \"$CACHE/%s\" 2>/dev/null || gzip -dc '%s/%s.gz' > \"$CACHE/%s\"; } || rm -f \"$CACHE/%s\"\n",
+                        src_dir, files[i], md5_hexes[i], src_dir, files[i], md5_hexes[i], md5_hexes[i])) {
+            return false;
+        }
+    }
+
+    return cmd_append(out, out_sz, &len, SCRIPT_CACHE_PRUNE, max_entries, max_kb);
+}
+
+int ssh_parse_cache_evictions(const char *stdout_text) {
+    int evictions = 0;
+
+    for (const char *p = stdout_text; p && (p = strstr(p, "EVICT ")) != NULL; p += 6) {
+        if (p == stdout_text || p[-1] == '\n') {
+            evictions++;
+        }
+    }
+
+    return evictions;
 }
 
 bool ssh_parse_step_error(const char *stderr_text, ssh_step_error_t *out) {
@@ -141,3 +241,26 @@ bool ssh_parse_step_error(const char *stderr_text, ssh_step_error_t *out) {
 
     return true;
 }
+
+bool ssh_parse_step_trace(const char **cursor, ssh_step_trace_t *out) {
+    if (!cursor || !out) {
+        return false;
+    }
+
+    for (const char *p = *cursor; p && (p = strstr(p, "TRACE step=")) != NULL; p++) {
+        char step[sizeof(out->step)];
+
+        if (sscanf(p, "TRACE step=%63s start=%lf end=%lf", step, &out->start_s, &out->end_s) != 3) {
+            continue;
+        }
+
+        strcpy(out->step, step);
+        *cursor = p + 1;
+
+        return true;
+    }
+
+    *cursor = NULL;
+
+    return false;
+}
@@ -0,0 +1,200 @@
+#include "trace.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_DETAIL_MAX 120
+
+static atomic_bool g_enabled;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *g_file = NULL;
+static char g_path[PATH_MAX];
+static long long g_written = 0;
+static long long g_max_bytes = 0;
+static int g_pid = 0;
+
+static atomic_int g_next_tid;
+static _Thread_local int t_tid;
+
+static uint64_t trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// Chrome expects small integer thread ids; number threads in the order they first record a span.
+static int trace_tid(void) {
+    if (t_tid == 0) {
+        t_tid = atomic_fetch_add_explicit(&g_next_tid, 1, memory_order_relaxed) + 1;
+    }
+
+    return t_tid;
+}
+
+// The array is never closed: the trace-event format allows a missing "]" so the file stays appendable.
+static bool trace_open_locked(void) {
+    g_file = fopen(g_path, "w");
+
+    if (!g_file) {
+        LOG_ERROR("Cannot open trace file '%s'", g_path);
+        return false;
+    }
+
+    g_written = fprintf(g_file, "[\n");
+
+    return true;
+}
+
+static void trace_rotate_locked(void) {
+    char rotated[PATH_MAX + 2];
+
+    fclose(g_file);
+    g_file = NULL;
+
+    snprintf(rotated, sizeof(rotated), "%s.1", g_path);
+
+    if (rename(g_path, rotated) != 0) {
+        LOG_WARN("Cannot rotate trace file '%s'", g_path);
+    }
+
+    if (!trace_open_locked()) {
+        atomic_store(&g_enabled, false);
+    }
+}
+
+// Long details (whole scripts) are cut to their first TRACE_DETAIL_MAX characters.
+static void trace_escape(char out[2 * TRACE_DETAIL_MAX + 1], const char *in) {
+    size_t n = 0;
+
+    for (size_t i = 0; in && in[i] && i < TRACE_DETAIL_MAX; i++) {
+        unsigned char c = (unsigned char)in[i];
+
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)c;
+        } else {
+            out[n++] = c < 0x20 ? ' ' : (char)c;
+        }
+    }
+
+    out[n] = '\0';
+}
+
+bool trace_start(const config_trace_t *cfg, const char *state_dir) {
+    if (!cfg || !cfg->enabled || !state_dir) {
+        return true;
+    }
+
+    if (!utils_create_directory(state_dir) || !utils_build_path(g_path, sizeof(g_path), state_dir, TRACE_FILE)) {
+        LOG_ERROR("Cannot prepare '%s' for the trace file", state_dir);
+        return false;
+    }
+
+    pthread_mutex_lock(&g_lock);
+
+    bool ok = trace_open_locked();
+
+    g_max_bytes = (long long)cfg->max_kb * 1024;
+    g_pid = (int)getpid();
+    atomic_store(&g_enabled, ok);
+
+    pthread_mutex_unlock(&g_lock);
+
+    if (ok) {
+        LOG_INFO("Tracing to '%s'", g_path);
+    }
+
+    return ok;
+}
+
+void trace_stop(void) {
+    atomic_store(&g_enabled, false);
+
+    pthread_mutex_lock(&g_lock);
+
+    if (g_file) {
+        fclose(g_file);
+        g_file = NULL;
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+bool trace_enabled(void) {
+    return atomic_load_explicit(&g_enabled, memory_order_relaxed);
+}
+
+uint64_t trace_begin(void) {
+    return trace_enabled() ? trace_now_us() : 0;
+}
+
+void trace_span(uint64_t start_us, uint64_t duration_us, const char *cat, const char *name, const char *detail, long long bytes) {
+    if (start_us == 0 || !trace_enabled()) {
+        return;
+    }
+
+    char escaped[2 * TRACE_DETAIL_MAX + 1];
+    char args[sizeof(escaped) + 64];
+    int n = 0;
+
+    trace_escape(escaped, detail);
+
+    if (detail) {
+        n += snprintf(args + n, sizeof(args) - (size_t)n, "\"detail\":\"%s\"", escaped);
+    }
+
+    if (bytes > 0) {
+        snprintf(args + n, sizeof(args) - (size_t)n, "%s\"bytes\":%lld", n > 0 ? "," : "", bytes);
+    } else if (n == 0) {
+        args[0] = '\0';
+    }
+
+    int tid = trace_tid();
+
+    pthread_mutex_lock(&g_lock);
+
+    if (g_file) {
+        int len = fprintf(g_file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d,\"args\":{%s}},\n",
+                          name, cat, (unsigned long long)start_us, (unsigned long long)duration_us, g_pid, tid, args);
+
+        g_written += len > 0 ? len : 0;
+
+        if (g_written > g_max_bytes) {
+            trace_rotate_locked();
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void trace_end(uint64_t start_us, const char *cat, const char *name, const char *detail, long long bytes) {
+    if (start_us == 0) {
+        return;
+    }
+
+    uint64_t now = trace_now_us();
+
+    trace_span(start_us, now > start_us ? now - start_us : 0, cat, name, detail, bytes);
+}
+
+void trace_flush(void) {
+    if (!trace_enabled()) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_lock);
+
+    if (g_file) {
+        fflush(g_file);
+    }
+
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,267 @@
+#include "transport.h"
+#include "arena.h"
+#include "deadline.h"
+#include "logger.h"
+#include "ssh.h"
+#include "ssh_commands.h"
+#include "trace.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct transport {
+    const transport_ops_t *ops;
+    void *impl;
+};
+
+static bool ssh_backend_exec(void *impl, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len) {
+    return ssh_exec_command(impl, command, stdout_data, stdout_len, stderr_data, stderr_len);
+}
+
+static bool ssh_backend_exec_write(void *impl, const char *command, const void *data, size_t len) {
+    return ssh_exec_write(impl, command, data, len);
+}
+
+static bool ssh_backend_upload_file(void *impl, const char *local_path, const char *remote_dir, unsigned long remote_mode) {
+    return ssh_scp_upload_file(impl, local_path, remote_dir, remote_mode);
+}
+
+static bool ssh_backend_upload_buffer(void *impl, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode) {
+    return ssh_scp_upload_buffer(impl, data, len, remote_dir, remote_name, remote_mode);
+}
+
+static bool ssh_backend_download_file(void *impl, const char *remote_path, const char *local_path) {
+    return ssh_scp_download_file(impl, remote_path, local_path);
+}
+
+static bool ssh_backend_stat(void *impl, const char *remote_path, transport_stat_t *out) {
+    char ssh_cmd[PATH_MAX + 64];
+    char *text = NULL;
+    bool ok = false;
+
+    if (!ssh_cmd_stat(ssh_cmd, sizeof(ssh_cmd), remote_path)) {
+        return false;
+    }
+
+    // The command prints nothing for a missing file, so a clean "no" is not logged as a failed command.
+    if (ssh_exec_command(impl, ssh_cmd, &text, NULL, NULL, NULL) && text) {
+        ok = sscanf(text, "%lld %lld", &out->size, &out->mtime) == 2;
+    }
+
+    arena_free(text);
+
+    return ok;
+}
+
+static double ssh_backend_rtt_ms(const void *impl) {
+    return ssh_session_rtt_ms(impl);
+}
+
+static void ssh_backend_close(void *impl) {
+    ssh_session_destroy(impl);
+}
+
+static const transport_ops_t g_ssh_ops = {
+    .name = "ssh",
+    .exec = ssh_backend_exec,
+    .exec_write = ssh_backend_exec_write,
+    .upload_file = ssh_backend_upload_file,
+    .upload_buffer = ssh_backend_upload_buffer,
+    .download_file = ssh_backend_download_file,
+    .stat = ssh_backend_stat,
+    .rtt_ms = ssh_backend_rtt_ms,
+    .close = ssh_backend_close,
+};
+
+// Only called with tracing on, to put the transferred size on a span.
+static long long local_file_size(const char *path) {
+    struct stat st;
+
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+// Checked before every operation so a cancelled or overdue command stops at the next device call.
+static bool transport_deadline_passed(const char *op) {
+    if (!deadline_expired()) {
+        return false;
+    }
+
+    LOG_WARN("transport_%s: not started, the command was %s.", op, deadline_cancelled() ? "cancelled" : "past its deadline");
+
+    return true;
+}
+
+transport_t *transport_create(const transport_ops_t *ops, void *impl) {
+    if (!ops || !impl) {
+        LOG_ERROR("transport_create: invalid arguments.");
+        return NULL;
+    }
+
+    transport_t *transport = calloc(1, sizeof(*transport));
+    if (!transport) {
+        LOG_ERROR("Out of memory creating transport_t");
+        ops->close(impl);
+        return NULL;
+    }
+
+    transport->ops = ops;
+    transport->impl = impl;
+
+    return transport;
+}
+
+transport_t *transport_open(const config_ssh_t *ssh_cfg) {
+    if (!ssh_cfg) {
+        LOG_ERROR("transport_open: invalid configuration");
+        return NULL;
+    }
+
+    if (transport_deadline_passed("open")) {
+        return NULL;
+    }
+
+    uint64_t span = trace_begin();
+    transport_t *transport = NULL;
+
+    if (ssh_cfg->sim.root[0] != '\0') {
+        transport = transport_sim_open(&ssh_cfg->sim);
+    } else {
+        ssh_session_t *session = ssh_session_create(ssh_cfg);
+
+        transport = session ? transport_create(&g_ssh_ops, session) : NULL;
+    }
+
+    trace_end(span, "transport", "open", ssh_cfg->host, 0);
+
+    return transport;
+}
+
+void transport_close(transport_t *transport) {
+    if (!transport) {
+        return;
+    }
+
+    transport->ops->close(transport->impl);
+    free(transport);
+}
+
+const char *transport_name(const transport_t *transport) {
+    return transport ? transport->ops->name : "none";
+}
+
+bool transport_exec(transport_t *transport, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len) {
+    if (!transport || !command) {
+        LOG_ERROR("transport_exec: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("exec")) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->exec(transport->impl, command, stdout_data, stdout_len, stderr_data, stderr_len);
+
+    trace_end(span, "transport", "exec", command, 0);
+
+    return ok;
+}
+
+bool transport_exec_write(transport_t *transport, const char *command, const void *data, size_t len) {
+    if (!transport || !command || (!data && len > 0)) {
+        LOG_ERROR("transport_exec_write: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("exec_write")) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->exec_write(transport->impl, command, data, len);
+
+    trace_end(span, "transport", "exec_write", command, (long long)len);
+
+    return ok;
+}
+
+bool transport_upload_file(transport_t *transport, const char *local_path, const char *remote_dir, unsigned long remote_mode) {
+    if (!transport || !local_path || !remote_dir) {
+        LOG_ERROR("transport_upload_file: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("upload_file")) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->upload_file(transport->impl, local_path, remote_dir, remote_mode);
+
+    trace_end(span, "transport", "upload", local_path, span ? local_file_size(local_path) : 0);
+
+    return ok;
+}
+
+bool transport_upload_buffer(transport_t *transport, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode) {
+    if (!transport || (!data && len > 0) || !remote_dir || !remote_name) {
+        LOG_ERROR("transport_upload_buffer: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("upload_buffer")) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->upload_buffer(transport->impl, data, len, remote_dir, remote_name, remote_mode);
+
+    trace_end(span, "transport", "upload", remote_name, (long long)len);
+
+    return ok;
+}
+
+bool transport_download_file(transport_t *transport, const char *remote_path, const char *local_path) {
+    if (!transport || !remote_path || !local_path) {
+        LOG_ERROR("transport_download_file: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("download_file")) {
+        return false;
+    }
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->download_file(transport->impl, remote_path, local_path);
+
+    trace_end(span, "transport", "download", remote_path, span && ok ? local_file_size(local_path) : 0);
+
+    return ok;
+}
+
+bool transport_stat(transport_t *transport, const char *remote_path, transport_stat_t *out) {
+    if (!transport || !remote_path || !out) {
+        LOG_ERROR("transport_stat: invalid arguments.");
+        return false;
+    }
+
+    if (transport_deadline_passed("stat")) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+
+    uint64_t span = trace_begin();
+    bool ok = transport->ops->stat(transport->impl, remote_path, out);
+
+    trace_end(span, "transport", "stat", remote_path, 0);
+
+    return ok;
+}
+
+double transport_rtt_ms(const transport_t *transport) {
+    return transport ? transport->ops->rtt_ms(transport->impl) : -1;
+}
@@ -0,0 +1,615 @@
+#include "transport.h"
+#include "arena.h"
+#include "deadline.h"
+#include "logger.h"
+#include "metrics.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// How long the doorbell services stay down after a kill before they are reported running again.
+#define SIM_RESTART_MS 100
+// Longest wait between checks for a cancel while a command runs or a delay is simulated.
+#define SIM_CANCEL_POLL_MS 50
+
+// Device paths that live under the root. UNIFI_REMOTE_UPLOAD_DIR is also a prefix of the staging area.
+static const char *const g_sim_device_paths[] = { "/etc/persistent", UNIFI_REMOTE_UPLOAD_DIR };
+
+// killall and pidof stand in for the doorbell services the apply script restarts: a killed service is
+// gone for SIM_RESTART_MS and then back.
+static const char g_sim_killall[] =
+    "#!/bin/sh\n"
+    "date +%s%3N > \"$SIM_RUN/$1\"\n";
+
+static const char g_sim_pidof_fmt[] =
+    "#!/bin/sh\n"
+    "[ -f \"$SIM_RUN/$1\" ] || exit 0\n"
+    "[ $(( $(date +%%s%%3N) - $(cat \"$SIM_RUN/$1\") )) -ge %d ]\n";
+
+// Factory state: welcome animation off, stock ring button sound.
+static const char g_sim_lcm_gui_conf[] =
+    "{\n"
+    "    \"customAnimations\": [\n"
+    "        { \"guiId\": \"WELCOME\", \"file\": \"\", \"count\": 1, \"durationMs\": 0, \"enable\": false, \"loop\": false }\n"
+    "    ]\n"
+    "}\n";
+
+static const char g_sim_sounds_leds_conf[] =
+    "{\n"
+    "    \"customSounds\": [\n"
+    "        { \"soundStateName\": \"RING_BUTTON_PRESSED\", \"file\": \"ring.wav\", \"enable\": false, \"repeatTimes\": 1, \"volume\": 100 }\n"
+    "    ]\n"
+    "}\n";
+
+typedef struct {
+    config_sim_t cfg;
+    char path_env[PATH_MAX * 2];
+    char run_env[PATH_MAX + 16];
+    char **envp;    // inherited environment with PATH led by the stub directory
+} sim_t;
+
+static void sim_delay(const sim_t *sim, size_t bytes) {
+    long long us = sim->cfg.latency_ms * 1000LL;
+
+    if (sim->cfg.bandwidth_kbps > 0) {
+        us += (long long)bytes * 8000 / sim->cfg.bandwidth_kbps;
+    }
+
+    if (us <= 0) {
+        return;
+    }
+
+    // Sleep in slices so a slow simulated link still honours cancels and deadlines.
+    while (us > 0 && !deadline_expired()) {
+        long long slice = us < SIM_CANCEL_POLL_MS * 1000LL ? us : SIM_CANCEL_POLL_MS * 1000LL;
+        struct timespec ts = { .tv_sec = slice / 1000000, .tv_nsec = (slice % 1000000) * 1000 };
+
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+        }
+
+        us -= slice;
+    }
+}
+
+// Poll timeout for a running command: the time left before its deadline, in slices short enough to notice a cancel.
+static int sim_poll_timeout_ms(void) {
+    int remaining = deadline_remaining_ms();
+
+    return (remaining < 0 || remaining > SIM_CANCEL_POLL_MS) ? SIM_CANCEL_POLL_MS : remaining;
+}
+
+static bool sim_map_path(const sim_t *sim, const char *remote_path, char *out, size_t out_size) {
+    for (size_t i = 0; i < sizeof(g_sim_device_paths) / sizeof(g_sim_device_paths[0]); i++) {
+        if (strncmp(remote_path, g_sim_device_paths[i], strlen(g_sim_device_paths[i])) == 0) {
+            return (size_t)snprintf(out, out_size, "%s%s", sim->cfg.root, remote_path) < out_size;
+        }
+    }
+
+    LOG_ERROR("'%s' is outside the simulated device", remote_path);
+    return false;
+}
+
+static bool is_path_char(char c) {
+    return isalnum((unsigned char)c) || c == '/' || c == '_' || c == '-' || c == '.';
+}
+
+// Copy of command with every device path moved under the root. Released with free().
+static char *sim_map_command(const sim_t *sim, const char *command) {
+    size_t root_len = strlen(sim->cfg.root);
+    size_t count = 0;
+
+    for (const char *p = command; *p; p++) {
+        for (size_t i = 0; i < sizeof(g_sim_device_paths) / sizeof(g_sim_device_paths[0]); i++) {
+            if ((p == command || !is_path_char(p[-1])) && strncmp(p, g_sim_device_paths[i], strlen(g_sim_device_paths[i])) == 0) {
+                count++;
+                break;
+            }
+        }
+    }
+
+    char *mapped = malloc(strlen(command) + count * root_len + 1);
+    if (!mapped) {
+        return NULL;
+    }
+
+    char *w = mapped;
+
+    for (const char *p = command; *p; p++) {
+        for (size_t i = 0; i < sizeof(g_sim_device_paths) / sizeof(g_sim_device_paths[0]); i++) {
+            if ((p == command || !is_path_char(p[-1])) && strncmp(p, g_sim_device_paths[i], strlen(g_sim_device_paths[i])) == 0) {
+                memcpy(w, sim->cfg.root, root_len);
+                w += root_len;
+                break;
+            }
+        }
+
+        *w++ = *p;
+    }
+
+    *w = '\0';
+
+    return mapped;
+}
+
+static bool sim_append(char **buf, size_t *size, const char *data, size_t n) {
+    char *tmp = arena_realloc(*buf, *size + n + 1);
+    if (!tmp) {
+        LOG_ERROR("Out of memory reading simulated command output.");
+        return false;
+    }
+
+    memcpy(tmp + *size, data, n);
+    *size += n;
+    tmp[*size] = '\0';
+    *buf = tmp;
+
+    return true;
+}
+
+// Runs command with /bin/sh, feeding it input and collecting both output streams like an SSH channel would.
+static bool sim_run(sim_t *sim, const char *command, const void *input, size_t input_len, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len) {
+    if (stdout_data) *stdout_data = NULL;
+    if (stdout_len) *stdout_len = 0;
+    if (stderr_data) *stderr_data = NULL;
+    if (stderr_len) *stderr_len = 0;
+
+    char *mapped = sim_map_command(sim, command);
+    if (!mapped) {
+        LOG_ERROR("Out of memory mapping command for the simulator.");
+        return false;
+    }
+
+    // stdin is a socket so a child that exits early cannot raise SIGPIPE in this process.
+    int in[2] = { -1, -1 };
+    int out[2] = { -1, -1 };
+    int err[2] = { -1, -1 };
+    char *out_buf = NULL;
+    char *err_buf = NULL;
+    size_t out_size = 0;
+    size_t err_size = 0;
+    bool ok = false;
+    int status = -1;
+    pid_t pid = -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    // Own process group, so an overdue command is killed together with everything it started.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, in) != 0 || pipe(out) != 0 || pipe(err) != 0) {
+        LOG_ERROR("Failed to create pipes for a simulated command: %s", strerror(errno));
+        goto cleanup;
+    }
+
+    // Keep these ends out of commands spawned concurrently by other devices' workers.
+    fcntl(in[1], F_SETFD, FD_CLOEXEC);
+    fcntl(out[0], F_SETFD, FD_CLOEXEC);
+    fcntl(err[0], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+    posix_spawn_file_actions_addclose(&actions, in[0]);
+    posix_spawn_file_actions_addclose(&actions, out[1]);
+    posix_spawn_file_actions_addclose(&actions, err[1]);
+
+    char *argv[] = { "sh", "-c", mapped, NULL };
+
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, sim->envp);
+    if (rc != 0) {
+        LOG_ERROR("Failed to start /bin/sh: %s", strerror(rc));
+        pid = -1;
+        goto cleanup;
+    }
+
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+    in[0] = out[1] = err[1] = -1;
+
+    const char *pending = input;
+    size_t remaining = input_len;
+
+    if (remaining == 0) {
+        close(in[1]);
+        in[1] = -1;
+    }
+
+    ok = true;
+
+    while (out[0] >= 0 || err[0] >= 0) {
+        struct pollfd fds[3] = {
+            { .fd = out[0], .events = POLLIN },
+            { .fd = err[0], .events = POLLIN },
+            { .fd = in[1], .events = POLLOUT },
+        };
+
+        if (deadline_expired()) {
+            LOG_ERROR("Simulated command %s: %s", deadline_cancelled() ? "cancelled" : "ran past its deadline", command);
+            kill(-pid, SIGKILL);
+            ok = false;
+            break;
+        }
+
+        if (poll(fds, 3, sim_poll_timeout_ms()) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_ERROR("poll failed for a simulated command: %s", strerror(errno));
+            ok = false;
+            break;
+        }
+
+        if (in[1] >= 0 && (fds[2].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            ssize_t n = send(in[1], pending, remaining, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+            if (n > 0) {
+                pending += n;
+                remaining -= (size_t)n;
+            }
+
+            if ((n < 0 && errno != EAGAIN && errno != EINTR) || remaining == 0) {
+                close(in[1]);
+                in[1] = -1;
+            }
+        }
+
+        char buffer[4096];
+        int *fd_of[2] = { &out[0], &err[0] };
+        char **buf_of[2] = { &out_buf, &err_buf };
+        size_t *size_of[2] = { &out_size, &err_size };
+
+        for (int s = 0; s < 2; s++) {
+            if (*fd_of[s] < 0 || !(fds[s].revents & (POLLIN | POLLERR | POLLHUP))) {
+                continue;
+            }
+
+            ssize_t n = read(*fd_of[s], buffer, sizeof(buffer));
+
+            if (n > 0) {
+                ok = sim_append(buf_of[s], size_of[s], buffer, (size_t)n) && ok;
+            } else if (n == 0 || errno != EINTR) {
+                close(*fd_of[s]);
+                *fd_of[s] = -1;
+            }
+        }
+    }
+
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    sim_delay(sim, input_len + out_size);
+
+    if (ok && exit_status != 0) {
+        LOG_ERROR("Simulated command exited non-zero (exit=%d): %s", exit_status, command);
+        ok = false;
+    }
+
+cleanup:
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    for (int i = 0; i < 2; i++) {
+        if (in[i] >= 0) close(in[i]);
+        if (out[i] >= 0) close(out[i]);
+        if (err[i] >= 0) close(err[i]);
+    }
+
+    if (stdout_data) {
+        *stdout_data = out_buf;
+        if (stdout_len) *stdout_len = out_size;
+    } else {
+        arena_free(out_buf);
+    }
+
+    if (stderr_data) {
+        *stderr_data = err_buf;
+        if (stderr_len) *stderr_len = err_size;
+    } else {
+        arena_free(err_buf);
+    }
+
+    free(mapped);
+
+    return ok;
+}
+
+static bool sim_write_file(const char *path, const void *data, size_t len, unsigned long mode) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        LOG_ERROR("Failed to open '%s' for writing: %s", path, strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, len, fp) == len;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok) {
+        LOG_ERROR("Short write to '%s'", path);
+        return false;
+    }
+
+    return chmod(path, (mode_t)mode) == 0;
+}
+
+static bool sim_copy_file(const char *src, const char *dst, unsigned long mode, size_t *bytes) {
+    char *data = NULL;
+    size_t len = 0;
+
+    if (!utils_read_file(src, &data, &len)) {
+        return false;
+    }
+
+    bool ok = sim_write_file(dst, data, len, mode);
+
+    arena_free(data);
+    *bytes = len;
+
+    return ok;
+}
+
+static bool sim_exec(void *impl, const char *command, char **stdout_data, size_t *stdout_len, char **stderr_data, size_t *stderr_len) {
+    return sim_run(impl, command, NULL, 0, stdout_data, stdout_len, stderr_data, stderr_len);
+}
+
+static bool sim_exec_write(void *impl, const char *command, const void *data, size_t len) {
+    if (!sim_run(impl, command, data, len, NULL, NULL, NULL, NULL)) {
+        return false;
+    }
+
+    metrics_add(METRIC_UPLOAD_BYTES, len);
+    return true;
+}
+
+static bool sim_upload_buffer(void *impl, const void *data, size_t len, const char *remote_dir, const char *remote_name, unsigned long remote_mode) {
+    sim_t *sim = impl;
+    char remote_path[PATH_MAX];
+    char path[PATH_MAX];
+
+    if ((size_t)snprintf(remote_path, sizeof(remote_path), "%s/%s", remote_dir, remote_name) >= sizeof(remote_path) ||
+        !sim_map_path(sim, remote_path, path, sizeof(path))) {
+        return false;
+    }
+
+    sim_delay(sim, len);
+
+    if (!sim_write_file(path, data, len, remote_mode)) {
+        return false;
+    }
+
+    metrics_add(METRIC_UPLOAD_BYTES, len);
+    LOG_INFO("Simulated upload complete: %zu bytes -> %s", len, remote_path);
+
+    return true;
+}
+
+static bool sim_upload_file(void *impl, const char *local_path, const char *remote_dir, unsigned long remote_mode) {
+    sim_t *sim = impl;
+    const char *base = strrchr(local_path, '/');
+    char remote_path[PATH_MAX];
+    char path[PATH_MAX];
+    size_t bytes = 0;
+
+    base = base ? base + 1 : local_path;
+
+    if ((size_t)snprintf(remote_path, sizeof(remote_path), "%s/%s", remote_dir, base) >= sizeof(remote_path) ||
+        !sim_map_path(sim, remote_path, path, sizeof(path))) {
+        return false;
+    }
+
+    if (!sim_copy_file(local_path, path, remote_mode, &bytes)) {
+        return false;
+    }
+
+    sim_delay(sim, bytes);
+    metrics_add(METRIC_UPLOAD_BYTES, bytes);
+    LOG_INFO("Simulated upload complete: %s -> %s", local_path, remote_path);
+
+    return true;
+}
+
+static bool sim_download_file(void *impl, const char *remote_path, const char *local_path) {
+    sim_t *sim = impl;
+    char path[PATH_MAX];
+    size_t bytes = 0;
+
+    if (!sim_map_path(sim, remote_path, path, sizeof(path)) || !sim_copy_file(path, local_path, 0644, &bytes)) {
+        LOG_ERROR("Simulated download failed for '%s'", remote_path);
+        return false;
+    }
+
+    sim_delay(sim, bytes);
+    metrics_add(METRIC_DOWNLOAD_BYTES, bytes);
+    LOG_INFO("Simulated download complete: %s -> %s (%zu bytes)", remote_path, local_path, bytes);
+
+    return true;
+}
+
+static bool sim_stat(void *impl, const char *remote_path, transport_stat_t *out) {
+    sim_t *sim = impl;
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (!sim_map_path(sim, remote_path, path, sizeof(path))) {
+        return false;
+    }
+
+    sim_delay(sim, 0);
+
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+
+    out->size = (long long)st.st_size;
+    out->mtime = (long long)st.st_mtime;
+
+    return true;
+}
+
+static double sim_rtt_ms(const void *impl) {
+    const sim_t *sim = impl;
+
+    return sim->cfg.latency_ms;
+}
+
+static void sim_close(void *impl) {
+    sim_t *sim = impl;
+
+    free(sim->envp);
+    free(sim);
+}
+
+static const transport_ops_t g_sim_ops = {
+    .name = "sim",
+    .exec = sim_exec,
+    .exec_write = sim_exec_write,
+    .upload_file = sim_upload_file,
+    .upload_buffer = sim_upload_buffer,
+    .download_file = sim_download_file,
+    .stat = sim_stat,
+    .rtt_ms = sim_rtt_ms,
+    .close = sim_close,
+};
+
+static bool sim_mkdirs(const char *root, const char *child) {
+    char path[PATH_MAX];
+
+    if ((size_t)snprintf(path, sizeof(path), "%s%s", root, child) >= sizeof(path)) {
+        return false;
+    }
+
+    for (char *p = path + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char saved = *p;
+            *p = '\0';
+
+            if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+                LOG_ERROR("Failed to create '%s': %s", path, strerror(errno));
+                return false;
+            }
+
+            *p = saved;
+        }
+
+        if (*p == '\0') {
+            return true;
+        }
+    }
+}
+
+static bool sim_seed_file(const char *root, const char *child, const char *content, unsigned long mode, bool overwrite) {
+    char path[PATH_MAX];
+
+    if ((size_t)snprintf(path, sizeof(path), "%s%s", root, child) >= sizeof(path)) {
+        return false;
+    }
+
+    if (!overwrite && utils_file_exists(path)) {
+        return true;
+    }
+
+    return sim_write_file(path, content, strlen(content), mode);
+}
+
+// Lays out the device directories and the service stubs, keeping any device state already in the root.
+static bool sim_prepare_root(const char *root) {
+    char pidof[sizeof(g_sim_pidof_fmt) + 16];
+
+    snprintf(pidof, sizeof(pidof), g_sim_pidof_fmt, SIM_RESTART_MS);
+
+    return sim_mkdirs(root, "/etc/persistent/lcm/animation") &&
+           sim_mkdirs(root, "/etc/persistent/sounds") &&
+           sim_mkdirs(root, UNIFI_REMOTE_UPLOAD_DIR) &&
+           sim_mkdirs(root, "/.sim/bin") &&
+           sim_mkdirs(root, "/.sim/run") &&
+           sim_seed_file(root, "/etc/persistent/ubnt_lcm_gui.conf", g_sim_lcm_gui_conf, 0644, false) &&
+           sim_seed_file(root, "/etc/persistent/ubnt_sounds_leds.conf", g_sim_sounds_leds_conf, 0644, false) &&
+           sim_seed_file(root, "/etc/persistent/sounds/ring.wav", "", 0644, false) &&
+           sim_seed_file(root, "/.sim/bin/killall", g_sim_killall, 0755, true) &&
+           sim_seed_file(root, "/.sim/bin/pidof", pidof, 0755, true);
+}
+
+static bool sim_build_env(sim_t *sim) {
+    const char *path = getenv("PATH");
+    size_t count = 0;
+
+    if ((size_t)snprintf(sim->path_env, sizeof(sim->path_env), "PATH=%s/.sim/bin:%s", sim->cfg.root, path ? path : "/usr/bin:/bin") >= sizeof(sim->path_env) ||
+        (size_t)snprintf(sim->run_env, sizeof(sim->run_env), "SIM_RUN=%s/.sim/run", sim->cfg.root) >= sizeof(sim->run_env)) {
+        LOG_ERROR("Simulator root '%s' is too long", sim->cfg.root);
+        return false;
+    }
+
+    while (environ && environ[count]) {
+        count++;
+    }
+
+    sim->envp = calloc(count + 3, sizeof(*sim->envp));
+    if (!sim->envp) {
+        LOG_ERROR("Out of memory building the simulator environment");
+        return false;
+    }
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (strncmp(environ[i], "PATH=", 5) != 0 && strncmp(environ[i], "SIM_RUN=", 8) != 0) {
+            sim->envp[n++] = environ[i];
+        }
+    }
+
+    sim->envp[n++] = sim->path_env;
+    sim->envp[n++] = sim->run_env;
+
+    return true;
+}
+
+transport_t *transport_sim_open(const config_sim_t *sim_cfg) {
+    if (!sim_cfg || sim_cfg->root[0] != '/') {
+        LOG_ERROR("transport_sim_open: the simulator root must be an absolute path");
+        return NULL;
+    }
+
+    sim_t *sim = calloc(1, sizeof(*sim));
+    if (!sim) {
+        LOG_ERROR("Out of memory creating the simulator");
+        return NULL;
+    }
+
+    sim->cfg = *sim_cfg;
+
+    if (!sim_prepare_root(sim->cfg.root) || !sim_build_env(sim)) {
+        sim_close(sim);
+        return NULL;
+    }
+
+    // Connection setup costs one round trip.
+    sim_delay(sim, 0);
+
+    LOG_INFO("Simulated doorbell ready in '%s' (latency=%dms bandwidth=%dkbps)", sim->cfg.root, sim->cfg.latency_ms, sim->cfg.bandwidth_kbps);
+
+    return transport_create(&g_sim_ops, sim);
+}
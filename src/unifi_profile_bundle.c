@@ -0,0 +1,347 @@
+#include "unifi_profile_bundle.h"
+#include "arena.h"
+#include "blob_store.h"
+#include "logger.h"
+#include "unifi_profile.h"
+#include "unifi_profile_json.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BUNDLE_MAGIC "DBPBNDL1"
+#define BUNDLE_HEADER_SIZE 32
+#define BUNDLE_NAME_SIZE 256
+#define BUNDLE_ENTRY_SIZE (BUNDLE_NAME_SIZE + 32 + 8 + 8)
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static bool bundle_read_entry(const unsigned char *base, size_t map_size, uint64_t data_offset, const unsigned char *entry, unifi_bundle_asset_t *out) {
+    const char *name = (const char *)entry;
+    size_t name_len = strnlen(name, BUNDLE_NAME_SIZE);
+
+    if (name_len == 0 || name_len == BUNDLE_NAME_SIZE || strchr(name, '/')) {
+        return false;
+    }
+
+    memcpy(out->name, name, name_len + 1);
+    memcpy(out->md5_hex, entry + BUNDLE_NAME_SIZE, 32);
+    out->md5_hex[32] = '\0';
+
+    if (!blob_store_is_md5(out->md5_hex)) {
+        return false;
+    }
+
+    uint64_t offset = get_u64(entry + BUNDLE_NAME_SIZE + 32);
+    uint64_t size = get_u64(entry + BUNDLE_NAME_SIZE + 40);
+
+    if (offset < data_offset || offset > map_size || size > map_size - offset) {
+        return false;
+    }
+
+    out->data = base + offset;
+    out->size = (size_t)size;
+
+    return true;
+}
+
+bool unifi_bundle_open(const char *path, unifi_bundle_t *out) {
+    if (!path || !out) {
+        LOG_ERROR("Invalid parameters: path=%p out=%p", (void*)path, (void*)out);
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open bundle '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size < BUNDLE_HEADER_SIZE) {
+        LOG_ERROR("Bundle '%s' is too small to be valid", path);
+        close(fd);
+        return false;
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to map bundle '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    const unsigned char *base = map;
+    uint32_t version = get_u32(base + 8);
+    uint32_t count = get_u32(base + 12);
+    uint32_t json_offset = get_u32(base + 16);
+    uint32_t json_len = get_u32(base + 20);
+    uint64_t data_offset = get_u64(base + 24);
+
+    if (memcmp(base, BUNDLE_MAGIC, 8) != 0 || version != UNIFI_BUNDLE_VERSION) {
+        LOG_ERROR("'%s' is not a version %d profile bundle", path, UNIFI_BUNDLE_VERSION);
+        goto fail;
+    }
+
+    if (count > UNIFI_BUNDLE_MAX_ASSETS || json_offset != BUNDLE_HEADER_SIZE + count * BUNDLE_ENTRY_SIZE ||
+        (uint64_t)json_offset + json_len > data_offset || data_offset > map_size) {
+        LOG_ERROR("Bundle '%s' has an invalid header", path);
+        goto fail;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *entry = base + BUNDLE_HEADER_SIZE + (size_t)i * BUNDLE_ENTRY_SIZE;
+
+        if (!bundle_read_entry(base, map_size, data_offset, entry, &out->assets[i])) {
+            LOG_ERROR("Bundle '%s' has an invalid asset entry %u", path, i);
+            goto fail;
+        }
+    }
+
+    out->map = map;
+    out->map_size = map_size;
+    out->json = (const char *)base + json_offset;
+    out->json_len = json_len;
+    out->asset_count = count;
+
+    return true;
+
+fail:
+    munmap(map, map_size);
+    memset(out, 0, sizeof(*out));
+
+    return false;
+}
+
+void unifi_bundle_close(unifi_bundle_t *bundle) {
+    if (!bundle || !bundle->map) {
+        return;
+    }
+
+    munmap(bundle->map, bundle->map_size);
+    memset(bundle, 0, sizeof(*bundle));
+}
+
+const unifi_bundle_asset_t *unifi_bundle_find(const unifi_bundle_t *bundle, const char *name) {
+    if (!bundle || !name) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < bundle->asset_count; i++) {
+        if (strcmp(bundle->assets[i].name, name) == 0) {
+            return &bundle->assets[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool pack_copy_file(FILE *out, const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        LOG_ERROR("Failed to open '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    char buffer[16384];
+    size_t n;
+    bool ok = true;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, n, out) != n) {
+            ok = false;
+            break;
+        }
+    }
+
+    if (ferror(in)) {
+        ok = false;
+    }
+
+    fclose(in);
+
+    return ok;
+}
+
+// Adds a referenced asset to the table once; missing files are only an error when the asset is enabled.
+static bool pack_add_asset(const char *profile_dir, const char *file, bool enabled, char names[][BUNDLE_NAME_SIZE], char paths[][PATH_MAX], long long *sizes, size_t *count) {
+    if (file[0] == '\0') {
+        return !enabled;
+    }
+
+    for (size_t i = 0; i < *count; i++) {
+        if (strcmp(names[i], file) == 0) {
+            return true;
+        }
+    }
+
+    if (strchr(file, '/') || strlen(file) >= BUNDLE_NAME_SIZE || !utils_build_path(paths[*count], PATH_MAX, profile_dir, file)) {
+        LOG_ERROR("Asset name '%s' cannot be packed", file);
+        return false;
+    }
+
+    struct stat st;
+
+    if (stat(paths[*count], &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (enabled) {
+            LOG_ERROR("Asset '%s' does not exist", paths[*count]);
+        }
+
+        return !enabled;
+    }
+
+    snprintf(names[*count], BUNDLE_NAME_SIZE, "%s", file);
+    sizes[*count] = (long long)st.st_size;
+    (*count)++;
+
+    return true;
+}
+
+bool unifi_bundle_pack_dir(const char *profile_dir, const char *out_path) {
+    if (!profile_dir || !out_path) {
+        LOG_ERROR("Invalid parameters: profile_dir=%p out_path=%p", (void*)profile_dir, (void*)out_path);
+        return false;
+    }
+
+    char json_path[PATH_MAX];
+    char tmp_path[PATH_MAX] = "";
+    char names[UNIFI_BUNDLE_MAX_ASSETS][BUNDLE_NAME_SIZE];
+    char paths[UNIFI_BUNDLE_MAX_ASSETS][PATH_MAX];
+    long long sizes[UNIFI_BUNDLE_MAX_ASSETS];
+    size_t count = 0;
+    char *json = NULL;
+    size_t json_len = 0;
+    unifi_profile_t profile;
+    unsigned char header[BUNDLE_HEADER_SIZE] = {0};
+    uint32_t json_offset = 0;
+    uint64_t offset = 0;
+    FILE *out = NULL;
+    bool ok = false;
+
+    if (!utils_build_path(json_path, sizeof(json_path), profile_dir, "profile.json") || !utils_read_file(json_path, &json, &json_len)) {
+        LOG_ERROR("Failed to read '%s/profile.json'", profile_dir);
+        return false;
+    }
+
+    if (!unifi_profile_load_from_json(json, json_len, json_path, &profile)) {
+        goto cleanup;
+    }
+
+    if (!pack_add_asset(profile_dir, profile.welcome.file, profile.welcome.enabled, names, paths, sizes, &count) ||
+        !pack_add_asset(profile_dir, profile.ring_button.file, profile.ring_button.enabled, names, paths, sizes, &count)) {
+        goto cleanup;
+    }
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path) >= (int)sizeof(tmp_path)) {
+        LOG_ERROR("Bundle path '%s' is too long", out_path);
+        goto cleanup;
+    }
+
+    json_offset = (uint32_t)(BUNDLE_HEADER_SIZE + count * BUNDLE_ENTRY_SIZE);
+    offset = (uint64_t)json_offset + json_len;
+
+    memcpy(header, BUNDLE_MAGIC, 8);
+    put_u32(header + 8, UNIFI_BUNDLE_VERSION);
+    put_u32(header + 12, (uint32_t)count);
+    put_u32(header + 16, json_offset);
+    put_u32(header + 20, (uint32_t)json_len);
+    put_u64(header + 24, offset);
+
+    out = fopen(tmp_path, "wb");
+    if (!out) {
+        LOG_ERROR("Failed to create '%s': %s", tmp_path, strerror(errno));
+        goto cleanup;
+    }
+
+    if (fwrite(header, 1, sizeof(header), out) != sizeof(header)) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned char entry[BUNDLE_ENTRY_SIZE] = {0};
+        char md5_hex[33];
+
+        if (!utils_md5_file_hex(paths[i], md5_hex)) {
+            LOG_ERROR("Failed to hash '%s'", paths[i]);
+            goto cleanup;
+        }
+
+        memcpy(entry, names[i], strlen(names[i]));
+        memcpy(entry + BUNDLE_NAME_SIZE, md5_hex, 32);
+        put_u64(entry + BUNDLE_NAME_SIZE + 32, offset);
+        put_u64(entry + BUNDLE_NAME_SIZE + 40, (uint64_t)sizes[i]);
+        offset += (uint64_t)sizes[i];
+
+        if (fwrite(entry, 1, sizeof(entry), out) != sizeof(entry)) {
+            goto cleanup;
+        }
+    }
+
+    if (fwrite(json, 1, json_len, out) != json_len) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!pack_copy_file(out, paths[i])) {
+            goto cleanup;
+        }
+    }
+
+    if (fclose(out) != 0) {
+        out = NULL;
+        goto cleanup;
+    }
+
+    out = NULL;
+
+    if (rename(tmp_path, out_path) != 0) {
+        LOG_ERROR("Failed to rename '%s' to '%s': %s", tmp_path, out_path, strerror(errno));
+        goto cleanup;
+    }
+
+    LOG_INFO("Packed '%s' into '%s' (%zu asset(s), %llu bytes)", profile_dir, out_path, count, (unsigned long long)offset);
+    ok = true;
+
+cleanup:
+    if (out) {
+        fclose(out);
+    }
+
+    if (!ok && tmp_path[0] != '\0') {
+        unlink(tmp_path);
+    }
+
+    arena_free(json);
+
+    return ok;
+}
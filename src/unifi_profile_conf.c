@@ -1,10 +1,13 @@
 #include "unifi_profile_conf.h"
+#include "arena.h"
 #include "cJSON.h"
+#include "json_scan.h"
 #include "logger.h"
 #include "utils.h"
 #include "utils_json.h"
 
 #include <errno.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,11 +52,11 @@ bool unifi_profile_read_from_lcm_gui_conf(const char *path, unifi_profile_t *out
     
     if (!root) {
         LOG_ERROR("Error reading conf file '%s' at '%s'", path, error_ptr);
-        free(file_buffer);
+        arena_free(file_buffer);
         return false;
     }
 
-    free(file_buffer);
+    arena_free(file_buffer);
     file_buffer = NULL;
 
     unifi_profile_welcome_reset(&out->welcome);
@@ -105,6 +108,11 @@ bool unifi_profile_read_from_lcm_gui_conf(const char *path, unifi_profile_t *out
             out->welcome.enabled = enabled;
         }
 
+        bool loop = false;
+        if (json_get_bool(item, "loop", &loop)) {
+            out->welcome.loop = loop;
+        }
+
         result = true;
         break;
     }
@@ -134,11 +142,11 @@ bool unifi_profile_read_from_sounds_leds_conf(const char *path, unifi_profile_t
     
     if (!root) {
         LOG_ERROR("Error reading conf file '%s' at '%s'", path, error_ptr);
-        free(file_buffer);
+        arena_free(file_buffer);
         return false;
     }
 
-    free(file_buffer);
+    arena_free(file_buffer);
     file_buffer = NULL;
 
     unifi_profile_ring_button_reset(&out->ring_button);
@@ -197,231 +205,381 @@ cleanup:
     return result;
 }
 
-bool unifi_profile_patch_lcm_gui_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired) {
-    if (!in_path || !out_path || !desired) {
-        LOG_ERROR("Invalid parameters: in_path=%p out_path=%p, desired=%p", (void*)in_path, (void*)out_path, (void*)desired);
+#define CONF_MAX_EDITS 8
+// Room for a 255 byte file name with every byte escaped as \u00XX.
+#define CONF_FIELD_SIZE 1600
+#define CONF_ENTRY_SIZE 4096
+
+// A splice into the input: remove bytes [at, at + len) and write text in their place.
+typedef struct {
+    size_t at;
+    size_t len;
+    char text[CONF_ENTRY_SIZE + 64];
+} conf_edit_t;
+
+typedef struct {
+    const char *key;
+    char value[CONF_FIELD_SIZE];    // already rendered as JSON
+} conf_field_t;
+
+typedef struct {
+    conf_edit_t edits[CONF_MAX_EDITS];
+    size_t count;
+} conf_edits_t;
+
+__attribute__((format(printf, 4, 5)))
+static bool conf_add_edit(conf_edits_t *edits, size_t at, size_t len, const char *fmt, ...) {
+    if (edits->count == CONF_MAX_EDITS) {
         return false;
     }
 
-    char *file_buffer = NULL;
+    conf_edit_t *edit = &edits->edits[edits->count];
+    va_list ap;
 
-    if (!utils_read_file(in_path, &file_buffer, NULL)) {
-        LOG_ERROR("Failed to read config file: %s", in_path);
+    va_start(ap, fmt);
+    int n = vsnprintf(edit->text, sizeof(edit->text), fmt, ap);
+    va_end(ap);
+
+    if (n < 0 || (size_t)n >= sizeof(edit->text)) {
         return false;
     }
 
-    const char *error_ptr  = NULL;
+    edit->at = at;
+    edit->len = len;
+    edits->count++;
 
-    cJSON *root = cJSON_ParseWithOpts(file_buffer, &error_ptr, false);
-    
-    if (!root) {
-        LOG_ERROR("Error reading conf file '%s' at '%s'", in_path, error_ptr ? error_ptr : "(unkown error)");
-        free(file_buffer);
+    return true;
+}
+
+// Renders {"<id_key>":"<id_value>","k1":v1,...} compactly.
+static bool conf_render_entry(char *out, size_t out_size, const char *id_key, const char *id_value, const conf_field_t *fields, size_t field_count) {
+    size_t n = (size_t)snprintf(out, out_size, "{\"%s\":\"%s\"", id_key, id_value);
+
+    for (size_t i = 0; i < field_count && n < out_size; i++) {
+        n += (size_t)snprintf(out + n, out_size - n, ",\"%s\":%s", fields[i].key, fields[i].value);
+    }
+
+    if (n + 2 > out_size) {
         return false;
     }
 
-    free(file_buffer);
-    file_buffer = NULL;
+    out[n++] = '}';
+    out[n] = '\0';
 
-    char *json = NULL;
-    bool result = false;
+    return true;
+}
 
-    cJSON *animations = cJSON_GetObjectItemCaseSensitive(root, "customAnimations");
-    if (!cJSON_IsArray(animations)) {
-        animations = cJSON_AddArrayToObject(root, "customAnimations");
-        if (!animations) {
-            LOG_ERROR("Failed to create customAnimations array");
-            goto cleanup;
-        }
+static bool conf_apply_edits(const char *in, size_t in_len, conf_edits_t *edits, char **out, size_t *out_len) {
+    size_t size = in_len + 1;
+
+    for (size_t i = 0; i < edits->count; i++) {
+        size += strlen(edits->edits[i].text);
     }
 
-    if (desired->welcome.enabled && desired->welcome.file[0] != '\0') {
+    // Stable insertion sort by offset: inserts at the same offset keep the order they were added in.
+    for (size_t i = 1; i < edits->count; i++) {
+        for (size_t j = i; j > 0 && edits->edits[j - 1].at > edits->edits[j].at; j--) {
+            conf_edit_t tmp = edits->edits[j];
+            edits->edits[j] = edits->edits[j - 1];
+            edits->edits[j - 1] = tmp;
+        }
+    }
 
-        cJSON *welcome = NULL;
-        cJSON *item = NULL;
+    char *buf = malloc(size);
+    if (!buf) {
+        return false;
+    }
 
-        cJSON_ArrayForEach(item, animations) {
-            if (!cJSON_IsObject(item)) {
-                continue;
-            }
+    size_t pos = 0;
+    size_t n = 0;
 
-            cJSON *gui_id = cJSON_GetObjectItemCaseSensitive(item, "guiId");
+    for (size_t i = 0; i < edits->count; i++) {
+        const conf_edit_t *edit = &edits->edits[i];
+        size_t text_len = strlen(edit->text);
 
-            if (cJSON_IsString(gui_id) && strcmp(gui_id->valuestring, "WELCOME") == 0) {
-                welcome = item;
-                break;
-            } 
+        if (edit->at < pos || edit->at + edit->len > in_len) {
+            free(buf);
+            return false;
         }
 
-        if (!welcome) {
-            welcome = cJSON_CreateObject();
-            if (!welcome) goto cleanup;
-            cJSON_AddStringToObject(welcome, "guiId", "WELCOME");
-            cJSON_AddItemToArray(animations, welcome);
-        }
+        memcpy(buf + n, in + pos, edit->at - pos);
+        n += edit->at - pos;
+        memcpy(buf + n, edit->text, text_len);
+        n += text_len;
+        pos = edit->at + edit->len;
+    }
+
+    memcpy(buf + n, in + pos, in_len - pos);
+    n += in_len - pos;
+    buf[n] = '\0';
+
+    *out = buf;
+    *out_len = n;
+
+    return true;
+}
 
-        if (!json_upsert_number_cs(welcome, "count", desired->welcome.count)) {
-            goto cleanup;
+// Upserts (or, with remove, deletes) the element of root[array_key] whose id_key is id_value, touching only
+// the bytes that change. Members of the element that are not in fields keep their bytes and position.
+static bool conf_splice_entry(const char *in, size_t in_len, const char *array_key, const char *id_key, const char *id_value,
+                              const conf_field_t *fields, size_t field_count, bool remove, char **out, size_t *out_len) {
+    const char *end = in + in_len;
+    const char *root = json_scan_skip_ws(in, end);
+    const char *root_end = json_scan_skip_value(root, end);
+    const char *array = NULL;
+    const char *array_end = NULL;
+    char entry[CONF_ENTRY_SIZE];
+    conf_edits_t edits;
+
+    edits.count = 0;
+
+    if (!root_end || *root != '{' || json_scan_skip_ws(root_end, end) != end) {
+        LOG_ERROR("Conf is not a JSON object");
+        return false;
+    }
+
+    if (!remove && !conf_render_entry(entry, sizeof(entry), id_key, id_value, fields, field_count)) {
+        return false;
+    }
+
+    if (!json_scan_find_member(root, end, array_key, &array, &array_end) || *array != '[') {
+        if (remove) {
+            return conf_apply_edits(in, in_len, &edits, out, out_len);
         }
 
-        if (!json_upsert_number_cs(welcome, "durationMs", desired->welcome.duration_ms)) {
-            goto cleanup;
+        if (array) {
+            // Present but not an array: replace it.
+            if (!conf_add_edit(&edits, (size_t)(array - in), (size_t)(array_end - array), "[%s]", entry)) {
+                return false;
+            }
+        } else {
+            bool empty = *json_scan_skip_ws(root + 1, end) == '}';
+
+            if (!conf_add_edit(&edits, (size_t)(root_end - 1 - in), 0, "%s\"%s\":[%s]", empty ? "" : ",", array_key, entry)) {
+                return false;
+            }
         }
 
-        if (!json_upsert_bool_cs(welcome, "enable", desired->welcome.enabled)) {
-            goto cleanup;
+        return conf_apply_edits(in, in_len, &edits, out, out_len);
+    }
+
+    const char *p = json_scan_skip_ws(array + 1, end);
+    const char *prev_end = NULL;
+    const char *element = NULL;
+    const char *element_end = NULL;
+
+    while (p < array_end - 1) {
+        const char *e_end = json_scan_skip_value(p, end);
+        const char *id = NULL;
+        const char *id_end = NULL;
+
+        if (!e_end) {
+            return false;
         }
 
-        if (!json_upsert_string_cs(welcome, "file", desired->welcome.file)) {
-            goto cleanup;
+        if (*p == '{' && json_scan_find_member(p, end, id_key, &id, &id_end) && json_scan_string_equals(id, id_end, id_value)) {
+            element = p;
+            element_end = e_end;
+            break;
         }
 
-        if (!json_upsert_bool_cs(welcome, "loop", desired->welcome.loop)) {
-            goto cleanup;
+        prev_end = e_end;
+        p = json_scan_skip_ws(e_end, end);
+
+        if (*p == ',') {
+            p = json_scan_skip_ws(p + 1, end);
         }
-    } else {
-        int count = cJSON_GetArraySize(animations);
+    }
 
-        for (int i = 0; i < count; i++) {
-             cJSON *item = cJSON_GetArrayItem(animations, i);
-        
-             if (!cJSON_IsObject(item)) continue;
+    if (remove) {
+        if (element) {
+            const char *from = prev_end ? prev_end : element;
+            const char *to = element_end;
 
-             cJSON *guiId = cJSON_GetObjectItemCaseSensitive(item, "guiId");
+            if (!prev_end) {
+                // First element: take the following comma with it.
+                const char *next = json_scan_skip_ws(element_end, end);
 
-             if (cJSON_IsString(guiId) && strcmp(guiId->valuestring, "WELCOME") == 0) {
-                cJSON_DetachItemFromArray(animations, i);
-                break;
-             }
+                if (*next == ',') {
+                    to = json_scan_skip_ws(next + 1, end);
+                }
+            }
+
+            if (!conf_add_edit(&edits, (size_t)(from - in), (size_t)(to - from), "%s", "")) {
+                return false;
+            }
         }
 
+        return conf_apply_edits(in, in_len, &edits, out, out_len);
     }
 
-    json = cJSON_Print(root);
+    if (!element) {
+        bool empty = *json_scan_skip_ws(array + 1, end) == ']';
 
-    if (!json) {
-        goto cleanup;
+        if (!conf_add_edit(&edits, (size_t)(array_end - 1 - in), 0, "%s%s", empty ? "" : ",", entry)) {
+            return false;
+        }
+
+        return conf_apply_edits(in, in_len, &edits, out, out_len);
     }
 
-    if (!utils_write_file(out_path, json)) {
-        goto cleanup;
+    for (size_t i = 0; i < field_count; i++) {
+        const char *v = NULL;
+        const char *v_end = NULL;
+
+        bool ok = json_scan_find_member(element, end, fields[i].key, &v, &v_end)
+            ? conf_add_edit(&edits, (size_t)(v - in), (size_t)(v_end - v), "%s", fields[i].value)
+            : conf_add_edit(&edits, (size_t)(element_end - 1 - in), 0, ",\"%s\":%s", fields[i].key, fields[i].value);
+
+        if (!ok) {
+            return false;
+        }
     }
 
-    result = true;
+    return conf_apply_edits(in, in_len, &edits, out, out_len);
+}
 
-cleanup:
-    if (json) {
-        cJSON_free(json);
+bool unifi_profile_patch_lcm_gui_buffer(const char *in, size_t in_len, const unifi_profile_t *desired, char **out, size_t *out_len) {
+    if (!in || !desired || !out || !out_len) {
+        LOG_ERROR("Invalid parameters: in=%p desired=%p out=%p out_len=%p", (void*)in, (void*)desired, (void*)out, (void*)out_len);
+        return false;
     }
 
-    cJSON_Delete(root);
+    const unifi_profile_welcome_t *w = &desired->welcome;
+    bool enabled = w->enabled && w->file[0] != '\0';
+    conf_field_t fields[] = {
+        { .key = "count" },
+        { .key = "durationMs" },
+        { .key = "enable" },
+        { .key = "file" },
+        { .key = "loop" },
+    };
+
+    snprintf(fields[0].value, sizeof(fields[0].value), "%d", w->count);
+    snprintf(fields[1].value, sizeof(fields[1].value), "%d", w->duration_ms);
+    snprintf(fields[2].value, sizeof(fields[2].value), "%s", w->enabled ? "true" : "false");
+    snprintf(fields[4].value, sizeof(fields[4].value), "%s", w->loop ? "true" : "false");
+
+    if (!json_scan_quote(fields[3].value, sizeof(fields[3].value), w->file)) {
+        return false;
+    }
 
-    return result;
+    return conf_splice_entry(in, in_len, "customAnimations", "guiId", "WELCOME", fields, sizeof(fields) / sizeof(fields[0]), !enabled, out, out_len);
 }
 
-
-bool unifi_profile_patch_sounds_leds_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired) {
-    if (!in_path || !out_path || !desired) {
-        LOG_ERROR("Invalid parameters: in_path=%p out_path=%p, desired=%p", (void*)in_path, (void*)out_path, (void*)desired);
+bool unifi_profile_patch_sounds_leds_buffer(const char *in, size_t in_len, const unifi_profile_t *desired, char **out, size_t *out_len) {
+    if (!in || !desired || !out || !out_len) {
+        LOG_ERROR("Invalid parameters: in=%p desired=%p out=%p out_len=%p", (void*)in, (void*)desired, (void*)out, (void*)out_len);
         return false;
     }
 
-    if (!desired->ring_button.enabled || desired->ring_button.file[0] == '\0') {
-        LOG_DEBUG("Ring button disabled or no file set, copying config unchanged");
+    const unifi_profile_ring_button_t *r = &desired->ring_button;
+    conf_field_t fields[] = {
+        { .key = "enable" },
+        { .key = "file" },
+        { .key = "repeatTimes" },
+        { .key = "volume" },
+    };
 
-        if (rename(in_path, out_path) != 0) {
-            LOG_ERROR("Failed to rename '%s' to '%s': %s", in_path, out_path, strerror(errno));
-            return false;
-        }   
+    snprintf(fields[0].value, sizeof(fields[0].value), "%s", r->enabled ? "true" : "false");
+    snprintf(fields[2].value, sizeof(fields[2].value), "%d", r->repeat_times);
+    snprintf(fields[3].value, sizeof(fields[3].value), "%d", r->volume);
 
-        return true;
+    if (!json_scan_quote(fields[1].value, sizeof(fields[1].value), r->file)) {
+        return false;
     }
 
+    return conf_splice_entry(in, in_len, "customSounds", "soundStateName", "RING_BUTTON_PRESSED", fields, sizeof(fields) / sizeof(fields[0]), false, out, out_len);
+}
+
+static bool conf_patch_file(const char *in_path, const char *out_path, const unifi_profile_t *desired,
+                            bool (*patch)(const char *, size_t, const unifi_profile_t *, char **, size_t *)) {
     char *file_buffer = NULL;
+    size_t file_len = 0;
+    char *patched = NULL;
+    size_t patched_len = 0;
 
-    if (!utils_read_file(in_path, &file_buffer, NULL)) {
+    if (!utils_read_file(in_path, &file_buffer, &file_len)) {
         LOG_ERROR("Failed to read config file: %s", in_path);
         return false;
     }
 
-    const char *error_ptr  = NULL;
-
-    cJSON *root = cJSON_ParseWithOpts(file_buffer, &error_ptr, false);
-    
-    if (!root) {
-        LOG_ERROR("Error reading conf file '%s' at '%s'", in_path, error_ptr ? error_ptr : "(unkown error)");
-        free(file_buffer);
+    if (!patch(file_buffer, file_len, desired, &patched, &patched_len)) {
+        LOG_ERROR("Failed to patch conf file '%s'", in_path);
+        arena_free(file_buffer);
         return false;
     }
 
-    free(file_buffer);
-    file_buffer = NULL;
+    arena_free(file_buffer);
 
-    char *json = NULL;
-    bool result = false;
+    bool result = utils_write_file(out_path, patched);
 
-    cJSON *sounds = cJSON_GetObjectItemCaseSensitive(root, "customSounds");
-    if (!cJSON_IsArray(sounds)) {
-        sounds = cJSON_AddArrayToObject(root, "customSounds");
-        if (!sounds) {
-            LOG_ERROR("Failed to create customSounds array");
-            goto cleanup;
-        }
-    }
+    free(patched);
 
-    cJSON *sound = NULL;
-    cJSON *item = NULL;
+    return result;
+}
 
-    cJSON_ArrayForEach(item, sounds) {
-        if (!cJSON_IsObject(item)) {
-            continue;
-        }
+bool unifi_profile_patch_lcm_gui_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired) {
+    if (!in_path || !out_path || !desired) {
+        LOG_ERROR("Invalid parameters: in_path=%p out_path=%p, desired=%p", (void*)in_path, (void*)out_path, (void*)desired);
+        return false;
+    }
 
-        cJSON *state = cJSON_GetObjectItemCaseSensitive(item, "soundStateName");
+    return conf_patch_file(in_path, out_path, desired, unifi_profile_patch_lcm_gui_buffer);
+}
 
-        if (cJSON_IsString(state) && strcmp(state->valuestring, "RING_BUTTON_PRESSED") == 0) {
-            sound = item;
-            break;
-        }
+bool unifi_profile_patch_sounds_leds_conf(const char *in_path, const char *out_path, const unifi_profile_t *desired) {
+    if (!in_path || !out_path || !desired) {
+        LOG_ERROR("Invalid parameters: in_path=%p out_path=%p, desired=%p", (void*)in_path, (void*)out_path, (void*)desired);
+        return false;
     }
 
-    if (!sound) {
-        sound = cJSON_CreateObject();
-        if (!sound) {
-            goto cleanup;
-        }
+    if (!desired->ring_button.enabled || desired->ring_button.file[0] == '\0') {
+        LOG_DEBUG("Ring button disabled or no file set, copying config unchanged");
+
+        if (rename(in_path, out_path) != 0) {
+            LOG_ERROR("Failed to rename '%s' to '%s': %s", in_path, out_path, strerror(errno));
+            return false;
+        }   
 
-        cJSON_AddStringToObject(sound, "soundStateName", "RING_BUTTON_PRESSED");
-        cJSON_AddItemToArray(sounds, sound);
+        return true;
     }
 
-    cJSON_ReplaceItemInObjectCaseSensitive(sound, "enable", cJSON_CreateBool(desired->ring_button.enabled));
+    return conf_patch_file(in_path, out_path, desired, unifi_profile_patch_sounds_leds_buffer);
+}
 
-    cJSON_ReplaceItemInObjectCaseSensitive(sound, "file", cJSON_CreateString(desired->ring_button.file));
+bool unifi_profile_conf_equivalent(const char *a, size_t a_len, const char *b, size_t b_len) {
+    if (!a || !b) {
+        return false;
+    }
 
-    cJSON_ReplaceItemInObjectCaseSensitive(sound, "repeatTimes", cJSON_CreateNumber(desired->ring_button.repeat_times));
+    cJSON *a_root = cJSON_ParseWithLength(a, a_len);
+    cJSON *b_root = cJSON_ParseWithLength(b, b_len);
 
-    cJSON_ReplaceItemInObjectCaseSensitive(sound, "volume", cJSON_CreateNumber(desired->ring_button.volume));
+    bool equal = a_root && b_root && cJSON_Compare(a_root, b_root, true);
 
-    json = cJSON_Print(root);
+    cJSON_Delete(a_root);
+    cJSON_Delete(b_root);
 
-    if (!json) {
-        goto cleanup;
-    }
+    return equal;
+}
 
-    if (!utils_write_file(out_path, json)) {
+bool unifi_profile_conf_files_equivalent(const char *a_path, const char *b_path) {
+    char *a = NULL;
+    char *b = NULL;
+    size_t a_len = 0;
+    size_t b_len = 0;
+    bool equal = false;
+
+    if (!a_path || !b_path || !utils_read_file(a_path, &a, &a_len) || !utils_read_file(b_path, &b, &b_len)) {
         goto cleanup;
     }
 
-    result = true;
+    equal = unifi_profile_conf_equivalent(a, a_len, b, b_len);
 
 cleanup:
-    if (json) {
-        cJSON_free(json);
-    }
+    arena_free(a);
+    arena_free(b);
 
-    cJSON_Delete(root);
-
-    return result;
+    return equal;
 }
-
@@ -1,14 +1,43 @@
 #include "unifi_profile_json.h"
-#include "cJSON.h"
+#include "arena.h"
+#include "unifi_profile_bundle.h"
 #include "logger.h"
 #include "utils.h"
-#include "utils_json.h"
 #include <linux/limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define X(member, key, kind, def) JSON_BIND_FIELD(unifi_profile_welcome_t, member, key, kind, def)
+static const json_bind_field_t UNIFI_PROFILE_WELCOME_FIELDS[] = {
+#include "unifi_profile_welcome.def"
+};
+#undef X
+
+#define X(member, key, kind, def) JSON_BIND_FIELD(unifi_profile_ring_button_t, member, key, kind, def)
+static const json_bind_field_t UNIFI_PROFILE_RING_BUTTON_FIELDS[] = {
+#include "unifi_profile_ring_button.def"
+};
+#undef X
+
+#define X(member, key, kind, def) JSON_BIND_FIELD(unifi_profile_t, member, key, kind, def)
+#define X_OBJECT(member, key, fields) JSON_BIND_OBJECT(unifi_profile_t, member, key, fields)
+const json_bind_field_t UNIFI_PROFILE_FIELDS[] = {
+#include "unifi_profile.def"
+};
+#undef X
+#undef X_OBJECT
+
+#define X(member, key, kind, def) JSON_BIND_FIELD(unifi_last_applied_profile_t, member, key, kind, def)
+const json_bind_field_t UNIFI_LAST_APPLIED_FIELDS[] = {
+#include "unifi_last_applied.def"
+};
+#undef X
+
+const size_t UNIFI_PROFILE_FIELD_COUNT = sizeof(UNIFI_PROFILE_FIELDS) / sizeof(UNIFI_PROFILE_FIELDS[0]);
+const size_t UNIFI_LAST_APPLIED_FIELD_COUNT = sizeof(UNIFI_LAST_APPLIED_FIELDS) / sizeof(UNIFI_LAST_APPLIED_FIELDS[0]);
+
 bool unifi_profile_load_from_file(const char *path, unifi_profile_t *p) {
     if (!path || !p) {
         LOG_ERROR("Invalid parameters: path=%p p=%p", (void*)path, (void*)p);
@@ -17,6 +46,25 @@ bool unifi_profile_load_from_file(const char *path, unifi_profile_t *p) {
 
     char profile_path[PATH_MAX];
 
+    if (!utils_build_path(profile_path, sizeof(profile_path), path, UNIFI_BUNDLE_FILE)) {
+        LOG_ERROR("Error building path profile path");
+        return false;
+    }
+
+    // A packed bundle takes precedence over loose files in the same directory.
+    if (utils_file_exists(profile_path)) {
+        unifi_bundle_t bundle;
+
+        if (!unifi_bundle_open(profile_path, &bundle)) {
+            return false;
+        }
+
+        bool ok = unifi_profile_load_from_json(bundle.json, bundle.json_len, profile_path, p);
+        unifi_bundle_close(&bundle);
+
+        return ok;
+    }
+
     if (!utils_build_path(profile_path, sizeof(profile_path), path, "profile.json")) {
         LOG_ERROR("Error building path profile path");
         return false;
@@ -27,103 +75,34 @@ bool unifi_profile_load_from_file(const char *path, unifi_profile_t *p) {
         return false;
     }
 
-    memset((void*)p, 0, sizeof(*p));
-
     char *json_buffer = NULL;
+    size_t json_len = 0;
 
-    if (!utils_read_file(profile_path, &json_buffer, NULL)) {
+    if (!utils_read_file(profile_path, &json_buffer, &json_len)) {
         LOG_ERROR("Failed to read the profile file: %s", profile_path);
         return false;
     }
 
-    const char *error_ptr = NULL;
+    bool ok = unifi_profile_load_from_json(json_buffer, json_len, profile_path, p);
+    arena_free(json_buffer);
 
-    cJSON *root = cJSON_ParseWithOpts(json_buffer, &error_ptr, false);
+    return ok;
+}
 
-    if (!root) {
-        LOG_ERROR("JSON parsing error in %s before: %s", profile_path, error_ptr ? error_ptr : "(unknown position)");
-        free(json_buffer);
+bool unifi_profile_load_from_json(const char *json, size_t json_len, const char *source, unifi_profile_t *p) {
+    if (!json || !p) {
+        LOG_ERROR("Invalid parameters: json=%p p=%p", (void*)json, (void*)p);
         return false;
     }
 
-    free(json_buffer);
-    json_buffer = NULL;
-
-    if (!json_get_int(root, "schemaVersion", &p->schema_version)) {
-        LOG_ERROR("Failed to load schema version using default of 1");
-        p->schema_version = 1;
-    }
-
-    cJSON *animation = cJSON_GetObjectItemCaseSensitive(root, "welcome");
-    cJSON *sound = cJSON_GetObjectItemCaseSensitive(root, "ringButton");
-
-    if (animation) {
-        bool enabled = false;
-        if (json_get_bool(animation, "enabled", &enabled)) {
-            p->welcome.enabled = enabled;
-        }
-
-        const char *file = json_get_string(animation, "file");
-
-        if (file) {
-            snprintf(p->welcome.file, sizeof(p->welcome.file), "%s", file);
-        }
-
-        int count = 0;
-        if (json_get_int(animation, "count", &count)) {
-            p->welcome.count = count;
-        }
-
-        int durationMs = 0;
-        if (json_get_int(animation, "durationMs", &durationMs)) {
-            p->welcome.duration_ms = durationMs;
-        }
-
-        bool loop = false;
-        if (json_get_bool(animation, "loop", &loop)) {
-            p->welcome.loop = loop;
-        }
-
-        const char *guiId = json_get_string(animation, "guiId");
-
-        if (guiId) {
-            snprintf(p->welcome.gui_id, sizeof(p->welcome.gui_id), "%s", guiId);
-        }
-    }
-
-    if (sound) {
-        bool enabled = false;
-        if (json_get_bool(sound, "enabled", &enabled)) {
-            p->ring_button.enabled = enabled;
-        }
-
-        const char *file = json_get_string(sound, "file");
+    json_bind_error_t err;
 
-        if (file) {
-            snprintf(p->ring_button.file, sizeof(p->ring_button.file), "%s", file);
-        }
-
-        int repeat_times = 1;
-        if (json_get_int(sound, "repeatTimes", &repeat_times)) {
-            p->ring_button.repeat_times = repeat_times;
-        }
-
-        int volume = 100;
-        if (json_get_int(sound, "volume", &volume)) {
-            p->ring_button.volume = volume;
-        }
-
-        const char *state_name = json_get_string(sound, "soundStateName");
-
-        if (state_name) {
-            snprintf(p->ring_button.sound_state_name, sizeof(p->ring_button.sound_state_name), "%s", state_name);
-        }
+    if (!json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, json, json_len, p, &err)) {
+        LOG_ERROR("JSON parsing error in %s:%d:%d: %s", source ? source : "profile", err.line, err.column, err.message);
+        return false;
     }
 
-    cJSON_Delete(root);
-
     return true;
-    
 }
 
 bool unifi_profile_write_to_file(const char *path, const unifi_profile_t *p) {
@@ -132,70 +111,19 @@ bool unifi_profile_write_to_file(const char *path, const unifi_profile_t *p) {
         return false;
     }
 
-    cJSON *root = cJSON_CreateObject();
-
-    if (!root) {
-        LOG_ERROR("Failed to create 'root' object");
-        return false;
-    }
+    // Profiles read back from a device carry no schema version; the file is always written in the current one.
+    unifi_profile_t current = *p;
+    current.schema_version = 1;
 
     char *json = NULL;
-    bool result = false;
-
-    cJSON_AddNumberToObject(root, "schemaVersion", 1);
-
-    cJSON *welcome = cJSON_AddObjectToObject(root, "welcome");
-
-    if (!welcome) {
-        LOG_ERROR("Failed to create 'welcome' object");
-        goto cleanup;
-    }
 
-    if (!cJSON_AddBoolToObject(welcome, "enabled", p->welcome.enabled) ||
-        !cJSON_AddStringToObject(welcome, "file", p->welcome.file) ||
-        !cJSON_AddNumberToObject(welcome, "count", p->welcome.count) ||
-        !cJSON_AddNumberToObject(welcome, "durationMs", p->welcome.duration_ms) ||
-        !cJSON_AddBoolToObject(welcome, "loop", p->welcome.loop) ||
-        !cJSON_AddStringToObject(welcome, "guiId", p->welcome.gui_id)) {
-            LOG_ERROR("Failed to populate 'welcome' object");
-            goto cleanup;
-        }
-
-    cJSON *ringButton = cJSON_AddObjectToObject(root, "ringButton");
-
-    if (!ringButton) {
-        goto cleanup;
-    }
-
-    if (!cJSON_AddBoolToObject(ringButton, "enabled", p->ring_button.enabled) ||
-        !cJSON_AddStringToObject(ringButton, "file", p->ring_button.file) ||
-        !cJSON_AddNumberToObject(ringButton, "repeatTimes", p->ring_button.repeat_times) ||
-        !cJSON_AddNumberToObject(ringButton, "volume", p->ring_button.volume) ||
-        !cJSON_AddStringToObject(ringButton, "soundStateName", p->ring_button.sound_state_name)) {
-            LOG_ERROR("Failed to populate 'ringButton' object");
-            goto cleanup;
-        }
-
-    json = cJSON_Print(root);
-
-    if (!json) {
-        goto cleanup;
-    }
-
-    if (!utils_write_file(path, json)) {
-        goto cleanup;
-    }
-
-    result = true;
-
-cleanup:
-    if (json) {
-        cJSON_free(json);
+    if (!json_bind_write(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, &current, &json, NULL)) {
+        LOG_ERROR("Failed to serialize profile for '%s'", path);
+        return false;
     }
 
-    cJSON_Delete(root);
+    bool result = utils_write_file(path, json);
+    free(json);
 
     return result;
-
 }
-
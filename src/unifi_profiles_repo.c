@@ -1,31 +1,77 @@
 #include "unifi_profiles_repo.h"
+#include "arena.h"
+#include "blob_store.h"
 #include "cJSON.h"
 #include "config_types.h"
+#include "errors.h"
 #include "logger.h"
+#include "unifi_profile_json.h"
 #include "utils.h"
-#include "utils_json.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <glob.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>
 #include <sys/stat.h>
 
-static const config_preset_t *g_profiles_cfg = NULL; 
+typedef struct {
+    config_preset_item_t item;      // owned copy of the configured mapping
+    profiles_preset_t *preset;      // NULL when the profile failed to load
+    int error;
+} profiles_slot_t;
+
+// Preset catalog: one slot per configured preset plus an open-addressed index on the normalized name.
+// The whole catalog is replaced on a config reload; single slots are replaced when a profile changes.
+typedef struct {
+    profiles_slot_t *slots;
+    size_t count;
+    size_t *index;      // slot number + 1, 0 = empty
+    size_t capacity;    // power of two
+} profiles_catalog_t;
+
+// Guards g_catalog, slot->preset and every preset's refs/retired.
+static pthread_mutex_t g_catalog_lock = PTHREAD_MUTEX_INITIALIZER;
+static profiles_catalog_t *g_catalog = NULL;
 static char *g_profiles_dir = NULL;
+static long long g_downloads_max_bytes = 0;    // 0 = unbounded
 
 static bool profiles_initialized(void) {
-    return g_profiles_dir != NULL && g_profiles_cfg != NULL;
+    return g_profiles_dir != NULL && g_catalog != NULL;
 }
 
-static const char *config_get_preset_directory(const char *preset_name) {
-    for (size_t i = 0; i < g_profiles_cfg->count; i++) {
-        if (strcasecmp(g_profiles_cfg->items[i].display_name, preset_name) == 0) {
-            return g_profiles_cfg->items[i].directory;
+static size_t catalog_hash(const char *key) {
+    // FNV-1a
+    uint64_t h = 1469598103934665603ULL;
+
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+
+    return (size_t)h;
+}
+
+// Caller holds g_catalog_lock.
+static profiles_slot_t *catalog_find(const profiles_catalog_t *catalog, const char *preset_name) {
+    char key[256];
+
+    if (catalog->capacity == 0 || !utils_normalize_name(preset_name, key, sizeof(key))) {
+        return NULL;
+    }
+
+    size_t mask = catalog->capacity - 1;
+
+    for (size_t i = catalog_hash(key) & mask; catalog->index[i] != 0; i = (i + 1) & mask) {
+        profiles_slot_t *slot = &catalog->slots[catalog->index[i] - 1];
+
+        if (strcmp(slot->item.key_name, key) == 0) {
+            return slot;
         }
     }
 
@@ -33,6 +79,174 @@ static const char *config_get_preset_directory(const char *preset_name) {
     return NULL;
 }
 
+static void preset_free(profiles_preset_t *preset) {
+    unifi_apply_plan_release(&preset->plan);
+    free((char *)preset->name);
+    free(preset);
+}
+
+// Caller holds g_catalog_lock. A preset still in use is freed by its last release.
+static void preset_retire(profiles_preset_t *preset) {
+    if (!preset) {
+        return;
+    }
+
+    if (preset->refs > 0) {
+        preset->retired = true;
+        return;
+    }
+
+    preset_free(preset);
+}
+
+static int catalog_load_preset(const config_preset_item_t *item, profiles_preset_t **out) {
+    char profile_path[PATH_MAX];
+    unifi_profile_t profile;
+
+    *out = NULL;
+
+    if (!utils_build_path(profile_path, sizeof(profile_path), g_profiles_dir, item->directory)) {
+        LOG_ERROR("Failed to build path for '%s' (directory %s).", item->display_name, item->directory);
+        return ERROR_PROFILE_NOT_FOUND;
+    }
+
+    if (!utils_directory_exists(profile_path)) {
+        LOG_WARN("Profile directory '%s' for preset '%s' not found.", profile_path, item->display_name);
+        return ERROR_PROFILE_NOT_FOUND;
+    }
+
+    if (!unifi_profile_load_from_file(profile_path, &profile)) {
+        LOG_WARN("Error loading profile.json for preset '%s'.", item->display_name);
+        return ERROR_PROFILE_INVALID;
+    }
+
+    profiles_preset_t *preset = calloc(1, sizeof(*preset));
+    char *name = strdup(item->display_name);
+
+    if (!preset || !name) {
+        LOG_ERROR("Out of memory allocating preset '%s'.", item->display_name);
+        free(preset);
+        free(name);
+        return ERROR_PROFILE_INVALID;
+    }
+
+    int rc = unifi_apply_plan_prepare(profile_path, &profile, &preset->plan);
+    if (rc != ERROR_NONE) {
+        LOG_WARN("Failed to prepare preset '%s' (code=%d).", item->display_name, rc);
+        free(preset);
+        free(name);
+        return rc;
+    }
+
+    preset->name = name;
+    preset->image_size = preset->plan.image_size;
+    preset->sound_size = preset->plan.sound_size;
+
+    *out = preset;
+    return ERROR_NONE;
+}
+
+// Caller holds g_catalog_lock, or owns a catalog that was never published.
+static void catalog_free(profiles_catalog_t *catalog) {
+    if (!catalog) {
+        return;
+    }
+
+    for (size_t i = 0; i < catalog->count; i++) {
+        preset_retire(catalog->slots[i].preset);
+
+        free(catalog->slots[i].item.display_name);
+        free(catalog->slots[i].item.key_name);
+        free(catalog->slots[i].item.directory);
+    }
+
+    free(catalog->slots);
+    free(catalog->index);
+    free(catalog);
+}
+
+// Builds a catalog for cfg. Presets whose mapping is unchanged in `previous` are shared instead of reloaded,
+// and flagged in moved[] so freeing `previous` leaves them alone. `previous` is only read.
+static profiles_catalog_t *catalog_build(const config_preset_t *cfg, const profiles_catalog_t *previous, bool *moved) {
+    profiles_catalog_t *catalog = calloc(1, sizeof(*catalog));
+    if (!catalog) {
+        LOG_ERROR("Out of memory allocating preset catalog.");
+        return NULL;
+    }
+
+    if (cfg->count == 0) {
+        return catalog;
+    }
+
+    size_t capacity = 16;
+    while (capacity < cfg->count * 2) {
+        capacity *= 2;
+    }
+
+    catalog->slots = calloc(cfg->count, sizeof(*catalog->slots));
+    catalog->index = calloc(capacity, sizeof(*catalog->index));
+
+    if (!catalog->slots || !catalog->index) {
+        LOG_ERROR("Out of memory allocating preset catalog (count=%zu).", cfg->count);
+        catalog_free(catalog);
+        return NULL;
+    }
+
+    catalog->capacity = capacity;
+
+    // First pass copies the mappings and fills the index; nothing is shared yet, so failing here is clean.
+    for (size_t i = 0; i < cfg->count; i++) {
+        const config_preset_item_t *item = &cfg->items[i];
+        profiles_slot_t *slot = &catalog->slots[i];
+
+        slot->item.display_name = strdup(item->display_name);
+        slot->item.key_name = strdup(item->key_name);
+        slot->item.directory = strdup(item->directory);
+        catalog->count++;
+
+        if (!slot->item.display_name || !slot->item.key_name || !slot->item.directory) {
+            LOG_ERROR("Out of memory copying preset '%s'.", item->display_name);
+            catalog_free(catalog);
+            return NULL;
+        }
+
+        // key_name is unique (enforced by config_load), so a plain insert is enough.
+        size_t mask = capacity - 1;
+        size_t pos = catalog_hash(slot->item.key_name) & mask;
+
+        while (catalog->index[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+
+        catalog->index[pos] = i + 1;
+    }
+
+    size_t loaded = 0;
+    size_t reused = 0;
+
+    for (size_t i = 0; i < catalog->count; i++) {
+        profiles_slot_t *slot = &catalog->slots[i];
+        const profiles_slot_t *old = previous ? catalog_find(previous, slot->item.key_name) : NULL;
+
+        if (old && old->preset && strcmp(old->item.directory, slot->item.directory) == 0 &&
+            strcmp(old->item.display_name, slot->item.display_name) == 0) {
+            slot->preset = old->preset;
+            slot->error = ERROR_NONE;
+            moved[old - previous->slots] = true;
+            reused++;
+        } else {
+            slot->error = catalog_load_preset(&slot->item, &slot->preset);
+        }
+
+        if (slot->preset) {
+            loaded++;
+        }
+    }
+
+    LOG_INFO("Indexed %zu of %zu presets (%zu unchanged).", loaded, catalog->count, reused);
+    return catalog;
+}
+
 bool profiles_repo_init(const char *base_dir, const config_preset_t *cfg) {
     if(profiles_initialized()) {
         LOG_ERROR("profiles_init called more than once.");
@@ -52,12 +266,179 @@ bool profiles_repo_init(const char *base_dir, const config_preset_t *cfg) {
         return false;
     }
 
-    g_profiles_cfg = cfg;
+    profiles_catalog_t *catalog = catalog_build(cfg, NULL, NULL);
+
+    if (!catalog) {
+        free(g_profiles_dir);
+        g_profiles_dir = NULL;
+        return false;
+    }
+
+    pthread_mutex_lock(&g_catalog_lock);
+    g_catalog = catalog;
+    pthread_mutex_unlock(&g_catalog_lock);
 
     LOG_INFO("Profile repository initialized with base directory '%s'.", g_profiles_dir);
     return true;
 }
 
+bool profiles_repo_reload_presets(const config_preset_t *cfg, bool *names_changed) {
+    if (!profiles_initialized() || !cfg) {
+        LOG_ERROR("Invalid state or parameters: initialized=%d cfg=%p", profiles_initialized(), (void*)cfg);
+        return false;
+    }
+
+    // Only the reload path (a single thread) changes the catalog, so it can be read here without the lock.
+    profiles_catalog_t *previous = g_catalog;
+    bool changed = previous->count != cfg->count;
+
+    for (size_t i = 0; !changed && i < cfg->count; i++) {
+        changed = strcmp(previous->slots[i].item.display_name, cfg->items[i].display_name) != 0;
+    }
+
+    bool *moved = previous->count ? calloc(previous->count, sizeof(*moved)) : NULL;
+
+    if (previous->count && !moved) {
+        LOG_ERROR("Out of memory reloading presets.");
+        return false;
+    }
+
+    // Profiles are loaded and hashed outside the lock, so commands keep running on the old catalog meanwhile.
+    profiles_catalog_t *catalog = catalog_build(cfg, previous, moved);
+
+    if (!catalog) {
+        free(moved);
+        return false;
+    }
+
+    pthread_mutex_lock(&g_catalog_lock);
+
+    g_catalog = catalog;
+
+    for (size_t i = 0; i < previous->count; i++) {
+        if (moved[i]) {
+            previous->slots[i].preset = NULL;
+        }
+    }
+
+    catalog_free(previous);
+
+    pthread_mutex_unlock(&g_catalog_lock);
+
+    free(moved);
+
+    if (names_changed) {
+        *names_changed = changed;
+    }
+
+    return true;
+}
+
+bool profiles_repo_reindex_directory(const char *directory) {
+    if (!profiles_initialized() || !directory) {
+        return false;
+    }
+
+    bool found = false;
+
+    // See profiles_repo_reload_presets(): the catalog pointer only changes on this thread.
+    profiles_catalog_t *catalog = g_catalog;
+
+    for (size_t i = 0; i < catalog->count; i++) {
+        profiles_slot_t *slot = &catalog->slots[i];
+
+        if (strcmp(slot->item.directory, directory) != 0) {
+            continue;
+        }
+
+        found = true;
+
+        profiles_preset_t *preset = NULL;
+        int error = catalog_load_preset(&slot->item, &preset);
+
+        pthread_mutex_lock(&g_catalog_lock);
+        preset_retire(slot->preset);
+        slot->preset = preset;
+        slot->error = error;
+        pthread_mutex_unlock(&g_catalog_lock);
+
+        LOG_INFO("Re-indexed preset '%s' (code=%d).", slot->item.display_name, error);
+    }
+
+    return found;
+}
+
+size_t profiles_repo_add_preset_names(cJSON *array) {
+    size_t added = 0;
+
+    if (!array) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_catalog_lock);
+
+    for (size_t i = 0; g_catalog && i < g_catalog->count; i++) {
+        if (cJSON_AddItemToArray(array, cJSON_CreateString(g_catalog->slots[i].item.display_name))) {
+            added++;
+        }
+    }
+
+    pthread_mutex_unlock(&g_catalog_lock);
+
+    return added;
+}
+
+int profiles_repo_acquire_preset(const char *preset_name, const profiles_preset_t **out) {
+    if (!profiles_initialized()) {
+        LOG_ERROR("Called before initializing profiles.");
+        return ERROR_PROFILE_NOT_FOUND;
+    }
+
+    if (!preset_name || !out) {
+        LOG_ERROR("Invalid parameters: preset_name=%p out=%p", (void*)preset_name, (void*)out);
+        return ERROR_PROFILE_NOT_FOUND;
+    }
+
+    *out = NULL;
+    int rc = ERROR_PROFILE_NOT_FOUND;
+
+    pthread_mutex_lock(&g_catalog_lock);
+
+    const profiles_slot_t *slot = catalog_find(g_catalog, preset_name);
+
+    if (slot && slot->preset) {
+        slot->preset->refs++;
+        *out = slot->preset;
+        rc = ERROR_NONE;
+    } else if (slot) {
+        rc = slot->error;
+    }
+
+    pthread_mutex_unlock(&g_catalog_lock);
+
+    if (!slot) {
+        LOG_WARN("No directory configured for preset '%s'.", preset_name);
+    }
+
+    return rc;
+}
+
+void profiles_repo_release_preset(const profiles_preset_t *preset) {
+    if (!preset) {
+        return;
+    }
+
+    profiles_preset_t *p = (profiles_preset_t *)preset;
+
+    pthread_mutex_lock(&g_catalog_lock);
+
+    if (--p->refs == 0 && p->retired) {
+        preset_free(p);
+    }
+
+    pthread_mutex_unlock(&g_catalog_lock);
+}
+
 bool profiles_repo_resolve_preset(const char *preset_name, char *out_dir, size_t out_len) {
     if (!profiles_initialized()) {
         LOG_ERROR("Called before initializing profiles.");
@@ -68,10 +449,21 @@ bool profiles_repo_resolve_preset(const char *preset_name, char *out_dir, size_t
         LOG_ERROR("Invalid parameters: preset_name=%p out=%p", (void*)preset_name, (void*)out_dir);
         return false;
     }
-    
-    const char *directory = config_get_preset_directory(preset_name);
 
-    if (!directory) {
+    char directory[PATH_MAX];
+    bool found = false;
+
+    pthread_mutex_lock(&g_catalog_lock);
+
+    const profiles_slot_t *slot = catalog_find(g_catalog, preset_name);
+
+    if (slot) {
+        found = snprintf(directory, sizeof(directory), "%s", slot->item.directory) < (int)sizeof(directory);
+    }
+
+    pthread_mutex_unlock(&g_catalog_lock);
+
+    if (!found) {
         LOG_WARN("No directory configured for preset '%s'.", preset_name);
         return false;
     }
@@ -149,6 +541,77 @@ bool profiles_repo_create_temp_profile_dir(char *out_dir, size_t out_len) {
     return true;
 }
 
+void profiles_repo_set_downloads_budget(const config_downloads_t *cfg) {
+    g_downloads_max_bytes = cfg ? (long long)cfg->max_mb * 1024LL * 1024LL : 0;
+}
+
+bool profiles_repo_blob_dir(char *out_dir, size_t out_len) {
+    if (!profiles_initialized()) {
+        LOG_ERROR("Called before initializing profile repo");
+        return false;
+    }
+
+    return out_dir && utils_build_path(out_dir, out_len, g_profiles_dir, ".blobs");
+}
+
+// Finds the oldest timestamped directory across downloads/ and partial/, skipping `keep`.
+static bool downloads_find_oldest(const char *keep, char *out_path, size_t out_len) {
+    static const char *const kinds[] = { "downloads", "partial" };
+    char oldest_name[NAME_MAX + 1] = "";
+    const char *oldest_kind = NULL;
+    char kind_path[PATH_MAX];
+    char path[PATH_MAX];
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if (!utils_build_path(kind_path, sizeof(kind_path), g_profiles_dir, kinds[k])) {
+            continue;
+        }
+
+        DIR *d = opendir(kind_path);
+        if (!d) {
+            continue;
+        }
+
+        struct dirent *entry;
+
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] == '.' || (oldest_kind && strcmp(entry->d_name, oldest_name) >= 0)) {
+                continue;
+            }
+
+            if (!utils_build_path(path, sizeof(path), kind_path, entry->d_name) || strcmp(path, keep) == 0 || !utils_directory_exists(path)) {
+                continue;
+            }
+
+            snprintf(oldest_name, sizeof(oldest_name), "%s", entry->d_name);
+            oldest_kind = kinds[k];
+        }
+
+        closedir(d);
+    }
+
+    if (!oldest_kind || !utils_build_path(kind_path, sizeof(kind_path), g_profiles_dir, oldest_kind)) {
+        return false;
+    }
+
+    return utils_build_path(out_path, out_len, kind_path, oldest_name);
+}
+
+static void downloads_enforce_budget(const char *blob_dir, const char *keep) {
+    long long size = blob_store_size(blob_dir);
+    char oldest[PATH_MAX];
+
+    while (g_downloads_max_bytes > 0 && size > g_downloads_max_bytes && downloads_find_oldest(keep, oldest, sizeof(oldest))) {
+        if (!utils_delete_directory(oldest)) {
+            LOG_WARN("Failed to delete old download '%s'", oldest);
+            break;
+        }
+
+        size -= blob_store_prune(blob_dir);
+        LOG_INFO("Deleted old download '%s' to stay within the downloads budget (%lld KB stored)", oldest, size / 1024);
+    }
+}
+
 bool profiles_repo_rename_temp_profile_dir(const char *temp_dir, time_t *time, bool partial, char *out_dir, size_t out_dir_len, char *out_path, size_t out_path_len) {
     if (!profiles_initialized()) {
         LOG_ERROR("Called before initializing profile repo");
@@ -183,11 +646,23 @@ bool profiles_repo_rename_temp_profile_dir(const char *temp_dir, time_t *time, b
         return false;
     }
 
+    char blob_dir[PATH_MAX];
+    bool have_blobs = utils_build_path(blob_dir, sizeof(blob_dir), g_profiles_dir, ".blobs");
+
+    // Not fatal: files that could not be adopted simply stay as plain copies.
+    if (have_blobs && !blob_store_adopt_dir(blob_dir, temp_dir)) {
+        LOG_WARN("Some files in '%s' could not be added to the blob store", temp_dir);
+    }
+
     if (rename(temp_dir, final_path) != 0) {
         LOG_ERROR("Failed to rename directory '%s' to '%s'", temp_dir, final_path);
         return false;
     }
 
+    if (have_blobs) {
+        downloads_enforce_budget(blob_dir, final_path);
+    }
+
     int len = snprintf(out_path, out_path_len, "%s", final_path);
 
     if ((size_t)len < strlen(final_path)) {
@@ -197,12 +672,26 @@ bool profiles_repo_rename_temp_profile_dir(const char *temp_dir, time_t *time, b
     return true;
 }
 
-bool profiles_write_last_applied(const char *name, bool is_preset) {
+static bool last_applied_file_name(char *out, size_t out_len, const char *device_id) {
+    int n = device_id
+        ? snprintf(out, out_len, "last_applied_%s.json", device_id)
+        : snprintf(out, out_len, "last_applied.json");
+
+    return n > 0 && (size_t)n < out_len;
+}
+
+bool profiles_write_last_applied(const char *device_id, const char *name, bool is_preset) {
     if (!name) {
         LOG_ERROR("Invalid parameters: name=%p", (void*)name);
         return false;
     }
 
+    char file_name[128];
+    if (!last_applied_file_name(file_name, sizeof(file_name), device_id)) {
+        LOG_ERROR("Failed to build last applied file name for device '%s'", device_id);
+        return false;
+    }
+
     char state_path[PATH_MAX];
     if (!utils_build_path(state_path, sizeof(state_path), g_profiles_dir, ".state/")) {
         LOG_ERROR("Failed to create path for profile '%s/.state/'", g_profiles_dir);
@@ -215,119 +704,87 @@ bool profiles_write_last_applied(const char *name, bool is_preset) {
     }
 
     char last_applied_path[PATH_MAX];
-    if (!utils_build_path(last_applied_path, sizeof(last_applied_path), state_path, "last_applied.json")) {
-        LOG_ERROR("Failed to create path for '%s/last_applied.json", state_path);
+    if (!utils_build_path(last_applied_path, sizeof(last_applied_path), state_path, file_name)) {
+        LOG_ERROR("Failed to create path for '%s/%s", state_path, file_name);
         return false;
     }
 
-    cJSON *root = cJSON_CreateObject();
-
-    if (!root) {
-        LOG_ERROR("Failed to create 'root' object");
-        return false;
-    }
+    unifi_last_applied_profile_t state = {
+        .schema_version = 1,
+        .is_preset = is_preset,
+        .appied_at = time(NULL),
+    };
+    snprintf(state.profile_name, sizeof(state.profile_name), "%s", name);
 
     char *json = NULL;
-    bool result = false;
-    time_t applied_at = time(NULL);
-
-    if (!cJSON_AddNumberToObject(root, "schemaVersion", 1) ||
-        !cJSON_AddStringToObject(root, "profileName", name) ||
-        !cJSON_AddBoolToObject(root, "isPreset", is_preset) ||
-        !cJSON_AddNumberToObject(root, "appliedAt", (double)applied_at)) {
-            LOG_ERROR("Failed to populate last applied object");
-            goto cleanup;
-        }
-
-    json = cJSON_Print(root);
-    
-    if (!json) {
-        goto cleanup;
-    }
-
-    if (!utils_write_file(last_applied_path, json)) {
-        goto cleanup;
-    }
 
-    result = true;
-
-cleanup:
-    if (json) {
-        cJSON_free(json);
+    if (!json_bind_write(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, &state, &json, NULL)) {
+        LOG_ERROR("Failed to serialize last applied state");
+        return false;
     }
 
-    cJSON_Delete(root);
+    bool result = utils_write_file(last_applied_path, json);
+    free(json);
 
     return result;
 }
 
-
-bool profile_load_last_applied(unifi_last_applied_profile_t *out) {
+bool profile_load_last_applied(const char *device_id, unifi_last_applied_profile_t *out) {
     if (!out) {
         LOG_ERROR("Invalid parameters: out=%p", (void*)out);
         return false;
     }
 
-    char path[PATH_MAX];
-    if (!utils_build_path(path, sizeof(path), g_profiles_dir, "/.state/last_applied.json")) {
-        LOG_ERROR("Failed to create path for '%s/.state/last_applied.json", g_profiles_dir);
+    char file_name[128];
+    if (!last_applied_file_name(file_name, sizeof(file_name), device_id)) {
+        LOG_ERROR("Failed to build last applied file name for device '%s'", device_id);
         return false;
     }
 
-    memset((void*)out, 0, sizeof(*out));
-
-    char *json_buffer = NULL;
-
-    if (!utils_read_file(path, &json_buffer, NULL)) {
-        LOG_ERROR("Failed to read the profile file: %s", path);
+    char state_path[PATH_MAX];
+    if (!utils_build_path(state_path, sizeof(state_path), g_profiles_dir, ".state")) {
+        LOG_ERROR("Failed to create path for '%s/.state'", g_profiles_dir);
         return false;
     }
 
-    const char *error_ptr = NULL;
-
-    cJSON *root = cJSON_ParseWithOpts(json_buffer, &error_ptr, false);
-
-    if (!root) {
-        LOG_ERROR("JSON parsing error in %s before: %s", path, error_ptr ? error_ptr : "(unknown position)");
-        free(json_buffer);
+    char path[PATH_MAX];
+    if (!utils_build_path(path, sizeof(path), state_path, file_name)) {
+        LOG_ERROR("Failed to create path for '%s/%s", state_path, file_name);
         return false;
     }
 
-    free(json_buffer);
-    json_buffer = NULL;
-
-    const char *profile_name = json_get_string(root, "profileName");
+    memset((void*)out, 0, sizeof(*out));
 
-    if (profile_name) {
-        snprintf(out->profile_name, sizeof(out->profile_name), "%s", profile_name);
-    }
+    char *json_buffer = NULL;
+    size_t json_len = 0;
 
-    bool is_preset = false;
-    if(json_get_bool(root, "isPreset", &is_preset)) {
-       out->is_preset = is_preset; 
+    if (!utils_read_file(path, &json_buffer, &json_len)) {
+        LOG_ERROR("Failed to read the profile file: %s", path);
+        return false;
     }
 
-    double applied_at = 0;
-    if (json_get_double(root, "appliedAt", &applied_at)) {
-        out->appied_at = (time_t)applied_at;
-    }
+    json_bind_error_t err;
+    bool ok = json_bind_parse(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, json_buffer, json_len, out, &err);
+    arena_free(json_buffer);
 
-    if (out->profile_name[0] == '\0') {
-        cJSON_Delete(root);
+    if (!ok) {
+        LOG_ERROR("JSON parsing error in %s:%d:%d: %s", path, err.line, err.column, err.message);
         return false;
     }
 
-    cJSON_Delete(root);
-
-    return true;
+    return out->profile_name[0] != '\0';
 }
 
 void profiles_repo_shutdown(void) {
     LOG_DEBUG("Shutting down profiles subsystem.");
+
+    pthread_mutex_lock(&g_catalog_lock);
+    catalog_free(g_catalog);
+    g_catalog = NULL;
+    pthread_mutex_unlock(&g_catalog_lock);
+
     free(g_profiles_dir);
-    
     g_profiles_dir = NULL;
-    g_profiles_cfg = NULL;
 }
 
 
@@ -1,7 +1,13 @@
 #include "unifi_remote.h"
+#include "arena.h"
+#include "asset_optimize.h"
+#include "blob_store.h"
+#include "deadline.h"
 #include "errors.h"
 #include "logger.h"
-#include "ssh.h"
+#include "metrics.h"
+#include "trace.h"
+#include "transport.h"
 #include "ssh_commands.h"
 #include "unifi_profile.h"
 #include "unifi_profile_conf.h"
@@ -13,6 +19,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+static config_cache_t g_cache_cfg = {0};
+
+void unifi_remote_set_cache(const config_cache_t *cache_cfg) {
+    if (!cache_cfg) {
+        memset(&g_cache_cfg, 0, sizeof(g_cache_cfg));
+        return;
+    }
+
+    g_cache_cfg = *cache_cfg;
+}
+
+static config_optimize_t g_optimize_cfg = {0};
+static char g_optimize_dir[PATH_MAX] = "";
+
+void unifi_remote_set_optimize(const config_optimize_t *optimize_cfg, const char *cache_dir) {
+    if (!optimize_cfg || !cache_dir || snprintf(g_optimize_dir, sizeof(g_optimize_dir), "%s", cache_dir) >= (int)sizeof(g_optimize_dir)) {
+        memset(&g_optimize_cfg, 0, sizeof(g_optimize_cfg));
+        g_optimize_dir[0] = '\0';
+        return;
+    }
+
+    g_optimize_cfg = *optimize_cfg;
+}
+
+static bool asset_cache_enabled(void) {
+    return g_cache_cfg.max_entries > 0 && g_cache_cfg.directory[0] != '\0';
+}
 
 static int map_apply_step_to_error(const char *step, int rc) {
     if (!step) {
@@ -42,7 +77,7 @@ static int map_apply_step_to_error(const char *step, int rc) {
     return ERROR_PROFILE_APPLY_FAILED;
 }
 
-bool unifi_conf_download(ssh_session_t *session, const char *tmp_dir) {
+bool unifi_conf_download(transport_t *session, const char *tmp_dir) {
     if (!session || !tmp_dir) {
         LOG_ERROR("Invalid parameters session=%p, tmp_dir=%p", (void*)session, (void*)tmp_dir);
         return false;
@@ -56,7 +91,7 @@ bool unifi_conf_download(ssh_session_t *session, const char *tmp_dir) {
         return false;
     }
 
-    if (!ssh_scp_download_file(session, "/etc/persistent/ubnt_lcm_gui.conf", lcm_gui_path)) {
+    if (!transport_download_file(session, "/etc/persistent/ubnt_lcm_gui.conf", lcm_gui_path)) {
         LOG_ERROR("Failed to download ubnt_lcm_gui.conf");
         return false;
     }
@@ -66,7 +101,7 @@ bool unifi_conf_download(ssh_session_t *session, const char *tmp_dir) {
         return false;
     }
 
-    if (!ssh_scp_download_file(session, "/etc/persistent/ubnt_sounds_leds.conf", sounds_leds_path)) {
+    if (!transport_download_file(session, "/etc/persistent/ubnt_sounds_leds.conf", sounds_leds_path)) {
         LOG_ERROR("Failed to download ubnt_sounds_leds.conf");
         return false;
     }
@@ -74,7 +109,52 @@ bool unifi_conf_download(ssh_session_t *session, const char *tmp_dir) {
     return true;
 }
 
-bool unifi_profile_download_and_load(ssh_session_t *session, const char *tmp_dir, unifi_profile_t *out) {
+// Reads the device-side .md5 sidecar of an asset. Returns false when it is missing or malformed.
+static bool read_remote_md5(transport_t *session, const char *remote_md5_path, char md5_hex[33]) {
+    char ssh_cmd[PATH_MAX + 16];
+    char *out = NULL;
+    size_t out_len = 0;
+    bool ok = false;
+
+    if (!ssh_cmd_cat(ssh_cmd, sizeof(ssh_cmd), remote_md5_path)) {
+        return false;
+    }
+
+    if (!transport_exec(session, ssh_cmd, &out, &out_len, NULL, NULL) || !out) {
+        goto cleanup;
+    }
+
+    // The sidecar may carry a trailing newline or an md5sum-style file name.
+    if (out_len >= 32) {
+        memcpy(md5_hex, out, 32);
+        md5_hex[32] = '\0';
+        ok = blob_store_is_md5(md5_hex) && (out_len == 32 || out[32] == '\n' || out[32] == ' ');
+    }
+
+cleanup:
+    arena_free(out);
+
+    return ok;
+}
+
+// Fetches one asset into tmp_dir, linking it from blob_dir instead when the device's sidecar names a blob we hold.
+static bool download_asset(transport_t *session, const char *remote_path, const char *remote_md5_path, const char *tmp_dir, const char *file, const char *blob_dir) {
+    char local_path[PATH_MAX];
+    char md5_hex[33];
+
+    if (!utils_build_path(local_path, sizeof(local_path), tmp_dir, file)) {
+        return false;
+    }
+
+    if (blob_dir && read_remote_md5(session, remote_md5_path, md5_hex) && blob_store_link(blob_dir, md5_hex, local_path)) {
+        LOG_DEBUG("Reused stored copy of '%s' (%s)", remote_path, md5_hex);
+        return true;
+    }
+
+    return transport_download_file(session, remote_path, local_path);
+}
+
+static bool profile_download_and_load(transport_t *session, const char *tmp_dir, const char *blob_dir, unifi_profile_t *out) {
     if (!session || !tmp_dir || !out) {
         LOG_ERROR("Invalid parameters session=%p, tmp_dir=%p, out=%p", (void*)session, (void*)tmp_dir , (void*)out);
         return false;
@@ -108,69 +188,417 @@ bool unifi_profile_download_and_load(ssh_session_t *session, const char *tmp_dir
         return false;
     }
 
-    char remote_image_path[PATH_MAX];
-    char local_image_path[PATH_MAX];
-    char remote_sound_path[PATH_MAX];
-    char local_sound_path[PATH_MAX];
-
-    char remote_image_file[265];
+    char remote_path[PATH_MAX];
+    char remote_md5_path[PATH_MAX];
+    char remote_file[265];
 
     if (out->welcome.file[0] != '\0') {
-        snprintf(remote_image_file, sizeof(remote_image_file), "%s.anim", out->welcome.file);
+        snprintf(remote_file, sizeof(remote_file), "%s.anim", out->welcome.file);
 
-        if (!utils_build_path(remote_image_path, sizeof(remote_image_path), "/etc/persistent/lcm/animation", remote_image_file)) {
+        if (!utils_build_path(remote_path, sizeof(remote_path), "/etc/persistent/lcm/animation", remote_file)) {
             return false;
         }
 
-        if (!utils_build_path(local_image_path, sizeof(local_image_path), tmp_dir, out->welcome.file)) {
+        snprintf(remote_file, sizeof(remote_file), "%s.md5", out->welcome.file);
+
+        if (!utils_build_path(remote_md5_path, sizeof(remote_md5_path), "/etc/persistent/lcm/animation", remote_file)) {
             return false;
         }
 
-        if (!ssh_scp_download_file(session, remote_image_path, local_image_path)) {
+        if (!download_asset(session, remote_path, remote_md5_path, tmp_dir, out->welcome.file, blob_dir)) {
             return false;
         }
     }
 
-    if (!utils_build_path(remote_sound_path, sizeof(remote_sound_path), "/etc/persistent/sounds", out->ring_button.file)) {
+    if (!utils_build_path(remote_path, sizeof(remote_path), "/etc/persistent/sounds", out->ring_button.file)) {
         return false;
     }
 
-    if (!utils_build_path(local_sound_path, sizeof(local_sound_path), tmp_dir, out->ring_button.file)) {
+    snprintf(remote_file, sizeof(remote_file), "%s.md5", out->ring_button.file);
+
+    if (!utils_build_path(remote_md5_path, sizeof(remote_md5_path), "/etc/persistent/sounds", remote_file)) {
         return false;
     }
 
-    if (!ssh_scp_download_file(session, remote_sound_path, local_sound_path)) {
+    if (!download_asset(session, remote_path, remote_md5_path, tmp_dir, out->ring_button.file, blob_dir)) {
         return false;
     }
 
     return true;
 }
 
+bool unifi_profile_download_and_load(transport_t *session, const char *tmp_dir, const char *blob_dir, unifi_profile_t *out) {
+    uint64_t start = metrics_now_us();
+    bool ok = profile_download_and_load(session, tmp_dir, blob_dir, out);
 
-int unifi_profile_upload_and_apply(ssh_session_t *session, const char *profile_dir, const unifi_profile_t *profile) {
-    if (!session || !profile_dir || !profile) {
-        LOG_ERROR("Invalid parameters session=%p, profile_dir=%p, profile=%p", (void*)session, (void*)profile_dir , (void*)profile);
+    metrics_observe_since(METRIC_DOWNLOAD_SECONDS, start);
+
+    return ok;
+}
+
+static int apply_plan_prepare_asset(unifi_apply_plan_t *plan, const char *file, char *asset_path, size_t asset_path_size, char *md5_path, size_t md5_path_size, char md5_hex[33], const unsigned char **data, long long *size) {
+    char md5_file[265];
+
+    if (plan->bundle.map) {
+        const unifi_bundle_asset_t *asset = unifi_bundle_find(&plan->bundle, file);
+
+        if (!asset) {
+            LOG_ERROR("Asset '%s' is not in bundle '%s/%s'", file, plan->profile_dir, UNIFI_BUNDLE_FILE);
+            return ERROR_PROFILE_INVALID;
+        }
+
+        if (!utils_build_path(asset_path, asset_path_size, plan->profile_dir, UNIFI_BUNDLE_FILE)) {
+            return ERROR_PROFILE_INVALID;
+        }
+
+        memcpy(md5_hex, asset->md5_hex, 33);
+        *data = asset->data;
+        *size = (long long)asset->size;
+    } else {
+        struct stat st;
+
+        if (!utils_build_path(asset_path, asset_path_size, plan->profile_dir, file)) {
+            LOG_ERROR("Error building path for asset '%s'", file);
+            return ERROR_PROFILE_INVALID;
+        }
+
+        if (stat(asset_path, &st) != 0) {
+            LOG_ERROR("File '%s' does not exist", asset_path);
+            return ERROR_PROFILE_INVALID;
+        }
+
+        if (!utils_md5_file_hex(asset_path, md5_hex)) {
+            LOG_ERROR("Failed to create MD5 hash for '%s'", asset_path);
+            return ERROR_PROFILE_UPLOAD_FAILED;
+        }
+
+        *size = (long long)st.st_size;
+    }
+
+    snprintf(md5_file, sizeof(md5_file), "%s.md5", file);
+
+    if (!utils_build_path(md5_path, md5_path_size, plan->work_dir, md5_file)) {
+        LOG_ERROR("Failed to create MD5 file path for '%s'", md5_file);
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    if (!utils_write_file(md5_path, md5_hex)) {
+        LOG_ERROR("Failed to write MD5 file '%s'", md5_path);
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    return ERROR_NONE;
+}
+
+// Swaps the welcome image for its recompressed copy when that is smaller. Failures keep the source image.
+static void apply_plan_optimize_image(unifi_apply_plan_t *plan) {
+    char optimized_path[PATH_MAX];
+    char *source = NULL;
+    size_t source_len = 0;
+    const unsigned char *in = plan->image_data;
+    size_t in_len = (size_t)plan->image_size;
+
+    if (!g_optimize_cfg.png || g_optimize_dir[0] == '\0') {
+        return;
+    }
+
+    if (!in) {
+        if (!utils_read_file(plan->image_path, &source, &source_len)) {
+            LOG_WARN("Failed to read '%s' for optimization", plan->image_path);
+            return;
+        }
+
+        in = (const unsigned char *)source;
+        in_len = source_len;
+    }
+
+    if (!asset_optimize_png_cached(in, in_len, plan->image_md5, g_optimize_dir, optimized_path, sizeof(optimized_path)) || optimized_path[0] == '\0') {
+        goto cleanup;
+    }
+
+    char *optimized = NULL;
+    size_t optimized_len = 0;
+    char optimized_md5[33];
+
+    // The optimized image lives as long as the plan, which can outlast the command preparing it.
+    arena_t *previous = arena_enter(NULL);
+    bool read = utils_read_file(optimized_path, &optimized, &optimized_len);
+    arena_leave(previous);
+
+    if (!read || !utils_md5_file_hex(optimized_path, optimized_md5)) {
+        LOG_WARN("Failed to read optimized image '%s'", optimized_path);
+        arena_free(optimized);
+        goto cleanup;
+    }
+
+    if (!utils_write_file(plan->image_md5_path, optimized_md5)) {
+        LOG_WARN("Failed to write MD5 file '%s'", plan->image_md5_path);
+        utils_write_file(plan->image_md5_path, plan->image_md5);
+        arena_free(optimized);
+        goto cleanup;
+    }
+
+    plan->image_optimized = (unsigned char *)optimized;
+    plan->image_data = plan->image_optimized;
+    plan->image_saved = (long long)in_len - (long long)optimized_len;
+    plan->image_size = (long long)optimized_len;
+    memcpy(plan->image_md5, optimized_md5, sizeof(optimized_md5));
+
+    LOG_DEBUG("Welcome image '%s' uploads as %lld bytes (%lld saved)", plan->profile.welcome.file, plan->image_size, plan->image_saved);
+
+cleanup:
+    arena_free(source);
+}
+
+int unifi_apply_plan_prepare(const char *profile_dir, const unifi_profile_t *profile, unifi_apply_plan_t *plan) {
+    if (!profile_dir || !profile || !plan) {
+        LOG_ERROR("Invalid parameters profile_dir=%p, profile=%p, plan=%p", (void*)profile_dir, (void*)profile, (void*)plan);
         return ERROR_PROFILE_INVALID;
     }
 
-    int result = ERROR_NONE;
+    memset(plan, 0, sizeof(*plan));
+    plan->profile = *profile;
 
-    char remote_temp_path[PATH_MAX] = "/tmp/doorbell-mqtt-unifi/";
-    
-    char local_img_path[PATH_MAX];
-    char local_img_md5_path[PATH_MAX];
-    
-    char local_snd_path[PATH_MAX];
-    char local_snd_md5_path[PATH_MAX];
-    
-    char md5_hex[33];
-    char md5_file[265];
-    char ssh_cmd[8192];
+    if (snprintf(plan->profile_dir, sizeof(plan->profile_dir), "%s", profile_dir) >= (int)sizeof(plan->profile_dir)) {
+        LOG_ERROR("Profile path '%s' is too long", profile_dir);
+        return ERROR_PROFILE_INVALID;
+    }
+
+    if (!utils_create_directory("/tmp/doorbell-mqtt-unifi")) {
+        LOG_ERROR("Failed to create /tmp/doorbell-mqtt-unifi directory");
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    snprintf(plan->work_dir, sizeof(plan->work_dir), "%s", "/tmp/doorbell-mqtt-unifi/plan-XXXXXX");
+
+    if (!mkdtemp(plan->work_dir)) {
+        LOG_ERROR("Failed to create temp directory for '%s': %s", plan->work_dir, strerror(errno));
+        plan->work_dir[0] = '\0';
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    int rc = ERROR_NONE;
+    char bundle_path[PATH_MAX];
+
+    if (utils_build_path(bundle_path, sizeof(bundle_path), profile_dir, UNIFI_BUNDLE_FILE) && utils_file_exists(bundle_path) &&
+        !unifi_bundle_open(bundle_path, &plan->bundle)) {
+        rc = ERROR_PROFILE_INVALID;
+    }
+
+    // Only hash the image and sound if enabled; they are uploaded as-is to every device.
+    if (rc == ERROR_NONE && profile->welcome.enabled) {
+        rc = apply_plan_prepare_asset(plan, profile->welcome.file, plan->image_path, sizeof(plan->image_path), plan->image_md5_path, sizeof(plan->image_md5_path), plan->image_md5, &plan->image_data, &plan->image_size);
+
+        if (rc == ERROR_NONE) {
+            apply_plan_optimize_image(plan);
+        }
+    }
+
+    if (rc == ERROR_NONE && profile->ring_button.enabled) {
+        rc = apply_plan_prepare_asset(plan, profile->ring_button.file, plan->sound_path, sizeof(plan->sound_path), plan->sound_md5_path, sizeof(plan->sound_md5_path), plan->sound_md5, &plan->sound_data, &plan->sound_size);
+    }
+
+    if (rc != ERROR_NONE) {
+        unifi_apply_plan_release(plan);
+    }
+
+    return rc;
+}
+
+void unifi_apply_plan_release(unifi_apply_plan_t *plan) {
+    if (!plan) {
+        return;
+    }
 
+    unifi_bundle_close(&plan->bundle);
+    arena_free(plan->image_optimized);
+    plan->image_optimized = NULL;
+    plan->image_data = NULL;
+    plan->sound_data = NULL;
+
+    if (plan->work_dir[0] == '\0') {
+        return;
+    }
+
+    if (!utils_delete_directory(plan->work_dir)) {
+        LOG_WARN("Failed to delete '%s'", plan->work_dir);
+    }
+
+    plan->work_dir[0] = '\0';
+}
+
+// Sends one file into remote_dir as remote_name (from data when set, otherwise from local_path). With
+// optimize.gzip, content that compresses well is streamed as <remote_name>.gz and inflated by the apply script.
+static bool apply_plan_send(transport_t *session, const char *local_path, const unsigned char *data, size_t size, const char *remote_dir, const char *remote_name, unifi_apply_stats_t *stats) {
+    char ssh_cmd[PATH_MAX + 64];
+    char gz_name[PATH_MAX];
+    char *content = NULL;
+    size_t content_len = 0;
+    unsigned char *packed = NULL;
+    size_t packed_len = 0;
+    bool ok = false;
+
+    if (!g_optimize_cfg.gzip || asset_optimize_is_precompressed(remote_name)) {
+        goto send_raw;
+    }
+
+    if (!data) {
+        if (!utils_read_file(local_path, &content, &content_len)) {
+            goto send_raw;
+        }
+
+        data = (const unsigned char *)content;
+        size = content_len;
+    }
+
+    if (!asset_optimize_gzip(data, size, &packed, &packed_len)) {
+        LOG_DEBUG("'%s' does not compress well (%zu -> %zu bytes); sending it as-is", remote_name, size, packed_len);
+        goto send_raw;
+    }
+
+    if (snprintf(gz_name, sizeof(gz_name), "%s.gz", remote_name) >= (int)sizeof(gz_name) ||
+        !ssh_cmd_write_file(ssh_cmd, sizeof(ssh_cmd), remote_dir, gz_name)) {
+        goto send_raw;
+    }
+
+    ok = transport_exec_write(session, ssh_cmd, packed, packed_len);
+
+    if (ok) {
+        stats->bytes_sent += (long long)packed_len;
+        stats->bytes_saved += (long long)size - (long long)packed_len;
+    }
+
+    goto cleanup;
+
+send_raw:
+    ok = data
+        ? transport_upload_buffer(session, data, size, remote_dir, remote_name, 0644)
+        : transport_upload_file(session, local_path, remote_dir, 0644);
+
+    struct stat st;
+
+    if (ok && !data && size == 0 && stat(local_path, &st) == 0) {
+        size = (size_t)st.st_size;
+    }
+
+    if (ok) {
+        stats->bytes_sent += (long long)size;
+    }
+
+cleanup:
+    free(packed);
+    arena_free(content);
+
+    return ok;
+}
+
+// Places one asset and its .md5 sidecar in remote_temp_path: from the on-device cache when it holds the
+// asset's hash, otherwise over SCP. *transferred tells the caller to add the asset to the cache.
+static int apply_plan_place_asset(transport_t *session, const char *asset_path, const unsigned char *data, long long size, long long saved, const char *md5_path, const char *md5_hex, const char *file, const char *remote_temp_path, unifi_apply_stats_t *stats, bool *transferred) {
+    char ssh_cmd[1024];
+
+    *transferred = false;
+
+    if (stats->cache_enabled && ssh_cmd_cache_fetch(ssh_cmd, sizeof(ssh_cmd), g_cache_cfg.directory, md5_hex, remote_temp_path, file) &&
+        transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
+        LOG_DEBUG("Asset cache hit for '%s' (%s)", file, md5_hex);
+        stats->cache_hits++;
+        return ERROR_NONE;
+    }
+
+    if (!apply_plan_send(session, asset_path, data, (size_t)size, remote_temp_path, file, stats)) {
+        return ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
+    }
+
+    if (!transport_upload_file(session, md5_path, remote_temp_path, 0644)) {
+        return ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
+    }
+
+    stats->bytes_saved += saved;
+
+    if (stats->cache_enabled) {
+        stats->cache_misses++;
+        *transferred = true;
+    }
+
+    return ERROR_NONE;
+}
+
+// Adds freshly transferred assets to the on-device cache and prunes it. Failures only cost future hits.
+static void apply_plan_cache_store(transport_t *session, const char *remote_temp_path, const char *const *files, const char *const *md5_hexes, size_t count, unifi_apply_stats_t *stats) {
+    char ssh_cmd[2048];
     char *out = NULL;
-    char *err = NULL;
     size_t out_len = 0;
-    size_t err_len = 0;
+
+    if (!stats->cache_enabled || count == 0) {
+        return;
+    }
+
+    if (!build_cache_store_command(ssh_cmd, sizeof(ssh_cmd), g_cache_cfg.directory, remote_temp_path, files, md5_hexes, count, g_cache_cfg.max_entries, g_cache_cfg.max_kb)) {
+        LOG_WARN("Failed to build asset cache store command");
+        return;
+    }
+
+    if (!transport_exec(session, ssh_cmd, &out, &out_len, NULL, NULL)) {
+        LOG_WARN("Failed to update the asset cache in '%s'", g_cache_cfg.directory);
+    } else {
+        stats->cache_evictions += ssh_parse_cache_evictions(out);
+    }
+
+    arena_free(out);
+}
+
+// True when the device's sidecar for an asset names the hash the plan would upload.
+static bool apply_plan_asset_is_current(transport_t *session, const char *remote_dir, const char *file, const char *md5_hex) {
+    char remote_file[265];
+    char remote_md5_path[PATH_MAX];
+    char device_md5[33];
+
+    snprintf(remote_file, sizeof(remote_file), "%s.md5", file);
+
+    return utils_build_path(remote_md5_path, sizeof(remote_md5_path), remote_dir, remote_file) &&
+           read_remote_md5(session, remote_md5_path, device_md5) && strcmp(device_md5, md5_hex) == 0;
+}
+
+// True when running the apply script would leave the device as it is: each conf it would replace already holds
+// the patched values, and each asset it would move in is already there with the same hash.
+static bool apply_plan_is_current(transport_t *session, const unifi_apply_plan_t *plan, const char *lcm_in, const char *lcm_out, const char *sounds_in, const char *sounds_out) {
+    const unifi_profile_t *profile = &plan->profile;
+
+    if (!unifi_profile_conf_files_equivalent(lcm_in, lcm_out)) {
+        return false;
+    }
+
+    if (profile->ring_button.enabled && !unifi_profile_conf_files_equivalent(sounds_in, sounds_out)) {
+        return false;
+    }
+
+    if (profile->welcome.enabled && !apply_plan_asset_is_current(session, "/etc/persistent/lcm/animation", profile->welcome.file, plan->image_md5)) {
+        return false;
+    }
+
+    if (profile->ring_button.enabled && !apply_plan_asset_is_current(session, "/etc/persistent/sounds", profile->ring_button.file, plan->sound_md5)) {
+        return false;
+    }
+
+    return true;
+}
+
+// Downloads and patches the device confs, then uploads them with the plan's assets into remote_temp_path.
+// With skip_if_current, nothing is uploaded and stats->unchanged is set when the device already runs the plan.
+static int apply_plan_upload(transport_t *session, const unifi_apply_plan_t *plan, const char *remote_temp_path, bool skip_if_current, unifi_apply_stats_t *stats) {
+    const unifi_profile_t *profile = &plan->profile;
+    int result = ERROR_NONE;
+
+    char ssh_cmd[1024];
+
+    const char *store_files[2];
+    const char *store_md5s[2];
+    size_t store_count = 0;
+    bool transferred = false;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->cache_enabled = asset_cache_enabled();
 
     if (!utils_create_directory("/tmp/doorbell-mqtt-unifi")) {
         LOG_ERROR("Failed to create /tmp/doorbell-mqtt-unifi directory");
@@ -190,29 +618,11 @@ int unifi_profile_upload_and_apply(ssh_session_t *session, const char *profile_d
         goto cleanup;
     }
 
-    if (!ssh_cmd_rm_rf(ssh_cmd, sizeof(ssh_cmd), remote_temp_path)) {
-        result = ERROR_PROFILE_UPLOAD_FAILED;
-        goto cleanup;
-    }
-
-    if (!ssh_exec_command(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
-        result = ERROR_PROFILE_UPLOAD_FAILED;
-        goto cleanup;
-    }
-
-    if (!ssh_cmd_mkdir(ssh_cmd, sizeof(ssh_cmd), remote_temp_path)) {
-        result = ERROR_PROFILE_UPLOAD_FAILED;
-        goto cleanup;
-    }
-
-    if (!ssh_exec_command(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
-        result = ERROR_PROFILE_UPLOAD_FAILED;
-        goto cleanup;
-    }
-
     // Always update the ubnt_lcm_gui.conf to remove the image if it is not enabled
     char lcm_in[PATH_MAX];
     char lcm_out[PATH_MAX];
+    char sounds_in[PATH_MAX];
+    char sounds_out[PATH_MAX];
     
     if (!utils_build_path(lcm_in, sizeof(lcm_in), temp_dir, "ubnt_lcm_gui.conf")) {
         LOG_ERROR("Failed to build path for ubnt_lcm_gui.conf");
@@ -231,158 +641,494 @@ int unifi_profile_upload_and_apply(ssh_session_t *session, const char *profile_d
         result = ERROR_PROFILE_DOWNLOAD_FAILED;
         goto cleanup;
     }
-    
-    // Only upload the image and md5 file if enabled
-    if (profile->welcome.enabled) {
-        
-        if (!utils_build_path(local_img_path, sizeof(local_img_path), profile_dir, profile->welcome.file)) {
-            LOG_ERROR("Error building path for image '%s'", profile->welcome.file);
-            result = ERROR_PROFILE_INVALID;
+
+    if (profile->ring_button.enabled) {
+        if (!utils_build_path(sounds_in, sizeof(sounds_in), temp_dir, "ubnt_sounds_leds.conf")) {
+            LOG_ERROR("Failed to build path for ubnt_sounds_leds.conf");
+            result = ERROR_PROFILE_DOWNLOAD_FAILED;
             goto cleanup;
         }
 
-        if (!utils_file_exists(local_img_path)) {
-            LOG_ERROR("File '%s' does not exist", local_img_path);
-            result = ERROR_PROFILE_INVALID;
+        if (!utils_build_path(sounds_out, sizeof(sounds_out), temp_dir, "ubnt_sounds_leds.conf.patched")) {
+            LOG_ERROR("Failed to build path for ubnt_sounds_leds.conf.patched");
+            result = ERROR_PROFILE_DOWNLOAD_FAILED;
             goto cleanup;
         }
 
-        if (!utils_md5_file_hex(local_img_path, md5_hex)) {
-            LOG_ERROR("Failed to create MD5 hash for '%s'", local_img_path);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
+        if (!unifi_profile_patch_sounds_leds_conf(sounds_in, sounds_out, profile)) {
+            LOG_ERROR("Failed to patch ubnt_sounds_leds.conf");
+            result = ERROR_PROFILE_DOWNLOAD_FAILED;
             goto cleanup;
         }
+    }
 
-        snprintf(md5_file, sizeof(md5_file), "%s.md5", profile->welcome.file);
+    if (skip_if_current && apply_plan_is_current(session, plan, lcm_in, lcm_out, sounds_in, sounds_out)) {
+        LOG_INFO("Device already runs this profile; skipping upload and restart");
+        stats->unchanged = true;
+        goto cleanup;
+    }
 
-        if (!utils_build_path(local_img_md5_path, sizeof(local_img_md5_path), temp_dir, md5_file)) {
-            LOG_ERROR("Failed to create MD5 file path for '%s'", md5_file);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+    if (!ssh_cmd_rm_rf(ssh_cmd, sizeof(ssh_cmd), remote_temp_path)) {
+        result = ERROR_PROFILE_UPLOAD_FAILED;
+        goto cleanup;
+    }
 
-        if (!utils_write_file(local_img_md5_path, md5_hex)) {
-            LOG_ERROR("Failed to write MD5 file '%s'", local_img_md5_path);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+    if (!transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
+        result = ERROR_PROFILE_UPLOAD_FAILED;
+        goto cleanup;
+    }
 
-        if (!ssh_scp_upload_file(session, local_img_path, remote_temp_path, 0644)) {
-            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
-            goto cleanup;
-        }
+    if (!ssh_cmd_mkdir(ssh_cmd, sizeof(ssh_cmd), remote_temp_path)) {
+        result = ERROR_PROFILE_UPLOAD_FAILED;
+        goto cleanup;
+    }
 
-        if (!ssh_scp_upload_file(session, local_img_md5_path, remote_temp_path, 0644)) {
-            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
+    if (!transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
+        result = ERROR_PROFILE_UPLOAD_FAILED;
+        goto cleanup;
+    }
+
+    if (profile->welcome.enabled) {
+        result = apply_plan_place_asset(session, plan->image_path, plan->image_data, plan->image_size, plan->image_saved, plan->image_md5_path, plan->image_md5, profile->welcome.file, remote_temp_path, stats, &transferred);
+        if (result != ERROR_NONE) {
             goto cleanup;
         }
 
+        if (transferred) {
+            store_files[store_count] = profile->welcome.file;
+            store_md5s[store_count++] = plan->image_md5;
+        }
     }
     
-    if (!ssh_scp_upload_file(session, lcm_out, remote_temp_path, 0644)) {
+    if (!apply_plan_send(session, lcm_out, NULL, 0, remote_temp_path, "ubnt_lcm_gui.conf.patched", stats)) {
         result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
         goto cleanup;
     }
 
     if (profile->ring_button.enabled) {
-
-        char sounds_in[PATH_MAX];
-        char sounds_out[PATH_MAX];
-
-        if (!utils_build_path(sounds_in, sizeof(sounds_in), temp_dir, "ubnt_sounds_leds.conf")) {
-            LOG_ERROR("Failed to build path for ubnt_sounds_leds.conf");
-            result = ERROR_PROFILE_DOWNLOAD_FAILED;
+        result = apply_plan_place_asset(session, plan->sound_path, plan->sound_data, plan->sound_size, 0, plan->sound_md5_path, plan->sound_md5, profile->ring_button.file, remote_temp_path, stats, &transferred);
+        if (result != ERROR_NONE) {
             goto cleanup;
         }
 
-        if (!utils_build_path(sounds_out, sizeof(sounds_out), temp_dir, "ubnt_sounds_leds.conf.patched")) {
-            LOG_ERROR("Failed to build path for ubnt_sounds_leds.conf.patched");
-            result = ERROR_PROFILE_DOWNLOAD_FAILED;
-            goto cleanup;
+        if (transferred) {
+            store_files[store_count] = profile->ring_button.file;
+            store_md5s[store_count++] = plan->sound_md5;
         }
 
-        if (!unifi_profile_patch_sounds_leds_conf(sounds_in, sounds_out, profile)) {
-            LOG_ERROR("Failed to patch ubnt_sounds_leds.conf");
-            result = ERROR_PROFILE_DOWNLOAD_FAILED;
-            goto cleanup;
-        }
-        
-        if (!utils_build_path(local_snd_path, sizeof(local_snd_path), profile_dir, profile->ring_button.file)) {
-            LOG_ERROR("Error building path for sound '%s'", profile->ring_button.file);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
+        if (!apply_plan_send(session, sounds_out, NULL, 0, remote_temp_path, "ubnt_sounds_leds.conf.patched", stats)) {
+            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
             goto cleanup;
         }
+    }
 
-        if (!utils_file_exists(local_snd_path)) {
-            LOG_ERROR("File '%s' does not exist", local_snd_path);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+    // Prune even when nothing new was transferred: the budget may have been lowered since the last apply.
+    apply_plan_cache_store(session, remote_temp_path, store_files, store_md5s, store_count, stats);
 
-        if (!utils_md5_file_hex(local_snd_path, md5_hex)) {
-            LOG_ERROR("Failed to create MD5 hash for '%s'", local_snd_path);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+    if (stats->cache_enabled) {
+        LOG_INFO("Asset cache: %d hit(s), %d miss(es), %d eviction(s)", stats->cache_hits, stats->cache_misses, stats->cache_evictions);
+    }
 
-        snprintf(md5_file, sizeof(md5_file), "%s.md5", profile->ring_button.file);
+    if (stats->bytes_saved > 0) {
+        LOG_INFO("Uploaded %lld byte(s); compression saved %lld", stats->bytes_sent, stats->bytes_saved);
+    }
 
-        if (!utils_build_path(local_snd_md5_path, sizeof(local_snd_md5_path), temp_dir, md5_file)) {
-            LOG_ERROR("Failed to create MD5 file path for '%s'", md5_file);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+cleanup:
+    if (!utils_delete_directory(temp_dir)) {
+        LOG_WARN("Failed to delete '%s'", temp_dir);
+    }
 
-        if (!utils_write_file(local_snd_md5_path, md5_hex)) {
-            LOG_ERROR("Failed to write MD5 file '%s'", local_snd_md5_path);
-            result = ERROR_PROFILE_UPLOAD_FAILED;
-            goto cleanup;
-        }
+    return result;
+}
 
-        if (!ssh_scp_upload_file(session, local_snd_path, remote_temp_path, 0644)) {
-            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
-            goto cleanup;
-        }
+// Step times are device uptimes; anchor the first step at the start of the script.
+static void apply_plan_trace_steps(uint64_t script_start_us, const char *err) {
+    const char *cursor = err;
+    ssh_step_trace_t step;
+    double base = -1;
 
-        if (!ssh_scp_upload_file(session, local_snd_md5_path, remote_temp_path, 0644)) {
-            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
-            goto cleanup;
+    while (ssh_parse_step_trace(&cursor, &step)) {
+        if (base < 0) {
+            base = step.start_s;
         }
 
-        if (!ssh_scp_upload_file(session, sounds_out, remote_temp_path, 0644)) {
-            result = ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
-            goto cleanup;
-        }
+        uint64_t start = script_start_us + (uint64_t)((step.start_s - base) * 1e6);
+        uint64_t duration = step.end_s > step.start_s ? (uint64_t)((step.end_s - step.start_s) * 1e6) : 0;
+
+        trace_span(start, duration, "apply", step.step, NULL, 0);
     }
+}
 
-    if (!build_apply_profile_command(ssh_cmd, sizeof(ssh_cmd), remote_temp_path, profile->welcome.enabled ? profile->welcome.file : NULL, profile->ring_button.enabled ? profile->ring_button.file : NULL)) {
-        result = ERROR_PROFILE_APPLY_FAILED;
-        goto cleanup;
+// Runs a built apply script and maps a failed step to its error. span is the trace_begin() the script was built under.
+static int apply_script_exec(transport_t *session, const char *ssh_cmd, uint64_t span, const char *remote_temp_path) {
+    int result = ERROR_NONE;
+
+    char *out = NULL;
+    char *err = NULL;
+    size_t out_len = 0;
+    size_t err_len = 0;
+
+    // Dropping the connection does not stop the script on the doorbell; it would go on moving files out of
+    // the upload area while the cleanup and the superseding apply reuse it. Only the deadline bounds it.
+    deadline_shield_begin();
+    bool ran = transport_exec(session, ssh_cmd, &out, &out_len, &err, &err_len);
+    deadline_shield_end();
+
+    if (span) {
+        apply_plan_trace_steps(span, err);
+        trace_end(span, "apply", "script", remote_temp_path, 0);
     }
 
-    if (!ssh_exec_command(session, ssh_cmd, &out, &out_len, &err, &err_len)) {
+    if (!ran) {
         ssh_step_error_t step_error;
+
+        result = ERROR_PROFILE_APPLY_FAILED;
+
         if (ssh_parse_step_error(err, &step_error)) {
             LOG_ERROR("Apply profiles failed at step '%s' with return code '%d'", step_error.step, step_error.rc);
             result = map_apply_step_to_error(step_error.step, step_error.rc);
         }
-        
-        result = ERROR_PROFILE_APPLY_FAILED;
+
         goto cleanup;
     }
 
 cleanup:
-    if (!utils_delete_directory(temp_dir)) {
-        LOG_WARN("Failed to delete '%s'", temp_dir);
-    }
-
     if (out) {
-        free(out);
+        arena_free(out);
     }
 
     if (err) {
-        free(err);
+        arena_free(err);
+    }
+
+    return result;
+}
+
+// Runs the move + restart script against files previously uploaded to remote_temp_path.
+static int apply_plan_run(transport_t *session, const unifi_apply_plan_t *plan, const char *remote_temp_path) {
+    const unifi_profile_t *profile = &plan->profile;
+    char ssh_cmd[8192];
+
+    // With tracing on, the script reports the device uptime around each step.
+    uint64_t span = trace_begin();
+    size_t prefix = span ? strlen(SCRIPT_TRACE_STEPS) : 0;
+
+    memcpy(ssh_cmd, SCRIPT_TRACE_STEPS, prefix);
+
+    if (!build_apply_profile_command(ssh_cmd + prefix, sizeof(ssh_cmd) - prefix, remote_temp_path, profile->welcome.enabled ? profile->welcome.file : NULL, profile->ring_button.enabled ? profile->ring_button.file : NULL)) {
+        return ERROR_PROFILE_APPLY_FAILED;
+    }
+
+    return apply_script_exec(session, ssh_cmd, span, remote_temp_path);
+}
+
+static bool apply_plan_is_valid(transport_t *session, const unifi_apply_plan_t *plan) {
+    if (!session || !plan || plan->work_dir[0] == '\0') {
+        LOG_ERROR("Invalid parameters session=%p, plan=%p", (void*)session, (void*)plan);
+        return false;
+    }
+
+    return true;
+}
+
+static int apply_plan(transport_t *session, const unifi_apply_plan_t *plan, bool force, unifi_apply_stats_t *stats) {
+    unifi_apply_stats_t local_stats = {0};
+
+    if (!apply_plan_is_valid(session, plan)) {
+        return ERROR_PROFILE_INVALID;
+    }
+
+    if (!stats) {
+        stats = &local_stats;
+    }
+
+    uint64_t start = metrics_now_us();
+    uint64_t span = trace_begin();
+
+    int result = apply_plan_upload(session, plan, UNIFI_REMOTE_UPLOAD_DIR, !force, stats);
+    stats->upload_seconds = (double)(metrics_now_us() - start) / 1e6;
+    trace_end(span, "apply", stats->unchanged ? "unchanged" : "upload", UNIFI_REMOTE_UPLOAD_DIR, stats->bytes_sent);
+
+    if (result == ERROR_NONE && stats->unchanged) {
+        // Kept out of the apply histogram: the check alone would drag its quantiles down.
+        stats->apply_seconds = stats->upload_seconds;
+        metrics_inc(METRIC_APPLY_UNCHANGED);
+        return result;
+    }
+
+    if (result == ERROR_NONE) {
+        result = apply_plan_run(session, plan, UNIFI_REMOTE_UPLOAD_DIR);
+
+        if (result != ERROR_NONE && deadline_expired()) {
+            result = deadline_error(ERROR_PROFILE_APPLY_TIMEOUT);
+        }
+    } else if (deadline_expired()) {
+        result = deadline_error(ERROR_PROFILE_UPLOAD_TIMEOUT);
+    }
+
+    stats->apply_seconds = (double)(metrics_now_us() - start) / 1e6;
+    metrics_observe_seconds(METRIC_APPLY_SECONDS, stats->apply_seconds);
+
+    return result;
+}
+
+int unifi_profile_apply_plan(transport_t *session, const unifi_apply_plan_t *plan, unifi_apply_stats_t *stats) {
+    return apply_plan(session, plan, false, stats);
+}
+
+int unifi_profile_stage_plan(transport_t *session, const unifi_apply_plan_t *plan, unifi_apply_stats_t *stats) {
+    unifi_apply_stats_t local_stats = {0};
+
+    if (!apply_plan_is_valid(session, plan)) {
+        return ERROR_PROFILE_INVALID;
+    }
+
+    if (!stats) {
+        stats = &local_stats;
+    }
+
+    uint64_t start = metrics_now_us();
+    uint64_t span = trace_begin();
+    int result = apply_plan_upload(session, plan, UNIFI_REMOTE_STAGING_DIR, false, stats);
+
+    stats->upload_seconds = (double)(metrics_now_us() - start) / 1e6;
+    trace_end(span, "apply", "upload", UNIFI_REMOTE_STAGING_DIR, stats->bytes_sent);
+
+    if (result != ERROR_NONE && deadline_expired()) {
+        result = deadline_error(ERROR_PROFILE_UPLOAD_TIMEOUT);
+    }
+
+    return result;
+}
+
+int unifi_profile_cutover(transport_t *session, const unifi_apply_plan_t *plan) {
+    if (!apply_plan_is_valid(session, plan)) {
+        return ERROR_PROFILE_INVALID;
+    }
+
+    transport_stat_t st;
+
+    // The patched lcm conf is always uploaded last-but-one and always present (possibly still compressed);
+    // use it as the staged marker.
+    if (!transport_stat(session, UNIFI_REMOTE_STAGING_DIR "/ubnt_lcm_gui.conf.patched", &st) &&
+        !transport_stat(session, UNIFI_REMOTE_STAGING_DIR "/ubnt_lcm_gui.conf.patched.gz", &st)) {
+        LOG_WARN("No staged profile found in '%s'", UNIFI_REMOTE_STAGING_DIR);
+        return ERROR_PROFILE_APPLY_MISSING_TMP_FILES;
+    }
+
+    // A staged apply already paid for its upload; only the cutover counts towards its duration.
+    uint64_t start = metrics_now_us();
+    int result = apply_plan_run(session, plan, UNIFI_REMOTE_STAGING_DIR);
+
+    metrics_observe_since(METRIC_APPLY_SECONDS, start);
+
+    if (result != ERROR_NONE && deadline_expired()) {
+        result = deadline_error(ERROR_PROFILE_APPLY_TIMEOUT);
+    }
+
+    return result;
+}
+
+int unifi_profile_upload_and_apply(transport_t *session, const char *profile_dir, const unifi_profile_t *profile, bool force, unifi_apply_stats_t *stats) {
+    if (!session || !profile_dir || !profile) {
+        LOG_ERROR("Invalid parameters session=%p, profile_dir=%p, profile=%p", (void*)session, (void*)profile_dir , (void*)profile);
+        return ERROR_PROFILE_INVALID;
+    }
+
+    unifi_apply_plan_t plan;
+
+    int result = unifi_apply_plan_prepare(profile_dir, profile, &plan);
+    if (result != ERROR_NONE) {
+        return result;
+    }
+
+    result = apply_plan(session, &plan, force, stats);
+
+    unifi_apply_plan_release(&plan);
+
+    return result;
+}
+
+// Patches one downloaded conf into <name>.patched. *changed is false when the patch left its values as they were.
+static bool params_patch_conf(const char *temp_dir, const char *name, const unifi_profile_t *desired, bool (*patch)(const char *, const char *, const unifi_profile_t *), bool *changed) {
+    char in_path[PATH_MAX];
+    char out_path[PATH_MAX];
+    char patched[128];
+
+    snprintf(patched, sizeof(patched), "%s.patched", name);
+
+    if (!utils_build_path(in_path, sizeof(in_path), temp_dir, name) || !utils_build_path(out_path, sizeof(out_path), temp_dir, patched)) {
+        LOG_ERROR("Failed to build path for %s", name);
+        return false;
+    }
+
+    if (!patch(in_path, out_path, desired)) {
+        LOG_ERROR("Failed to patch %s", name);
+        return false;
+    }
+
+    *changed = !unifi_profile_conf_files_equivalent(in_path, out_path);
+
+    return true;
+}
+
+static int params_upload_and_run(transport_t *session, const char *temp_dir, bool lcm_gui, bool sounds_leds, unifi_apply_stats_t *stats) {
+    char ssh_cmd[4096];
+    char local_path[PATH_MAX];
+
+    if (!ssh_cmd_rm_rf(ssh_cmd, sizeof(ssh_cmd), UNIFI_REMOTE_UPLOAD_DIR) || !transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL) ||
+        !ssh_cmd_mkdir(ssh_cmd, sizeof(ssh_cmd), UNIFI_REMOTE_UPLOAD_DIR) || !transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL)) {
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    if (lcm_gui && (!utils_build_path(local_path, sizeof(local_path), temp_dir, "ubnt_lcm_gui.conf.patched") ||
+                    !apply_plan_send(session, local_path, NULL, 0, UNIFI_REMOTE_UPLOAD_DIR, "ubnt_lcm_gui.conf.patched", stats))) {
+        return ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
+    }
+
+    if (sounds_leds && (!utils_build_path(local_path, sizeof(local_path), temp_dir, "ubnt_sounds_leds.conf.patched") ||
+                        !apply_plan_send(session, local_path, NULL, 0, UNIFI_REMOTE_UPLOAD_DIR, "ubnt_sounds_leds.conf.patched", stats))) {
+        return ERROR_PROFILE_UPLOAD_TRANSFER_FAILED;
+    }
+
+    uint64_t span = trace_begin();
+    size_t prefix = span ? strlen(SCRIPT_TRACE_STEPS) : 0;
+
+    memcpy(ssh_cmd, SCRIPT_TRACE_STEPS, prefix);
+
+    if (!build_apply_conf_command(ssh_cmd + prefix, sizeof(ssh_cmd) - prefix, UNIFI_REMOTE_UPLOAD_DIR, lcm_gui, sounds_leds)) {
+        return ERROR_PROFILE_APPLY_FAILED;
+    }
+
+    return apply_script_exec(session, ssh_cmd, span, UNIFI_REMOTE_UPLOAD_DIR);
+}
+
+int unifi_profile_apply_params(transport_t *session, const unifi_profile_params_t *params, unifi_profile_t *current, unifi_apply_stats_t *stats) {
+    unifi_apply_stats_t local_stats = {0};
+    unifi_profile_t desired;
+    char path[PATH_MAX];
+    int result = ERROR_NONE;
+
+    if (!session || !params || !current) {
+        LOG_ERROR("Invalid parameters session=%p, params=%p, current=%p", (void*)session, (void*)params, (void*)current);
+        return ERROR_PARAMS_INVALID;
+    }
+
+    if (!stats) {
+        stats = &local_stats;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    bool welcome = params->has_duration_ms || params->has_loop;
+    bool ring = params->has_volume || params->has_repeat_times;
+
+    if (!welcome && !ring) {
+        LOG_ERROR("Parameter update names no parameter");
+        return ERROR_PARAMS_INVALID;
+    }
+
+    if (!utils_create_directory("/tmp/doorbell-mqtt-unifi")) {
+        LOG_ERROR("Failed to create /tmp/doorbell-mqtt-unifi directory");
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    uint64_t start = metrics_now_us();
+    uint64_t span = trace_begin();
+
+    char template[] = "/tmp/doorbell-mqtt-unifi/params-XXXXXX";
+    char *temp_dir = mkdtemp(template);
+
+    if (!temp_dir) {
+        LOG_ERROR("Failed to create temp directory for '%s': %s", template, strerror(errno));
+        return ERROR_PROFILE_UPLOAD_FAILED;
+    }
+
+    memset(current, 0, sizeof(*current));
+
+    if (!unifi_conf_download(session, temp_dir)) {
+        result = ERROR_PROFILE_DOWNLOAD_FAILED;
+        goto cleanup;
+    }
+
+    if (!utils_build_path(path, sizeof(path), temp_dir, "ubnt_lcm_gui.conf") || !unifi_profile_read_from_lcm_gui_conf(path, current) ||
+        !utils_build_path(path, sizeof(path), temp_dir, "ubnt_sounds_leds.conf") || !unifi_profile_read_from_sounds_leds_conf(path, current)) {
+        LOG_ERROR("Failed to read the device configuration");
+        result = ERROR_PROFILE_DOWNLOAD_FAILED;
+        goto cleanup;
+    }
+
+    // Parameters belong to the running assets; without them there is nothing to adjust.
+    if (welcome && (!current->welcome.enabled || current->welcome.file[0] == '\0')) {
+        LOG_ERROR("The doorbell has no custom welcome animation to adjust");
+        result = ERROR_PARAMS_INVALID;
+        goto cleanup;
+    }
+
+    if (ring && (!current->ring_button.enabled || current->ring_button.file[0] == '\0')) {
+        LOG_ERROR("The doorbell has no custom ring sound to adjust");
+        result = ERROR_PARAMS_INVALID;
+        goto cleanup;
+    }
+
+    desired = *current;
+
+    if (params->has_duration_ms) {
+        desired.welcome.duration_ms = params->duration_ms;
+    }
+
+    if (params->has_loop) {
+        desired.welcome.loop = params->loop;
+    }
+
+    if (params->has_volume) {
+        desired.ring_button.volume = params->volume;
+    }
+
+    if (params->has_repeat_times) {
+        desired.ring_button.repeat_times = params->repeat_times;
+    }
+
+    bool lcm_changed = false;
+    bool sounds_changed = false;
+
+    if ((welcome && !params_patch_conf(temp_dir, "ubnt_lcm_gui.conf", &desired, unifi_profile_patch_lcm_gui_conf, &lcm_changed)) ||
+        (ring && !params_patch_conf(temp_dir, "ubnt_sounds_leds.conf", &desired, unifi_profile_patch_sounds_leds_conf, &sounds_changed))) {
+        result = ERROR_PROFILE_DOWNLOAD_FAILED;
+        goto cleanup;
+    }
+
+    if (!lcm_changed && !sounds_changed) {
+        LOG_INFO("Device already runs these parameters; skipping upload and restart");
+        stats->unchanged = true;
+        metrics_inc(METRIC_APPLY_UNCHANGED);
+        goto cleanup;
+    }
+
+    result = params_upload_and_run(session, temp_dir, lcm_changed, sounds_changed, stats);
+
+    if (result == ERROR_NONE) {
+        LOG_INFO("Updated parameters; restarted %s%s%s", lcm_changed ? "ubnt_lcm_gui" : "", lcm_changed && sounds_changed ? " and " : "",
+                 sounds_changed ? "ubnt_sounds_leds" : "");
+        *current = desired;
+    } else if (deadline_expired()) {
+        result = deadline_error(ERROR_PROFILE_APPLY_TIMEOUT);
+    }
+
+cleanup:
+    stats->apply_seconds = (double)(metrics_now_us() - start) / 1e6;
+    stats->upload_seconds = stats->apply_seconds;
+    trace_end(span, "apply", stats->unchanged ? "unchanged" : "params", UNIFI_REMOTE_UPLOAD_DIR, stats->bytes_sent);
+
+    if (!utils_delete_directory(temp_dir)) {
+        LOG_WARN("Failed to delete '%s'", temp_dir);
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+bool unifi_remote_clear_upload_area(transport_t *session) {
+    char ssh_cmd[PATH_MAX];
+
+    return ssh_cmd_rm_rf(ssh_cmd, sizeof(ssh_cmd), UNIFI_REMOTE_UPLOAD_DIR) && transport_exec(session, ssh_cmd, NULL, NULL, NULL, NULL);
+}
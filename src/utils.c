@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "arena.h"
 #include "logger.h"
 
 #include "md5.h"
@@ -95,7 +96,7 @@ bool utils_read_file(const char *path, char **out, size_t *out_len) {
 
     rewind(file);
 
-    char *buffer = malloc(length + 1);
+    char *buffer = arena_malloc((size_t)length + 1);
     if (!buffer) {
         LOG_ERROR("Unable to allocate %ld bytes for file buffer %s", length, path);
         fclose(file);
@@ -106,7 +107,7 @@ bool utils_read_file(const char *path, char **out, size_t *out_len) {
     
     if(bytes_read != (size_t)length) {
         LOG_ERROR("Short read: only %zu of %ld bytes read from file: %s", bytes_read, length, path);
-        free(buffer);
+        arena_free(buffer);
         fclose(file);
         return false;
     }
@@ -214,6 +215,32 @@ void to_human_readable(const char *input, char *output, size_t out_size) {
     output[j] = '\0';
 }
 
+bool utils_normalize_name(const char *input, char *output, size_t out_size) {
+    if (!input || !output || out_size == 0) {
+        return false;
+    }
+
+    while (*input && isspace((unsigned char)*input)) {
+        input++;
+    }
+
+    size_t len = strlen(input);
+    while (len > 0 && isspace((unsigned char)input[len - 1])) {
+        len--;
+    }
+
+    if (len == 0 || len >= out_size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        output[i] = (char)tolower((unsigned char)input[i]);
+    }
+
+    output[len] = '\0';
+    return true;
+}
+
 bool utils_md5_file_hex(const char *path, char out_hex[33]) {
     if (!path || *path == '\0' || !out_hex) {
         return false;
@@ -272,6 +299,8 @@ bool utils_delete_directory(const char *path) {
     struct dirent *entry;
     char child_path[PATH_MAX];
 
+    errno = 0;
+
     while ((entry = readdir(dir)) != NULL) {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
             continue;
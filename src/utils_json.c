@@ -1,5 +1,6 @@
 #include "utils_json.h"
 #include "cJSON.h"
+#include "utils.h"
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,33 +25,17 @@ char *json_strdup_normalized(cJSON *obj, const char *key) {
         return NULL;
     }
 
-    const char *string = value->valuestring;
-
-    while (*string && isspace((unsigned char)*string)) {
-        string++;
-    }
-
-    const char *end = string + strlen(string);
-    while (end > string && isspace((unsigned char)end[-1])) {
-        end--;
-    }
-
-    size_t len = (size_t)(end - string);
-
-    if (len == 0) {
-        return NULL;
-    }
-
-    char *out = (char *)malloc(len + 1);
+    size_t size = strlen(value->valuestring) + 1;
+    char *out = (char *)malloc(size);
     if (!out) {
         return NULL;
     }
 
-    for (size_t i = 0; i < len; i++) {
-        out[i] = (char)tolower((unsigned char)string[i]);
+    if (!utils_normalize_name(value->valuestring, out, size)) {
+        free(out);
+        return NULL;
     }
 
-    out[len] = '\0';
     return out;
 }
 
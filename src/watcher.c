@@ -0,0 +1,395 @@
+#include "watcher.h"
+#include "config.h"
+#include "ha_discovery.h"
+#include "logger.h"
+#include "unifi_profiles_repo.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Editors and copies produce bursts of events; act once the tree has been quiet this long.
+#define WATCHER_SETTLE_MS 500
+#define WATCHER_MAX_DIRS 256
+
+#define WATCHER_DIR_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+#define WATCHER_BASE_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_ONLYDIR)
+
+typedef struct {
+    int wd;             // -1 once the directory is gone; the entry is dropped after its re-index
+    char name[NAME_MAX + 1];
+    bool dirty;
+} watcher_dir_t;
+
+static struct {
+    pthread_t th;
+    bool running;
+    int fd;
+    int stop_pipe[2];
+    const config_t *cfg;
+    char config_path[PATH_MAX];
+    char config_dir[PATH_MAX];
+    char config_name[NAME_MAX + 1];
+    char profiles_dir[PATH_MAX];
+    int config_wd;
+    int base_wd;
+    watcher_dir_t dirs[WATCHER_MAX_DIRS];
+    size_t dir_count;
+    bool config_dirty;
+} g_watch = {
+    .running = false,
+    .fd = -1,
+    .stop_pipe = { -1, -1 },
+    .config_wd = -1,
+    .base_wd = -1
+};
+
+// Directories the service itself writes to; they never hold presets.
+static bool watcher_ignored(const char *name) {
+    return name[0] == '.' || strcmp(name, "tmp") == 0 || strcmp(name, "downloads") == 0 || strcmp(name, "partial") == 0;
+}
+
+static watcher_dir_t *watcher_find_wd(int wd) {
+    for (size_t i = 0; i < g_watch.dir_count; i++) {
+        if (g_watch.dirs[i].wd == wd) {
+            return &g_watch.dirs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static watcher_dir_t *watcher_find_name(const char *name) {
+    for (size_t i = 0; i < g_watch.dir_count; i++) {
+        if (strcmp(g_watch.dirs[i].name, name) == 0) {
+            return &g_watch.dirs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void watcher_add_dir(const char *name) {
+    char path[PATH_MAX];
+
+    if (watcher_ignored(name)) {
+        return;
+    }
+
+    watcher_dir_t *dir = watcher_find_name(name);
+
+    if (dir && dir->wd >= 0) {
+        return;
+    }
+
+    if (!dir && g_watch.dir_count == WATCHER_MAX_DIRS) {
+        LOG_WARN("Not watching '%s': more than %d profile directories", name, WATCHER_MAX_DIRS);
+        return;
+    }
+
+    if (!utils_build_path(path, sizeof(path), g_watch.profiles_dir, name) || !utils_directory_exists(path)) {
+        return;
+    }
+
+    int wd = inotify_add_watch(g_watch.fd, path, WATCHER_DIR_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        LOG_WARN("Failed to watch '%s': %s", path, strerror(errno));
+        return;
+    }
+
+    if (!dir) {
+        dir = &g_watch.dirs[g_watch.dir_count++];
+        dir->dirty = false;
+        snprintf(dir->name, sizeof(dir->name), "%s", name);
+    }
+
+    dir->wd = wd;
+}
+
+static bool watcher_add_existing_dirs(void) {
+    DIR *d = opendir(g_watch.profiles_dir);
+    if (!d) {
+        LOG_ERROR("Failed to open '%s': %s", g_watch.profiles_dir, strerror(errno));
+        return false;
+    }
+
+    struct dirent *entry;
+
+    while ((entry = readdir(d)) != NULL) {
+        watcher_add_dir(entry->d_name);
+    }
+
+    closedir(d);
+    return true;
+}
+
+static void watcher_mark(const char *name) {
+    watcher_dir_t *dir = watcher_find_name(name);
+
+    if (dir) {
+        dir->dirty = true;
+    }
+}
+
+static void watcher_handle_event(const struct inotify_event *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        LOG_WARN("inotify queue overflowed; re-indexing every preset");
+        g_watch.config_dirty = true;
+
+        for (size_t i = 0; i < g_watch.dir_count; i++) {
+            g_watch.dirs[i].dirty = true;
+        }
+
+        return;
+    }
+
+    if (ev->wd == g_watch.config_wd) {
+        if (ev->len && strcmp(ev->name, g_watch.config_name) == 0) {
+            g_watch.config_dirty = true;
+        }
+
+        return;
+    }
+
+    if (ev->wd == g_watch.base_wd) {
+        if (!ev->len || !(ev->mask & IN_ISDIR) || watcher_ignored(ev->name)) {
+            return;
+        }
+
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            watcher_add_dir(ev->name);
+        } else if (ev->mask & IN_MOVED_FROM) {
+            // The watch would follow the directory to its new name; drop it (this queues IN_IGNORED).
+            watcher_dir_t *moved = watcher_find_name(ev->name);
+
+            if (moved && moved->wd >= 0) {
+                inotify_rm_watch(g_watch.fd, moved->wd);
+            }
+        }
+
+        // A preset directory that appears, disappears or is renamed changes whether its preset loads.
+        watcher_mark(ev->name);
+
+        return;
+    }
+
+    watcher_dir_t *dir = watcher_find_wd(ev->wd);
+    if (!dir) {
+        return;
+    }
+
+    dir->dirty = true;
+
+    if (ev->mask & IN_IGNORED) {
+        dir->wd = -1;
+    }
+}
+
+static void watcher_reload_config(void) {
+    config_t next = {0};
+
+    if (!config_load(g_watch.config_path, &next)) {
+        LOG_ERROR("Reloading '%s' failed; keeping the current presets", g_watch.config_path);
+        config_free(&next);
+        return;
+    }
+
+    bool names_changed = false;
+
+    if (profiles_repo_reload_presets(&next.preset_cfg, &names_changed)) {
+        LOG_INFO("Presets reloaded from '%s'; other configuration changes apply after a restart", g_watch.config_path);
+
+        if (names_changed && !ha_publish_discovery_entity(g_watch.cfg, "preset")) {
+            LOG_WARN("Failed to re-publish the preset select discovery");
+        }
+    }
+
+    config_free(&next);
+}
+
+static void watcher_flush(void) {
+    if (g_watch.config_dirty) {
+        g_watch.config_dirty = false;
+        watcher_reload_config();
+    }
+
+    for (size_t i = 0; i < g_watch.dir_count; ) {
+        watcher_dir_t *dir = &g_watch.dirs[i];
+
+        if (dir->dirty) {
+            dir->dirty = false;
+
+            // Directories no preset maps to (custom profiles) are not in the catalog and are skipped.
+            profiles_repo_reindex_directory(dir->name);
+        }
+
+        if (dir->wd < 0) {
+            *dir = g_watch.dirs[--g_watch.dir_count];
+            continue;
+        }
+
+        i++;
+    }
+}
+
+static void *watcher_worker(void *arg) {
+    (void)arg;
+
+    // Large enough for a burst of events; each carries at most NAME_MAX + 1 bytes of name.
+    _Alignas(struct inotify_event) char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    bool pending = false;
+
+    for (;;) {
+        struct pollfd fds[2] = {
+            { .fd = g_watch.fd, .events = POLLIN },
+            { .fd = g_watch.stop_pipe[0], .events = POLLIN }
+        };
+
+        int n = poll(fds, 2, pending ? WATCHER_SETTLE_MS : -1);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG_ERROR("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents) {
+            break;
+        }
+
+        if (n == 0) {
+            pending = false;
+            watcher_flush();
+            continue;
+        }
+
+        ssize_t len = read(g_watch.fd, buf, sizeof(buf));
+        if (len <= 0) {
+            continue;
+        }
+
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+
+            watcher_handle_event(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+
+        pending = true;
+    }
+
+    return NULL;
+}
+
+static bool watcher_split_path(const char *path) {
+    const char *slash = strrchr(path, '/');
+
+    if (snprintf(g_watch.config_path, sizeof(g_watch.config_path), "%s", path) >= (int)sizeof(g_watch.config_path)) {
+        return false;
+    }
+
+    if (!slash) {
+        snprintf(g_watch.config_dir, sizeof(g_watch.config_dir), "%s", ".");
+        return snprintf(g_watch.config_name, sizeof(g_watch.config_name), "%s", path) < (int)sizeof(g_watch.config_name);
+    }
+
+    int dir_len = slash == path ? 1 : (int)(slash - path);
+
+    snprintf(g_watch.config_dir, sizeof(g_watch.config_dir), "%.*s", dir_len, path);
+    return snprintf(g_watch.config_name, sizeof(g_watch.config_name), "%s", slash + 1) < (int)sizeof(g_watch.config_name);
+}
+
+static void watcher_close(void) {
+    if (g_watch.fd >= 0) {
+        close(g_watch.fd);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (g_watch.stop_pipe[i] >= 0) {
+            close(g_watch.stop_pipe[i]);
+        }
+    }
+
+    g_watch.fd = -1;
+    g_watch.stop_pipe[0] = -1;
+    g_watch.stop_pipe[1] = -1;
+    g_watch.config_wd = -1;
+    g_watch.base_wd = -1;
+    g_watch.dir_count = 0;
+}
+
+bool watcher_start(const char *config_path, const char *profiles_dir, const config_t *cfg) {
+    if (!config_path || !profiles_dir || !cfg) {
+        LOG_ERROR("Invalid parameters config_path=%p, profiles_dir=%p, cfg=%p", (void*)config_path, (void*)profiles_dir, (void*)cfg);
+        return false;
+    }
+
+    if (g_watch.running) {
+        return true;
+    }
+
+    if (!watcher_split_path(config_path) ||
+        snprintf(g_watch.profiles_dir, sizeof(g_watch.profiles_dir), "%s", profiles_dir) >= (int)sizeof(g_watch.profiles_dir)) {
+        LOG_ERROR("Watch path too long");
+        return false;
+    }
+
+    g_watch.cfg = cfg;
+    g_watch.config_dirty = false;
+
+    g_watch.fd = inotify_init1(IN_CLOEXEC);
+    if (g_watch.fd < 0 || pipe(g_watch.stop_pipe) != 0) {
+        LOG_ERROR("Failed to set up inotify: %s", strerror(errno));
+        watcher_close();
+        return false;
+    }
+
+    // Watch the directory rather than the file: editors and `docker cp` replace the file, which drops a file watch.
+    g_watch.config_wd = inotify_add_watch(g_watch.fd, g_watch.config_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    g_watch.base_wd = inotify_add_watch(g_watch.fd, g_watch.profiles_dir, WATCHER_BASE_EVENTS);
+
+    if (g_watch.config_wd < 0 || g_watch.base_wd < 0 || !watcher_add_existing_dirs()) {
+        LOG_ERROR("Failed to watch '%s' or '%s': %s", g_watch.config_dir, g_watch.profiles_dir, strerror(errno));
+        watcher_close();
+        return false;
+    }
+
+    g_watch.running = true;
+
+    if (pthread_create(&g_watch.th, NULL, watcher_worker, NULL) != 0) {
+        LOG_ERROR("Failed to start watcher thread");
+        g_watch.running = false;
+        watcher_close();
+        return false;
+    }
+
+    LOG_INFO("Watching '%s' and %zu profile directories for changes", config_path, g_watch.dir_count);
+    return true;
+}
+
+void watcher_stop(void) {
+    if (!g_watch.running) {
+        return;
+    }
+
+    char c = 0;
+    if (write(g_watch.stop_pipe[1], &c, 1) != 1) {
+        LOG_WARN("Failed to signal the watcher thread");
+    }
+
+    pthread_join(g_watch.th, NULL);
+
+    g_watch.running = false;
+    watcher_close();
+    g_watch.cfg = NULL;
+}
@@ -0,0 +1,129 @@
+#include "third_party/unity/unity.h"
+#include "arena.h"
+#include "cJSON.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static arena_t *g_arena;
+
+void setUp(void) {
+    g_arena = arena_create(1024);
+    TEST_ASSERT_NOT_NULL(g_arena);
+}
+
+void tearDown(void) {
+    arena_leave(NULL);
+    arena_destroy(g_arena);
+}
+
+void test_arena_blocks_are_aligned_and_reset_in_one_step(void) {
+    arena_t *previous = arena_enter(g_arena);
+
+    TEST_ASSERT_NULL(previous);
+
+    for (size_t i = 1; i < 200; i += 7) {
+        unsigned char *p = arena_malloc(i);
+
+        TEST_ASSERT_NOT_NULL(p);
+        TEST_ASSERT_EQUAL_UINT(0, (uintptr_t)p % 16);
+        memset(p, 0xab, i);
+        arena_free(p);
+    }
+
+    // Larger than a chunk: served from a dedicated one and dropped on reset.
+    TEST_ASSERT_NOT_NULL(arena_malloc(8192));
+    TEST_ASSERT_GREATER_THAN_UINT(8192, arena_used(g_arena));
+
+    arena_reset(g_arena);
+    TEST_ASSERT_EQUAL_UINT(0, arena_used(g_arena));
+
+    void *first = arena_malloc(32);
+    arena_reset(g_arena);
+    TEST_ASSERT_EQUAL_PTR(first, arena_malloc(32));
+
+    arena_leave(previous);
+}
+
+void test_arena_realloc_grows_last_block_in_place(void) {
+    arena_enter(g_arena);
+
+    char *buf = arena_malloc(16);
+    memcpy(buf, "doorbell", 9);
+
+    char *grown = arena_realloc(buf, 400);
+    TEST_ASSERT_EQUAL_PTR(buf, grown);
+    TEST_ASSERT_EQUAL_STRING("doorbell", grown);
+
+    // Once another block follows it, growing has to move it.
+    TEST_ASSERT_NOT_NULL(arena_malloc(8));
+    char *moved = arena_realloc(grown, 500);
+    TEST_ASSERT_NOT_NULL(moved);
+    TEST_ASSERT_TRUE(moved != grown);
+    TEST_ASSERT_EQUAL_STRING("doorbell", moved);
+
+    // Past the end of the chunk the block moves to a new one.
+    char *big = arena_realloc(moved, 4096);
+    TEST_ASSERT_NOT_NULL(big);
+    TEST_ASSERT_EQUAL_STRING("doorbell", big);
+}
+
+void test_arena_without_current_uses_heap(void) {
+    char *heap = arena_malloc(64);
+    TEST_ASSERT_NOT_NULL(heap);
+    strcpy(heap, "kept");
+
+    // A heap block stays on the heap even when reallocated inside a command.
+    arena_t *previous = arena_enter(g_arena);
+    heap = arena_realloc(heap, 128);
+    arena_reset(g_arena);
+    arena_leave(previous);
+
+    TEST_ASSERT_EQUAL_UINT(0, arena_used(g_arena));
+    TEST_ASSERT_EQUAL_STRING("kept", heap);
+    arena_free(heap);
+
+    // Entering NULL suspends the arena for data that must outlive the command.
+    arena_enter(g_arena);
+    previous = arena_enter(NULL);
+    void *escaped = arena_malloc(64);
+    arena_leave(previous);
+    TEST_ASSERT_EQUAL_UINT(0, arena_used(g_arena));
+    arena_free(escaped);
+}
+
+void test_arena_backs_cjson_through_hooks(void) {
+    arena_install_cjson_hooks();
+
+    arena_t *previous = arena_enter(g_arena);
+    cJSON *root = cJSON_Parse("{\"state\":\"uploading\",\"devices\":[1,2,3]}");
+
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_GREATER_THAN_UINT(0, arena_used(g_arena));
+
+    char *json = cJSON_PrintUnformatted(root);
+    TEST_ASSERT_EQUAL_STRING("{\"state\":\"uploading\",\"devices\":[1,2,3]}", json);
+
+    cJSON_free(json);
+    cJSON_Delete(root);
+    arena_reset(g_arena);
+    arena_leave(previous);
+
+    // Outside a command cJSON falls back to the heap.
+    root = cJSON_CreateObject();
+    TEST_ASSERT_NOT_NULL(cJSON_AddStringToObject(root, "state", "idle"));
+    TEST_ASSERT_EQUAL_UINT(0, arena_used(g_arena));
+    cJSON_Delete(root);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_arena_blocks_are_aligned_and_reset_in_one_step);
+    RUN_TEST(test_arena_realloc_grows_last_block_in_place);
+    RUN_TEST(test_arena_without_current_uses_heap);
+    RUN_TEST(test_arena_backs_cjson_through_hooks);
+
+    return UNITY_END();
+}
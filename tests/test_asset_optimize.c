@@ -0,0 +1,231 @@
+#include "third_party/unity/unity.h"
+#include "asset_optimize.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define IMAGE_PX 32
+#define RAW_LEN (IMAGE_PX * (IMAGE_PX + 1))
+
+static char g_root[PATH_MAX];
+static unsigned char g_raw[RAW_LEN];
+
+void setUp(void) {
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_asset_optimize_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+
+    // 8-bit greyscale rows, filter type 0, with a repeating gradient.
+    for (int y = 0; y < IMAGE_PX; y++) {
+        g_raw[y * (IMAGE_PX + 1)] = 0;
+
+        for (int x = 0; x < IMAGE_PX; x++) {
+            g_raw[y * (IMAGE_PX + 1) + 1 + x] = (unsigned char)((x * 8) & 0xff);
+        }
+    }
+}
+
+void tearDown(void) {
+    utils_delete_directory(g_root);
+}
+
+static size_t put_chunk(unsigned char *out, const char *type, const unsigned char *data, size_t len) {
+    out[0] = (unsigned char)(len >> 24);
+    out[1] = (unsigned char)(len >> 16);
+    out[2] = (unsigned char)(len >> 8);
+    out[3] = (unsigned char)len;
+    memcpy(out + 4, type, 4);
+
+    uLong crc = crc32(0L, (const Bytef *)type, 4);
+
+    if (len > 0) {
+        memcpy(out + 8, data, len);
+        crc = crc32(crc, data, (uInt)len);
+    }
+
+    out[8 + len] = (unsigned char)(crc >> 24);
+    out[9 + len] = (unsigned char)(crc >> 16);
+    out[10 + len] = (unsigned char)(crc >> 8);
+    out[11 + len] = (unsigned char)crc;
+
+    return len + 12;
+}
+
+// A PNG as an unoptimizing encoder writes it: stored deflate blocks plus a text chunk.
+static size_t make_png(unsigned char *out) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const unsigned char ihdr[13] = { 0, 0, 0, IMAGE_PX, 0, 0, 0, IMAGE_PX, 8, 0, 0, 0, 0 };
+    static const char text[] = "Software\0test encoder";
+    unsigned char idat[RAW_LEN + 64];
+    uLongf idat_len = sizeof(idat);
+    size_t pos = 0;
+
+    TEST_ASSERT_EQUAL_INT(Z_OK, compress2(idat, &idat_len, g_raw, RAW_LEN, 0));
+
+    memcpy(out, signature, sizeof(signature));
+    pos += sizeof(signature);
+    pos += put_chunk(out + pos, "IHDR", ihdr, sizeof(ihdr));
+    pos += put_chunk(out + pos, "tEXt", (const unsigned char *)text, sizeof(text) - 1);
+    pos += put_chunk(out + pos, "IDAT", idat, idat_len);
+    pos += put_chunk(out + pos, "IEND", NULL, 0);
+
+    return pos;
+}
+
+static bool has_chunk(const unsigned char *png, size_t len, const char *type) {
+    for (size_t pos = 8; pos + 12 <= len; ) {
+        size_t chunk_len = (size_t)png[pos] << 24 | (size_t)png[pos + 1] << 16 | (size_t)png[pos + 2] << 8 | png[pos + 3];
+
+        if (memcmp(png + pos + 4, type, 4) == 0) {
+            return true;
+        }
+
+        pos += chunk_len + 12;
+    }
+
+    return false;
+}
+
+void test_asset_optimize_png_shrinks_without_changing_pixels(void) {
+    unsigned char png[RAW_LEN + 256];
+    size_t png_len = make_png(png);
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+
+    TEST_ASSERT_TRUE(asset_optimize_png(png, png_len, &out, &out_len));
+    TEST_ASSERT_LESS_THAN(png_len, out_len);
+    TEST_ASSERT_TRUE(has_chunk(out, out_len, "IHDR"));
+    TEST_ASSERT_TRUE(has_chunk(out, out_len, "IEND"));
+    TEST_ASSERT_FALSE(has_chunk(out, out_len, "tEXt"));
+
+    // IHDR is untouched and the single IDAT follows it.
+    TEST_ASSERT_EQUAL_MEMORY(png, out, 8 + 25);
+    TEST_ASSERT_EQUAL_MEMORY("IDAT", out + 8 + 25 + 4, 4);
+
+    size_t idat_len = (size_t)out[33] << 24 | (size_t)out[34] << 16 | (size_t)out[35] << 8 | out[36];
+    unsigned char raw[RAW_LEN];
+    uLongf raw_len = sizeof(raw);
+
+    TEST_ASSERT_EQUAL_INT(Z_OK, uncompress(raw, &raw_len, out + 41, idat_len));
+    TEST_ASSERT_EQUAL_UINT(RAW_LEN, raw_len);
+    TEST_ASSERT_EQUAL_MEMORY(g_raw, raw, RAW_LEN);
+
+    free(out);
+}
+
+void test_asset_optimize_png_rejects_invalid_input(void) {
+    unsigned char png[RAW_LEN + 256];
+    size_t png_len = make_png(png);
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+
+    TEST_ASSERT_FALSE(asset_optimize_png((const unsigned char *)"OggS not a png", 14, &out, &out_len));
+    TEST_ASSERT_FALSE(asset_optimize_png(png, png_len - 20, &out, &out_len));
+
+    png[40] ^= 0xff;    // inside the tEXt chunk: its CRC no longer matches
+    TEST_ASSERT_FALSE(asset_optimize_png(png, png_len, &out, &out_len));
+    TEST_ASSERT_NULL(out);
+}
+
+void test_asset_optimize_png_cached_reuses_result(void) {
+    unsigned char png[RAW_LEN + 256];
+    size_t png_len = make_png(png);
+    char cache_dir[PATH_MAX];
+    char path[PATH_MAX];
+    char again[PATH_MAX];
+    char expected[PATH_MAX];
+
+    TEST_ASSERT_TRUE(utils_build_path(cache_dir, sizeof(cache_dir), g_root, "optimized"));
+    TEST_ASSERT_TRUE(utils_build_path(expected, sizeof(expected), cache_dir, "0123456789abcdef0123456789abcdef.png"));
+
+    TEST_ASSERT_TRUE(asset_optimize_png_cached(png, png_len, "0123456789abcdef0123456789abcdef", cache_dir, path, sizeof(path)));
+    TEST_ASSERT_EQUAL_STRING(expected, path);
+    TEST_ASSERT_TRUE(utils_file_exists(path));
+
+    // A second call does not look at the source again.
+    TEST_ASSERT_TRUE(asset_optimize_png_cached((const unsigned char *)"x", 1, "0123456789abcdef0123456789abcdef", cache_dir, again, sizeof(again)));
+    TEST_ASSERT_EQUAL_STRING(path, again);
+}
+
+void test_asset_optimize_png_cached_keeps_source_that_does_not_shrink(void) {
+    unsigned char png[RAW_LEN + 256];
+    size_t png_len = make_png(png);
+    unsigned char *optimized = NULL;
+    size_t optimized_len = 0;
+    char cache_dir[PATH_MAX];
+    char path[PATH_MAX];
+    char marker[PATH_MAX];
+
+    TEST_ASSERT_TRUE(asset_optimize_png(png, png_len, &optimized, &optimized_len));
+    TEST_ASSERT_TRUE(utils_build_path(cache_dir, sizeof(cache_dir), g_root, "optimized"));
+    TEST_ASSERT_TRUE(utils_build_path(marker, sizeof(marker), cache_dir, "fedcba9876543210fedcba9876543210.keep"));
+
+    TEST_ASSERT_TRUE(asset_optimize_png_cached(optimized, optimized_len, "fedcba9876543210fedcba9876543210", cache_dir, path, sizeof(path)));
+    TEST_ASSERT_EQUAL_STRING("", path);
+    TEST_ASSERT_TRUE(utils_file_exists(marker));
+
+    free(optimized);
+}
+
+void test_asset_optimize_gzip_round_trips_compressible_data(void) {
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+    unsigned char restored[RAW_LEN];
+    z_stream zs;
+
+    TEST_ASSERT_TRUE(asset_optimize_gzip(g_raw, RAW_LEN, &out, &out_len));
+    TEST_ASSERT_LESS_THAN(RAW_LEN, out_len);
+    TEST_ASSERT_EQUAL_HEX8(0x1f, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x8b, out[1]);
+
+    memset(&zs, 0, sizeof(zs));
+    TEST_ASSERT_EQUAL_INT(Z_OK, inflateInit2(&zs, 15 + 16));
+    zs.next_in = out;
+    zs.avail_in = (uInt)out_len;
+    zs.next_out = restored;
+    zs.avail_out = sizeof(restored);
+    TEST_ASSERT_EQUAL_INT(Z_STREAM_END, inflate(&zs, Z_FINISH));
+    TEST_ASSERT_EQUAL_UINT(RAW_LEN, zs.total_out);
+    inflateEnd(&zs);
+
+    TEST_ASSERT_EQUAL_MEMORY(g_raw, restored, RAW_LEN);
+    free(out);
+}
+
+void test_asset_optimize_gzip_skips_incompressible_data(void) {
+    unsigned char noise[4096];
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+    unsigned int x = 2463534242u;
+
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        noise[i] = (unsigned char)x;
+    }
+
+    TEST_ASSERT_FALSE(asset_optimize_gzip(noise, sizeof(noise), &out, &out_len));
+    free(out);
+
+    TEST_ASSERT_TRUE(asset_optimize_is_precompressed("welcome.PNG"));
+    TEST_ASSERT_TRUE(asset_optimize_is_precompressed("ring.ogg"));
+    TEST_ASSERT_FALSE(asset_optimize_is_precompressed("ring.wav"));
+    TEST_ASSERT_FALSE(asset_optimize_is_precompressed("ubnt_lcm_gui.conf.patched"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_asset_optimize_png_shrinks_without_changing_pixels);
+    RUN_TEST(test_asset_optimize_png_rejects_invalid_input);
+    RUN_TEST(test_asset_optimize_png_cached_reuses_result);
+    RUN_TEST(test_asset_optimize_png_cached_keeps_source_that_does_not_shrink);
+    RUN_TEST(test_asset_optimize_gzip_round_trips_compressible_data);
+    RUN_TEST(test_asset_optimize_gzip_skips_incompressible_data);
+
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include "third_party/unity/unity.h"
+#include "blob_store.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static char g_root[PATH_MAX];
+static char g_store[PATH_MAX];
+
+void setUp(void) {
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_blob_store_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+    TEST_ASSERT_TRUE(utils_build_path(g_store, sizeof(g_store), g_root, ".blobs"));
+}
+
+void tearDown(void) {
+    utils_delete_directory(g_root);
+}
+
+static void make_download(const char *name, const char *content, char *out_dir, size_t out_len) {
+    char path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(utils_build_path(out_dir, out_len, g_root, name));
+    TEST_ASSERT_TRUE(utils_create_directory(out_dir));
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), out_dir, "sound.ogg"));
+    TEST_ASSERT_TRUE(utils_write_file(path, content));
+}
+
+static ino_t inode_of(const char *dir, const char *file) {
+    char path[PATH_MAX];
+    struct stat st;
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), dir, file));
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+
+    return st.st_ino;
+}
+
+void test_blob_store_is_md5_checks_format(void) {
+    TEST_ASSERT_TRUE(blob_store_is_md5("0123456789abcdef0123456789abcdef"));
+    TEST_ASSERT_FALSE(blob_store_is_md5("0123456789ABCDEF0123456789abcdef"));
+    TEST_ASSERT_FALSE(blob_store_is_md5("0123456789abcdef0123456789abcde"));
+    TEST_ASSERT_FALSE(blob_store_is_md5("0123456789abcdef0123456789abcdef0"));
+    TEST_ASSERT_FALSE(blob_store_is_md5("../../../../etc/passwd"));
+}
+
+void test_blob_store_adopt_dir_shares_identical_files(void) {
+    char first[PATH_MAX];
+    char second[PATH_MAX];
+
+    make_download("first", "ding dong", first, sizeof(first));
+    make_download("second", "ding dong", second, sizeof(second));
+
+    TEST_ASSERT_TRUE(blob_store_adopt_dir(g_store, first));
+    TEST_ASSERT_TRUE(blob_store_adopt_dir(g_store, second));
+
+    TEST_ASSERT_EQUAL_UINT64(inode_of(first, "sound.ogg"), inode_of(second, "sound.ogg"));
+    TEST_ASSERT_EQUAL_INT64(9, blob_store_size(g_store));
+}
+
+void test_blob_store_link_reuses_held_blob(void) {
+    char first[PATH_MAX];
+    char md5_hex[33];
+    char src[PATH_MAX];
+    char dst[PATH_MAX];
+
+    make_download("first", "ding dong", first, sizeof(first));
+    TEST_ASSERT_TRUE(blob_store_adopt_dir(g_store, first));
+
+    TEST_ASSERT_TRUE(utils_build_path(src, sizeof(src), first, "sound.ogg"));
+    TEST_ASSERT_TRUE(utils_md5_file_hex(src, md5_hex));
+    TEST_ASSERT_TRUE(utils_build_path(dst, sizeof(dst), g_root, "linked.ogg"));
+
+    TEST_ASSERT_TRUE(blob_store_link(g_store, md5_hex, dst));
+    TEST_ASSERT_EQUAL_UINT64(inode_of(first, "sound.ogg"), inode_of(g_root, "linked.ogg"));
+
+    TEST_ASSERT_FALSE(blob_store_link(g_store, "0123456789abcdef0123456789abcdef", dst));
+}
+
+void test_blob_store_prune_removes_only_unreferenced_blobs(void) {
+    char first[PATH_MAX];
+    char second[PATH_MAX];
+
+    make_download("first", "ding dong", first, sizeof(first));
+    make_download("second", "jingle bells", second, sizeof(second));
+
+    TEST_ASSERT_TRUE(blob_store_adopt_dir(g_store, first));
+    TEST_ASSERT_TRUE(blob_store_adopt_dir(g_store, second));
+    TEST_ASSERT_EQUAL_INT64(0, blob_store_prune(g_store));
+
+    TEST_ASSERT_TRUE(utils_delete_directory(first));
+
+    TEST_ASSERT_EQUAL_INT64(9, blob_store_prune(g_store));
+    TEST_ASSERT_EQUAL_INT64(12, blob_store_size(g_store));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_blob_store_is_md5_checks_format);
+    RUN_TEST(test_blob_store_adopt_dir_shares_identical_files);
+    RUN_TEST(test_blob_store_link_reuses_held_blob);
+    RUN_TEST(test_blob_store_prune_removes_only_unreferenced_blobs);
+
+    return UNITY_END();
+}
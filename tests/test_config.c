@@ -47,6 +47,144 @@ void test_config_does_not_load_presets_when_duplicates(void) {
     config_free(&cfg);
 }
 
+void test_config_loads_single_ssh_object_as_one_device(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_valid.json", &cfg));
+    TEST_ASSERT_EQUAL_size_t(1, cfg.devices_cfg.count);
+    TEST_ASSERT_EQUAL_STRING(cfg.mqtt_cfg.instance, cfg.devices_cfg.items[0].id);
+    TEST_ASSERT_EQUAL_INT(22, cfg.devices_cfg.items[0].ssh_cfg.port);
+    config_free(&cfg);
+}
+
+void test_config_loads_device_array(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_size_t(2, cfg.devices_cfg.count);
+    TEST_ASSERT_EQUAL_STRING("front_door", cfg.devices_cfg.items[0].id);
+    TEST_ASSERT_EQUAL_STRING("Front Door", cfg.devices_cfg.items[0].name_human);
+    TEST_ASSERT_EQUAL_STRING("garage", cfg.devices_cfg.items[1].id);
+    TEST_ASSERT_EQUAL_STRING("Garage Side", cfg.devices_cfg.items[1].name_human);
+    TEST_ASSERT_EQUAL_STRING("192.168.1.21", cfg.devices_cfg.items[1].ssh_cfg.host);
+    TEST_ASSERT_EQUAL_STRING("GARAGE_RECOVERY_CODE", cfg.devices_cfg.items[1].ssh_cfg.password_env);
+    TEST_ASSERT_EQUAL_size_t(1, cfg.devices_cfg.items[1].index);
+    config_free(&cfg);
+}
+
+void test_config_loads_device_tags_and_fleet(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_size_t(1, cfg.devices_cfg.items[0].tag_count);
+    TEST_ASSERT_EQUAL_STRING("outdoor", cfg.devices_cfg.items[0].tags[0]);
+    TEST_ASSERT_EQUAL_size_t(2, cfg.devices_cfg.items[1].tag_count);
+    TEST_ASSERT_EQUAL_STRING("garage", cfg.devices_cfg.items[1].tags[1]);
+    TEST_ASSERT_EQUAL_INT(2, cfg.fleet_cfg.concurrency);
+    config_free(&cfg);
+}
+
+void test_config_loads_device_simulator(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_STRING("", cfg.devices_cfg.items[0].ssh_cfg.sim.root);
+    TEST_ASSERT_EQUAL_STRING("/tmp/doorbell-sim/garage", cfg.devices_cfg.items[1].ssh_cfg.sim.root);
+    TEST_ASSERT_EQUAL_INT(40, cfg.devices_cfg.items[1].ssh_cfg.sim.latency_ms);
+    TEST_ASSERT_EQUAL_INT(2000, cfg.devices_cfg.items[1].ssh_cfg.sim.bandwidth_kbps);
+    config_free(&cfg);
+}
+
+void test_config_loads_device_timeouts(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(10, cfg.devices_cfg.items[0].ssh_cfg.connect_timeout_s);
+    TEST_ASSERT_EQUAL_INT(300, cfg.devices_cfg.items[0].ssh_cfg.command_timeout_s);
+    TEST_ASSERT_EQUAL_INT(5, cfg.devices_cfg.items[1].ssh_cfg.connect_timeout_s);
+    TEST_ASSERT_EQUAL_INT(60, cfg.devices_cfg.items[1].ssh_cfg.command_timeout_s);
+    config_free(&cfg);
+}
+
+void test_config_loads_schedule_windows(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(90, cfg.schedule_cfg.lead_minutes);
+    TEST_ASSERT_EQUAL_STRING("Everyday", cfg.schedule_cfg.default_preset);
+    TEST_ASSERT_EQUAL_size_t(2, cfg.schedule_cfg.count);
+
+    const config_schedule_window_t *w = &cfg.schedule_cfg.items[0];
+    TEST_ASSERT_EQUAL_STRING("outdoor", w->tag);
+    TEST_ASSERT_EQUAL_INT(0, w->start.year);
+    TEST_ASSERT_EQUAL_INT(12, w->start.month);
+    TEST_ASSERT_EQUAL_INT(24, w->start.day);
+    TEST_ASSERT_TRUE(w->has_end);
+    TEST_ASSERT_EQUAL_INT(26, w->end.day);
+
+    w = &cfg.schedule_cfg.items[1];
+    TEST_ASSERT_EQUAL_INT(2030, w->start.year);
+    TEST_ASSERT_EQUAL_INT(6, w->start.hour);
+    TEST_ASSERT_EQUAL_INT(30, w->start.minute);
+    TEST_ASSERT_FALSE(w->has_end);
+    config_free(&cfg);
+}
+
+void test_config_loads_cache_with_default_directory(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(6, cfg.cache_cfg.max_entries);
+    TEST_ASSERT_EQUAL_INT(4096, cfg.cache_cfg.max_kb);
+    TEST_ASSERT_EQUAL_STRING("/etc/persistent/doorbell-mqtt-cache", cfg.cache_cfg.directory);
+    config_free(&cfg);
+}
+
+void test_config_loads_downloads_budget(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(64, cfg.downloads_cfg.max_mb);
+    config_free(&cfg);
+}
+
+void test_config_loads_optimize_section(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(1, cfg.optimize_cfg.png);
+    TEST_ASSERT_EQUAL_INT(1, cfg.optimize_cfg.gzip);
+    config_free(&cfg);
+
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_valid.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(0, cfg.optimize_cfg.png);
+    TEST_ASSERT_EQUAL_INT(0, cfg.optimize_cfg.gzip);
+    config_free(&cfg);
+}
+
+void test_config_loads_metrics_section(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(9464, cfg.metrics_cfg.port);
+    TEST_ASSERT_EQUAL_STRING("0.0.0.0", cfg.metrics_cfg.address);
+    config_free(&cfg);
+
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_valid.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(0, cfg.metrics_cfg.port);
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", cfg.metrics_cfg.address);
+    config_free(&cfg);
+}
+
+void test_config_loads_trace_section(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_fleet.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(1, cfg.trace_cfg.enabled);
+    TEST_ASSERT_EQUAL_INT(2048, cfg.trace_cfg.max_kb);
+    config_free(&cfg);
+
+    TEST_ASSERT_TRUE(config_load("tests/fixtures/config_valid.json", &cfg));
+    TEST_ASSERT_EQUAL_INT(0, cfg.trace_cfg.enabled);
+    TEST_ASSERT_EQUAL_INT(8192, cfg.trace_cfg.max_kb);
+    config_free(&cfg);
+}
+
+void test_config_fails_on_duplicate_device_ids(void) {
+    config_t cfg = {0};
+    TEST_ASSERT_FALSE(config_load("tests/fixtures/config_fleet_duplicate_ids.json", &cfg));
+    config_free(&cfg);
+}
+
 void test_config_fails_when_long_string_truncated(void) {
     config_t cfg = {0};
     TEST_ASSERT_FALSE(config_load("tests/fixtures/config_invalid_long_strings.json", &cfg));
@@ -62,6 +200,18 @@ int main(void) {
     RUN_TEST(test_config_loads_presets);
     RUN_TEST(test_config_does_not_load_presets_when_invalid_preset);
     RUN_TEST(test_config_does_not_load_presets_when_duplicates);
+    RUN_TEST(test_config_loads_single_ssh_object_as_one_device);
+    RUN_TEST(test_config_loads_device_array);
+    RUN_TEST(test_config_loads_device_tags_and_fleet);
+    RUN_TEST(test_config_loads_device_simulator);
+    RUN_TEST(test_config_loads_device_timeouts);
+    RUN_TEST(test_config_loads_schedule_windows);
+    RUN_TEST(test_config_loads_cache_with_default_directory);
+    RUN_TEST(test_config_loads_downloads_budget);
+    RUN_TEST(test_config_loads_optimize_section);
+    RUN_TEST(test_config_loads_metrics_section);
+    RUN_TEST(test_config_loads_trace_section);
+    RUN_TEST(test_config_fails_on_duplicate_device_ids);
     RUN_TEST(test_config_fails_when_long_string_truncated);
 
     return UNITY_END();
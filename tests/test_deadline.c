@@ -0,0 +1,230 @@
+#include "third_party/unity/unity.h"
+#include "deadline.h"
+#include "errors.h"
+#include "transport.h"
+#include "unifi_profile_json.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROFILE_DIR "tests/fixtures/profiles/christmas"
+
+static char g_root[64];
+static config_sim_t g_sim;
+static transport_t *g_transport;
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(deadline_init(2));
+
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_deadline_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+
+    memset(&g_sim, 0, sizeof(g_sim));
+    snprintf(g_sim.root, sizeof(g_sim.root), "%s", g_root);
+
+    g_transport = transport_sim_open(&g_sim);
+    TEST_ASSERT_NOT_NULL(g_transport);
+}
+
+void tearDown(void) {
+    transport_close(g_transport);
+    utils_delete_directory(g_root);
+    deadline_shutdown();
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static void *cancel_device_0_later(void *arg) {
+    (void)arg;
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 100 * 1000000L };
+
+    nanosleep(&delay, NULL);
+    deadline_cancel(0);
+
+    return NULL;
+}
+
+void test_cancel_reaches_only_commands_received_before_it(void) {
+    deadline_op_t op;
+    deadline_op_t other;
+
+    TEST_ASSERT_FALSE(deadline_expired());
+    TEST_ASSERT_EQUAL_INT(-1, deadline_remaining_ms());
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    TEST_ASSERT_FALSE(deadline_expired());
+
+    deadline_cancel(1);
+    TEST_ASSERT_FALSE(deadline_expired());
+
+    deadline_cancel(0);
+    TEST_ASSERT_TRUE(deadline_expired());
+    TEST_ASSERT_EQUAL_INT(0, deadline_remaining_ms());
+    TEST_ASSERT_EQUAL_INT(ERROR_OPERATION_CANCELLED, deadline_error(ERROR_SSH_TIMEOUT));
+
+    // A nested operation started after the cancel, e.g. the cleanup of the aborted apply, runs normally.
+    deadline_begin(&other, 0, deadline_generation(0), 0);
+    TEST_ASSERT_FALSE(deadline_expired());
+    deadline_end(&other);
+
+    TEST_ASSERT_TRUE(deadline_expired());
+    deadline_end(&op);
+    TEST_ASSERT_FALSE(deadline_expired());
+}
+
+void test_deadline_passes_and_reports_a_timeout(void) {
+    deadline_op_t op;
+
+    deadline_begin(&op, 0, deadline_generation(0), 60);
+    TEST_ASSERT_TRUE(deadline_remaining_ms() > 59000);
+    TEST_ASSERT_FALSE(deadline_expired());
+
+    op.expires_us = 1;
+    TEST_ASSERT_TRUE(deadline_expired());
+    TEST_ASSERT_EQUAL_INT(0, deadline_remaining_ms());
+    TEST_ASSERT_EQUAL_INT(ERROR_SSH_TIMEOUT, deadline_error(ERROR_SSH_TIMEOUT));
+    TEST_ASSERT_FALSE(transport_exec(g_transport, "true", NULL, NULL, NULL, NULL));
+
+    deadline_end(&op);
+}
+
+void test_cancel_shuts_down_the_watched_socket(void) {
+    int sv[2];
+    char byte;
+    deadline_op_t op;
+
+    TEST_ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    deadline_watch_socket(sv[0]);
+    deadline_cancel(0);
+
+    // Nothing was ever written: without the shutdown this read would block forever.
+    TEST_ASSERT_EQUAL_INT(0, (int)recv(sv[0], &byte, 1, 0));
+
+    deadline_unwatch_socket(sv[0]);
+    deadline_end(&op);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+void test_shield_holds_off_a_cancel_until_it_ends(void) {
+    int sv[2];
+    char byte;
+    deadline_op_t op;
+
+    TEST_ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    deadline_watch_socket(sv[0]);
+    deadline_shield_begin();
+    deadline_cancel(0);
+
+    TEST_ASSERT_FALSE(deadline_expired());
+    TEST_ASSERT_EQUAL_INT(-1, deadline_remaining_ms());
+
+    // The socket still carries data: it was not shut down.
+    TEST_ASSERT_EQUAL_INT(1, (int)send(sv[1], "x", 1, 0));
+    TEST_ASSERT_EQUAL_INT(1, (int)recv(sv[0], &byte, 1, 0));
+
+    deadline_shield_end();
+    TEST_ASSERT_TRUE(deadline_expired());
+    TEST_ASSERT_EQUAL_INT(ERROR_OPERATION_CANCELLED, deadline_error(ERROR_SSH_TIMEOUT));
+
+    deadline_unwatch_socket(sv[0]);
+    deadline_end(&op);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+void test_shielded_command_runs_to_completion_through_a_cancel(void) {
+    deadline_op_t op;
+    pthread_t th;
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    deadline_shield_begin();
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, cancel_device_0_later, NULL));
+
+    double start = now_ms();
+    TEST_ASSERT_TRUE(transport_exec(g_transport, "sleep 0.3", NULL, NULL, NULL, NULL));
+    double elapsed = now_ms() - start;
+
+    pthread_join(th, NULL);
+    deadline_shield_end();
+
+    TEST_ASSERT_TRUE(deadline_cancelled());
+    deadline_end(&op);
+
+    TEST_ASSERT_TRUE(elapsed >= 250);
+}
+
+void test_hung_command_is_killed_at_the_deadline(void) {
+    deadline_op_t op;
+
+    deadline_begin(&op, 0, deadline_generation(0), 1);
+
+    double start = now_ms();
+    TEST_ASSERT_FALSE(transport_exec(g_transport, "sleep 10", NULL, NULL, NULL, NULL));
+    double elapsed = now_ms() - start;
+
+    deadline_end(&op);
+
+    TEST_ASSERT_TRUE(elapsed >= 900);
+    TEST_ASSERT_TRUE(elapsed < 3000);
+}
+
+void test_cancel_from_another_thread_stops_a_running_command(void) {
+    deadline_op_t op;
+    pthread_t th;
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, cancel_device_0_later, NULL));
+
+    double start = now_ms();
+    TEST_ASSERT_FALSE(transport_exec(g_transport, "sleep 10", NULL, NULL, NULL, NULL));
+    double elapsed = now_ms() - start;
+
+    pthread_join(th, NULL);
+    deadline_end(&op);
+
+    TEST_ASSERT_TRUE(elapsed < 2000);
+}
+
+void test_cancelled_apply_reports_the_cancel(void) {
+    unifi_profile_t profile;
+    deadline_op_t op;
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+
+    deadline_begin(&op, 0, deadline_generation(0), 0);
+    deadline_cancel(0);
+    TEST_ASSERT_EQUAL_INT(ERROR_OPERATION_CANCELLED, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, NULL));
+    deadline_end(&op);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cancel_reaches_only_commands_received_before_it);
+    RUN_TEST(test_deadline_passes_and_reports_a_timeout);
+    RUN_TEST(test_cancel_shuts_down_the_watched_socket);
+    RUN_TEST(test_shield_holds_off_a_cancel_until_it_ends);
+    RUN_TEST(test_shielded_command_runs_to_completion_through_a_cancel);
+    RUN_TEST(test_hung_command_is_killed_at_the_deadline);
+    RUN_TEST(test_cancel_from_another_thread_stops_a_running_command);
+    RUN_TEST(test_cancelled_apply_reports_the_cancel);
+
+    return UNITY_END();
+}
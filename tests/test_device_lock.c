@@ -0,0 +1,195 @@
+#include "third_party/unity/unity.h"
+#include "command.h"
+#include "config.h"
+#include "deadline.h"
+#include "device_lock.h"
+#include "metrics.h"
+#include "mqtt_router.h"
+#include "scheduler.h"
+#include "unifi_profile.h"
+#include "unifi_profile_conf.h"
+#include "unifi_profiles_repo.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COMMAND_TOPIC "test/door/cmd/preset_set"
+
+static char g_root[64];
+static config_t g_cfg;
+static mqtt_router_ctx_t g_ctx;
+static atomic_bool g_command_done;
+
+static void write_profile(const char *profiles_dir, const char *name, const char *image) {
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    static const char *const assets[] = { "christmas1.png", "christmas2.png", "christmas.ogg" };
+
+    TEST_ASSERT_TRUE(utils_build_path(dir, sizeof(dir), profiles_dir, name));
+    TEST_ASSERT_TRUE(utils_create_directory(dir));
+
+    for (size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++) {
+        TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), dir, assets[i]));
+        TEST_ASSERT_TRUE(utils_write_file(path, ""));
+    }
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), dir, "profile.json"));
+
+    FILE *fp = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(fp);
+    fprintf(fp, "{ \"schemaVersion\": 1,\n"
+                "  \"welcome\": { \"enabled\": true, \"file\": \"%s\", \"count\": 1, \"durationMs\": 1000, \"loop\": false },\n"
+                "  \"ringButton\": { \"enabled\": true, \"file\": \"christmas.ogg\", \"repeatTimes\": 1, \"volume\": 100 } }\n", image);
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+}
+
+// One simulated doorbell with a small per-call latency, so an apply lasts long enough to overlap another one,
+// and a one second command timeout, well above what an apply takes.
+static void write_config(const char *path) {
+    FILE *fp = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(fp);
+
+    fprintf(fp, "{\n  \"mqtt\": { \"host\": \"127.0.0.1\", \"port\": 1883 },\n"
+                "  \"ssh\": [ { \"id\": \"door\", \"host\": \"127.0.0.1\", \"command_timeout_seconds\": 1, \"sim\": { \"root\": \"%s/door\", \"latency_ms\": 5 } } ],\n"
+                "  \"presets\": [ { \"name\": \"Christmas\", \"directory\": \"christmas\" }, { \"name\": \"Christmas Eve\", \"directory\": \"christmas_eve\" } ],\n"
+                "  \"schedule\": { \"windows\": [ { \"preset\": \"Christmas\", \"start\": \"2020-01-01 00:00\" } ] }\n}\n",
+            g_root);
+
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+}
+
+void setUp(void) {
+    char config_path[PATH_MAX];
+    char profiles_dir[PATH_MAX];
+
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_device_lock_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+
+    snprintf(config_path, sizeof(config_path), "%s/config.json", g_root);
+    snprintf(profiles_dir, sizeof(profiles_dir), "%s/profiles", g_root);
+
+    TEST_ASSERT_TRUE(utils_create_directory(profiles_dir));
+    write_profile(profiles_dir, "christmas", "christmas1.png");
+    write_profile(profiles_dir, "christmas_eve", "christmas2.png");
+    write_config(config_path);
+
+    memset(&g_cfg, 0, sizeof(g_cfg));
+    TEST_ASSERT_TRUE(config_load(config_path, &g_cfg));
+    TEST_ASSERT_TRUE(profiles_repo_init(profiles_dir, &g_cfg.preset_cfg));
+    TEST_ASSERT_TRUE(deadline_init(g_cfg.devices_cfg.count));
+    TEST_ASSERT_TRUE(device_lock_init(g_cfg.devices_cfg.count));
+
+    memset(&g_ctx, 0, sizeof(g_ctx));
+    g_ctx.devices_cfg = &g_cfg.devices_cfg;
+    g_ctx.fleet_cfg = &g_cfg.fleet_cfg;
+    g_ctx.preset_cfg = &g_cfg.preset_cfg;
+
+    atomic_store(&g_command_done, false);
+}
+
+void tearDown(void) {
+    mqtt_router_stop();
+    device_lock_shutdown();
+    deadline_shutdown();
+    profiles_repo_shutdown();
+    config_free(&g_cfg);
+    utils_delete_directory(g_root);
+}
+
+static void set_preset_and_signal(const mqtt_router_ctx_t *ctx, const char *payload, size_t payloadLen) {
+    command_set_preset(ctx, payload, payloadLen);
+    atomic_store(&g_command_done, true);
+}
+
+static void *catch_up_thread(void *arg) {
+    (void)arg;
+    scheduler_catch_up(&g_cfg, time(NULL));
+
+    return NULL;
+}
+
+// Sum of every error reported to Home Assistant, e.g. a failed apply.
+static unsigned long long reported_errors(void) {
+    static const char series[] = "doorbell_errors_total{";
+    unsigned long long total = 0;
+    char *text = metrics_render(NULL);
+
+    TEST_ASSERT_NOT_NULL(text);
+
+    for (const char *line = strstr(text, series); line; line = strstr(line + 1, series)) {
+        total += strtoull(strchr(line, '}') + 1, NULL, 10);
+    }
+
+    free(text);
+
+    return total;
+}
+
+void test_scheduled_apply_and_command_take_turns_on_a_device(void) {
+    pthread_t th;
+    unifi_profile_t device;
+    char path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(mqtt_router_start(&g_ctx));
+    TEST_ASSERT_EQUAL_INT(0, mqtt_routes_add(COMMAND_TOPIC, set_preset_and_signal, &g_cfg.devices_cfg.items[0], 0));
+
+    // Both reach the device at once: the catch-up applies "Christmas", the command "Christmas Eve".
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, catch_up_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(0, mqtt_router_enqueue(COMMAND_TOPIC, (int)strlen(COMMAND_TOPIC), "Christmas Eve", strlen("Christmas Eve")));
+
+    pthread_join(th, NULL);
+
+    for (int i = 0; i < 1000 && !atomic_load(&g_command_done); i++) {
+        struct timespec delay = { .tv_sec = 0, .tv_nsec = 10 * 1000000L };
+        nanosleep(&delay, NULL);
+    }
+
+    TEST_ASSERT_TRUE(atomic_load(&g_command_done));
+
+    // Interleaved, one apply wipes the other's upload area halfway and its script fails.
+    TEST_ASSERT_EQUAL_UINT64(0, reported_errors());
+
+    // The device runs one of the two presets completely: its conf names an image that is on the device.
+    memset(&device, 0, sizeof(device));
+    snprintf(path, sizeof(path), "%s/door/etc/persistent/ubnt_lcm_gui.conf", g_root);
+    TEST_ASSERT_TRUE(unifi_profile_read_from_lcm_gui_conf(path, &device));
+
+    snprintf(path, sizeof(path), "%s/door/etc/persistent/lcm/animation/%s.anim", g_root, device.welcome.file);
+    TEST_ASSERT_TRUE(utils_file_exists(path));
+}
+
+void test_waiting_for_the_device_does_not_use_up_the_deadline(void) {
+    pthread_t th;
+    unifi_profile_t device;
+    char path[PATH_MAX];
+    struct timespec held = { .tv_sec = 1, .tv_nsec = 500 * 1000000L };
+
+    // A command holds the device for longer than the whole command timeout.
+    device_lock(0);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, catch_up_thread, NULL));
+    nanosleep(&held, NULL);
+    device_unlock(0);
+
+    pthread_join(th, NULL);
+
+    // The catch-up applied "Christmas" once it had the device.
+    memset(&device, 0, sizeof(device));
+    snprintf(path, sizeof(path), "%s/door/etc/persistent/ubnt_lcm_gui.conf", g_root);
+    TEST_ASSERT_TRUE(unifi_profile_read_from_lcm_gui_conf(path, &device));
+    TEST_ASSERT_EQUAL_STRING("christmas1.png", device.welcome.file);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_scheduled_apply_and_command_take_turns_on_a_device);
+    RUN_TEST(test_waiting_for_the_device_does_not_use_up_the_deadline);
+
+    return UNITY_END();
+}
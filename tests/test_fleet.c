@@ -0,0 +1,133 @@
+#include "third_party/unity/unity.h"
+#include "cJSON.h"
+#include "config_types.h"
+#include "errors.h"
+#include "fleet.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEVICE_COUNT 5
+
+static config_device_t g_items[DEVICE_COUNT];
+static config_devices_t g_devices;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_active = 0;
+static int g_max_active = 0;
+
+void setUp(void) {
+    memset(g_items, 0, sizeof(g_items));
+
+    for (size_t i = 0; i < DEVICE_COUNT; i++) {
+        g_items[i].index = i;
+        snprintf(g_items[i].id, sizeof(g_items[i].id), "door_%zu", i);
+    }
+
+    snprintf(g_items[1].tags[0], sizeof(g_items[1].tags[0]), "%s", "garage");
+    g_items[1].tag_count = 1;
+    snprintf(g_items[3].tags[0], sizeof(g_items[3].tags[0]), "%s", "outdoor");
+    snprintf(g_items[3].tags[1], sizeof(g_items[3].tags[1]), "%s", "garage");
+    g_items[3].tag_count = 2;
+
+    g_devices.items = g_items;
+    g_devices.count = DEVICE_COUNT;
+
+    g_active = 0;
+    g_max_active = 0;
+}
+
+void tearDown(void) {}
+
+static int fake_apply(const config_device_t *device, void *user) {
+    (void)user;
+
+    pthread_mutex_lock(&g_lock);
+    if (++g_active > g_max_active) {
+        g_max_active = g_active;
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    struct timespec ts = { 0, 20 * 1000000L };
+    nanosleep(&ts, NULL);
+
+    pthread_mutex_lock(&g_lock);
+    g_active--;
+    pthread_mutex_unlock(&g_lock);
+
+    return device->index == 2 ? ERROR_SSH_CONNECTION_FAILED : ERROR_NONE;
+}
+
+void test_fleet_selects_all_devices_without_tag(void) {
+    fleet_rollout_t rollout;
+
+    TEST_ASSERT_TRUE(fleet_rollout_init(&rollout, &g_devices, NULL));
+    TEST_ASSERT_EQUAL_size_t(DEVICE_COUNT, rollout.count);
+
+    fleet_rollout_free(&rollout);
+}
+
+void test_fleet_selects_devices_by_tag(void) {
+    fleet_rollout_t rollout;
+
+    TEST_ASSERT_TRUE(fleet_rollout_init(&rollout, &g_devices, "garage"));
+    TEST_ASSERT_EQUAL_size_t(2, rollout.count);
+    TEST_ASSERT_EQUAL_STRING("door_1", rollout.results[0].device->id);
+    TEST_ASSERT_EQUAL_STRING("door_3", rollout.results[1].device->id);
+
+    fleet_rollout_free(&rollout);
+}
+
+void test_fleet_run_respects_concurrency_and_records_results(void) {
+    fleet_rollout_t rollout;
+
+    TEST_ASSERT_TRUE(fleet_rollout_init(&rollout, &g_devices, NULL));
+    TEST_ASSERT_FALSE(fleet_rollout_run(&rollout, 2, fake_apply, NULL));
+
+    TEST_ASSERT_TRUE(g_max_active <= 2);
+    TEST_ASSERT_EQUAL_INT(2, rollout.concurrency);
+    TEST_ASSERT_EQUAL_size_t(DEVICE_COUNT - 1, rollout.succeeded);
+    TEST_ASSERT_EQUAL_INT(ERROR_SSH_CONNECTION_FAILED, rollout.results[2].error);
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, rollout.results[4].error);
+
+    fleet_rollout_free(&rollout);
+}
+
+void test_fleet_summary_reports_per_device_results(void) {
+    fleet_rollout_t rollout;
+
+    TEST_ASSERT_TRUE(fleet_rollout_init(&rollout, &g_devices, "garage"));
+    TEST_ASSERT_TRUE(fleet_rollout_run(&rollout, 4, fake_apply, NULL));
+
+    char *json = fleet_rollout_summary_json(&rollout, "Christmas", "garage");
+    TEST_ASSERT_NOT_NULL(json);
+
+    cJSON *root = cJSON_Parse(json);
+    TEST_ASSERT_NOT_NULL(root);
+
+    TEST_ASSERT_EQUAL_STRING("Christmas", cJSON_GetObjectItem(root, "profile")->valuestring);
+    TEST_ASSERT_EQUAL_INT(2, cJSON_GetObjectItem(root, "succeeded")->valueint);
+    TEST_ASSERT_EQUAL_INT(0, cJSON_GetObjectItem(root, "failed")->valueint);
+    TEST_ASSERT_TRUE(cJSON_IsNumber(cJSON_GetObjectItem(root, "wall_ms")));
+
+    cJSON *results = cJSON_GetObjectItem(root, "results");
+    TEST_ASSERT_EQUAL_INT(2, cJSON_GetArraySize(results));
+    TEST_ASSERT_EQUAL_STRING("door_3", cJSON_GetObjectItem(cJSON_GetArrayItem(results, 1), "id")->valuestring);
+
+    cJSON_Delete(root);
+    cJSON_free(json);
+    fleet_rollout_free(&rollout);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fleet_selects_all_devices_without_tag);
+    RUN_TEST(test_fleet_selects_devices_by_tag);
+    RUN_TEST(test_fleet_run_respects_concurrency_and_records_results);
+    RUN_TEST(test_fleet_summary_reports_per_device_results);
+
+    return UNITY_END();
+}
@@ -0,0 +1,82 @@
+#include "third_party/unity/unity.h"
+#include "config_types.h"
+#include "ha_status.h"
+#include "ha_topics.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static config_t g_cfg;
+static config_device_t g_devices[2];
+
+void setUp(void) {
+    g_cfg = (config_t){0};
+    snprintf(g_cfg.mqtt_cfg.prefix, sizeof(g_cfg.mqtt_cfg.prefix), "%s", "chrishansentech");
+
+    g_devices[0] = (config_device_t){ .index = 0 };
+    snprintf(g_devices[0].id, sizeof(g_devices[0].id), "%s", "front_door");
+
+    g_devices[1] = (config_device_t){ .index = 1 };
+    snprintf(g_devices[1].id, sizeof(g_devices[1].id), "%s", "back_door");
+
+    g_cfg.devices_cfg.items = g_devices;
+    g_cfg.devices_cfg.count = 2;
+}
+
+void tearDown(void) {
+    ha_topics_shutdown();
+}
+
+static unsigned long long performance_publishes(void) {
+    static const char series[] = "doorbell_status_publishes_total{topic=\"performance\"} ";
+    char *text = metrics_render(NULL);
+
+    TEST_ASSERT_NOT_NULL(text);
+
+    const char *line = strstr(text, series);
+    TEST_ASSERT_NOT_NULL(line);
+
+    unsigned long long count = strtoull(line + strlen(series), NULL, 10);
+    free(text);
+
+    return count;
+}
+
+void test_flush_publishes_queue_depth_for_devices_never_applied_to(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    unsigned long long before = performance_publishes();
+
+    status_flush_performance();
+    TEST_ASSERT_EQUAL_UINT64(before + 2, performance_publishes());
+
+    // Nothing changed since, so the next flush is quiet.
+    status_flush_performance();
+    TEST_ASSERT_EQUAL_UINT64(before + 2, performance_publishes());
+}
+
+void test_connect_republishes_within_the_rate_limit(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    status_flush_performance();
+    unsigned long long before = performance_publishes();
+
+    // The broker came back: what was published while it was away is sent again, without waiting out the limit.
+    status_mark_performance_dirty();
+    status_flush_performance();
+    TEST_ASSERT_EQUAL_UINT64(before + 2, performance_publishes());
+
+    status_flush_performance();
+    TEST_ASSERT_EQUAL_UINT64(before + 2, performance_publishes());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_flush_publishes_queue_depth_for_devices_never_applied_to);
+    RUN_TEST(test_connect_republishes_within_the_rate_limit);
+
+    return UNITY_END();
+}
@@ -0,0 +1,99 @@
+#include "third_party/unity/unity.h"
+#include "config_types.h"
+#include "ha_topics.h"
+
+#include <stdio.h>
+
+static config_t g_cfg;
+static config_device_t g_devices[2];
+
+void setUp(void) {
+    g_cfg = (config_t){0};
+    snprintf(g_cfg.mqtt_cfg.prefix, sizeof(g_cfg.mqtt_cfg.prefix), "%s", "chrishansentech");
+    snprintf(g_cfg.mqtt_cfg.instance, sizeof(g_cfg.mqtt_cfg.instance), "%s", "front_door");
+
+    g_devices[0] = (config_device_t){ .index = 0 };
+    snprintf(g_devices[0].id, sizeof(g_devices[0].id), "%s", "front_door");
+
+    g_devices[1] = (config_device_t){ .index = 1 };
+    snprintf(g_devices[1].id, sizeof(g_devices[1].id), "%s", "back_door");
+
+    g_cfg.devices_cfg.items = g_devices;
+    g_cfg.devices_cfg.count = 1;
+}
+
+void tearDown(void) {
+    ha_topics_shutdown();
+}
+
+void test_ha_topics_init_builds_fixed_topics(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/status", ha_topic(0, HA_TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/preset/selected", ha_topic(0, HA_TOPIC_PRESET_SELECTED));
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/last_download/time/attributes", ha_topic(0, HA_TOPIC_LAST_DOWNLOAD_ATTRIBUTES));
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/cmd/preset_set", ha_topic(0, HA_TOPIC_CMD_PRESET_SET));
+}
+
+void test_ha_topics_lookup_returns_stable_pointer(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    TEST_ASSERT_EQUAL_PTR(ha_topic(0, HA_TOPIC_AVAILABILITY), ha_availability_topic());
+    TEST_ASSERT_EQUAL_PTR(ha_topic(0, HA_TOPIC_STATUS), ha_topic(0, HA_TOPIC_STATUS));
+}
+
+void test_ha_topics_returns_null_for_none_and_unknown_device(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    TEST_ASSERT_NULL(ha_topic(0, HA_TOPIC_NONE));
+    TEST_ASSERT_NULL(ha_topic(0, HA_TOPIC_COUNT));
+    TEST_ASSERT_NULL(ha_topic(ha_topics_device_count(), HA_TOPIC_STATUS));
+}
+
+void test_ha_topics_builds_one_table_per_device(void) {
+    g_cfg.devices_cfg.count = 2;
+
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    TEST_ASSERT_EQUAL_size_t(2, ha_topics_device_count());
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/status", ha_topic(0, HA_TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/back_door/status", ha_topic(1, HA_TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/back_door/cmd/preset_set", ha_topic(1, HA_TOPIC_CMD_PRESET_SET));
+}
+
+void test_ha_topics_devices_share_interned_availability(void) {
+    g_cfg.devices_cfg.count = 2;
+
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+
+    TEST_ASSERT_EQUAL_STRING("chrishansentech/doorbell-mqtt/front_door/availability", ha_topic(1, HA_TOPIC_AVAILABILITY));
+    TEST_ASSERT_EQUAL_PTR(ha_topic(0, HA_TOPIC_AVAILABILITY), ha_topic(1, HA_TOPIC_AVAILABILITY));
+}
+
+void test_ha_topics_init_fails_without_devices(void) {
+    g_cfg.devices_cfg.count = 0;
+
+    TEST_ASSERT_FALSE(ha_topics_init(&g_cfg));
+}
+
+void test_ha_topics_returns_null_after_shutdown(void) {
+    TEST_ASSERT_TRUE(ha_topics_init(&g_cfg));
+    ha_topics_shutdown();
+
+    TEST_ASSERT_EQUAL_size_t(0, ha_topics_device_count());
+    TEST_ASSERT_NULL(ha_topic(0, HA_TOPIC_STATUS));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_ha_topics_init_builds_fixed_topics);
+    RUN_TEST(test_ha_topics_lookup_returns_stable_pointer);
+    RUN_TEST(test_ha_topics_returns_null_for_none_and_unknown_device);
+    RUN_TEST(test_ha_topics_builds_one_table_per_device);
+    RUN_TEST(test_ha_topics_devices_share_interned_availability);
+    RUN_TEST(test_ha_topics_init_fails_without_devices);
+    RUN_TEST(test_ha_topics_returns_null_after_shutdown);
+
+    return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#include "third_party/unity/unity.h"
+#include "json_bind.h"
+#include "unifi_profile_json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_parse_profile_binds_every_member(void) {
+    const char *json =
+        "{\"schemaVersion\": 1, \"extra\": {\"ignored\": [1, \"}\"]},\n"
+        " \"welcome\": {\"enabled\": true, \"file\": \"tree.png\", \"count\": 24, \"durationMs\": 3000, \"loop\": true, \"guiId\": \"WELCOME\"},\n"
+        " \"ringButton\": {\"enabled\": true, \"file\": \"bells.wav\", \"repeatTimes\": 3, \"volume\": 80, \"soundStateName\": \"RING_BUTTON_PRESSED\"}}";
+    unifi_profile_t p;
+
+    TEST_ASSERT_TRUE(json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, json, strlen(json), &p, NULL));
+    TEST_ASSERT_EQUAL_INT(1, p.schema_version);
+    TEST_ASSERT_TRUE(p.welcome.enabled);
+    TEST_ASSERT_EQUAL_STRING("tree.png", p.welcome.file);
+    TEST_ASSERT_EQUAL_INT(24, p.welcome.count);
+    TEST_ASSERT_EQUAL_INT(3000, p.welcome.duration_ms);
+    TEST_ASSERT_TRUE(p.welcome.loop);
+    TEST_ASSERT_EQUAL_STRING("WELCOME", p.welcome.gui_id);
+    TEST_ASSERT_TRUE(p.ring_button.enabled);
+    TEST_ASSERT_EQUAL_STRING("bells.wav", p.ring_button.file);
+    TEST_ASSERT_EQUAL_INT(3, p.ring_button.repeat_times);
+    TEST_ASSERT_EQUAL_INT(80, p.ring_button.volume);
+    TEST_ASSERT_EQUAL_STRING("RING_BUTTON_PRESSED", p.ring_button.sound_state_name);
+}
+
+void test_parse_missing_and_null_members_take_defaults(void) {
+    const char *json = "{\"welcome\": null, \"ringButton\": {\"file\": \"bells.wav\", \"volume\": null}}";
+    unifi_profile_t p;
+
+    memset(&p, 0x5a, sizeof(p));
+
+    TEST_ASSERT_TRUE(json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, json, strlen(json), &p, NULL));
+    TEST_ASSERT_EQUAL_INT(1, p.schema_version);
+    TEST_ASSERT_FALSE(p.welcome.enabled);
+    TEST_ASSERT_EQUAL_STRING("", p.welcome.file);
+    TEST_ASSERT_EQUAL_INT(0, p.welcome.count);
+    TEST_ASSERT_EQUAL_STRING("bells.wav", p.ring_button.file);
+    TEST_ASSERT_EQUAL_INT(1, p.ring_button.repeat_times);
+    TEST_ASSERT_EQUAL_INT(100, p.ring_button.volume);
+}
+
+void test_parse_reports_line_and_column(void) {
+    const char *cases[][2] = {
+        { "{\n  \"welcome\": {\n    \"count\": \"24\"\n  }\n}", "3:14" },
+        { "{\n  \"schemaVersion\": 1,\n  \"welcome\": {\"enabled\": yes}\n}", "3:26" },
+        { "{\"schemaVersion\": 1\n\"welcome\": {}}", "2:1" },
+        { "{\"schemaVersion\": 1} {}", "1:22" },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        unifi_profile_t p;
+        json_bind_error_t err;
+        char where[32];
+
+        TEST_ASSERT_FALSE(json_bind_parse(UNIFI_PROFILE_FIELDS, UNIFI_PROFILE_FIELD_COUNT, cases[i][0], strlen(cases[i][0]), &p, &err));
+        snprintf(where, sizeof(where), "%d:%d", err.line, err.column);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(cases[i][1], where, err.message);
+        TEST_ASSERT_NOT_EQUAL(0, strlen(err.message));
+    }
+}
+
+void test_parse_rejects_overlong_strings_and_bad_escapes(void) {
+    unifi_last_applied_profile_t state;
+    json_bind_error_t err;
+    char json[600];
+
+    memset(json, 0, sizeof(json));
+    strcpy(json, "{\"profileName\": \"");
+    memset(json + strlen(json), 'a', 300);
+    strcat(json, "\"}");
+
+    TEST_ASSERT_FALSE(json_bind_parse(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, json, strlen(json), &state, &err));
+    TEST_ASSERT_NOT_NULL(strstr(err.message, "longer than 255"));
+
+    const char *bad_escape = "{\"profileName\": \"a\\qb\"}";
+    TEST_ASSERT_FALSE(json_bind_parse(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, bad_escape, strlen(bad_escape), &state, &err));
+    TEST_ASSERT_EQUAL_INT(19, err.column);
+}
+
+void test_write_then_parse_round_trips(void) {
+    unifi_last_applied_profile_t in = {
+        .schema_version = 1,
+        .is_preset = true,
+        .appied_at = 1767225600,
+    };
+    unifi_last_applied_profile_t out;
+    char *json = NULL;
+    size_t json_len = 0;
+
+    snprintf(in.profile_name, sizeof(in.profile_name), "%s", "Caf\xc3\xa9 \"quoted\" \\ tab\t");
+
+    TEST_ASSERT_TRUE(json_bind_write(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, &in, &json, &json_len));
+    TEST_ASSERT_EQUAL_UINT(strlen(json), json_len);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\n"
+        "\t\"schemaVersion\":\t1,\n"
+        "\t\"profileName\":\t\"Caf\xc3\xa9 \\\"quoted\\\" \\\\ tab\\u0009\",\n"
+        "\t\"isPreset\":\ttrue,\n"
+        "\t\"appliedAt\":\t1767225600\n"
+        "}\n", json);
+
+    TEST_ASSERT_TRUE(json_bind_parse(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, json, json_len, &out, NULL));
+    TEST_ASSERT_EQUAL_STRING(in.profile_name, out.profile_name);
+    TEST_ASSERT_TRUE(out.is_preset);
+    TEST_ASSERT_EQUAL_INT64(1767225600, (long long)out.appied_at);
+    free(json);
+
+    const char *escaped = "{\"profileName\": \"\\u00e9\\ud83c\\udf84\\/\"}";
+    TEST_ASSERT_TRUE(json_bind_parse(UNIFI_LAST_APPLIED_FIELDS, UNIFI_LAST_APPLIED_FIELD_COUNT, escaped, strlen(escaped), &out, NULL));
+    TEST_ASSERT_EQUAL_STRING("\xc3\xa9\xf0\x9f\x8e\x84/", out.profile_name);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_profile_binds_every_member);
+    RUN_TEST(test_parse_missing_and_null_members_take_defaults);
+    RUN_TEST(test_parse_reports_line_and_column);
+    RUN_TEST(test_parse_rejects_overlong_strings_and_bad_escapes);
+    RUN_TEST(test_write_then_parse_round_trips);
+
+    return UNITY_END();
+}
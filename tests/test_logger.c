@@ -0,0 +1,165 @@
+#include "third_party/unity/unity.h"
+#include "cJSON.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+#define LINES_PER_THREAD 500
+
+static FILE *g_stream;
+
+void setUp(void) {
+    g_stream = tmpfile();
+    TEST_ASSERT_NOT_NULL(g_stream);
+
+    log_set_stream(g_stream);
+    log_set_level(LOG_LEVEL_DEBUG);
+    log_set_format(LOG_FORMAT_TEXT);
+    log_set_overflow(LOG_OVERFLOW_DROP);
+}
+
+void tearDown(void) {
+    log_shutdown();
+    log_set_stream(NULL);
+    fclose(g_stream);
+}
+
+static char *read_stream(void) {
+    fflush(g_stream);
+
+    long len = ftell(g_stream);
+    char *text = calloc(1, (size_t)len + 1);
+
+    rewind(g_stream);
+    TEST_ASSERT_EQUAL_size_t((size_t)len, fread(text, 1, (size_t)len, g_stream));
+
+    return text;
+}
+
+static size_t count_lines(const char *text) {
+    size_t n = 0;
+
+    for (; *text; text++) {
+        n += *text == '\n';
+    }
+
+    return n;
+}
+
+void test_text_lines_keep_their_layout(void) {
+    LOG_INFO("hello %d", 42);
+    LOG_WARN("careful");
+
+    char *text = read_stream();
+
+    // "YYYY-MM-DD HH:MM:SS " prefix, then the level and message.
+    TEST_ASSERT_EQUAL_size_t(2, count_lines(text));
+    TEST_ASSERT_EQUAL_STRING_LEN(" [INFO ] hello 42\n", text + 19, 18);
+    TEST_ASSERT_NOT_NULL(strstr(text, " [WARN ] test_text_lines_keep_their_layout: careful\n"));
+    free(text);
+}
+
+void test_json_lines_escape_the_message(void) {
+    log_set_format(LOG_FORMAT_JSON);
+    LOG_ERROR("quote \" slash \\ newline\n tab\t");
+
+    char *text = read_stream();
+    cJSON *line = cJSON_Parse(text);
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(line, text);
+    TEST_ASSERT_EQUAL_STRING("error", cJSON_GetStringValue(cJSON_GetObjectItem(line, "level")));
+    TEST_ASSERT_EQUAL_STRING("quote \" slash \\ newline\n tab\t", cJSON_GetStringValue(cJSON_GetObjectItem(line, "msg")));
+    TEST_ASSERT_EQUAL_STRING("test_json_lines_escape_the_message", cJSON_GetStringValue(cJSON_GetObjectItem(line, "func")));
+    TEST_ASSERT_TRUE(cJSON_IsNumber(cJSON_GetObjectItem(line, "line")));
+    TEST_ASSERT_EQUAL_CHAR('T', cJSON_GetStringValue(cJSON_GetObjectItem(line, "ts"))[10]);
+
+    cJSON_Delete(line);
+    free(text);
+}
+
+static void *log_burst(void *arg) {
+    int id = *(int *)arg;
+
+    for (int i = 0; i < LINES_PER_THREAD; i++) {
+        LOG_DEBUG("thread %d line %d", id, i);
+    }
+
+    return NULL;
+}
+
+static void run_burst(void) {
+    pthread_t threads[THREADS];
+    int ids[THREADS];
+
+    for (int i = 0; i < THREADS; i++) {
+        ids[i] = i;
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, log_burst, &ids[i]));
+    }
+
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void test_async_block_mode_delivers_every_line_in_order(void) {
+    log_set_overflow(LOG_OVERFLOW_BLOCK);
+    TEST_ASSERT_TRUE(log_start_async());
+
+    run_burst();
+    log_shutdown();
+
+    char *text = read_stream();
+    int next[THREADS] = {0};
+
+    TEST_ASSERT_EQUAL_size_t(THREADS * LINES_PER_THREAD, count_lines(text));
+
+    // Lines from one thread come out in the order it logged them.
+    for (const char *p = strstr(text, "thread "); p; p = strstr(p + 1, "thread ")) {
+        int id = -1;
+        int n = -1;
+
+        TEST_ASSERT_EQUAL_INT(2, sscanf(p, "thread %d line %d", &id, &n));
+        TEST_ASSERT_EQUAL_INT(next[id], n);
+        next[id]++;
+    }
+
+    free(text);
+}
+
+void test_async_drop_mode_counts_and_reports_dropped_lines(void) {
+    unsigned long before = log_dropped();
+
+    TEST_ASSERT_TRUE(log_start_async());
+    run_burst();
+    log_shutdown();
+
+    char *text = read_stream();
+    unsigned long dropped = log_dropped() - before;
+    size_t lines = count_lines(text);
+
+    // Every line was either written or counted; a report line appears for any drops.
+    if (dropped > 0) {
+        TEST_ASSERT_NOT_NULL(strstr(text, "line(s) dropped"));
+        TEST_ASSERT_GREATER_OR_EQUAL(1, lines + dropped - THREADS * LINES_PER_THREAD);
+    } else {
+        TEST_ASSERT_EQUAL_size_t(THREADS * LINES_PER_THREAD, lines);
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL(THREADS * LINES_PER_THREAD + 16, lines + dropped);
+    free(text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_text_lines_keep_their_layout);
+    RUN_TEST(test_json_lines_escape_the_message);
+    RUN_TEST(test_async_block_mode_delivers_every_line_in_order);
+    RUN_TEST(test_async_drop_mode_counts_and_reports_dropped_lines);
+
+    return UNITY_END();
+}
@@ -0,0 +1,200 @@
+#include "third_party/unity/unity.h"
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define THREADS 8
+#define INCREMENTS 10000
+#define TEST_PORT 19464
+
+void setUp(void) {}
+
+void tearDown(void) {
+    metrics_http_stop();
+}
+
+// Value of the sample whose name and labels are exactly series, or -1 if it is missing.
+static double sample(const char *text, const char *series) {
+    size_t len = strlen(series);
+
+    for (const char *line = text; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        if (strncmp(line, series, len) == 0 && line[len] == ' ') {
+            return strtod(line + len + 1, NULL);
+        }
+    }
+
+    return -1;
+}
+
+static double render_sample(const char *series) {
+    char *text = metrics_render(NULL);
+    TEST_ASSERT_NOT_NULL(text);
+
+    double value = sample(text, series);
+    free(text);
+
+    return value;
+}
+
+static void *count_commands(void *arg) {
+    (void)arg;
+
+    for (int i = 0; i < INCREMENTS; i++) {
+        metrics_inc(METRIC_COMMANDS);
+    }
+
+    metrics_add(METRIC_UPLOAD_BYTES, 1000);
+    return NULL;
+}
+
+void test_counters_from_many_threads_add_up(void) {
+    double commands = render_sample("doorbell_commands_total");
+    double bytes = render_sample("doorbell_upload_bytes_total");
+    pthread_t threads[THREADS];
+
+    for (int i = 0; i < THREADS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, count_commands, NULL));
+    }
+
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL_FLOAT(commands + THREADS * INCREMENTS, render_sample("doorbell_commands_total"));
+    TEST_ASSERT_EQUAL_FLOAT(bytes + THREADS * 1000, render_sample("doorbell_upload_bytes_total"));
+    TEST_ASSERT_EQUAL_FLOAT(commands + THREADS * INCREMENTS, (double)metrics_counter_value(METRIC_COMMANDS));
+    TEST_ASSERT_EQUAL_UINT64(0, metrics_counter_value(METRIC_INBOUND_QUEUE_DEPTH));
+
+    // Counter updates through the wrong kind are ignored.
+    metrics_gauge_set(METRIC_COMMANDS, 5);
+    TEST_ASSERT_EQUAL_FLOAT(commands + THREADS * INCREMENTS, render_sample("doorbell_commands_total"));
+}
+
+void test_gauge_tracks_queue_depth(void) {
+    metrics_gauge_set(METRIC_INBOUND_QUEUE_DEPTH, 3);
+    metrics_gauge_add(METRIC_INBOUND_QUEUE_DEPTH, -1);
+
+    TEST_ASSERT_EQUAL_FLOAT(2, render_sample("doorbell_inbound_queue_depth"));
+    metrics_gauge_set(METRIC_INBOUND_QUEUE_DEPTH, 0);
+}
+
+void test_histogram_buckets_are_cumulative(void) {
+    metrics_observe_seconds(METRIC_SSH_AUTH_SECONDS, 0.003);
+    metrics_observe_seconds(METRIC_SSH_AUTH_SECONDS, 0.2);
+    metrics_observe_seconds(METRIC_SSH_AUTH_SECONDS, 0.25);
+    metrics_observe_seconds(METRIC_SSH_AUTH_SECONDS, 500);
+
+    char *text = metrics_render(NULL);
+    TEST_ASSERT_NOT_NULL(text);
+
+    TEST_ASSERT_NOT_NULL(strstr(text, "# TYPE doorbell_ssh_auth_duration_seconds histogram\n"));
+    TEST_ASSERT_EQUAL_FLOAT(1, sample(text, "doorbell_ssh_auth_duration_seconds_bucket{le=\"0.005\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(1, sample(text, "doorbell_ssh_auth_duration_seconds_bucket{le=\"0.1\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(3, sample(text, "doorbell_ssh_auth_duration_seconds_bucket{le=\"0.25\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(3, sample(text, "doorbell_ssh_auth_duration_seconds_bucket{le=\"120\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(4, sample(text, "doorbell_ssh_auth_duration_seconds_bucket{le=\"+Inf\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(4, sample(text, "doorbell_ssh_auth_duration_seconds_count"));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 500.453, sample(text, "doorbell_ssh_auth_duration_seconds_sum"));
+
+    free(text);
+}
+
+void test_errors_and_publishes_are_labelled(void) {
+    metrics_count_error(ERROR_NONE);
+    metrics_count_error(ERROR_SSH_AUTH_FAILED);
+    metrics_count_error(ERROR_SSH_AUTH_FAILED);
+    metrics_count_publish(HA_TOPIC_STATUS);
+    metrics_count_publish(HA_TOPIC_NONE);
+
+    char *text = metrics_render(NULL);
+    TEST_ASSERT_NOT_NULL(text);
+
+    TEST_ASSERT_EQUAL_FLOAT(2, sample(text, "doorbell_errors_total{code=\"3002\",name=\"ERROR_SSH_AUTH_FAILED\"}"));
+    TEST_ASSERT_NULL(strstr(text, "ERROR_NONE"));
+    TEST_ASSERT_EQUAL_FLOAT(1, sample(text, "doorbell_status_publishes_total{topic=\"status\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(1, sample(text, "doorbell_status_publishes_total{topic=\"other\"}"));
+    TEST_ASSERT_EQUAL_FLOAT(0, sample(text, "doorbell_status_publishes_total{topic=\"last_error\"}"));
+
+    free(text);
+}
+
+static char *http_get(const char *path) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(TEST_PORT) };
+    char request[128];
+    size_t cap = 4096;
+    size_t len = 0;
+    char *response = malloc(cap);
+
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_NOT_NULL(response);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    TEST_ASSERT_EQUAL_INT(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+
+    int n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    TEST_ASSERT_EQUAL_INT(n, (int)send(fd, request, (size_t)n, 0));
+
+    for (;;) {
+        if (len + 1024 > cap) {
+            cap *= 2;
+            response = realloc(response, cap);
+            TEST_ASSERT_NOT_NULL(response);
+        }
+
+        ssize_t got = recv(fd, response + len, cap - len - 1, 0);
+        if (got <= 0) {
+            break;
+        }
+
+        len += (size_t)got;
+    }
+
+    response[len] = '\0';
+    close(fd);
+
+    return response;
+}
+
+void test_http_endpoint_serves_metrics_only(void) {
+    config_metrics_t cfg = { .port = TEST_PORT, .address = "127.0.0.1" };
+
+    if (!metrics_http_start(&cfg)) {
+        TEST_IGNORE_MESSAGE("test port is in use");
+    }
+
+    metrics_inc(METRIC_MQTT_RECONNECTS);
+
+    char *response = http_get("/metrics");
+    TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 200 OK\r\n", response, 17);
+    TEST_ASSERT_NOT_NULL(strstr(response, "Content-Type: text/plain; version=0.0.4"));
+    TEST_ASSERT_NOT_NULL(strstr(response, "\ndoorbell_mqtt_reconnects_total "));
+    free(response);
+
+    response = http_get("/");
+    TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 404 Not Found\r\n", response, 24);
+    free(response);
+
+    // Port 0 keeps the endpoint off.
+    metrics_http_stop();
+    cfg.port = 0;
+    TEST_ASSERT_TRUE(metrics_http_start(&cfg));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_counters_from_many_threads_add_up);
+    RUN_TEST(test_gauge_tracks_queue_depth);
+    RUN_TEST(test_histogram_buckets_are_cumulative);
+    RUN_TEST(test_errors_and_publishes_are_labelled);
+    RUN_TEST(test_http_endpoint_serves_metrics_only);
+
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include "third_party/unity/unity.h"
+#include "errors.h"
+#include "profile_check.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char g_root[PATH_MAX];
+
+// 8-byte signature, IHDR length + tag, then width and height (big-endian).
+static const unsigned char PNG_480x240[24] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+    0, 0, 0, 13, 'I', 'H', 'D', 'R',
+    0, 0, 0x01, 0xe0, 0, 0, 0, 0xf0
+};
+
+static void write_bytes(const char *dir, const char *name, const void *data, size_t len) {
+    char path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), dir, name));
+
+    FILE *fp = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL_size_t(len, fwrite(data, 1, len, fp));
+    fclose(fp);
+}
+
+static void make_profile(const char *name, int count, char *out_dir, size_t out_len) {
+    char json[512];
+
+    TEST_ASSERT_TRUE(utils_build_path(out_dir, out_len, g_root, name));
+    TEST_ASSERT_TRUE(utils_create_directory(out_dir));
+
+    snprintf(json, sizeof(json),
+             "{\"schemaVersion\":1,"
+             "\"welcome\":{\"enabled\":true,\"file\":\"anim.png\",\"count\":%d,\"durationMs\":100},"
+             "\"ringButton\":{\"enabled\":true,\"file\":\"ring.ogg\",\"repeatTimes\":1,\"volume\":100}}", count);
+
+    write_bytes(out_dir, "profile.json", json, strlen(json));
+    write_bytes(out_dir, "anim.png", PNG_480x240, sizeof(PNG_480x240));
+    write_bytes(out_dir, "ring.ogg", "OggS\0\x02", 6);
+}
+
+void setUp(void) {
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_profile_check_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+}
+
+void tearDown(void) {
+    utils_delete_directory(g_root);
+}
+
+void test_png_frames_reads_sprite_sheet_size(void) {
+    int frames = 0;
+
+    TEST_ASSERT_TRUE(profile_check_png_frames(PNG_480x240, sizeof(PNG_480x240), &frames));
+    TEST_ASSERT_EQUAL_INT(2, frames);
+
+    unsigned char odd[24];
+    memcpy(odd, PNG_480x240, sizeof(odd));
+    odd[19] = 0xe1;     // 481 px wide
+
+    TEST_ASSERT_FALSE(profile_check_png_frames(odd, sizeof(odd), &frames));
+    TEST_ASSERT_FALSE(profile_check_png_frames(PNG_480x240, 16, &frames));
+}
+
+void test_sound_header_accepts_ogg_and_wav(void) {
+    TEST_ASSERT_TRUE(profile_check_sound_header((const unsigned char *)"OggS", 4));
+    TEST_ASSERT_TRUE(profile_check_sound_header((const unsigned char *)"RIFF\x24\0\0\0WAVE", 12));
+    TEST_ASSERT_FALSE(profile_check_sound_header((const unsigned char *)"ID3\x03", 4));
+}
+
+void test_check_dir_reports_frame_count_mismatch(void) {
+    char dir[PATH_MAX];
+    char message[256];
+
+    make_profile("good", 2, dir, sizeof(dir));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profile_check_dir(dir, message, sizeof(message)));
+
+    make_profile("bad", 3, dir, sizeof(dir));
+    TEST_ASSERT_EQUAL_INT(ERROR_PROFILE_INVALID, profile_check_dir(dir, message, sizeof(message)));
+    TEST_ASSERT_NOT_NULL(strstr(message, "welcome.count"));
+}
+
+void test_check_library_runs_in_parallel_and_caches_by_digest(void) {
+    char dir[PATH_MAX];
+    profile_check_report_t report;
+
+    make_profile("good", 2, dir, sizeof(dir));
+    make_profile("bad", 3, dir, sizeof(dir));
+
+    TEST_ASSERT_FALSE(profile_check_library(g_root, NULL, 4, &report));
+    TEST_ASSERT_EQUAL_size_t(2, report.count);
+    TEST_ASSERT_EQUAL_size_t(1, report.failed);
+    TEST_ASSERT_EQUAL_size_t(0, report.cached);
+    profile_check_report_free(&report);
+
+    TEST_ASSERT_FALSE(profile_check_library(g_root, NULL, 4, &report));
+    TEST_ASSERT_EQUAL_size_t(1, report.failed);
+    TEST_ASSERT_EQUAL_size_t(2, report.cached);
+    profile_check_report_free(&report);
+
+    // Fixing the profile changes its digest, so only it is checked again.
+    make_profile("bad", 2, dir, sizeof(dir));
+
+    TEST_ASSERT_TRUE(profile_check_library(g_root, NULL, 4, &report));
+    TEST_ASSERT_EQUAL_size_t(1, report.cached);
+    profile_check_report_free(&report);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_png_frames_reads_sprite_sheet_size);
+    RUN_TEST(test_sound_header_accepts_ogg_and_wav);
+    RUN_TEST(test_check_dir_reports_frame_count_mismatch);
+    RUN_TEST(test_check_library_runs_in_parallel_and_caches_by_digest);
+
+    return UNITY_END();
+}
@@ -0,0 +1,119 @@
+#include "third_party/unity/unity.h"
+#include "config_types.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static config_schedule_window_t g_windows[2];
+static config_schedule_t g_schedule;
+
+static time_t local_time(int year, int month, int day, int hour, int minute) {
+    struct tm tm = {0};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+void setUp(void) {
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    memset(g_windows, 0, sizeof(g_windows));
+    memset(&g_schedule, 0, sizeof(g_schedule));
+
+    snprintf(g_windows[0].preset, sizeof(g_windows[0].preset), "%s", "Christmas");
+    g_windows[0].start = (config_schedule_time_t){ .year = 0, .month = 12, .day = 24, .hour = 0, .minute = 0 };
+    g_windows[0].end = (config_schedule_time_t){ .year = 0, .month = 12, .day = 26, .hour = 0, .minute = 0 };
+    g_windows[0].has_end = true;
+
+    snprintf(g_windows[1].preset, sizeof(g_windows[1].preset), "%s", "New Years");
+    snprintf(g_windows[1].tag, sizeof(g_windows[1].tag), "%s", "outdoor");
+    g_windows[1].start = (config_schedule_time_t){ .year = 2030, .month = 12, .day = 31, .hour = 23, .minute = 0 };
+
+    g_schedule.items = g_windows;
+    g_schedule.count = 2;
+}
+
+void tearDown(void) {}
+
+void test_scheduler_picks_yearly_start_in_current_year(void) {
+    scheduler_event_t ev;
+
+    TEST_ASSERT_TRUE(scheduler_next_event(&g_schedule, local_time(2029, 6, 1, 12, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("Christmas", ev.preset);
+    TEST_ASSERT_TRUE(ev.at == local_time(2029, 12, 24, 0, 0));
+}
+
+void test_scheduler_ignores_end_without_default_preset(void) {
+    scheduler_event_t ev;
+
+    TEST_ASSERT_TRUE(scheduler_next_event(&g_schedule, local_time(2029, 12, 25, 0, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("Christmas", ev.preset);
+    TEST_ASSERT_TRUE(ev.at == local_time(2030, 12, 24, 0, 0));
+}
+
+void test_scheduler_switches_back_to_default_at_window_end(void) {
+    scheduler_event_t ev;
+    snprintf(g_schedule.default_preset, sizeof(g_schedule.default_preset), "%s", "Everyday");
+
+    TEST_ASSERT_TRUE(scheduler_next_event(&g_schedule, local_time(2029, 12, 25, 0, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("Everyday", ev.preset);
+    TEST_ASSERT_TRUE(ev.at == local_time(2029, 12, 26, 0, 0));
+}
+
+void test_scheduler_one_off_window_keeps_tag(void) {
+    scheduler_event_t ev;
+
+    TEST_ASSERT_TRUE(scheduler_next_event(&g_schedule, local_time(2030, 12, 26, 0, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("New Years", ev.preset);
+    TEST_ASSERT_EQUAL_STRING("outdoor", ev.tag);
+}
+
+void test_scheduler_skips_past_one_off_window(void) {
+    scheduler_event_t ev;
+    g_windows[0] = g_windows[1];
+    g_schedule.count = 1;
+
+    TEST_ASSERT_FALSE(scheduler_next_event(&g_schedule, local_time(2031, 1, 1, 0, 0), &ev));
+}
+
+void test_scheduler_active_window_is_caught_up(void) {
+    scheduler_event_t ev;
+
+    TEST_ASSERT_TRUE(scheduler_active_event(&g_schedule, local_time(2029, 12, 25, 0, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("Christmas", ev.preset);
+    TEST_ASSERT_TRUE(ev.at == local_time(2029, 12, 24, 0, 0));
+
+    // Closed window and nothing to switch back to.
+    TEST_ASSERT_FALSE(scheduler_active_event(&g_schedule, local_time(2029, 6, 1, 12, 0), &ev));
+
+    snprintf(g_schedule.default_preset, sizeof(g_schedule.default_preset), "%s", "Everyday");
+    TEST_ASSERT_TRUE(scheduler_active_event(&g_schedule, local_time(2029, 6, 1, 12, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("Everyday", ev.preset);
+    TEST_ASSERT_TRUE(ev.at == local_time(2028, 12, 26, 0, 0));
+
+    // A one-off window without an end stays active.
+    TEST_ASSERT_TRUE(scheduler_active_event(&g_schedule, local_time(2031, 1, 1, 0, 0), &ev));
+    TEST_ASSERT_EQUAL_STRING("New Years", ev.preset);
+    TEST_ASSERT_EQUAL_STRING("outdoor", ev.tag);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_scheduler_picks_yearly_start_in_current_year);
+    RUN_TEST(test_scheduler_ignores_end_without_default_preset);
+    RUN_TEST(test_scheduler_switches_back_to_default_at_window_end);
+    RUN_TEST(test_scheduler_one_off_window_keeps_tag);
+    RUN_TEST(test_scheduler_skips_past_one_off_window);
+    RUN_TEST(test_scheduler_active_window_is_caught_up);
+
+    return UNITY_END();
+}
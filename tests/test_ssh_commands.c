@@ -0,0 +1,158 @@
+#include "third_party/unity/unity.h"
+#include "ssh_commands.h"
+
+#include <string.h>
+
+#define CACHE_DIR "/etc/persistent/doorbell-mqtt-cache"
+#define MD5_A "0123456789abcdef0123456789abcdef"
+#define MD5_B "fedcba9876543210fedcba9876543210"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_cache_fetch_copies_entry_and_writes_sidecar(void) {
+    char cmd[1024];
+
+    TEST_ASSERT_TRUE(ssh_cmd_cache_fetch(cmd, sizeof(cmd), CACHE_DIR, MD5_A, "/tmp/doorbell-mqtt-unifi", "anim.png"));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "cp -f '" CACHE_DIR "/" MD5_A "' '/tmp/doorbell-mqtt-unifi/anim.png'"));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "> '/tmp/doorbell-mqtt-unifi/anim.png.md5'"));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "touch '" CACHE_DIR "/" MD5_A "'"));
+}
+
+void test_cache_fetch_rejects_quotes(void) {
+    char cmd[1024];
+
+    TEST_ASSERT_FALSE(ssh_cmd_cache_fetch(cmd, sizeof(cmd), CACHE_DIR, MD5_A, "/tmp/doorbell-mqtt-unifi", "it's.png"));
+}
+
+void test_cache_store_copies_each_file_then_prunes(void) {
+    char cmd[2048];
+    const char *files[] = { "anim.png", "ring.wav" };
+    const char *md5s[] = { MD5_A, MD5_B };
+
+    TEST_ASSERT_TRUE(build_cache_store_command(cmd, sizeof(cmd), CACHE_DIR, "/tmp/doorbell-mqtt-unifi", files, md5s, 2, 6, 4096));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "CACHE='" CACHE_DIR "'"));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "cp -f '/tmp/doorbell-mqtt-unifi/anim.png' \"$CACHE/" MD5_A "\""));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "cp -f '/tmp/doorbell-mqtt-unifi/ring.wav' \"$CACHE/" MD5_B "\""));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "[ $n -gt 6 -o $kb -gt 4096 ]"));
+}
+
+void test_cache_store_fails_when_buffer_too_small(void) {
+    char cmd[64];
+    const char *files[] = { "anim.png" };
+    const char *md5s[] = { MD5_A };
+
+    TEST_ASSERT_FALSE(build_cache_store_command(cmd, sizeof(cmd), CACHE_DIR, "/tmp/doorbell-mqtt-unifi", files, md5s, 1, 6, 4096));
+}
+
+void test_cache_store_falls_back_to_compressed_upload(void) {
+    char cmd[2048];
+    const char *files[] = { "ring.wav" };
+    const char *md5s[] = { MD5_B };
+
+    TEST_ASSERT_TRUE(build_cache_store_command(cmd, sizeof(cmd), CACHE_DIR, "/tmp/doorbell-mqtt-unifi", files, md5s, 1, 6, 4096));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "gzip -dc '/tmp/doorbell-mqtt-unifi/ring.wav.gz' > \"$CACHE/" MD5_B "\""));
+}
+
+void test_apply_script_decompresses_before_moving(void) {
+    char cmd[8192];
+
+    TEST_ASSERT_TRUE(build_apply_profile_command(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+
+    const char *decompress = strstr(cmd, "run decompress gzip -df");
+    const char *first_move = strstr(cmd, "run move_anim ");
+
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "for f in '/tmp/doorbell-mqtt-unifi'/*.gz; do"));
+    TEST_ASSERT_NOT_NULL(decompress);
+    TEST_ASSERT_NOT_NULL(first_move);
+    TEST_ASSERT_TRUE(decompress < first_move);
+}
+
+void test_apply_script_fails_when_buffer_too_small(void) {
+    char cmd[8192];
+    size_t full;
+
+    TEST_ASSERT_TRUE(build_apply_profile_command(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+    full = strlen(cmd);
+
+    // Every cut, from the preamble to the closing restart, is refused rather than returned as a shorter script.
+    TEST_ASSERT_FALSE(build_apply_profile_command(cmd, 64, "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+    TEST_ASSERT_FALSE(build_apply_profile_command(cmd, full / 2, "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+    TEST_ASSERT_FALSE(build_apply_profile_command(cmd, full, "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+    TEST_ASSERT_TRUE(build_apply_profile_command(cmd, full + 1, "/tmp/doorbell-mqtt-unifi", "anim.png", "ring.wav"));
+}
+
+void test_conf_script_restarts_only_the_named_service(void) {
+    char cmd[8192];
+
+    TEST_ASSERT_FALSE(build_apply_conf_command(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", false, false));
+    TEST_ASSERT_TRUE(build_apply_conf_command(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", false, true));
+
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "run move_snd_conf mv -f '/tmp/doorbell-mqtt-unifi/ubnt_sounds_leds.conf.patched'"));
+    TEST_ASSERT_NOT_NULL(strstr(cmd, "svc=ubnt_sounds_leds"));
+    TEST_ASSERT_NULL(strstr(cmd, "ubnt_lcm_gui"));
+    TEST_ASSERT_NULL(strstr(cmd, "run move_anim "));
+    TEST_ASSERT_NULL(strstr(cmd, "run move_snd "));
+}
+
+void test_write_file_rejects_unsafe_names(void) {
+    char cmd[256];
+
+    TEST_ASSERT_TRUE(ssh_cmd_write_file(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", "ring.wav.gz"));
+    TEST_ASSERT_EQUAL_STRING("cat > '/tmp/doorbell-mqtt-unifi/ring.wav.gz'", cmd);
+    TEST_ASSERT_FALSE(ssh_cmd_write_file(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", "../ring.wav.gz"));
+    TEST_ASSERT_FALSE(ssh_cmd_write_file(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi", "it's.wav.gz"));
+}
+
+void test_stat_command_is_quiet_for_missing_files(void) {
+    char cmd[256];
+
+    TEST_ASSERT_TRUE(ssh_cmd_stat(cmd, sizeof(cmd), "/tmp/doorbell-mqtt-unifi-staged/ubnt_lcm_gui.conf.patched"));
+    TEST_ASSERT_EQUAL_STRING("stat -c '%s %Y' '/tmp/doorbell-mqtt-unifi-staged/ubnt_lcm_gui.conf.patched' 2>/dev/null || true", cmd);
+    TEST_ASSERT_FALSE(ssh_cmd_stat(cmd, sizeof(cmd), "/etc/persistent/it's.conf"));
+}
+
+void test_parse_cache_evictions_counts_lines(void) {
+    TEST_ASSERT_EQUAL_INT(0, ssh_parse_cache_evictions(NULL));
+    TEST_ASSERT_EQUAL_INT(0, ssh_parse_cache_evictions(""));
+    TEST_ASSERT_EQUAL_INT(2, ssh_parse_cache_evictions("EVICT " MD5_A "\nEVICT " MD5_B "\n"));
+    TEST_ASSERT_EQUAL_INT(1, ssh_parse_cache_evictions("noise NOT EVICT x\nEVICT " MD5_A "\n"));
+}
+
+void test_parse_step_trace_reads_each_step(void) {
+    const char *err = "TRACE step=ensure_dirs start=100.25 end=100.25\n"
+                      "noise\n"
+                      "TRACE step=restart_services start=100.30 end=102.80\n";
+    const char *cursor = err;
+    ssh_step_trace_t step;
+
+    TEST_ASSERT_TRUE(ssh_parse_step_trace(&cursor, &step));
+    TEST_ASSERT_EQUAL_STRING("ensure_dirs", step.step);
+    TEST_ASSERT_TRUE(ssh_parse_step_trace(&cursor, &step));
+    TEST_ASSERT_EQUAL_STRING("restart_services", step.step);
+    TEST_ASSERT_EQUAL_FLOAT(100.30, step.start_s);
+    TEST_ASSERT_EQUAL_FLOAT(102.80, step.end_s);
+    TEST_ASSERT_FALSE(ssh_parse_step_trace(&cursor, &step));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cache_fetch_copies_entry_and_writes_sidecar);
+    RUN_TEST(test_cache_fetch_rejects_quotes);
+    RUN_TEST(test_cache_store_copies_each_file_then_prunes);
+    RUN_TEST(test_cache_store_fails_when_buffer_too_small);
+    RUN_TEST(test_cache_store_falls_back_to_compressed_upload);
+    RUN_TEST(test_apply_script_decompresses_before_moving);
+    RUN_TEST(test_apply_script_fails_when_buffer_too_small);
+    RUN_TEST(test_conf_script_restarts_only_the_named_service);
+    RUN_TEST(test_write_file_rejects_unsafe_names);
+    RUN_TEST(test_stat_command_is_quiet_for_missing_files);
+    RUN_TEST(test_parse_cache_evictions_counts_lines);
+    RUN_TEST(test_parse_step_trace_reads_each_step);
+
+    return UNITY_END();
+}
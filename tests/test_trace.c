@@ -0,0 +1,181 @@
+#include "third_party/unity/unity.h"
+#include "arena.h"
+#include "cJSON.h"
+#include "errors.h"
+#include "trace.h"
+#include "transport.h"
+#include "unifi_profile_json.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROFILE_DIR "tests/fixtures/profiles/christmas"
+
+static char g_dir[64];
+static char g_path[PATH_MAX];
+
+void setUp(void) {
+    snprintf(g_dir, sizeof(g_dir), "%s", "/tmp/test_trace_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_dir));
+    snprintf(g_path, sizeof(g_path), "%s/.state/%s", g_dir, TRACE_FILE);
+}
+
+void tearDown(void) {
+    trace_stop();
+    utils_delete_directory(g_dir);
+}
+
+static void start_tracing(int max_kb) {
+    char state_dir[PATH_MAX];
+    config_trace_t cfg = { .enabled = 1, .max_kb = max_kb };
+
+    snprintf(state_dir, sizeof(state_dir), "%s/.state", g_dir);
+    TEST_ASSERT_TRUE(trace_start(&cfg, state_dir));
+}
+
+// The file is an unterminated array; close it the way a trace viewer does.
+static cJSON *load_events(void) {
+    char *text = NULL;
+    size_t len = 0;
+
+    trace_flush();
+    TEST_ASSERT_TRUE(utils_read_file(g_path, &text, &len));
+
+    char *closed = malloc(len + 2);
+    TEST_ASSERT_NOT_NULL(closed);
+    memcpy(closed, text, len);
+    arena_free(text);
+
+    while (len > 0 && (closed[len - 1] == '\n' || closed[len - 1] == ',')) {
+        len--;
+    }
+
+    closed[len++] = ']';
+    closed[len] = '\0';
+
+    cJSON *events = cJSON_Parse(closed);
+    free(closed);
+    TEST_ASSERT_NOT_NULL(events);
+
+    return events;
+}
+
+static const cJSON *find_event(const cJSON *events, const char *cat, const char *name) {
+    const cJSON *event;
+
+    cJSON_ArrayForEach(event, events) {
+        const cJSON *c = cJSON_GetObjectItem(event, "cat");
+        const cJSON *n = cJSON_GetObjectItem(event, "name");
+
+        if (cJSON_IsString(c) && cJSON_IsString(n) && strcmp(c->valuestring, cat) == 0 && strcmp(n->valuestring, name) == 0) {
+            return event;
+        }
+    }
+
+    return NULL;
+}
+
+void test_disabled_tracing_records_nothing(void) {
+    config_trace_t cfg = { .enabled = 0, .max_kb = 64 };
+
+    TEST_ASSERT_TRUE(trace_start(&cfg, g_dir));
+    TEST_ASSERT_FALSE(trace_enabled());
+    TEST_ASSERT_EQUAL_UINT64(0, trace_begin());
+
+    trace_end(trace_begin(), "test", "ignored", NULL, 0);
+    TEST_ASSERT_FALSE(utils_file_exists(g_path));
+}
+
+void test_spans_are_chrome_trace_events(void) {
+    start_tracing(64);
+
+    uint64_t outer = trace_begin();
+    uint64_t inner = trace_begin();
+
+    TEST_ASSERT_TRUE(outer > 0);
+    trace_end(inner, "ssh", "upload", "say \"cheese\"", 4096);
+    trace_end(outer, "router", "dispatch", NULL, 0);
+
+    cJSON *events = load_events();
+    const cJSON *upload = find_event(events, "ssh", "upload");
+    const cJSON *dispatch = find_event(events, "router", "dispatch");
+
+    TEST_ASSERT_EQUAL_INT(2, cJSON_GetArraySize(events));
+    TEST_ASSERT_NOT_NULL(upload);
+    TEST_ASSERT_NOT_NULL(dispatch);
+    TEST_ASSERT_EQUAL_STRING("X", cJSON_GetObjectItem(upload, "ph")->valuestring);
+    TEST_ASSERT_EQUAL_STRING("ssh", cJSON_GetObjectItem(upload, "cat")->valuestring);
+
+    const cJSON *args = cJSON_GetObjectItem(upload, "args");
+    TEST_ASSERT_EQUAL_STRING("say \"cheese\"", cJSON_GetObjectItem(args, "detail")->valuestring);
+    TEST_ASSERT_EQUAL_INT(4096, cJSON_GetObjectItem(args, "bytes")->valueint);
+
+    // Same thread and the inner span lies within the outer one, so a viewer nests them.
+    double outer_ts = cJSON_GetObjectItem(dispatch, "ts")->valuedouble;
+    double outer_end = outer_ts + cJSON_GetObjectItem(dispatch, "dur")->valuedouble;
+    double inner_ts = cJSON_GetObjectItem(upload, "ts")->valuedouble;
+
+    TEST_ASSERT_EQUAL_INT(cJSON_GetObjectItem(dispatch, "tid")->valueint, cJSON_GetObjectItem(upload, "tid")->valueint);
+    TEST_ASSERT_TRUE(inner_ts >= outer_ts);
+    TEST_ASSERT_TRUE(inner_ts + cJSON_GetObjectItem(upload, "dur")->valuedouble <= outer_end);
+
+    cJSON_Delete(events);
+}
+
+void test_file_rotates_past_its_budget(void) {
+    char rotated[PATH_MAX + 2];
+
+    start_tracing(1);
+
+    for (int i = 0; i < 20; i++) {
+        trace_end(trace_begin(), "test", "span", "padding padding padding padding", i + 1);
+    }
+
+    snprintf(rotated, sizeof(rotated), "%s.1", g_path);
+    TEST_ASSERT_TRUE(utils_file_exists(rotated));
+
+    cJSON *events = load_events();
+    TEST_ASSERT_TRUE(cJSON_GetArraySize(events) < 20);
+    cJSON_Delete(events);
+}
+
+void test_apply_records_transfers_and_script_steps(void) {
+    config_sim_t sim = {0};
+    unifi_profile_t profile;
+
+    snprintf(sim.root, sizeof(sim.root), "%s/device", g_dir);
+
+    start_tracing(1024);
+
+    transport_t *transport = transport_sim_open(&sim);
+    TEST_ASSERT_NOT_NULL(transport);
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(transport, PROFILE_DIR, &profile, false, NULL));
+    transport_close(transport);
+
+    cJSON *events = load_events();
+    const cJSON *upload = find_event(events, "apply", "upload");
+
+    TEST_ASSERT_NOT_NULL(upload);
+    TEST_ASSERT_TRUE(cJSON_GetObjectItem(cJSON_GetObjectItem(upload, "args"), "bytes")->valueint > 0);
+    TEST_ASSERT_NOT_NULL(find_event(events, "apply", "script"));
+    TEST_ASSERT_NOT_NULL(find_event(events, "apply", "ensure_dirs"));
+    TEST_ASSERT_NOT_NULL(find_event(events, "apply", "restart_services"));
+
+    cJSON_Delete(events);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_disabled_tracing_records_nothing);
+    RUN_TEST(test_spans_are_chrome_trace_events);
+    RUN_TEST(test_file_rotates_past_its_budget);
+    RUN_TEST(test_apply_records_transfers_and_script_steps);
+
+    return UNITY_END();
+}
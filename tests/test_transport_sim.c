@@ -0,0 +1,245 @@
+#include "third_party/unity/unity.h"
+#include "arena.h"
+#include "errors.h"
+#include "transport.h"
+#include "unifi_profile_conf.h"
+#include "unifi_profile_json.h"
+#include "unifi_remote.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROFILE_DIR "tests/fixtures/profiles/christmas"
+
+static char g_root[64];
+static config_sim_t g_sim;
+static transport_t *g_transport;
+
+void setUp(void) {
+    snprintf(g_root, sizeof(g_root), "%s", "/tmp/test_transport_sim_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_root));
+
+    memset(&g_sim, 0, sizeof(g_sim));
+    snprintf(g_sim.root, sizeof(g_sim.root), "%s", g_root);
+
+    g_transport = transport_sim_open(&g_sim);
+    TEST_ASSERT_NOT_NULL(g_transport);
+}
+
+void tearDown(void) {
+    transport_close(g_transport);
+    utils_delete_directory(g_root);
+}
+
+static bool device_file_exists(const char *device_path) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s%s", g_root, device_path);
+
+    return utils_file_exists(path);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+void test_exec_runs_against_the_device_root(void) {
+    char *out = NULL;
+    char *err = NULL;
+    size_t out_len = 0;
+    transport_stat_t st;
+
+    TEST_ASSERT_EQUAL_STRING("sim", transport_name(g_transport));
+    TEST_ASSERT_TRUE(transport_exec_write(g_transport, "cat > '/etc/persistent/note.txt'", "hello", 5));
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/note.txt"));
+
+    TEST_ASSERT_TRUE(transport_exec(g_transport, "cat '/etc/persistent/note.txt'", &out, &out_len, NULL, NULL));
+    TEST_ASSERT_EQUAL_size_t(5, out_len);
+    TEST_ASSERT_EQUAL_STRING("hello", out);
+    arena_free(out);
+
+    TEST_ASSERT_TRUE(transport_stat(g_transport, "/etc/persistent/note.txt", &st));
+    TEST_ASSERT_EQUAL_INT(5, (int)st.size);
+    TEST_ASSERT_FALSE(transport_stat(g_transport, "/etc/persistent/missing.txt", &st));
+    TEST_ASSERT_FALSE(transport_stat(g_transport, "/etc/passwd", &st));
+
+    // A failing command reports its exit status and keeps its stderr, like an SSH channel.
+    TEST_ASSERT_FALSE(transport_exec(g_transport, "echo oops 1>&2; exit 3", NULL, NULL, &err, NULL));
+    TEST_ASSERT_EQUAL_STRING("oops\n", err);
+    arena_free(err);
+}
+
+void test_apply_then_download_round_trips_the_profile(void) {
+    unifi_profile_t profile;
+    unifi_profile_t device;
+    unifi_apply_stats_t stats = {0};
+    char tmp_dir[] = "/tmp/test_transport_sim_download_XXXXXX";
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, &stats));
+    TEST_ASSERT_TRUE(stats.bytes_sent > 0);
+
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/lcm/animation/christmas1.png.anim"));
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/lcm/animation/christmas1.png.md5"));
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/sounds/christmas.ogg"));
+
+    TEST_ASSERT_NOT_NULL(mkdtemp(tmp_dir));
+    TEST_ASSERT_TRUE(unifi_profile_download_and_load(g_transport, tmp_dir, NULL, &device));
+    utils_delete_directory(tmp_dir);
+
+    TEST_ASSERT_TRUE(device.welcome.enabled);
+    TEST_ASSERT_EQUAL_STRING("christmas1.png", device.welcome.file);
+    TEST_ASSERT_TRUE(device.ring_button.enabled);
+    TEST_ASSERT_EQUAL_STRING("christmas.ogg", device.ring_button.file);
+}
+
+void test_reapplying_the_running_profile_changes_nothing(void) {
+    unifi_profile_t profile;
+    unifi_apply_stats_t stats = {0};
+    static const char other_md5[] = "00000000000000000000000000000000";
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, &stats));
+    TEST_ASSERT_FALSE(stats.unchanged);
+
+    // A full apply empties the sounds directory before moving the new sound in, so this marks a skipped apply.
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, "x", 1, "/etc/persistent/sounds", "marker", 0644));
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, &stats));
+    TEST_ASSERT_TRUE(stats.unchanged);
+    TEST_ASSERT_EQUAL_INT(0, (int)stats.bytes_sent);
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/sounds/marker"));
+
+    // A conf value that differs from the device's.
+    profile.ring_button.volume = 50;
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, &stats));
+    TEST_ASSERT_FALSE(stats.unchanged);
+    TEST_ASSERT_FALSE(device_file_exists("/etc/persistent/sounds/marker"));
+
+    // An asset whose sidecar names other content.
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, other_md5, 32, "/etc/persistent/lcm/animation", "christmas1.png.md5", 0644));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, &stats));
+    TEST_ASSERT_FALSE(stats.unchanged);
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, true, &stats));
+    TEST_ASSERT_FALSE(stats.unchanged);
+    TEST_ASSERT_TRUE(stats.bytes_sent > 0);
+}
+
+// The simulator's killall records each killed service under .sim/run; clear the records of earlier restarts.
+static void forget_restarts(void) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/.sim/run/ubnt_lcm_gui", g_root);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/.sim/run/ubnt_sounds_leds", g_root);
+    remove(path);
+}
+
+void test_params_update_replaces_one_conf_and_restarts_one_service(void) {
+    unifi_profile_t profile;
+    unifi_profile_t current;
+    unifi_profile_t device;
+    unifi_apply_stats_t stats = {0};
+    unifi_profile_params_t volume = { .has_volume = true, .volume = 42 };
+    unifi_profile_params_t loop = { .has_loop = true, .loop = true };
+    char conf_path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_upload_and_apply(g_transport, PROFILE_DIR, &profile, false, NULL));
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, "x", 1, "/etc/persistent/sounds", "marker", 0644));
+    forget_restarts();
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_apply_params(g_transport, &volume, &current, &stats));
+    TEST_ASSERT_FALSE(stats.unchanged);
+    TEST_ASSERT_EQUAL_INT(42, current.ring_button.volume);
+    TEST_ASSERT_TRUE(device_file_exists("/.sim/run/ubnt_sounds_leds"));
+    TEST_ASSERT_FALSE(device_file_exists("/.sim/run/ubnt_lcm_gui"));
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/sounds/marker"));
+
+    snprintf(conf_path, sizeof(conf_path), "%s/etc/persistent/ubnt_sounds_leds.conf", g_root);
+    memset(&device, 0, sizeof(device));
+    TEST_ASSERT_TRUE(unifi_profile_read_from_sounds_leds_conf(conf_path, &device));
+    TEST_ASSERT_EQUAL_INT(42, device.ring_button.volume);
+    TEST_ASSERT_EQUAL_INT(profile.ring_button.repeat_times, device.ring_button.repeat_times);
+
+    forget_restarts();
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_apply_params(g_transport, &volume, &current, &stats));
+    TEST_ASSERT_TRUE(stats.unchanged);
+    TEST_ASSERT_FALSE(device_file_exists("/.sim/run/ubnt_sounds_leds"));
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_apply_params(g_transport, &loop, &current, &stats));
+    TEST_ASSERT_TRUE(current.welcome.loop);
+    TEST_ASSERT_TRUE(device_file_exists("/.sim/run/ubnt_lcm_gui"));
+    TEST_ASSERT_FALSE(device_file_exists("/.sim/run/ubnt_sounds_leds"));
+}
+
+void test_params_update_runs_without_a_prior_apply(void) {
+    static const char lcm_conf[] = "{\"customAnimations\":[{\"guiId\":\"WELCOME\",\"file\":\"wave.png\",\"count\":1,\"durationMs\":1000,\"enable\":true,\"loop\":false}]}";
+    static const char sounds_conf[] = "{\"customSounds\":[{\"soundStateName\":\"RING_BUTTON_PRESSED\",\"file\":\"ding.wav\",\"enable\":true,\"repeatTimes\":1,\"volume\":100}]}";
+    unifi_profile_t current;
+    unifi_profile_params_t volume = { .has_volume = true, .volume = 42 };
+
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, lcm_conf, strlen(lcm_conf), "/etc/persistent", "ubnt_lcm_gui.conf", 0644));
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, sounds_conf, strlen(sounds_conf), "/etc/persistent", "ubnt_sounds_leds.conf", 0644));
+
+    // As after startup, which clears the local work area that applies create.
+    utils_delete_directory("/tmp/doorbell-mqtt-unifi");
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_apply_params(g_transport, &volume, &current, NULL));
+    TEST_ASSERT_EQUAL_INT(42, current.ring_button.volume);
+    TEST_ASSERT_TRUE(device_file_exists("/.sim/run/ubnt_sounds_leds"));
+}
+
+void test_cutover_needs_a_staged_profile(void) {
+    unifi_profile_t profile;
+    unifi_apply_plan_t plan;
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(PROFILE_DIR, &profile));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_apply_plan_prepare(PROFILE_DIR, &profile, &plan));
+
+    TEST_ASSERT_EQUAL_INT(ERROR_PROFILE_APPLY_MISSING_TMP_FILES, unifi_profile_cutover(g_transport, &plan));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_stage_plan(g_transport, &plan, NULL));
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, unifi_profile_cutover(g_transport, &plan));
+    TEST_ASSERT_TRUE(device_file_exists("/etc/persistent/sounds/christmas.ogg"));
+
+    unifi_apply_plan_release(&plan);
+}
+
+void test_latency_and_bandwidth_are_simulated(void) {
+    static const char data[10000];
+
+    transport_close(g_transport);
+    g_sim.latency_ms = 20;
+    g_sim.bandwidth_kbps = 800;
+    g_transport = transport_sim_open(&g_sim);
+    TEST_ASSERT_NOT_NULL(g_transport);
+
+    TEST_ASSERT_EQUAL_FLOAT(20, transport_rtt_ms(g_transport));
+
+    // 10000 bytes at 800 kbit/s take 100 ms on top of the 20 ms round trip.
+    double start = now_ms();
+    TEST_ASSERT_TRUE(transport_upload_buffer(g_transport, data, sizeof(data), UNIFI_REMOTE_UPLOAD_DIR, "blob.bin", 0644));
+    TEST_ASSERT_TRUE(now_ms() - start >= 120);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_exec_runs_against_the_device_root);
+    RUN_TEST(test_apply_then_download_round_trips_the_profile);
+    RUN_TEST(test_reapplying_the_running_profile_changes_nothing);
+    RUN_TEST(test_params_update_replaces_one_conf_and_restarts_one_service);
+    RUN_TEST(test_params_update_runs_without_a_prior_apply);
+    RUN_TEST(test_cutover_needs_a_staged_profile);
+    RUN_TEST(test_latency_and_bandwidth_are_simulated);
+
+    return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include "third_party/unity/unity.h"
+#include "arena.h"
+#include "unifi_profile.h"
+#include "unifi_profile_bundle.h"
+#include "unifi_profile_json.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PROFILE_JSON \
+    "{\"schemaVersion\":1," \
+    "\"welcome\":{\"enabled\":true,\"file\":\"anim.png\",\"count\":2,\"durationMs\":500,\"loop\":false}," \
+    "\"ringButton\":{\"enabled\":true,\"file\":\"ring.ogg\",\"repeatTimes\":1,\"volume\":80}}"
+
+static char g_dir[PATH_MAX];
+static char g_bundle[PATH_MAX];
+
+static void write_in_dir(const char *name, const char *content) {
+    char path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), g_dir, name));
+    TEST_ASSERT_TRUE(utils_write_file(path, content));
+}
+
+void setUp(void) {
+    snprintf(g_dir, sizeof(g_dir), "%s", "/tmp/test_bundle_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(g_dir));
+    TEST_ASSERT_TRUE(utils_build_path(g_bundle, sizeof(g_bundle), g_dir, UNIFI_BUNDLE_FILE));
+
+    write_in_dir("profile.json", PROFILE_JSON);
+    write_in_dir("anim.png", "sprite-bytes");
+    write_in_dir("ring.ogg", "ogg-bytes");
+}
+
+void tearDown(void) {
+    utils_delete_directory(g_dir);
+}
+
+void test_bundle_pack_and_open_round_trip(void) {
+    unifi_bundle_t bundle;
+    char path[PATH_MAX];
+    char md5_hex[33];
+
+    TEST_ASSERT_TRUE(unifi_bundle_pack_dir(g_dir, g_bundle));
+    TEST_ASSERT_TRUE(unifi_bundle_open(g_bundle, &bundle));
+
+    TEST_ASSERT_EQUAL_size_t(2, bundle.asset_count);
+    TEST_ASSERT_EQUAL_size_t(strlen(PROFILE_JSON), bundle.json_len);
+
+    const unifi_bundle_asset_t *ring = unifi_bundle_find(&bundle, "ring.ogg");
+    TEST_ASSERT_NOT_NULL(ring);
+    TEST_ASSERT_EQUAL_size_t(9, ring->size);
+    TEST_ASSERT_EQUAL_MEMORY("ogg-bytes", ring->data, 9);
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), g_dir, "ring.ogg"));
+    TEST_ASSERT_TRUE(utils_md5_file_hex(path, md5_hex));
+    TEST_ASSERT_EQUAL_STRING(md5_hex, ring->md5_hex);
+
+    TEST_ASSERT_NULL(unifi_bundle_find(&bundle, "missing.png"));
+
+    unifi_bundle_close(&bundle);
+}
+
+void test_bundle_is_preferred_over_loose_profile(void) {
+    char path[PATH_MAX];
+    unifi_profile_t profile;
+
+    TEST_ASSERT_TRUE(unifi_bundle_pack_dir(g_dir, g_bundle));
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), g_dir, "profile.json"));
+    TEST_ASSERT_EQUAL_INT(0, unlink(path));
+
+    TEST_ASSERT_TRUE(unifi_profile_load_from_file(g_dir, &profile));
+    TEST_ASSERT_EQUAL_STRING("anim.png", profile.welcome.file);
+    TEST_ASSERT_EQUAL_INT(500, profile.welcome.duration_ms);
+    TEST_ASSERT_EQUAL_INT(80, profile.ring_button.volume);
+}
+
+void test_bundle_open_rejects_truncated_file(void) {
+    unifi_bundle_t bundle;
+    char *content = NULL;
+    size_t len = 0;
+
+    TEST_ASSERT_TRUE(unifi_bundle_pack_dir(g_dir, g_bundle));
+    TEST_ASSERT_TRUE(utils_read_file(g_bundle, &content, &len));
+    arena_free(content);
+
+    TEST_ASSERT_EQUAL_INT(0, truncate(g_bundle, (off_t)len - 1));
+    TEST_ASSERT_FALSE(unifi_bundle_open(g_bundle, &bundle));
+    TEST_ASSERT_NULL(bundle.map);
+}
+
+void test_bundle_pack_fails_for_missing_enabled_asset(void) {
+    char path[PATH_MAX];
+
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), g_dir, "anim.png"));
+    TEST_ASSERT_EQUAL_INT(0, unlink(path));
+
+    TEST_ASSERT_FALSE(unifi_bundle_pack_dir(g_dir, g_bundle));
+    TEST_ASSERT_FALSE(utils_file_exists(g_bundle));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_bundle_pack_and_open_round_trip);
+    RUN_TEST(test_bundle_is_preferred_over_loose_profile);
+    RUN_TEST(test_bundle_open_rejects_truncated_file);
+    RUN_TEST(test_bundle_pack_fails_for_missing_enabled_asset);
+
+    return UNITY_END();
+}
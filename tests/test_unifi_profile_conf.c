@@ -0,0 +1,164 @@
+#include "third_party/unity/unity.h"
+#include "cJSON.h"
+#include "unifi_profile_conf.h"
+#include "utils.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LCM_CONF \
+    "{\n" \
+    "    \"brightness\": 80,\n" \
+    "    \"customAnimations\": [\n" \
+    "        {\"guiId\": \"IDLE\", \"file\": \"idle.png\", \"count\": 1},\n" \
+    "        {\"guiId\": \"WELCOME\", \"file\": \"old.png\", \"count\": 2, \"durationMs\": 100, \"enable\": false, \"loop\": false, \"extra\": [1, {\"a\": \"}\"}]},\n" \
+    "        {\"guiId\": \"RING\", \"file\": \"ring.png\"}\n" \
+    "    ]\n" \
+    "}\n"
+
+static unifi_profile_t g_profile;
+static char *g_out;
+static size_t g_out_len;
+
+void setUp(void) {
+    memset(&g_profile, 0, sizeof(g_profile));
+    g_profile.welcome.enabled = true;
+    g_profile.welcome.count = 24;
+    g_profile.welcome.duration_ms = 3000;
+    g_profile.welcome.loop = true;
+    snprintf(g_profile.welcome.file, sizeof(g_profile.welcome.file), "%s", "christmas.png");
+
+    g_profile.ring_button.enabled = true;
+    g_profile.ring_button.repeat_times = 2;
+    g_profile.ring_button.volume = 75;
+    snprintf(g_profile.ring_button.file, sizeof(g_profile.ring_button.file), "%s", "bells \"jingle\".wav");
+
+    g_out = NULL;
+    g_out_len = 0;
+}
+
+void tearDown(void) {
+    free(g_out);
+}
+
+static cJSON *find_entry(cJSON *root, const char *array_key, const char *id_key, const char *id_value) {
+    cJSON *item = NULL;
+
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(root, array_key)) {
+        cJSON *id = cJSON_GetObjectItemCaseSensitive(item, id_key);
+
+        if (cJSON_IsString(id) && strcmp(id->valuestring, id_value) == 0) {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+void test_patch_lcm_splices_existing_welcome_entry(void) {
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(LCM_CONF, strlen(LCM_CONF), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_EQUAL_UINT(strlen(g_out), g_out_len);
+
+    // Only the values changed; layout and unrelated members are byte-identical.
+    TEST_ASSERT_NOT_NULL(strstr(g_out, "{\"guiId\": \"WELCOME\", \"file\": \"christmas.png\", \"count\": 24, \"durationMs\": 3000, \"enable\": true, \"loop\": true, \"extra\": [1, {\"a\": \"}\"}]},\n"));
+    TEST_ASSERT_EQUAL_STRING_LEN(LCM_CONF, g_out, strstr(LCM_CONF, "{\"guiId\": \"WELCOME\"") - LCM_CONF);
+    TEST_ASSERT_NOT_NULL(strstr(g_out, "{\"guiId\": \"RING\", \"file\": \"ring.png\"}\n    ]\n}\n"));
+}
+
+void test_patch_lcm_appends_missing_welcome_entry(void) {
+    const char *conf = "{\"customAnimations\":[{\"guiId\":\"IDLE\"}],\"x\":1}";
+
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(conf, strlen(conf), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_EQUAL_STRING("{\"customAnimations\":[{\"guiId\":\"IDLE\"},{\"guiId\":\"WELCOME\",\"count\":24,\"durationMs\":3000,\"enable\":true,\"file\":\"christmas.png\",\"loop\":true}],\"x\":1}", g_out);
+    free(g_out);
+
+    conf = "{ }";
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(conf, strlen(conf), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_EQUAL_STRING("{ \"customAnimations\":[{\"guiId\":\"WELCOME\",\"count\":24,\"durationMs\":3000,\"enable\":true,\"file\":\"christmas.png\",\"loop\":true}]}", g_out);
+}
+
+void test_patch_lcm_removes_disabled_welcome_entry(void) {
+    g_profile.welcome.enabled = false;
+
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(LCM_CONF, strlen(LCM_CONF), &g_profile, &g_out, &g_out_len));
+
+    cJSON *root = cJSON_Parse(g_out);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_NULL(find_entry(root, "customAnimations", "guiId", "WELCOME"));
+    TEST_ASSERT_NOT_NULL(find_entry(root, "customAnimations", "guiId", "IDLE"));
+    TEST_ASSERT_NOT_NULL(find_entry(root, "customAnimations", "guiId", "RING"));
+    cJSON_Delete(root);
+    free(g_out);
+
+    const char *first = "{\"customAnimations\": [{\"guiId\":\"WELCOME\"}, {\"guiId\":\"IDLE\"}]}";
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(first, strlen(first), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_EQUAL_STRING("{\"customAnimations\": [{\"guiId\":\"IDLE\"}]}", g_out);
+}
+
+void test_patch_sounds_adds_missing_fields_and_escapes_file(void) {
+    const char *conf = "{\"customSounds\":[{\"soundStateName\":\"RING_BUTTON_PRESSED\",\"file\":\"old.wav\",\"enable\":false}]}";
+    unifi_profile_t read_back;
+
+    TEST_ASSERT_TRUE(unifi_profile_patch_sounds_leds_buffer(conf, strlen(conf), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_EQUAL_STRING("{\"customSounds\":[{\"soundStateName\":\"RING_BUTTON_PRESSED\",\"file\":\"bells \\\"jingle\\\".wav\",\"enable\":true,\"repeatTimes\":2,\"volume\":75}]}", g_out);
+
+    char dir[] = "/tmp/test_unifi_profile_conf_XXXXXX";
+    char path[PATH_MAX];
+
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    TEST_ASSERT_TRUE(utils_build_path(path, sizeof(path), dir, "ubnt_sounds_leds.conf"));
+    TEST_ASSERT_TRUE(utils_write_file(path, g_out));
+    TEST_ASSERT_TRUE(unifi_profile_read_from_sounds_leds_conf(path, &read_back));
+    TEST_ASSERT_EQUAL_STRING(g_profile.ring_button.file, read_back.ring_button.file);
+    TEST_ASSERT_EQUAL_INT(75, read_back.ring_button.volume);
+    utils_delete_directory(dir);
+}
+
+void test_patch_rejects_malformed_conf(void) {
+    const char *confs[] = {
+        "",
+        "[]",
+        "{\"customAnimations\":[{\"guiId\":\"WELCOME\"}",
+        "{\"customAnimations\":[{\"guiId\":\"WELCOME]}}",
+        "{\"a\":1} trailing",
+    };
+
+    for (size_t i = 0; i < sizeof(confs) / sizeof(confs[0]); i++) {
+        TEST_ASSERT_FALSE(unifi_profile_patch_lcm_gui_buffer(confs[i], strlen(confs[i]), &g_profile, &g_out, &g_out_len));
+        TEST_ASSERT_NULL(g_out);
+    }
+}
+
+void test_conf_equivalence_ignores_layout_but_not_values(void) {
+    char *again = NULL;
+    size_t again_len = 0;
+    const char *reordered = "{\"b\":[1,2],\"a\":{\"y\":true,\"x\":\"s\"}}";
+    const char *spaced = "{ \"a\": { \"x\": \"s\", \"y\": true },\n  \"b\": [ 1, 2 ] }";
+    const char *changed = "{\"a\":{\"x\":\"s\",\"y\":false},\"b\":[1,2]}";
+
+    TEST_ASSERT_TRUE(unifi_profile_conf_equivalent(reordered, strlen(reordered), spaced, strlen(spaced)));
+    TEST_ASSERT_FALSE(unifi_profile_conf_equivalent(reordered, strlen(reordered), changed, strlen(changed)));
+    TEST_ASSERT_FALSE(unifi_profile_conf_equivalent(reordered, strlen(reordered), "{", 1));
+
+    // Patching a conf that already holds the desired values changes nothing.
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(LCM_CONF, strlen(LCM_CONF), &g_profile, &g_out, &g_out_len));
+    TEST_ASSERT_FALSE(unifi_profile_conf_equivalent(LCM_CONF, strlen(LCM_CONF), g_out, g_out_len));
+    TEST_ASSERT_TRUE(unifi_profile_patch_lcm_gui_buffer(g_out, g_out_len, &g_profile, &again, &again_len));
+    TEST_ASSERT_TRUE(unifi_profile_conf_equivalent(g_out, g_out_len, again, again_len));
+    free(again);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_patch_lcm_splices_existing_welcome_entry);
+    RUN_TEST(test_patch_lcm_appends_missing_welcome_entry);
+    RUN_TEST(test_patch_lcm_removes_disabled_welcome_entry);
+    RUN_TEST(test_patch_sounds_adds_missing_fields_and_escapes_file);
+    RUN_TEST(test_patch_rejects_malformed_conf);
+    RUN_TEST(test_conf_equivalence_ignores_layout_but_not_values);
+
+    return UNITY_END();
+}
@@ -2,6 +2,7 @@
 #include "support/test_config_mock.h"
 #include "config.h"
 #include "config_types.h"
+#include "errors.h"
 #include "unifi_profiles_repo.h"
 
 static config_t g_cfg;
@@ -11,6 +12,7 @@ void setUp(void) {
 } 
 
 void tearDown(void) { 
+    profiles_repo_shutdown();
     config_free(&g_cfg); 
 }
 
@@ -50,6 +52,91 @@ void test_unifi_profiles_repo_resolve_custom_returns_valid_profile_directory(voi
     profiles_repo_shutdown();
 }
 
+void test_unifi_profiles_repo_acquire_preset_is_case_and_space_insensitive(void) {
+    profiles_repo_init("tests/fixtures/profiles", &g_cfg.preset_cfg);
+
+    const profiles_preset_t *preset = NULL;
+
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profiles_repo_acquire_preset("  CHRISTMAS ", &preset));
+    TEST_ASSERT_NOT_NULL(preset);
+    TEST_ASSERT_EQUAL_STRING("Christmas", preset->name);
+    TEST_ASSERT_TRUE(preset->plan.profile.welcome.enabled);
+    TEST_ASSERT_EQUAL_STRING("tests/fixtures/profiles/christmas/christmas1.png", preset->plan.image_path);
+    // The fixture assets are empty files.
+    TEST_ASSERT_EQUAL_STRING("d41d8cd98f00b204e9800998ecf8427e", preset->plan.sound_md5);
+    TEST_ASSERT_EQUAL_INT64(0, preset->sound_size);
+
+    profiles_repo_release_preset(preset);
+    profiles_repo_shutdown();
+}
+
+void test_unifi_profiles_repo_acquire_preset_reports_missing_profiles(void) {
+    profiles_repo_init("tests/fixtures/profiles", &g_cfg.preset_cfg);
+
+    const profiles_preset_t *preset = NULL;
+
+    // Configured, but its directory does not exist.
+    TEST_ASSERT_EQUAL_INT(ERROR_PROFILE_NOT_FOUND, profiles_repo_acquire_preset("Labor Day", &preset));
+    TEST_ASSERT_NULL(preset);
+
+    TEST_ASSERT_EQUAL_INT(ERROR_PROFILE_NOT_FOUND, profiles_repo_acquire_preset("Halloween", &preset));
+    TEST_ASSERT_NULL(preset);
+
+    profiles_repo_shutdown();
+}
+
+void test_unifi_profiles_repo_reload_keeps_unchanged_presets(void) {
+    profiles_repo_init("tests/fixtures/profiles", &g_cfg.preset_cfg);
+
+    const profiles_preset_t *before = NULL;
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profiles_repo_acquire_preset("Christmas", &before));
+    profiles_repo_release_preset(before);
+
+    // Labor Day is dropped and Halloween added; Christmas is untouched.
+    config_preset_item_t items[] = {
+        { .display_name = "Christmas", .key_name = "christmas", .directory = "christmas" },
+        { .display_name = "Halloween", .key_name = "halloween", .directory = "halloween" }
+    };
+    config_preset_t next = { .items = items, .count = 2 };
+    bool names_changed = false;
+
+    TEST_ASSERT_TRUE(profiles_repo_reload_presets(&next, &names_changed));
+    TEST_ASSERT_TRUE(names_changed);
+
+    const profiles_preset_t *after = NULL;
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profiles_repo_acquire_preset("christmas", &after));
+    TEST_ASSERT_EQUAL_PTR(before, after);
+    profiles_repo_release_preset(after);
+
+    TEST_ASSERT_EQUAL_INT(ERROR_PROFILE_NOT_FOUND, profiles_repo_acquire_preset("Labor Day", &after));
+
+    cJSON *names = cJSON_CreateArray();
+    TEST_ASSERT_EQUAL_size_t(2, profiles_repo_add_preset_names(names));
+    TEST_ASSERT_EQUAL_STRING("Halloween", cJSON_GetArrayItem(names, 1)->valuestring);
+    cJSON_Delete(names);
+}
+
+void test_unifi_profiles_repo_reindex_keeps_acquired_preset_alive(void) {
+    profiles_repo_init("tests/fixtures/profiles", &g_cfg.preset_cfg);
+
+    const profiles_preset_t *held = NULL;
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profiles_repo_acquire_preset("Christmas", &held));
+
+    TEST_ASSERT_TRUE(profiles_repo_reindex_directory("christmas"));
+    TEST_ASSERT_FALSE(profiles_repo_reindex_directory("custom"));
+
+    // The held entry was retired by the re-index but stays usable until released.
+    TEST_ASSERT_TRUE(held->retired);
+    TEST_ASSERT_EQUAL_STRING("Christmas", held->name);
+
+    const profiles_preset_t *fresh = NULL;
+    TEST_ASSERT_EQUAL_INT(ERROR_NONE, profiles_repo_acquire_preset("Christmas", &fresh));
+    TEST_ASSERT_TRUE(fresh != held);
+
+    profiles_repo_release_preset(fresh);
+    profiles_repo_release_preset(held);
+}
+
 int main(void) {
     UNITY_BEGIN();
     
@@ -57,6 +144,10 @@ int main(void) {
     RUN_TEST(test_unifi_profiles_repo_init_succeeds_for_valid_dir);
     RUN_TEST(test_unifi_profiles_repo_resolve_preset_returns_valid_profile_directory);
     RUN_TEST(test_unifi_profiles_repo_resolve_custom_returns_valid_profile_directory);
+    RUN_TEST(test_unifi_profiles_repo_acquire_preset_is_case_and_space_insensitive);
+    RUN_TEST(test_unifi_profiles_repo_acquire_preset_reports_missing_profiles);
+    RUN_TEST(test_unifi_profiles_repo_reload_keeps_unchanged_presets);
+    RUN_TEST(test_unifi_profiles_repo_reindex_keeps_acquired_preset_alive);
 
     return UNITY_END();
 }
\ No newline at end of file